@@ -824,7 +824,7 @@ create_managers(void) {
 	}
 
 	result = isc_socketmgr_create2(named_g_mctx, &named_g_socketmgr,
-				       maxsocks);
+				       maxsocks, named_g_cpus);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socketmgr_create() failed: %s",
@@ -838,6 +838,12 @@ create_managers(void) {
 			      NAMED_LOGMODULE_SERVER,
 			      ISC_LOG_INFO, "using up to %u sockets", socks);
 	}
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "using %d socket watcher thread%s",
+		      isc_socketmgr_getnthreads(named_g_socketmgr),
+		      isc_socketmgr_getnthreads(named_g_socketmgr) == 1 ?
+		      "" : "s");
 
 	return (ISC_R_SUCCESS);
 }
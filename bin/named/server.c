@@ -70,6 +70,7 @@
 #include <dns/events.h>
 #include <dns/forward.h>
 #include <dns/fixedname.h>
+#include <dns/hotnames.h>
 #include <dns/journal.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
@@ -3680,6 +3681,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	unsigned int resopts = 0;
 	dns_zone_t *zone = NULL;
 	uint32_t max_clients_per_query;
+	uint32_t hotnames, hotrate;
 	bool empty_zones_enable;
 	const cfg_obj_t *disablelist = NULL;
 	isc_stats_t *resstats = NULL;
@@ -4452,6 +4454,10 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	if (resolver_param > 0)
 		dns_resolver_setnonbackofftries(view->resolver, resolver_param);
 
+	obj = NULL;
+	CHECK(named_config_get(maps, "resolver-hedge-queries", &obj));
+	dns_resolver_sethedging(view->resolver, cfg_obj_asboolean(obj));
+
 	/*
 	 * Set supported DNSSEC algorithms.
 	 */
@@ -5044,6 +5050,20 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 			view->prefetch_eligible = view->prefetch_trigger + 6;
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "prefetch-hot-names", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	hotnames = cfg_obj_asuint32(obj);
+	obj = NULL;
+	result = named_config_get(maps, "prefetch-hot-rate", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	hotrate = cfg_obj_asuint32(obj);
+	if (view->prefetch_trigger != 0 && hotnames != 0 && hotrate != 0) {
+		CHECK(dns_hotnames_create(mctx, view, named_g_taskmgr,
+					  named_g_timermgr, hotnames, hotrate,
+					  &view->hotnames));
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "dnssec-enable", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -8344,6 +8364,21 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 	ns_interfacemgr_setbacklog(server->interfacemgr, backlog);
 
+	/*
+	 * Shard the UDP listeners with SO_REUSEPORT?
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "reuseport", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_interfacemgr_setreuseport(server->interfacemgr,
+				     cfg_obj_asboolean(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "udp-batch-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_interfacemgr_setudpbatch(server->interfacemgr,
+				    cfg_obj_asuint32(obj));
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -10844,6 +10879,10 @@ named_server_dumprecursing(named_server_t *server) {
 			view->name);
 		dns_resolver_dumpfetches(view->resolver,
 					 isc_statsformat_file, fp);
+		fprintf(fp, ";\n; Fetch buckets [view: %s]\n;\n",
+			view->name);
+		dns_resolver_dumpbuckets(view->resolver,
+					 isc_statsformat_file, fp);
 	}
 
 	fprintf(fp, "; Dump complete\n");
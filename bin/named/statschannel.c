@@ -314,6 +314,15 @@ init_desc(void) {
 		       "QryUsedStale");
 	SET_NSSTATDESC(prefetch, "queries triggered prefetch", "Prefetch");
 	SET_NSSTATDESC(keytagopt, "Keytag option received", "KeyTagOpt");
+	SET_NSSTATDESC(synthrecavoided,
+		       "recursions avoided by synthesizing from NSEC records",
+		       "SynthRecAvoided");
+	SET_NSSTATDESC(recursjoin,
+		       "queries that joined an identical query's recursion",
+		       "RecursJoined");
+	SET_NSSTATDESC(anscachehit,
+		       "queries answered from a zone's answer cache",
+		       "AnsCacheHit");
 	INSIST(i == ns_statscounter_max);
 
 	/* Initialize resolver statistics */
@@ -402,6 +411,19 @@ init_desc(void) {
 			"ServerQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
 	SET_RESSTATDESC(priming, "priming queries", "Priming");
+	SET_RESSTATDESC(bucketmax, "peak fetch contexts in a bucket",
+			"BucketMax");
+	SET_RESSTATDESC(hedgesent, "hedged queries sent", "HedgeSent");
+	SET_RESSTATDESC(hedgewon, "hedged queries answered first",
+			"HedgeWon");
+	SET_RESSTATDESC(dispsockreuse, "UDP query sockets reused",
+			"SockReuse");
+	SET_RESSTATDESC(sigcachehit, "signature verifications cached",
+			"SigCacheHit");
+	SET_RESSTATDESC(sigcachemiss, "signature verifications not cached",
+			"SigCacheMiss");
+	SET_RESSTATDESC(hotprefetch, "hot names refreshed ahead of expiry",
+			"HotPrefetch");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -1047,6 +1047,19 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 	if (zone != mayberaw)
 		dns_zone_setmaxrecords(zone, 0);
 
+	/*
+	 * Other database types may build their answers differently
+	 * for each query, so only cache answers from rbt zones.
+	 */
+	if ((ztype == dns_zone_master || ztype == dns_zone_slave) &&
+	    cpval == default_dbtype)
+	{
+		obj = NULL;
+		result = named_config_get(maps, "answer-cache-size", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		RETERR(dns_zone_setanswercache(zone, cfg_obj_asuint32(obj)));
+	}
+
 	if (raw != NULL && filename != NULL) {
 #define SIGNED ".signed"
 		size_t signedlen = strlen(filename) + sizeof(SIGNED);
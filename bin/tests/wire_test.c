@@ -21,6 +21,7 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/message.h>
@@ -30,10 +31,15 @@ int parseflags = 0;
 isc_mem_t *mctx = NULL;
 bool printmemstats = false;
 bool dorender = false;
+unsigned int createflags = 0;
+unsigned int benchcount = 0;
 
 static void
 process_message(isc_buffer_t *source);
 
+static void
+benchmark_message(isc_buffer_t *source);
+
 static isc_result_t
 printmessage(dns_message_t *msg);
 
@@ -62,11 +68,15 @@ fromhex(char c) {
 
 static void
 usage(void) {
-	fprintf(stderr, "wire_test [-b] [-d] [-p] [-r] [-s]\n");
+	fprintf(stderr, "wire_test [-a] [-b] [-d] [-p] [-r] [-s] [-n count]\n");
 	fprintf(stderr, "          [-m {usage|trace|record|size|mctx}]\n");
 	fprintf(stderr, "          [filename]\n\n");
+	fprintf(stderr, "\t-a\tAllocate message objects from an arena\n");
 	fprintf(stderr, "\t-b\tBest-effort parsing (ignore some errors)\n");
 	fprintf(stderr, "\t-d\tRead input as raw binary data\n");
+	fprintf(stderr, "\t-n\tParse (and render) each message 'count' "
+			"times,\n\t\treusing one dns_message_t, and print "
+			"timing and\n\t\tallocation statistics\n");
 	fprintf(stderr, "\t-p\tPreserve order of the records in messages\n");
 	fprintf(stderr, "\t-r\tAfter parsing, re-render the message\n");
 	fprintf(stderr, "\t-s\tPrint memory statistics\n");
@@ -114,12 +124,15 @@ main(int argc, char *argv[]) {
 	FILE *f;
 	int ch;
 
-#define CMDLINE_FLAGS "bdm:prst"
+#define CMDLINE_FLAGS "abdm:n:prst"
 	/*
 	 * Process memory debugging argument first.
 	 */
 	while ((ch = isc_commandline_parse(argc, argv, CMDLINE_FLAGS)) != -1) {
 		switch (ch) {
+		case 'n':
+			benchcount = atoi(isc_commandline_argument);
+			break;
 		case 'm':
 			if (strcasecmp(isc_commandline_argument, "record") == 0)
 				isc_mem_debugging |= ISC_MEM_DEBUGRECORD;
@@ -138,10 +151,20 @@ main(int argc, char *argv[]) {
 	}
 	isc_commandline_reset = true;
 
-	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+	/*
+	 * When benchmarking, use a context without the internal allocator
+	 * or per-thread caches, so that isc_mem_total() counts every
+	 * allocation.
+	 */
+	RUNTIME_CHECK(isc_mem_create2(0, 0, &mctx,
+				      benchcount != 0 ? ISC_MEMFLAG_NOLOCK :
+				      isc_mem_defaultflags) == ISC_R_SUCCESS);
 
 	while ((ch = isc_commandline_parse(argc, argv, CMDLINE_FLAGS)) != -1) {
 		switch (ch) {
+			case 'a':
+				createflags |= DNS_MESSAGECREATE_ARENA;
+				break;
 			case 'b':
 				parseflags |= DNS_MESSAGEPARSE_BESTEFFORT;
 				break;
@@ -150,6 +173,12 @@ main(int argc, char *argv[]) {
 				break;
 			case 'm':
 				break;
+			case 'n':
+				if (benchcount == 0) {
+					usage();
+					exit(1);
+				}
+				break;
 			case 'p':
 				parseflags |= DNS_MESSAGEPARSE_PRESERVEORDER;
 				break;
@@ -244,9 +273,14 @@ main(int argc, char *argv[]) {
 				fprintf(stderr, "premature end of packet\n");
 				exit(1);
 			}
-			process_message(input);
+			if (benchcount != 0)
+				benchmark_message(input);
+			else
+				process_message(input);
 		}
-	} else
+	} else if (benchcount != 0)
+		benchmark_message(input);
+	else
 		process_message(input);
 
 	if (input != NULL)
@@ -266,7 +300,8 @@ process_message(isc_buffer_t *source) {
 	int i;
 
 	message = NULL;
-	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &message);
+	result = dns_message_create2(mctx, DNS_MESSAGE_INTENTPARSE,
+				     createflags, &message);
 	CHECKRESULT(result, "dns_message_create failed");
 
 	result = dns_message_parse(message, source, parseflags);
@@ -334,8 +369,8 @@ process_message(isc_buffer_t *source) {
 		if (printmemstats)
 			isc_mem_stats(mctx, stdout);
 
-		result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE,
-					    &message);
+		result = dns_message_create2(mctx, DNS_MESSAGE_INTENTPARSE,
+					     createflags, &message);
 		CHECKRESULT(result, "dns_message_create failed");
 
 		result = dns_message_parse(message, &buffer, parseflags);
@@ -346,3 +381,80 @@ process_message(isc_buffer_t *source) {
 	}
 	dns_message_destroy(&message);
 }
+
+/*
+ * Parse the message in 'source' 'benchcount' times, rendering it again
+ * after each parse if -r was given, the way a server reuses one message
+ * for many queries; print the time taken and the memory allocated per
+ * iteration.  The message is created (and its first blocks allocated)
+ * before timing starts.
+ */
+static void
+benchmark_message(isc_buffer_t *source) {
+	static unsigned char b2[64 * 1024];
+	dns_message_t *message = NULL;
+	isc_buffer_t buffer, wire;
+	isc_region_t r;
+	isc_result_t result;
+	isc_time_t start, finish;
+	dns_compress_t cctx;
+	size_t total;
+	uint64_t t;
+	unsigned int n;
+	int i;
+
+	isc_buffer_remainingregion(source, &r);
+
+	result = dns_message_create2(mctx, DNS_MESSAGE_INTENTPARSE,
+				     createflags, &message);
+	CHECKRESULT(result, "dns_message_create failed");
+
+	total = isc_mem_total(mctx);
+	isc_time_now(&start);
+	for (n = 0; n < benchcount; n++) {
+		if (n != 0)
+			dns_message_reset(message, DNS_MESSAGE_INTENTPARSE);
+
+		isc_buffer_init(&wire, r.base, r.length);
+		isc_buffer_add(&wire, r.length);
+		result = dns_message_parse(message, &wire, parseflags);
+		if (result == DNS_R_RECOVERABLE)
+			result = ISC_R_SUCCESS;
+		CHECKRESULT(result, "dns_message_parse failed");
+
+		if (!dorender)
+			continue;
+
+		/* See process_message() */
+		message->from_to_wire = DNS_MESSAGE_INTENTRENDER;
+		for (i = 0; i < DNS_SECTION_MAX; i++)
+			message->counts[i] = 0;
+
+		isc_buffer_init(&buffer, b2, sizeof(b2));
+		result = dns_compress_init(&cctx, -1, mctx);
+		CHECKRESULT(result, "dns_compress_init() failed");
+		result = dns_message_renderbegin(message, &cctx, &buffer);
+		CHECKRESULT(result, "dns_message_renderbegin() failed");
+		for (i = DNS_SECTION_QUESTION; i < DNS_SECTION_MAX; i++) {
+			result = dns_message_rendersection(message, i, 0);
+			CHECKRESULT(result,
+				    "dns_message_rendersection() failed");
+		}
+		result = dns_message_renderend(message);
+		CHECKRESULT(result, "dns_message_renderend() failed");
+		dns_compress_invalidate(&cctx);
+		message->from_to_wire = DNS_MESSAGE_INTENTPARSE;
+	}
+	isc_time_now(&finish);
+	total = isc_mem_total(mctx) - total;
+
+	isc_buffer_forward(source, isc_buffer_consumedlength(&wire));
+	dns_message_destroy(&message);
+
+	t = isc_time_microdiff(&finish, &start);
+	printf("%u iterations (%s%s): %" PRIu64 " ns/message, "
+	       "%.1f bytes allocated/message\n", benchcount,
+	       dorender ? "parse+render" : "parse",
+	       (createflags & DNS_MESSAGECREATE_ARENA) != 0 ? ", arena" : "",
+	       t * 1000 / benchcount, (double)total / benchcount);
+}
@@ -24,6 +24,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/mutexblock.h>
 #include <isc/netaddr.h>
 #include <isc/print.h>
@@ -86,6 +87,20 @@
 
 #define DNS_ADB_MINADBSIZE      (1024U*1024U)     /*%< 1 Megabyte */
 
+/*%
+ * The names and entries are spread over a fixed number of lock buckets
+ * (a prime).  Each bucket keeps its own hash table of the live names or
+ * entries in it, which starts at ADB_MINCHAINS chains and doubles, under
+ * that bucket's lock alone, whenever it holds more than ADB_CHAINLOAD
+ * objects per chain.  Since an object never changes bucket, the bucket
+ * lock of an entry can be found without any lock held.
+ */
+#define DNS_ADB_NBUCKETS        1021
+#define ADB_MINCHAINS           4
+#define ADB_MAXCHAINS           65536
+#define ADB_CHAINLOAD           2
+#define ADB_CHAIN(t, n, h)      (((h) / (n)) & ((t)->nchains - 1))
+
 typedef ISC_LIST(dns_adbname_t) dns_adbnamelist_t;
 typedef struct dns_adbnamehook dns_adbnamehook_t;
 typedef ISC_LIST(dns_adbnamehook_t) dns_adbnamehooklist_t;
@@ -94,6 +109,22 @@ typedef ISC_LIST(dns_adbentry_t) dns_adbentrylist_t;
 typedef struct dns_adbfetch dns_adbfetch_t;
 typedef struct dns_adbfetch6 dns_adbfetch6_t;
 
+/*%
+ * The hash tables of the live names and entries in a bucket.  These are
+ * only used with the bucket lock held.
+ */
+typedef struct adbnamehash {
+	dns_adbnamelist_t		*chains;
+	unsigned int			nchains;
+	unsigned int			count;
+} adbnamehash_t;
+
+typedef struct adbentryhash {
+	dns_adbentrylist_t		*chains;
+	unsigned int			nchains;
+	unsigned int			count;
+} adbentryhash_t;
+
 /*% dns adb structure */
 struct dns_adb {
 	unsigned int                    magic;
@@ -106,7 +137,6 @@ struct dns_adb {
 
 	isc_taskmgr_t                  *taskmgr;
 	isc_task_t                     *task;
-	isc_task_t                     *excl;
 
 	isc_interval_t                  tick_interval;
 	int                             next_cleanbucket;
@@ -133,6 +163,8 @@ struct dns_adb {
 	unsigned int			namescnt;
 	dns_adbnamelist_t               *names;
 	dns_adbnamelist_t               *deadnames;
+	adbnamehash_t                   *namehash;
+	atomic_uint_fast32_t            nnamechains;
 	isc_mutex_t                     *namelocks;
 	bool                   *name_sd;
 	unsigned int                    *name_refcnt;
@@ -147,6 +179,8 @@ struct dns_adb {
 	unsigned int			entriescnt;
 	dns_adbentrylist_t              *entries;
 	dns_adbentrylist_t              *deadentries;
+	adbentryhash_t                  *entryhash;
+	atomic_uint_fast32_t            nentrychains;
 	isc_mutex_t                     *entrylocks;
 	bool                   *entry_sd; /*%< shutting down */
 	unsigned int                    *entry_refcnt;
@@ -155,10 +189,6 @@ struct dns_adb {
 	bool                   cevent_out;
 	bool                   shutting_down;
 	isc_eventlist_t                 whenshutdown;
-	isc_event_t			growentries;
-	bool			growentries_sent;
-	isc_event_t			grownames;
-	bool			grownames_sent;
 
 	uint32_t			quota;
 	uint32_t			atr_freq;
@@ -179,6 +209,7 @@ struct dns_adbname {
 	unsigned int                    partial_result;
 	unsigned int                    flags;
 	int                             lock_bucket;
+	unsigned int                    hashval;
 	dns_name_t                      target;
 	isc_stdtime_t                   expire_target;
 	isc_stdtime_t                   expire_v4;
@@ -195,6 +226,7 @@ struct dns_adbname {
 	isc_stdtime_t                   last_used;
 
 	ISC_LINK(dns_adbname_t)         plink;
+	ISC_LINK(dns_adbname_t)         hlink;
 };
 
 /*% The adbfetch structure */
@@ -225,6 +257,7 @@ struct dns_adblameinfo {
 	unsigned int                    magic;
 
 	dns_name_t                      qname;
+	unsigned int                    qhash;  /*%< dns_name_hash(qname) */
 	dns_rdatatype_t                 qtype;
 	isc_stdtime_t                   lame_timer;
 
@@ -235,17 +268,23 @@ struct dns_adblameinfo {
  * An address entry.  It holds quite a bit of information about addresses,
  * including edns state (in "flags"), rtt, and of course the address of
  * the host.
+ *
+ * 'flags', 'srtt', 'udpsize', 'quota' and 'active' are only changed
+ * with the bucket locked, but are read and written atomically so that
+ * the resolver can read them (and count its queries in 'active')
+ * without taking the lock.
  */
 struct dns_adbentry {
 	unsigned int                    magic;
 
 	int                             lock_bucket;
+	unsigned int                    hashval;
 	unsigned int                    refcnt;
 	unsigned int                    nh;
 
-	unsigned int                    flags;
-	unsigned int                    srtt;
-	uint16_t			udpsize;
+	atomic_uint_fast32_t		flags;
+	atomic_uint_fast32_t		srtt;
+	atomic_uint_fast32_t		udpsize;
 	unsigned int			completed;
 	unsigned int			timeouts;
 	unsigned char			plain;
@@ -254,8 +293,8 @@ struct dns_adbentry {
 	unsigned char			to4096;		/* Our max. */
 
 	uint8_t			mode;
-	uint32_t			quota;
-	uint32_t			active;
+	atomic_uint_fast32_t		quota;
+	atomic_uint_fast32_t		active;
 	double				atr;
 
 	/*
@@ -270,7 +309,7 @@ struct dns_adbentry {
 	uint16_t			cookielen;
 
 	isc_stdtime_t                   expires;
-	isc_stdtime_t			lastage;
+	atomic_uint_fast32_t		lastage;
 	/*%<
 	 * A nonzero 'expires' field indicates that the entry should
 	 * persist until that time.  This allows entries found
@@ -281,6 +320,7 @@ struct dns_adbentry {
 
 	ISC_LIST(dns_adblameinfo_t)     lameinfo;
 	ISC_LINK(dns_adbentry_t)        plink;
+	ISC_LINK(dns_adbentry_t)        hlink;
 };
 
 /*
@@ -343,8 +383,10 @@ static void destroy(dns_adb_t *);
 static bool shutdown_names(dns_adb_t *);
 static bool shutdown_entries(dns_adb_t *);
 static inline void link_name(dns_adb_t *, int, dns_adbname_t *);
+static inline void unhash_name(dns_adb_t *, int, dns_adbname_t *);
 static inline bool unlink_name(dns_adb_t *, dns_adbname_t *);
 static inline void link_entry(dns_adb_t *, int, dns_adbentry_t *);
+static inline void unhash_entry(dns_adb_t *, int, dns_adbentry_t *);
 static inline bool unlink_entry(dns_adb_t *, dns_adbentry_t *);
 static bool kill_name(dns_adbname_t **, isc_eventtype_t);
 static void water(void *, int);
@@ -541,329 +583,74 @@ ttlclamp(dns_ttl_t ttl) {
 }
 
 /*
- * Hashing is most efficient if the number of buckets is prime.
- * The sequence below is the closest previous primes to 2^n and
- * 1.5 * 2^n, for values of n from 10 to 28.  (The tables will
- * no longer grow beyond 2^28 entries.)
+ * Double the number of chains in a bucket's hash table.  Nothing else
+ * is stalled while this happens, since only this bucket is locked; if
+ * memory is short the chains just get longer.
+ *
+ * Requires the bucket be locked.
  */
-static const unsigned nbuckets[] = { 1021, 1531, 2039, 3067, 4093, 6143,
-				     8191, 12281, 16381, 24571, 32749,
-				     49193, 65521, 98299, 131071, 199603,
-				     262139, 393209, 524287, 768431, 1048573,
-				     1572853, 2097143, 3145721, 4194301,
-				     6291449, 8388593, 12582893, 16777213,
-				     25165813, 33554393, 50331599, 67108859,
-				     100663291, 134217689, 201326557,
-				     268535431, 0 };
-
 static void
-grow_entries(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbentry_t *e;
-	dns_adbentrylist_t *newdeadentries = NULL;
-	dns_adbentrylist_t *newentries = NULL;
-	bool *newentry_sd = NULL;
-	isc_mutex_t *newentrylocks = NULL;
-	isc_result_t result;
-	unsigned int *newentry_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nentries >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_entries to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nentries; i++)
-		if (adb->entry_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newentries = isc_mem_get(adb->mctx, sizeof(*newentries) * n);
-	newdeadentries = isc_mem_get(adb->mctx, sizeof(*newdeadentries) * n);
-	newentrylocks = isc_mem_get(adb->mctx, sizeof(*newentrylocks) * n);
-	newentry_sd = isc_mem_get(adb->mctx, sizeof(*newentry_sd) * n);
-	newentry_refcnt = isc_mem_get(adb->mctx, sizeof(*newentry_refcnt) * n);
-	if (newentries == NULL || newdeadentries == NULL ||
-	    newentrylocks == NULL || newentry_sd == NULL ||
-	    newentry_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newentrylocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newentries[i]);
-		ISC_LIST_INIT(newdeadentries[i]);
-		newentry_sd[i] = false;
-		newentry_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
+grow_namehash(dns_adb_t *adb, adbnamehash_t *hash) {
+	dns_adbnamelist_t *chains;
+	dns_adbname_t *name;
+	unsigned int i, n, chain;
 
-	/*
-	 * Move entries to new arrays.
-	 */
-	for (i = 0; i < adb->nentries; i++) {
-		e = ISC_LIST_HEAD(adb->entries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->entries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, true) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->entries[i]);
-		}
-		e = ISC_LIST_HEAD(adb->deadentries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->deadentries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, true) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->deadentries[i]);
+	n = hash->nchains * 2;
+	chains = isc_mem_get(adb->mctx, sizeof(*chains) * n);
+	if (chains == NULL)
+		return;
+	for (i = 0; i < n; i++)
+		ISC_LIST_INIT(chains[i]);
+
+	for (i = 0; i < hash->nchains; i++) {
+		while ((name = ISC_LIST_HEAD(hash->chains[i])) != NULL) {
+			ISC_LIST_UNLINK(hash->chains[i], name, hlink);
+			chain = (name->hashval / adb->nnames) & (n - 1);
+			ISC_LIST_APPEND(chains[chain], name, hlink);
 		}
-		INSIST(adb->entry_refcnt[i] == 0);
-		adb->irefcnt--;
 	}
 
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
-	isc_mem_put(adb->mctx, adb->entries,
-		    sizeof(*adb->entries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->deadentries,
-		    sizeof(*adb->deadentries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entrylocks,
-		    sizeof(*adb->entrylocks) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_sd,
-		    sizeof(*adb->entry_sd) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_refcnt,
-		    sizeof(*adb->entry_refcnt) * adb->nentries);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->entries = newentries;
-	adb->deadentries = newdeadentries;
-	adb->entrylocks = newentrylocks;
-	adb->entry_sd = newentry_sd;
-	adb->entry_refcnt = newentry_refcnt;
-	adb->nentries = n;
-
-	set_adbstat(adb, adb->nentries, dns_adbstats_nentries);
-
-	/*
-	 * Only on success do we set adb->growentries_sent to false.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->growentries_sent = false;
-	goto done;
+	isc_mem_put(adb->mctx, hash->chains,
+		    sizeof(*hash->chains) * hash->nchains);
+	hash->chains = chains;
+	atomic_fetch_add(&adb->nnamechains, n - hash->nchains);
+	hash->nchains = n;
 
- cleanup:
-	if (newentries != NULL)
-		isc_mem_put(adb->mctx, newentries,
-			    sizeof(*newentries) * n);
-	if (newdeadentries != NULL)
-		isc_mem_put(adb->mctx, newdeadentries,
-			    sizeof(*newdeadentries) * n);
-	if (newentrylocks != NULL)
-		isc_mem_put(adb->mctx, newentrylocks,
-			    sizeof(*newentrylocks) * n);
-	if (newentry_sd != NULL)
-		isc_mem_put(adb->mctx, newentry_sd,
-			    sizeof(*newentry_sd) * n);
-	if (newentry_refcnt != NULL)
-		isc_mem_put(adb->mctx, newentry_refcnt,
-			     sizeof(*newentry_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_entries finished");
+	set_adbstat(adb, atomic_load(&adb->nnamechains), dns_adbstats_nnames);
 }
 
+/*
+ * Requires the bucket be locked.
+ */
 static void
-grow_names(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbname_t *name;
-	dns_adbnamelist_t *newdeadnames = NULL;
-	dns_adbnamelist_t *newnames = NULL;
-	bool *newname_sd = NULL;
-	isc_mutex_t *newnamelocks = NULL;
-	isc_result_t result;
-	unsigned int *newname_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nnames >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_names to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nnames; i++)
-		if (adb->name_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newnames = isc_mem_get(adb->mctx, sizeof(*newnames) * n);
-	newdeadnames = isc_mem_get(adb->mctx, sizeof(*newdeadnames) * n);
-	newnamelocks = isc_mem_get(adb->mctx, sizeof(*newnamelocks) * n);
-	newname_sd = isc_mem_get(adb->mctx, sizeof(*newname_sd) * n);
-	newname_refcnt = isc_mem_get(adb->mctx, sizeof(*newname_refcnt) * n);
-	if (newnames == NULL || newdeadnames == NULL ||
-	    newnamelocks == NULL || newname_sd == NULL ||
-	    newname_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newnamelocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newnames[i]);
-		ISC_LIST_INIT(newdeadnames[i]);
-		newname_sd[i] = false;
-		newname_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
+grow_entryhash(dns_adb_t *adb, adbentryhash_t *hash) {
+	dns_adbentrylist_t *chains;
+	dns_adbentry_t *entry;
+	unsigned int i, n, chain;
 
-	/*
-	 * Move names to new arrays.
-	 */
-	for (i = 0; i < adb->nnames; i++) {
-		name = ISC_LIST_HEAD(adb->names[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->names[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, true) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->names[i]);
-		}
-		name = ISC_LIST_HEAD(adb->deadnames[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->deadnames[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, true) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->deadnames[i]);
+	n = hash->nchains * 2;
+	chains = isc_mem_get(adb->mctx, sizeof(*chains) * n);
+	if (chains == NULL)
+		return;
+	for (i = 0; i < n; i++)
+		ISC_LIST_INIT(chains[i]);
+
+	for (i = 0; i < hash->nchains; i++) {
+		while ((entry = ISC_LIST_HEAD(hash->chains[i])) != NULL) {
+			ISC_LIST_UNLINK(hash->chains[i], entry, hlink);
+			chain = (entry->hashval / adb->nentries) & (n - 1);
+			ISC_LIST_APPEND(chains[chain], entry, hlink);
 		}
-		INSIST(adb->name_refcnt[i] == 0);
-		adb->irefcnt--;
 	}
 
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
-	isc_mem_put(adb->mctx, adb->names,
-		    sizeof(*adb->names) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->deadnames,
-		    sizeof(*adb->deadnames) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->namelocks,
-		    sizeof(*adb->namelocks) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_sd,
-		    sizeof(*adb->name_sd) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_refcnt,
-		    sizeof(*adb->name_refcnt) * adb->nnames);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->names = newnames;
-	adb->deadnames = newdeadnames;
-	adb->namelocks = newnamelocks;
-	adb->name_sd = newname_sd;
-	adb->name_refcnt = newname_refcnt;
-	adb->nnames = n;
-
-	set_adbstat(adb, adb->nnames, dns_adbstats_nnames);
+	isc_mem_put(adb->mctx, hash->chains,
+		    sizeof(*hash->chains) * hash->nchains);
+	hash->chains = chains;
+	atomic_fetch_add(&adb->nentrychains, n - hash->nchains);
+	hash->nchains = n;
 
-	/*
-	 * Only on success do we set adb->grownames_sent to false.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->grownames_sent = false;
-	goto done;
-
- cleanup:
-	if (newnames != NULL)
-		isc_mem_put(adb->mctx, newnames, sizeof(*newnames) * n);
-	if (newdeadnames != NULL)
-		isc_mem_put(adb->mctx, newdeadnames, sizeof(*newdeadnames) * n);
-	if (newnamelocks != NULL)
-		isc_mem_put(adb->mctx, newnamelocks, sizeof(*newnamelocks) * n);
-	if (newname_sd != NULL)
-		isc_mem_put(adb->mctx, newname_sd, sizeof(*newname_sd) * n);
-	if (newname_refcnt != NULL)
-		isc_mem_put(adb->mctx, newname_refcnt,
-			     sizeof(*newname_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_names finished");
+	set_adbstat(adb, atomic_load(&adb->nentrychains),
+		    dns_adbstats_nentries);
 }
 
 /*
@@ -1065,6 +852,7 @@ kill_name(dns_adbname_t **n, isc_eventtype_t ev) {
 		cancel_fetches_at_name(name);
 		if (!NAME_DEAD(name)) {
 			bucket = name->lock_bucket;
+			unhash_name(adb, bucket, name);
 			ISC_LIST_UNLINK(adb->names[bucket], name, plink);
 			ISC_LIST_APPEND(adb->deadnames[bucket], name, plink);
 			name->flags |= NAME_IS_DEAD;
@@ -1122,12 +910,39 @@ check_expire_namehooks(dns_adbname_t *name, isc_stdtime_t now) {
 	return (result4 || result6);
 }
 
+/*
+ * Remove a name that is going away, or dying, from its bucket's hash
+ * table.  Requires the name's bucket be locked.
+ */
+static inline void
+unhash_name(dns_adb_t *adb, int bucket, dns_adbname_t *name) {
+	adbnamehash_t *hash = &adb->namehash[bucket];
+	unsigned int chain = ADB_CHAIN(hash, adb->nnames, name->hashval);
+
+	ISC_LIST_UNLINK(hash->chains[chain], name, hlink);
+	INSIST(hash->count > 0);
+	hash->count--;
+}
+
 /*
  * Requires the name's bucket be locked.
  */
 static inline void
 link_name(dns_adb_t *adb, int bucket, dns_adbname_t *name) {
+	adbnamehash_t *hash = &adb->namehash[bucket];
+	unsigned int chain;
+
 	INSIST(name->lock_bucket == DNS_ADB_INVALIDBUCKET);
+	INSIST((int)(name->hashval % adb->nnames) == bucket);
+
+	if (hash->count >= hash->nchains * ADB_CHAINLOAD &&
+	    hash->nchains < ADB_MAXCHAINS)
+	{
+		grow_namehash(adb, hash);
+	}
+	chain = ADB_CHAIN(hash, adb->nnames, name->hashval);
+	ISC_LIST_PREPEND(hash->chains[chain], name, hlink);
+	hash->count++;
 
 	ISC_LIST_PREPEND(adb->names[bucket], name, plink);
 	name->lock_bucket = bucket;
@@ -1145,10 +960,12 @@ unlink_name(dns_adb_t *adb, dns_adbname_t *name) {
 	bucket = name->lock_bucket;
 	INSIST(bucket != DNS_ADB_INVALIDBUCKET);
 
-	if (NAME_DEAD(name))
+	if (NAME_DEAD(name)) {
 		ISC_LIST_UNLINK(adb->deadnames[bucket], name, plink);
-	else
+	} else {
+		unhash_name(adb, bucket, name);
 		ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+	}
 	name->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->name_refcnt[bucket] > 0);
 	adb->name_refcnt[bucket]--;
@@ -1157,11 +974,27 @@ unlink_name(dns_adb_t *adb, dns_adbname_t *name) {
 	return (result);
 }
 
+/*
+ * Requires the entry's bucket be locked.
+ */
+static inline void
+unhash_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
+	adbentryhash_t *hash = &adb->entryhash[bucket];
+	unsigned int chain = ADB_CHAIN(hash, adb->nentries, entry->hashval);
+
+	ISC_LIST_UNLINK(hash->chains[chain], entry, hlink);
+	INSIST(hash->count > 0);
+	hash->count--;
+}
+
 /*
  * Requires the entry's bucket be locked.
  */
 static inline void
 link_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
+	adbentryhash_t *hash = &adb->entryhash[bucket];
+	unsigned int chain;
+	unsigned int flags;
 	int i;
 	dns_adbentry_t *e;
 
@@ -1175,13 +1008,27 @@ link_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
 				free_adbentry(adb, &e);
 				continue;
 			}
-			INSIST((e->flags & ENTRY_IS_DEAD) == 0);
-			e->flags |= ENTRY_IS_DEAD;
+			flags = atomic_load(&e->flags);
+			INSIST((flags & ENTRY_IS_DEAD) == 0);
+			atomic_store(&e->flags, flags | ENTRY_IS_DEAD);
+			unhash_entry(adb, bucket, e);
 			ISC_LIST_UNLINK(adb->entries[bucket], e, plink);
 			ISC_LIST_PREPEND(adb->deadentries[bucket], e, plink);
 		}
 	}
 
+	entry->hashval = isc_sockaddr_hash(&entry->sockaddr, true);
+	INSIST((int)(entry->hashval % adb->nentries) == bucket);
+
+	if (hash->count >= hash->nchains * ADB_CHAINLOAD &&
+	    hash->nchains < ADB_MAXCHAINS)
+	{
+		grow_entryhash(adb, hash);
+	}
+	chain = ADB_CHAIN(hash, adb->nentries, entry->hashval);
+	ISC_LIST_PREPEND(hash->chains[chain], entry, hlink);
+	hash->count++;
+
 	ISC_LIST_PREPEND(adb->entries[bucket], entry, plink);
 	entry->lock_bucket = bucket;
 	adb->entry_refcnt[bucket]++;
@@ -1198,10 +1045,12 @@ unlink_entry(dns_adb_t *adb, dns_adbentry_t *entry) {
 	bucket = entry->lock_bucket;
 	INSIST(bucket != DNS_ADB_INVALIDBUCKET);
 
-	if ((entry->flags & ENTRY_IS_DEAD) != 0)
+	if ((atomic_load(&entry->flags) & ENTRY_IS_DEAD) != 0) {
 		ISC_LIST_UNLINK(adb->deadentries[bucket], entry, plink);
-	else
+	} else {
+		unhash_entry(adb, bucket, entry);
 		ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
+	}
 	entry->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->entry_refcnt[bucket] > 0);
 	adb->entry_refcnt[bucket]--;
@@ -1647,7 +1496,7 @@ dec_entry_refcnt(dns_adb_t *adb, bool overmem, dns_adbentry_t *entry,
 	destroy_entry = false;
 	if (entry->refcnt == 0 &&
 	    (adb->entry_sd[bucket] || entry->expires == 0 || overmem ||
-	     (entry->flags & ENTRY_IS_DEAD) != 0)) {
+	     (atomic_load(&entry->flags) & ENTRY_IS_DEAD) != 0)) {
 		destroy_entry = true;
 		result = unlink_entry(adb, entry);
 	}
@@ -1690,6 +1539,7 @@ new_adbname(dns_adb_t *adb, const dns_name_t *dnsname) {
 	name->expire_target = INT_MAX;
 	name->chains = 0;
 	name->lock_bucket = DNS_ADB_INVALIDBUCKET;
+	name->hashval = dns_name_fullhash(&name->name, false);
 	ISC_LIST_INIT(name->v4);
 	ISC_LIST_INIT(name->v6);
 	name->fetch_a = NULL;
@@ -1698,18 +1548,11 @@ new_adbname(dns_adb_t *adb, const dns_name_t *dnsname) {
 	name->fetch6_err = FIND_ERR_UNEXPECTED;
 	ISC_LIST_INIT(name->finds);
 	ISC_LINK_INIT(name, plink);
+	ISC_LINK_INIT(name, hlink);
 
 	LOCK(&adb->namescntlock);
 	adb->namescnt++;
 	inc_adbstats(adb, dns_adbstats_namescnt);
-	if (!adb->grownames_sent && adb->excl != NULL &&
-	    adb->namescnt > (adb->nnames * 8))
-	{
-		isc_event_t *event = &adb->grownames;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->grownames_sent = true;
-	}
 	UNLOCK(&adb->namescntlock);
 
 	return (name);
@@ -1728,6 +1571,7 @@ free_adbname(dns_adb_t *adb, dns_adbname_t **name) {
 	INSIST(!NAME_FETCH(n));
 	INSIST(ISC_LIST_EMPTY(n->finds));
 	INSIST(!ISC_LINK_LINKED(n, plink));
+	INSIST(!ISC_LINK_LINKED(n, hlink));
 	INSIST(n->lock_bucket == DNS_ADB_INVALIDBUCKET);
 	INSIST(n->adb == adb);
 
@@ -1788,6 +1632,7 @@ new_adblameinfo(dns_adb_t *adb, const dns_name_t *qname,
 	}
 	li->magic = DNS_ADBLAMEINFO_MAGIC;
 	li->lame_timer = 0;
+	li->qhash = dns_name_hash(qname, false);
 	li->qtype = qtype;
 	ISC_LINK_INIT(li, plink);
 
@@ -1821,10 +1666,11 @@ new_adbentry(dns_adb_t *adb) {
 
 	e->magic = DNS_ADBENTRY_MAGIC;
 	e->lock_bucket = DNS_ADB_INVALIDBUCKET;
+	e->hashval = 0;
 	e->refcnt = 0;
 	e->nh = 0;
-	e->flags = 0;
-	e->udpsize = 0;
+	atomic_init(&e->flags, 0);
+	atomic_init(&e->udpsize, 0);
 	e->edns = 0;
 	e->completed = 0;
 	e->timeouts = 0;
@@ -1836,26 +1682,19 @@ new_adbentry(dns_adb_t *adb) {
 	e->to512 = 0;
 	e->cookie = NULL;
 	e->cookielen = 0;
-	e->srtt = (isc_random_uniform(0x1f)) + 1;
-	e->lastage = 0;
+	atomic_init(&e->srtt, isc_random_uniform(0x1f) + 1);
+	atomic_init(&e->lastage, 0);
 	e->expires = 0;
-	e->active = 0;
+	atomic_init(&e->active, 0);
 	e->mode = 0;
-	e->quota = adb->quota;
+	atomic_init(&e->quota, adb->quota);
 	e->atr = 0.0;
 	ISC_LIST_INIT(e->lameinfo);
 	ISC_LINK_INIT(e, plink);
+	ISC_LINK_INIT(e, hlink);
 	LOCK(&adb->entriescntlock);
 	adb->entriescnt++;
 	inc_adbstats(adb, dns_adbstats_entriescnt);
-	if (!adb->growentries_sent && adb->excl != NULL &&
-	    adb->entriescnt > (adb->nentries * 8))
-	{
-		isc_event_t *event = &adb->growentries;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->growentries_sent = true;
-	}
 	UNLOCK(&adb->entriescntlock);
 
 	return (e);
@@ -1873,6 +1712,7 @@ free_adbentry(dns_adb_t *adb, dns_adbentry_t **entry) {
 	INSIST(e->lock_bucket == DNS_ADB_INVALIDBUCKET);
 	INSIST(e->refcnt == 0);
 	INSIST(!ISC_LINK_LINKED(e, plink));
+	INSIST(!ISC_LINK_LINKED(e, hlink));
 
 	e->magic = 0;
 
@@ -2006,8 +1846,8 @@ new_adbaddrinfo(dns_adb_t *adb, dns_adbentry_t *entry, in_port_t port) {
 	ai->magic = DNS_ADBADDRINFO_MAGIC;
 	ai->sockaddr = entry->sockaddr;
 	isc_sockaddr_setport(&ai->sockaddr, port);
-	ai->srtt = entry->srtt;
-	ai->flags = entry->flags;
+	ai->srtt = (unsigned int)atomic_load(&entry->srtt);
+	ai->flags = (unsigned int)atomic_load(&entry->flags);
 	ai->entry = entry;
 	ai->dscp = -1;
 	ISC_LINK_INIT(ai, publink);
@@ -2043,9 +1883,12 @@ find_name_and_lock(dns_adb_t *adb, const dns_name_t *name,
 		   unsigned int options, int *bucketp)
 {
 	dns_adbname_t *adbname;
+	adbnamehash_t *hash;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = dns_name_fullhash(name, false) % adb->nnames;
+	hashval = dns_name_fullhash(name, false);
+	bucket = hashval % adb->nnames;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->namelocks[bucket]);
@@ -2056,15 +1899,17 @@ find_name_and_lock(dns_adb_t *adb, const dns_name_t *name,
 		*bucketp = bucket;
 	}
 
-	adbname = ISC_LIST_HEAD(adb->names[bucket]);
+	hash = &adb->namehash[bucket];
+	adbname = ISC_LIST_HEAD(hash->chains[ADB_CHAIN(hash, adb->nnames,
+						       hashval)]);
 	while (adbname != NULL) {
-		if (!NAME_DEAD(adbname)) {
-			if (dns_name_equal(name, &adbname->name)
-			    && GLUEHINT_OK(adbname, options)
-			    && STARTATZONE_MATCHES(adbname, options))
-				return (adbname);
-		}
-		adbname = ISC_LIST_NEXT(adbname, plink);
+		INSIST(!NAME_DEAD(adbname));
+		if (adbname->hashval == hashval
+		    && dns_name_equal(name, &adbname->name)
+		    && GLUEHINT_OK(adbname, options)
+		    && STARTATZONE_MATCHES(adbname, options))
+			return (adbname);
+		adbname = ISC_LIST_NEXT(adbname, hlink);
 	}
 
 	return (NULL);
@@ -2085,9 +1930,13 @@ find_entry_and_lock(dns_adb_t *adb, const isc_sockaddr_t *addr, int *bucketp,
 	isc_stdtime_t now)
 {
 	dns_adbentry_t *entry, *entry_next;
+	adbentryhash_t *hash;
+	dns_adbentrylist_t *chain;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = isc_sockaddr_hash(addr, true) % adb->nentries;
+	hashval = isc_sockaddr_hash(addr, true);
+	bucket = hashval % adb->nentries;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->entrylocks[bucket]);
@@ -2098,13 +1947,15 @@ find_entry_and_lock(dns_adb_t *adb, const isc_sockaddr_t *addr, int *bucketp,
 		*bucketp = bucket;
 	}
 
-	/* Search the list, while cleaning up expired entries. */
-	for (entry = ISC_LIST_HEAD(adb->entries[bucket]);
+	/* Search the chain, while cleaning up expired entries. */
+	hash = &adb->entryhash[bucket];
+	chain = &hash->chains[ADB_CHAIN(hash, adb->nentries, hashval)];
+	for (entry = ISC_LIST_HEAD(*chain);
 	     entry != NULL;
 	     entry = entry_next) {
-		entry_next = ISC_LIST_NEXT(entry, plink);
+		entry_next = ISC_LIST_NEXT(entry, hlink);
 		(void)check_expire_entry(adb, &entry, now);
-		if (entry != NULL &&
+		if (entry != NULL && entry->hashval == hashval &&
 		    (entry->expires == 0 || entry->expires > now) &&
 		    isc_sockaddr_equal(addr, &entry->sockaddr)) {
 			ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
@@ -2121,7 +1972,7 @@ find_entry_and_lock(dns_adb_t *adb, const isc_sockaddr_t *addr, int *bucketp,
  */
 static bool
 entry_is_lame(dns_adb_t *adb, dns_adbentry_t *entry, const dns_name_t *qname,
-	      dns_rdatatype_t qtype, isc_stdtime_t now)
+	      unsigned int qhash, dns_rdatatype_t qtype, isc_stdtime_t now)
 {
 	dns_adblameinfo_t *li, *next_li;
 	bool is_bad;
@@ -2149,7 +2000,7 @@ entry_is_lame(dns_adb_t *adb, dns_adbentry_t *entry, const dns_name_t *qname,
 		 * we use the loop for house keeping.
 		 */
 		if (li != NULL && !is_bad && li->qtype == qtype &&
-		    dns_name_equal(qname, &li->qname))
+		    li->qhash == qhash && dns_name_equal(qname, &li->qname))
 			is_bad = true;
 
 		li = next_li;
@@ -2174,7 +2025,21 @@ log_quota(dns_adbentry_t *entry, const char *fmt, ...) {
 
 	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_ADB,
 		      ISC_LOG_INFO, "adb: quota %s (%u/%u): %s",
-		      addrbuf, entry->active, entry->quota, msgbuf);
+		      addrbuf, (unsigned int)atomic_load(&entry->active),
+		      (unsigned int)atomic_load(&entry->quota), msgbuf);
+}
+
+/*
+ * The entry need not be locked.
+ */
+static inline bool
+entry_overquota(dns_adbentry_t *entry) {
+	uint_fast32_t quota = atomic_load_explicit(&entry->quota,
+						   memory_order_relaxed);
+
+	return (quota != 0 &&
+		atomic_load_explicit(&entry->active,
+				     memory_order_relaxed) >= quota);
 }
 
 static void
@@ -2185,9 +2050,11 @@ copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find,
 	dns_adbnamehook_t *namehook;
 	dns_adbaddrinfo_t *addrinfo;
 	dns_adbentry_t *entry;
+	unsigned int qhash;
 	int bucket;
 
 	bucket = DNS_ADB_INVALIDBUCKET;
+	qhash = dns_name_hash(qname, false);
 
 	if (find->options & DNS_ADBFIND_INET) {
 		namehook = ISC_LIST_HEAD(name->v4);
@@ -2197,9 +2064,7 @@ copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find,
 			INSIST(bucket != DNS_ADB_INVALIDBUCKET);
 			LOCK(&adb->entrylocks[bucket]);
 
-			if (entry->quota != 0 &&
-			    entry->active >= entry->quota)
-			{
+			if (entry_overquota(entry)) {
 				find->options |=
 					(DNS_ADBFIND_LAMEPRUNED|
 					 DNS_ADBFIND_OVERQUOTA);
@@ -2207,7 +2072,8 @@ copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find,
 			}
 
 			if (!FIND_RETURNLAME(find)
-			    && entry_is_lame(adb, entry, qname, qtype, now)) {
+			    && entry_is_lame(adb, entry, qname, qhash, qtype,
+					     now)) {
 				find->options |= DNS_ADBFIND_LAMEPRUNED;
 				goto nextv4;
 			}
@@ -2237,9 +2103,7 @@ copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find,
 			INSIST(bucket != DNS_ADB_INVALIDBUCKET);
 			LOCK(&adb->entrylocks[bucket]);
 
-			if (entry->quota != 0 &&
-			    entry->active >= entry->quota)
-			{
+			if (entry_overquota(entry)) {
 				find->options |=
 					(DNS_ADBFIND_LAMEPRUNED|
 					 DNS_ADBFIND_OVERQUOTA);
@@ -2247,7 +2111,8 @@ copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find,
 			}
 
 			if (!FIND_RETURNLAME(find)
-			    && entry_is_lame(adb, entry, qname, qtype, now)) {
+			    && entry_is_lame(adb, entry, qname, qhash, qtype,
+					     now)) {
 				find->options |= DNS_ADBFIND_LAMEPRUNED;
 				goto nextv6;
 			}
@@ -2465,13 +2330,47 @@ cleanup_entries(dns_adb_t *adb, int bucket, isc_stdtime_t now) {
 	return (result);
 }
 
+/*
+ * Free the per-bucket hash tables, and the arrays holding them.
+ */
+static void
+free_hashes(dns_adb_t *adb) {
+	unsigned int i;
+
+	if (adb->namehash != NULL) {
+		for (i = 0; i < adb->nnames; i++) {
+			adbnamehash_t *hash = &adb->namehash[i];
+			if (hash->chains == NULL)
+				continue;
+			INSIST(hash->count == 0);
+			isc_mem_put(adb->mctx, hash->chains,
+				    sizeof(*hash->chains) * hash->nchains);
+		}
+		isc_mem_put(adb->mctx, adb->namehash,
+			    sizeof(*adb->namehash) * adb->nnames);
+		adb->namehash = NULL;
+	}
+
+	if (adb->entryhash != NULL) {
+		for (i = 0; i < adb->nentries; i++) {
+			adbentryhash_t *hash = &adb->entryhash[i];
+			if (hash->chains == NULL)
+				continue;
+			INSIST(hash->count == 0);
+			isc_mem_put(adb->mctx, hash->chains,
+				    sizeof(*hash->chains) * hash->nchains);
+		}
+		isc_mem_put(adb->mctx, adb->entryhash,
+			    sizeof(*adb->entryhash) * adb->nentries);
+		adb->entryhash = NULL;
+	}
+}
+
 static void
 destroy(dns_adb_t *adb) {
 	adb->magic = 0;
 
 	isc_task_detach(&adb->task);
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 
 	isc_mempool_destroy(&adb->nmp);
 	isc_mempool_destroy(&adb->nhmp);
@@ -2481,6 +2380,8 @@ destroy(dns_adb_t *adb) {
 	isc_mempool_destroy(&adb->aimp);
 	isc_mempool_destroy(&adb->afmp);
 
+	free_hashes(adb);
+
 	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
 	isc_mem_put(adb->mctx, adb->entries,
 		    sizeof(*adb->entries) * adb->nentries);
@@ -2555,7 +2456,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->aimp = NULL;
 	adb->afmp = NULL;
 	adb->task = NULL;
-	adb->excl = NULL;
 	adb->mctx = NULL;
 	adb->view = view;
 	adb->taskmgr = taskmgr;
@@ -2566,17 +2466,15 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->shutting_down = false;
 	ISC_LIST_INIT(adb->whenshutdown);
 
-	adb->nentries = nbuckets[0];
+	adb->nentries = DNS_ADB_NBUCKETS;
 	adb->entriescnt = 0;
 	adb->entries = NULL;
 	adb->deadentries = NULL;
+	adb->entryhash = NULL;
+	atomic_init(&adb->nentrychains, 0);
 	adb->entry_sd = NULL;
 	adb->entry_refcnt = NULL;
 	adb->entrylocks = NULL;
-	ISC_EVENT_INIT(&adb->growentries, sizeof(adb->growentries), 0, NULL,
-		       DNS_EVENT_ADBGROWENTRIES, grow_entries, adb,
-		       adb, NULL, NULL);
-	adb->growentries_sent = false;
 
 	adb->quota = 0;
 	adb->atr_freq = 0;
@@ -2584,26 +2482,15 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->atr_high = 0.0;
 	adb->atr_discount = 0.0;
 
-	adb->nnames = nbuckets[0];
+	adb->nnames = DNS_ADB_NBUCKETS;
 	adb->namescnt = 0;
 	adb->names = NULL;
 	adb->deadnames = NULL;
+	adb->namehash = NULL;
+	atomic_init(&adb->nnamechains, 0);
 	adb->name_sd = NULL;
 	adb->name_refcnt = NULL;
 	adb->namelocks = NULL;
-	ISC_EVENT_INIT(&adb->grownames, sizeof(adb->grownames), 0, NULL,
-		       DNS_EVENT_ADBGROWNAMES, grow_names, adb,
-		       adb, NULL, NULL);
-	adb->grownames_sent = false;
-
-	result = isc_taskmgr_excltask(adb->taskmgr, &adb->excl);
-	if (result != ISC_R_SUCCESS) {
-		DP(DEF_LEVEL, "adb: task-exclusive mode unavailable, "
-			      "intializing table sizes to %u\n",
-			      nbuckets[11]);
-		adb->nentries = nbuckets[11];
-		adb->nnames = nbuckets[11];
-	}
 
 	isc_mem_attach(mem, &adb->mctx);
 
@@ -2663,6 +2550,63 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	ALLOCNAME(adb, name_refcnt);
 #undef ALLOCNAME
 
+	/*
+	 * Give each bucket its own small hash table; these grow as
+	 * needed.
+	 */
+	adb->namehash = isc_mem_get(adb->mctx,
+				    sizeof(*adb->namehash) * adb->nnames);
+	if (adb->namehash == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto fail1;
+	}
+	for (i = 0; i < adb->nnames; i++) {
+		adb->namehash[i].chains = NULL;
+		adb->namehash[i].nchains = 0;
+		adb->namehash[i].count = 0;
+	}
+	adb->entryhash = isc_mem_get(adb->mctx,
+				     sizeof(*adb->entryhash) * adb->nentries);
+	if (adb->entryhash == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto fail1;
+	}
+	for (i = 0; i < adb->nentries; i++) {
+		adb->entryhash[i].chains = NULL;
+		adb->entryhash[i].nchains = 0;
+		adb->entryhash[i].count = 0;
+	}
+	for (i = 0; i < adb->nnames; i++) {
+		adbnamehash_t *hash = &adb->namehash[i];
+		unsigned int j;
+
+		hash->chains = isc_mem_get(adb->mctx, sizeof(*hash->chains) *
+					   ADB_MINCHAINS);
+		if (hash->chains == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto fail1;
+		}
+		hash->nchains = ADB_MINCHAINS;
+		for (j = 0; j < ADB_MINCHAINS; j++)
+			ISC_LIST_INIT(hash->chains[j]);
+	}
+	for (i = 0; i < adb->nentries; i++) {
+		adbentryhash_t *hash = &adb->entryhash[i];
+		unsigned int j;
+
+		hash->chains = isc_mem_get(adb->mctx, sizeof(*hash->chains) *
+					   ADB_MINCHAINS);
+		if (hash->chains == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto fail1;
+		}
+		hash->nchains = ADB_MINCHAINS;
+		for (j = 0; j < ADB_MINCHAINS; j++)
+			ISC_LIST_INIT(hash->chains[j]);
+	}
+	atomic_init(&adb->nnamechains, adb->nnames * ADB_MINCHAINS);
+	atomic_init(&adb->nentrychains, adb->nentries * ADB_MINCHAINS);
+
 	/*
 	 * Initialize the bucket locks for names and elements.
 	 * May as well initialize the list heads, too.
@@ -2724,8 +2668,9 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	if (result != ISC_R_SUCCESS)
 		goto fail3;
 
-	set_adbstat(adb, adb->nentries, dns_adbstats_nentries);
-	set_adbstat(adb, adb->nnames, dns_adbstats_nnames);
+	set_adbstat(adb, atomic_load(&adb->nentrychains),
+		    dns_adbstats_nentries);
+	set_adbstat(adb, atomic_load(&adb->nnamechains), dns_adbstats_nnames);
 
 	/*
 	 * Normal return.
@@ -2745,6 +2690,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
 
  fail1: /* clean up only allocated memory */
+	free_hashes(adb);
 	if (adb->entries != NULL)
 		isc_mem_put(adb->mctx, adb->entries,
 			    sizeof(*adb->entries) * adb->nentries);
@@ -2802,8 +2748,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
  fail0c:
 	DESTROYLOCK(&adb->lock);
  fail0b:
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 	isc_mem_putanddetach(&adb->mctx, adb, sizeof(dns_adb_t));
 
 	return (result);
@@ -3530,11 +3474,14 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry,
 		fprintf(f, ";\t%p: refcnt %u\n", entry, entry->refcnt);
 
 	fprintf(f, ";\t%s [srtt %u] [flags %08x] [edns %u/%u/%u/%u/%u] "
-		"[plain %u/%u]", addrbuf, entry->srtt, entry->flags,
+		"[plain %u/%u]", addrbuf,
+		(unsigned int)atomic_load(&entry->srtt),
+		(unsigned int)atomic_load(&entry->flags),
 		entry->edns, entry->to4096, entry->to1432, entry->to1232,
 		entry->to512, entry->plain, entry->plainto);
-	if (entry->udpsize != 0U)
-		fprintf(f, " [udpsize %u]", entry->udpsize);
+	if (atomic_load(&entry->udpsize) != 0U)
+		fprintf(f, " [udpsize %u]",
+			(unsigned int)atomic_load(&entry->udpsize));
 	if (entry->cookie != NULL) {
 		unsigned int i;
 		fprintf(f, " [cookie=");
@@ -3547,7 +3494,7 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry,
 
 	if (adb != NULL && adb->quota != 0 && adb->atr_freq != 0) {
 		fprintf(f, " [atr %0.2f] [quota %u]",
-			entry->atr, entry->quota);
+			entry->atr, (unsigned int)atomic_load(&entry->quota));
 	}
 
 	fprintf(f, "\n");
@@ -4084,6 +4031,7 @@ dns_adb_marklame(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		 isc_stdtime_t expire_time)
 {
 	dns_adblameinfo_t *li;
+	unsigned int qhash;
 	int bucket;
 	isc_result_t result = ISC_R_SUCCESS;
 
@@ -4091,11 +4039,13 @@ dns_adb_marklame(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 	REQUIRE(qname != NULL);
 
+	qhash = dns_name_hash(qname, false);
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
 	li = ISC_LIST_HEAD(addr->entry->lameinfo);
 	while (li != NULL &&
-	       (li->qtype != qtype || !dns_name_equal(qname, &li->qname)))
+	       (li->qtype != qtype || li->qhash != qhash ||
+		!dns_name_equal(qname, &li->qname)))
 		li = ISC_LIST_NEXT(li, plink);
 	if (li != NULL) {
 		if (expire_time > li->lame_timer)
@@ -4145,6 +4095,16 @@ dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
+	/*
+	 * The resolver ages every address it did not try each time it
+	 * gets an answer; most of the time the entry has already been
+	 * aged this second, and there is nothing to do but read the srtt.
+	 */
+	if (atomic_load(&addr->entry->lastage) == now) {
+		addr->srtt = (unsigned int)atomic_load(&addr->entry->srtt);
+		return;
+	}
+
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
 
@@ -4157,22 +4117,23 @@ static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now)
 {
-	uint64_t new_srtt;
+	uint64_t new_srtt, srtt;
 
+	srtt = atomic_load(&addr->entry->srtt);
 	if (factor == DNS_ADB_RTTADJAGE) {
-		if (addr->entry->lastage != now) {
-			new_srtt = addr->entry->srtt;
+		if (atomic_load(&addr->entry->lastage) != now) {
+			new_srtt = srtt;
 			new_srtt <<= 9;
-			new_srtt -= addr->entry->srtt;
+			new_srtt -= srtt;
 			new_srtt >>= 9;
-			addr->entry->lastage = now;
+			atomic_store(&addr->entry->lastage, now);
 		} else
-			new_srtt = addr->entry->srtt;
+			new_srtt = srtt;
 	} else
-		new_srtt = ((uint64_t)addr->entry->srtt / 10 * factor)
+		new_srtt = (srtt / 10 * factor)
 			+ ((uint64_t)rtt / 10 * (10 - factor));
 
-	addr->entry->srtt = (unsigned int) new_srtt;
+	atomic_store(&addr->entry->srtt, (unsigned int) new_srtt);
 	addr->srtt = (unsigned int) new_srtt;
 
 	if (addr->entry->expires == 0)
@@ -4195,7 +4156,9 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	bucket = addr->entry->lock_bucket;
 	LOCK(&adb->entrylocks[bucket]);
 
-	addr->entry->flags = (addr->entry->flags & ~mask) | (bits & mask);
+	atomic_store(&addr->entry->flags,
+		     (atomic_load(&addr->entry->flags) & ~mask) |
+		     (bits & mask));
 	if (addr->entry->expires == 0) {
 		isc_stdtime_get(&now);
 		addr->entry->expires = now + ADB_ENTRY_WINDOW;
@@ -4237,6 +4200,7 @@ maybe_adjust_quota(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		   bool timeout)
 {
 	double tr;
+	uint32_t quota;
 
 	UNUSED(adb);
 
@@ -4265,21 +4229,18 @@ maybe_adjust_quota(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	addr->entry->atr = ISC_CLAMP(addr->entry->atr, 0.0, 1.0);
 
 	if (addr->entry->atr < adb->atr_low && addr->entry->mode > 0) {
-		addr->entry->quota = adb->quota *
-			quota_adj[--addr->entry->mode] / 10000;
+		quota = adb->quota * quota_adj[--addr->entry->mode] / 10000;
+		/* Ensure we don't drop to zero */
+		atomic_store(&addr->entry->quota, ISC_MAX(quota, 1));
 		log_quota(addr->entry, "atr %0.2f, quota increased to %u",
-			  addr->entry->atr, addr->entry->quota);
+			  addr->entry->atr, ISC_MAX(quota, 1));
 	} else if (addr->entry->atr > adb->atr_high &&
 		   addr->entry->mode < (QUOTA_ADJ_SIZE - 1)) {
-		addr->entry->quota = adb->quota *
-			quota_adj[++addr->entry->mode] / 10000;
+		quota = adb->quota * quota_adj[++addr->entry->mode] / 10000;
+		atomic_store(&addr->entry->quota, ISC_MAX(quota, 1));
 		log_quota(addr->entry, "atr %0.2f, quota decreased to %u",
-			  addr->entry->atr, addr->entry->quota);
+			  addr->entry->atr, ISC_MAX(quota, 1));
 	}
-
-	/* Ensure we don't drop to zero */
-	if (addr->entry->quota == 0)
-		addr->entry->quota = 1;
 }
 
 #define EDNSTOS 3U
@@ -4438,8 +4399,8 @@ dns_adb_setudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int size) {
 	LOCK(&adb->entrylocks[bucket]);
 	if (size < 512U)
 		size = 512U;
-	if (size > addr->entry->udpsize)
-		addr->entry->udpsize = size;
+	if (size > atomic_load(&addr->entry->udpsize))
+		atomic_store(&addr->entry->udpsize, size);
 
 	maybe_adjust_quota(adb, addr, false);
 
@@ -4458,24 +4419,16 @@ dns_adb_setudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int size) {
 
 unsigned int
 dns_adb_getudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	int bucket;
-	unsigned int size;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
-	size = addr->entry->udpsize;
-	UNLOCK(&adb->entrylocks[bucket]);
-
-	return (size);
+	return ((unsigned int)atomic_load(&addr->entry->udpsize));
 }
 
 unsigned int
 dns_adb_probesize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, int lookups) {
 	int bucket;
-	unsigned int size;
+	unsigned int size, udpsize;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
@@ -4494,9 +4447,9 @@ dns_adb_probesize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, int lookups) {
 	 * Don't shrink probe size below what we have seen due to multiple
 	 * lookups.
 	 */
-	if (lookups > 0 &&
-	    size < addr->entry->udpsize && addr->entry->udpsize < 4096)
-		size = addr->entry->udpsize;
+	udpsize = atomic_load(&addr->entry->udpsize);
+	if (lookups > 0 && size < udpsize && udpsize < 4096)
+		size = udpsize;
 	UNLOCK(&adb->entrylocks[bucket]);
 
 	return (size);
@@ -4677,18 +4630,23 @@ void
 dns_adb_flushname(dns_adb_t *adb, const dns_name_t *name) {
 	dns_adbname_t *adbname;
 	dns_adbname_t *nextname;
+	adbnamehash_t *hash;
+	unsigned int hashval;
 	int bucket;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(name != NULL);
 
 	LOCK(&adb->lock);
-	bucket = dns_name_hash(name, false) % adb->nnames;
+	hashval = dns_name_fullhash(name, false);
+	bucket = hashval % adb->nnames;
 	LOCK(&adb->namelocks[bucket]);
-	adbname = ISC_LIST_HEAD(adb->names[bucket]);
+	hash = &adb->namehash[bucket];
+	adbname = ISC_LIST_HEAD(hash->chains[ADB_CHAIN(hash, adb->nnames,
+						       hashval)]);
 	while (adbname != NULL) {
-		nextname = ISC_LIST_NEXT(adbname, plink);
-		if (!NAME_DEAD(adbname) &&
+		nextname = ISC_LIST_NEXT(adbname, hlink);
+		if (adbname->hashval == hashval &&
 		    dns_name_equal(name, &adbname->name)) {
 			RUNTIME_CHECK(kill_name(&adbname,
 						DNS_EVENT_ADBCANCELED) ==
@@ -4782,34 +4740,36 @@ dns_adb_setquota(dns_adb_t *adb, uint32_t quota, uint32_t freq,
 bool
 dns_adbentry_overquota(dns_adbentry_t *entry) {
 	REQUIRE(DNS_ADBENTRY_VALID(entry));
-	return (entry->quota != 0 && entry->active >= entry->quota);
+	return (entry_overquota(entry));
 }
 
 void
 dns_adb_beginudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	int bucket;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-
-	LOCK(&adb->entrylocks[bucket]);
-	addr->entry->active++;
-	UNLOCK(&adb->entrylocks[bucket]);
+	atomic_fetch_add_explicit(&addr->entry->active, 1,
+				  memory_order_relaxed);
 }
 
 void
 dns_adb_endudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	int bucket;
+	uint_fast32_t active;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-
-	LOCK(&adb->entrylocks[bucket]);
-	if (addr->entry->active > 0)
-		addr->entry->active--;
-	UNLOCK(&adb->entrylocks[bucket]);
+	/*
+	 * Never go below zero.
+	 */
+	active = atomic_load_explicit(&addr->entry->active,
+				      memory_order_relaxed);
+	while (active > 0 &&
+	       !atomic_compare_exchange_weak_explicit(&addr->entry->active,
+						      &active, active - 1,
+						      memory_order_relaxed,
+						      memory_order_relaxed))
+	{
+		/* 'active' was reloaded; try again. */
+	}
 }
@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/rwlock.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/anscache.h>
+#include <dns/db.h>
+#include <dns/name.h>
+#include <dns/types.h>
+
+#define ANSCACHE_MAGIC		ISC_MAGIC('A', 'n', 's', 'C')
+#define VALID_ANSCACHE(c)	ISC_MAGIC_VALID(c, ANSCACHE_MAGIC)
+
+typedef struct dns_ansentry dns_ansentry_t;
+
+/*%
+ * An entry is allocated as a single block: the structure is followed
+ * by the query name in wire format and then by the response.
+ */
+struct dns_ansentry {
+	dns_ansentry_t *		next;		/*%< hash chain */
+	ISC_LINK(dns_ansentry_t)	link;		/*%< CLOCK order */
+	atomic_bool			referenced;
+	uint32_t			hashval;
+	dns_rdatatype_t			type;
+	uint32_t			variant;
+	unsigned int			info;
+	unsigned int			namelen;
+	unsigned int			length;
+};
+
+#define ENTRY_NAME(e)		((unsigned char *)((e) + 1))
+#define ENTRY_WIRE(e)		(ENTRY_NAME(e) + (e)->namelen)
+#define ENTRY_SIZE(e)		(sizeof(*(e)) + (e)->namelen + (e)->length)
+
+struct dns_anscache {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	isc_refcount_t			references;
+	isc_rwlock_t			lock;
+	atomic_uint_fast32_t		generation;
+
+	/* Locked by lock. */
+	dns_ansentry_t			**table;
+	unsigned int			size;		/*%< power of two */
+	unsigned int			count;
+	unsigned int			maxentries;
+	ISC_LIST(dns_ansentry_t)	clock;
+};
+
+static inline uint32_t
+hash_key(const isc_region_t *name, dns_rdatatype_t type, uint32_t variant) {
+	uint32_t h;
+	uint32_t tail[2];
+
+	tail[0] = type;
+	tail[1] = variant;
+	h = isc_hash_function(name->base, name->length, true, NULL);
+	return (isc_hash_function(tail, sizeof(tail), true, &h));
+}
+
+static inline bool
+entry_match(dns_ansentry_t *e, uint32_t hashval,
+	    const isc_region_t *name, dns_rdatatype_t type, uint32_t variant)
+{
+	return (e->hashval == hashval && e->type == type &&
+		e->variant == variant && e->namelen == name->length &&
+		memcmp(ENTRY_NAME(e), name->base, name->length) == 0);
+}
+
+static void
+entry_unlink(dns_anscache_t *cache, dns_ansentry_t *e) {
+	dns_ansentry_t **prevp;
+
+	prevp = &cache->table[e->hashval & (cache->size - 1)];
+	while (*prevp != e) {
+		INSIST(*prevp != NULL);
+		prevp = &(*prevp)->next;
+	}
+	*prevp = e->next;
+	ISC_LIST_UNLINK(cache->clock, e, link);
+	cache->count--;
+	isc_mem_put(cache->mctx, e, ENTRY_SIZE(e));
+}
+
+/*
+ * Pick an entry to make room for a new one: walk the CLOCK list from
+ * the oldest entry, giving each entry that has been used since the hand
+ * last passed it a second chance at the tail of the list.
+ */
+static void
+evict(dns_anscache_t *cache) {
+	dns_ansentry_t *e;
+
+	for (;;) {
+		e = ISC_LIST_HEAD(cache->clock);
+		INSIST(e != NULL);
+		if (!atomic_exchange_explicit(&e->referenced, false,
+					      memory_order_relaxed))
+		{
+			break;
+		}
+		ISC_LIST_UNLINK(cache->clock, e, link);
+		ISC_LIST_APPEND(cache->clock, e, link);
+	}
+	entry_unlink(cache, e);
+}
+
+isc_result_t
+dns_anscache_create(isc_mem_t *mctx, unsigned int maxentries,
+		    dns_anscache_t **cachep)
+{
+	isc_result_t result;
+	dns_anscache_t *cache;
+	unsigned int size;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxentries > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
+
+	/*
+	 * Keep the load factor at or below one.
+	 */
+	size = 16;
+	while (size < maxentries && size < (1U << 24)) {
+		size <<= 1;
+	}
+
+	cache->table = isc_mem_get(mctx, size * sizeof(cache->table[0]));
+	if (cache->table == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_cache;
+	}
+	memset(cache->table, 0, size * sizeof(cache->table[0]));
+
+	result = isc_rwlock_init(&cache->lock, 0, 0);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup_table;
+	}
+
+	cache->mctx = NULL;
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_refcount_init(&cache->references, 1);
+	atomic_init(&cache->generation, 0);
+	cache->size = size;
+	cache->count = 0;
+	cache->maxentries = maxentries;
+	ISC_LIST_INIT(cache->clock);
+	cache->magic = ANSCACHE_MAGIC;
+
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup_table:
+	isc_mem_put(mctx, cache->table, size * sizeof(cache->table[0]));
+ cleanup_cache:
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_anscache_attach(dns_anscache_t *source, dns_anscache_t **targetp) {
+	REQUIRE(VALID_ANSCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references);
+	*targetp = source;
+}
+
+static void
+anscache_free(dns_anscache_t *cache) {
+	dns_ansentry_t *e;
+
+	while ((e = ISC_LIST_HEAD(cache->clock)) != NULL) {
+		ISC_LIST_UNLINK(cache->clock, e, link);
+		isc_mem_put(cache->mctx, e, ENTRY_SIZE(e));
+	}
+	isc_mem_put(cache->mctx, cache->table,
+		    cache->size * sizeof(cache->table[0]));
+	isc_rwlock_destroy(&cache->lock);
+	isc_refcount_destroy(&cache->references);
+	cache->magic = 0;
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+dns_anscache_detach(dns_anscache_t **cachep) {
+	dns_anscache_t *cache;
+
+	REQUIRE(cachep != NULL && VALID_ANSCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	if (isc_refcount_decrement(&cache->references) == 1) {
+		anscache_free(cache);
+	}
+}
+
+unsigned int
+dns_anscache_getmaxentries(dns_anscache_t *cache) {
+	REQUIRE(VALID_ANSCACHE(cache));
+
+	return (cache->maxentries);
+}
+
+uint32_t
+dns_anscache_generation(dns_anscache_t *cache) {
+	REQUIRE(VALID_ANSCACHE(cache));
+
+	return (atomic_load_explicit(&cache->generation,
+				     memory_order_acquire));
+}
+
+void
+dns_anscache_flush(dns_anscache_t *cache) {
+	dns_ansentry_t *e;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+
+	RWLOCK(&cache->lock, isc_rwlocktype_write);
+	atomic_fetch_add_explicit(&cache->generation, 1,
+				  memory_order_release);
+	while ((e = ISC_LIST_HEAD(cache->clock)) != NULL) {
+		ISC_LIST_UNLINK(cache->clock, e, link);
+		isc_mem_put(cache->mctx, e, ENTRY_SIZE(e));
+	}
+	memset(cache->table, 0, cache->size * sizeof(cache->table[0]));
+	cache->count = 0;
+	RWUNLOCK(&cache->lock, isc_rwlocktype_write);
+}
+
+isc_result_t
+dns_anscache_dbupdate(dns_db_t *db, void *fn_arg) {
+	dns_anscache_t *cache = fn_arg;
+
+	UNUSED(db);
+
+	dns_anscache_flush(cache);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_anscache_find(dns_anscache_t *cache, const dns_name_t *qname,
+		  dns_rdatatype_t qtype, uint32_t variant,
+		  isc_buffer_t *target, unsigned int *infop)
+{
+	isc_result_t result = ISC_R_NOTFOUND;
+	isc_region_t name;
+	dns_ansentry_t *e;
+	uint32_t hashval;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+	REQUIRE(dns_name_isabsolute(qname));
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	dns_name_toregion(qname, &name);
+	hashval = hash_key(&name, qtype, variant);
+
+	RWLOCK(&cache->lock, isc_rwlocktype_read);
+	for (e = cache->table[hashval & (cache->size - 1)];
+	     e != NULL;
+	     e = e->next)
+	{
+		if (!entry_match(e, hashval, &name, qtype, variant)) {
+			continue;
+		}
+		if (isc_buffer_availablelength(target) < e->length) {
+			result = ISC_R_NOSPACE;
+			break;
+		}
+		isc_buffer_putmem(target, ENTRY_WIRE(e), e->length);
+		if (infop != NULL) {
+			*infop = e->info;
+		}
+		if (!atomic_load_explicit(&e->referenced,
+					  memory_order_relaxed))
+		{
+			atomic_store_explicit(&e->referenced, true,
+					      memory_order_relaxed);
+		}
+		result = ISC_R_SUCCESS;
+		break;
+	}
+	RWUNLOCK(&cache->lock, isc_rwlocktype_read);
+
+	return (result);
+}
+
+isc_result_t
+dns_anscache_add(dns_anscache_t *cache, const dns_name_t *qname,
+		 dns_rdatatype_t qtype, uint32_t variant,
+		 uint32_t generation, unsigned int info,
+		 const isc_region_t *wire)
+{
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_region_t name;
+	dns_ansentry_t *e, *newe;
+	uint32_t hashval, bucket;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+	REQUIRE(dns_name_isabsolute(qname));
+	REQUIRE(wire != NULL);
+
+	if (wire->length > DNS_ANSCACHE_MAXLENGTH) {
+		return (ISC_R_RANGE);
+	}
+
+	dns_name_toregion(qname, &name);
+	hashval = hash_key(&name, qtype, variant);
+	bucket = hashval & (cache->size - 1);
+
+	/*
+	 * Build the entry before taking the lock; it is simply thrown
+	 * away if it turns out not to be needed.
+	 */
+	newe = isc_mem_get(cache->mctx,
+			   sizeof(*newe) + name.length + wire->length);
+	if (newe == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
+	newe->next = NULL;
+	ISC_LINK_INIT(newe, link);
+	atomic_init(&newe->referenced, false);
+	newe->hashval = hashval;
+	newe->type = qtype;
+	newe->variant = variant;
+	newe->info = info;
+	newe->namelen = name.length;
+	newe->length = wire->length;
+	memmove(ENTRY_NAME(newe), name.base, name.length);
+	memmove(ENTRY_WIRE(newe), wire->base, wire->length);
+
+	RWLOCK(&cache->lock, isc_rwlocktype_write);
+	if (atomic_load_explicit(&cache->generation,
+				 memory_order_relaxed) != generation)
+	{
+		result = ISC_R_CANCELED;
+		goto unlock;
+	}
+	for (e = cache->table[bucket]; e != NULL; e = e->next) {
+		if (entry_match(e, hashval, &name, qtype, variant)) {
+			result = ISC_R_EXISTS;
+			goto unlock;
+		}
+	}
+	if (cache->count >= cache->maxentries) {
+		evict(cache);
+	}
+	newe->next = cache->table[bucket];
+	cache->table[bucket] = newe;
+	ISC_LIST_APPEND(cache->clock, newe, link);
+	cache->count++;
+	newe = NULL;
+ unlock:
+	RWUNLOCK(&cache->lock, isc_rwlocktype_write);
+
+	if (newe != NULL) {
+		isc_mem_put(cache->mctx, newe, ENTRY_SIZE(newe));
+	}
+	return (result);
+}
+
+unsigned int
+dns_anscache_count(dns_anscache_t *cache) {
+	unsigned int count;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+
+	RWLOCK(&cache->lock, isc_rwlocktype_read);
+	count = cache->count;
+	RWUNLOCK(&cache->lock, isc_rwlocktype_read);
+
+	return (count);
+}
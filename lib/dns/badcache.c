@@ -32,18 +32,42 @@
 #include <dns/rdatatype.h>
 #include <dns/types.h>
 
+/*%
+ * The cache is split into partitions, each with its own lock and hash
+ * table, so that lookups from different worker threads rarely contend.
+ * A partition's table is resized incrementally: the old table is kept
+ * alongside the new one and drained a few buckets at a time by the
+ * operations that follow, so no single caller pays for rehashing the
+ * whole partition.
+ */
+#ifndef DNS_BADCACHE_NPARTS
+#define DNS_BADCACHE_NPARTS	16
+#endif
+
+/*%
+ * Number of old-table buckets moved per operation while a partition
+ * is being resized.
+ */
+#define BADCACHE_MIGRATE	4
+
 typedef struct dns_bcentry dns_bcentry_t;
 
+typedef struct dns_bcpart {
+	isc_mutex_t		lock;
+	dns_bcentry_t		**table;
+	unsigned int		size;
+	dns_bcentry_t		**oldtable;	/*%< being drained */
+	unsigned int		oldsize;
+	unsigned int		oldnext;	/*%< next bucket to drain */
+	unsigned int		count;
+	unsigned int		minsize;
+	unsigned int		sweep;
+} dns_bcpart_t;
+
 struct dns_badcache {
 	unsigned int		magic;
-	isc_mutex_t		lock;
 	isc_mem_t		*mctx;
-
-	dns_bcentry_t 		**table;
-	unsigned int 		count;
-	unsigned int 		minsize;
-	unsigned int 		size;
-	unsigned int 		sweep;
+	dns_bcpart_t		parts[DNS_BADCACHE_NPARTS];
 };
 
 #define BADCACHE_MAGIC                   ISC_MAGIC('B', 'd', 'C', 'a')
@@ -58,13 +82,27 @@ struct dns_bcentry {
 	dns_name_t		name;
 };
 
-static isc_result_t
-badcache_resize(dns_badcache_t *bc, isc_time_t *now, bool grow);
+#define PART(bc, h)		(&(bc)->parts[(h) % DNS_BADCACHE_NPARTS])
+#define BUCKET(h, size)		(((h) / DNS_BADCACHE_NPARTS) % (size))
+
+static void
+part_resize(dns_badcache_t *bc, dns_bcpart_t *part, bool grow);
+
+static void
+part_migrate(dns_badcache_t *bc, dns_bcpart_t *part, isc_time_t *now);
+
+static inline void
+bcentry_free(dns_badcache_t *bc, dns_bcpart_t *part, dns_bcentry_t *bad) {
+	isc_mem_put(bc->mctx, bad, sizeof(*bad) + bad->name.length);
+	part->count--;
+}
 
 isc_result_t
 dns_badcache_init(isc_mem_t *mctx, unsigned int size, dns_badcache_t **bcp) {
 	isc_result_t result;
 	dns_badcache_t *bc = NULL;
+	dns_bcpart_t *part;
+	unsigned int i, partsize;
 
 	REQUIRE(bcp != NULL && *bcp == NULL);
 	REQUIRE(mctx != NULL);
@@ -75,29 +113,46 @@ dns_badcache_init(isc_mem_t *mctx, unsigned int size, dns_badcache_t **bcp) {
 	memset(bc, 0, sizeof(dns_badcache_t));
 
 	isc_mem_attach(mctx, &bc->mctx);
-	result = isc_mutex_init(&bc->lock);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
 
-	bc->table = isc_mem_get(bc->mctx, sizeof(*bc->table) * size);
-	if (bc->table == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto destroy_lock;
-	}
+	partsize = (size + DNS_BADCACHE_NPARTS - 1) / DNS_BADCACHE_NPARTS;
+	if (partsize < 1)
+		partsize = 1;
 
-	bc->size = bc->minsize = size;
-	memset(bc->table, 0, bc->size * sizeof(dns_bcentry_t *));
+	for (i = 0; i < DNS_BADCACHE_NPARTS; i++) {
+		part = &bc->parts[i];
+		part->table = isc_mem_get(bc->mctx,
+					  sizeof(*part->table) * partsize);
+		if (part->table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		result = isc_mutex_init(&part->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(bc->mctx, part->table,
+				    sizeof(*part->table) * partsize);
+			goto cleanup;
+		}
+		part->size = part->minsize = partsize;
+		memset(part->table, 0, part->size * sizeof(dns_bcentry_t *));
+		part->oldtable = NULL;
+		part->oldsize = 0;
+		part->oldnext = 0;
+		part->count = 0;
+		part->sweep = 0;
+	}
 
-	bc->count = 0;
-	bc->sweep = 0;
 	bc->magic = BADCACHE_MAGIC;
 
 	*bcp = bc;
 	return (ISC_R_SUCCESS);
 
- destroy_lock:
-	DESTROYLOCK(&bc->lock);
  cleanup:
+	while (i-- > 0) {
+		part = &bc->parts[i];
+		DESTROYLOCK(&part->lock);
+		isc_mem_put(bc->mctx, part->table,
+			    sizeof(*part->table) * part->size);
+	}
 	isc_mem_putanddetach(&bc->mctx, bc, sizeof(dns_badcache_t));
 	return (result);
 }
@@ -105,6 +160,8 @@ dns_badcache_init(isc_mem_t *mctx, unsigned int size, dns_badcache_t **bcp) {
 void
 dns_badcache_destroy(dns_badcache_t **bcp) {
 	dns_badcache_t *bc;
+	dns_bcpart_t *part;
+	unsigned int i;
 
 	REQUIRE(bcp != NULL && *bcp != NULL);
 	bc = *bcp;
@@ -112,47 +169,152 @@ dns_badcache_destroy(dns_badcache_t **bcp) {
 	dns_badcache_flush(bc);
 
 	bc->magic = 0;
-	DESTROYLOCK(&bc->lock);
-	isc_mem_put(bc->mctx, bc->table, sizeof(dns_bcentry_t *) * bc->size);
+	for (i = 0; i < DNS_BADCACHE_NPARTS; i++) {
+		part = &bc->parts[i];
+		DESTROYLOCK(&part->lock);
+		isc_mem_put(bc->mctx, part->table,
+			    sizeof(dns_bcentry_t *) * part->size);
+	}
 	isc_mem_putanddetach(&bc->mctx, bc, sizeof(dns_badcache_t));
 	*bcp = NULL;
 }
 
-static isc_result_t
-badcache_resize(dns_badcache_t *bc, isc_time_t *now, bool grow) {
-	dns_bcentry_t **newtable, *bad, *next;
-	unsigned int newsize, i;
+/*
+ * Start resizing 'part'.  The current table becomes the old table and
+ * is drained into the new one by part_migrate().
+ *
+ * Requires the partition to be locked and not already resizing.
+ */
+static void
+part_resize(dns_badcache_t *bc, dns_bcpart_t *part, bool grow) {
+	dns_bcentry_t **newtable;
+	unsigned int newsize;
+
+	INSIST(part->oldtable == NULL);
 
 	if (grow)
-		newsize = bc->size * 2 + 1;
+		newsize = part->size * 2 + 1;
 	else
-		newsize = (bc->size - 1) / 2;
+		newsize = (part->size - 1) / 2;
+	if (newsize < part->minsize)
+		newsize = part->minsize;
+	if (newsize == part->size)
+		return;
 
 	newtable = isc_mem_get(bc->mctx, sizeof(dns_bcentry_t *) * newsize);
 	if (newtable == NULL)
-		return (ISC_R_NOMEMORY);
+		return;
 	memset(newtable, 0, sizeof(dns_bcentry_t *) * newsize);
 
-	for (i = 0; bc->count > 0 && i < bc->size; i++) {
-		for (bad = bc->table[i]; bad != NULL; bad = next) {
+	part->oldtable = part->table;
+	part->oldsize = part->size;
+	part->oldnext = 0;
+	part->table = newtable;
+	part->size = newsize;
+}
+
+/*
+ * Move the next few buckets of an old table into the current one,
+ * dropping expired entries, and free the old table once it is empty.
+ *
+ * Requires the partition to be locked.
+ */
+static void
+part_migrate(dns_badcache_t *bc, dns_bcpart_t *part, isc_time_t *now) {
+	dns_bcentry_t *bad, *next;
+	unsigned int i, n;
+
+	if (part->oldtable == NULL)
+		return;
+
+	for (n = 0; n < BADCACHE_MIGRATE && part->oldnext < part->oldsize;
+	     n++)
+	{
+		i = part->oldnext++;
+		for (bad = part->oldtable[i]; bad != NULL; bad = next) {
+			unsigned int b;
+
 			next = bad->next;
 			if (isc_time_compare(&bad->expire, now) < 0) {
-				isc_mem_put(bc->mctx, bad,
-					    sizeof(*bad) + bad->name.length);
-				bc->count--;
-			} else {
-				bad->next = newtable[bad->hashval % newsize];
-				newtable[bad->hashval % newsize] = bad;
+				bcentry_free(bc, part, bad);
+				continue;
 			}
+			b = BUCKET(bad->hashval, part->size);
+			bad->next = part->table[b];
+			part->table[b] = bad;
+		}
+		part->oldtable[i] = NULL;
+	}
+
+	if (part->oldnext == part->oldsize) {
+		isc_mem_put(bc->mctx, part->oldtable,
+			    sizeof(dns_bcentry_t *) * part->oldsize);
+		part->oldtable = NULL;
+		part->oldsize = 0;
+		part->oldnext = 0;
+	}
+}
+
+/*
+ * Search the hash chain at '*chainp' for 'name'/'type', freeing
+ * expired entries on the way.
+ */
+static dns_bcentry_t *
+chain_find(dns_badcache_t *bc, dns_bcpart_t *part, dns_bcentry_t **chainp,
+	   const dns_name_t *name, unsigned int hashval,
+	   dns_rdatatype_t type, isc_time_t *now)
+{
+	dns_bcentry_t *bad, *prev, *next;
+
+	prev = NULL;
+	for (bad = *chainp; bad != NULL; bad = next) {
+		next = bad->next;
+		if (isc_time_compare(&bad->expire, now) < 0) {
+			if (prev == NULL)
+				*chainp = bad->next;
+			else
+				prev->next = bad->next;
+			bcentry_free(bc, part, bad);
+			continue;
+		}
+		if (bad->hashval == hashval && bad->type == type &&
+		    dns_name_equal(name, &bad->name))
+		{
+			return (bad);
 		}
-		bc->table[i] = NULL;
+		prev = bad;
 	}
 
-	isc_mem_put(bc->mctx, bc->table, sizeof(*bc->table) * bc->size);
-	bc->size = newsize;
-	bc->table = newtable;
+	return (NULL);
+}
+
+/*
+ * Remove every entry at 'name' (or, if 'tree' is true, at or below it)
+ * from the hash chain at '*chainp', along with any expired entries.
+ */
+static void
+chain_flush(dns_badcache_t *bc, dns_bcpart_t *part, dns_bcentry_t **chainp,
+	    const dns_name_t *name, bool tree, isc_time_t *now)
+{
+	dns_bcentry_t *bad, *prev, *next;
+	bool match;
 
-	return (ISC_R_SUCCESS);
+	prev = NULL;
+	for (bad = *chainp; bad != NULL; bad = next) {
+		next = bad->next;
+		if (tree)
+			match = dns_name_issubdomain(&bad->name, name);
+		else
+			match = dns_name_equal(name, &bad->name);
+		if (match || isc_time_compare(&bad->expire, now) < 0) {
+			if (prev == NULL)
+				*chainp = bad->next;
+			else
+				prev->next = bad->next;
+			bcentry_free(bc, part, bad);
+		} else
+			prev = bad;
+	}
 }
 
 void
@@ -162,41 +324,32 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 {
 	isc_result_t result;
 	unsigned int i, hashval;
-	dns_bcentry_t *bad, *prev, *next;
+	dns_bcpart_t *part;
+	dns_bcentry_t *bad;
 	isc_time_t now;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 	REQUIRE(expire != NULL);
 
-	LOCK(&bc->lock);
-
 	result = isc_time_now(&now);
 	if (result != ISC_R_SUCCESS)
 		isc_time_settoepoch(&now);
 
 	hashval = dns_name_hash(name, false);
-	i = hashval % bc->size;
-	prev = NULL;
-	for (bad = bc->table[i]; bad != NULL; bad = next) {
-		next = bad->next;
-		if (bad->type == type && dns_name_equal(name, &bad->name)) {
-			if (update) {
-				bad->expire = *expire;
-				bad->flags = flags;
-			}
-			break;
-		}
-		if (isc_time_compare(&bad->expire, &now) < 0) {
-			if (prev == NULL)
-				bc->table[i] = bad->next;
-			else
-				prev->next = bad->next;
-			isc_mem_put(bc->mctx, bad,
-				    sizeof(*bad) + bad->name.length);
-			bc->count--;
-		} else
-			prev = bad;
+	part = PART(bc, hashval);
+
+	LOCK(&part->lock);
+
+	part_migrate(bc, part, &now);
+
+	i = BUCKET(hashval, part->size);
+	bad = chain_find(bc, part, &part->table[i], name, hashval, type, &now);
+	if (bad == NULL && part->oldtable != NULL) {
+		bad = chain_find(bc, part,
+				 &part->oldtable[BUCKET(hashval,
+							part->oldsize)],
+				 name, hashval, type, &now);
 	}
 
 	if (bad == NULL) {
@@ -211,18 +364,24 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 		isc_buffer_init(&buffer, bad + 1, name->length);
 		dns_name_init(&bad->name, NULL);
 		dns_name_copy(name, &bad->name, &buffer);
-		bad->next = bc->table[i];
-		bc->table[i] = bad;
-		bc->count++;
-		if (bc->count > bc->size * 8)
-			badcache_resize(bc, &now, true);
-		if (bc->count < bc->size * 2 && bc->size > bc->minsize)
-			badcache_resize(bc, &now, false);
-	} else
+		bad->next = part->table[i];
+		part->table[i] = bad;
+		part->count++;
+		if (part->oldtable == NULL) {
+			if (part->count > part->size * 8)
+				part_resize(bc, part, true);
+			else if (part->count < part->size * 2 &&
+				 part->size > part->minsize)
+				part_resize(bc, part, false);
+		}
+	} else {
+		if (update)
+			bad->flags = flags;
 		bad->expire = *expire;
+	}
 
  cleanup:
-	UNLOCK(&bc->lock);
+	UNLOCK(&part->lock);
 }
 
 bool
@@ -230,211 +389,210 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 		  dns_rdatatype_t type, uint32_t *flagp,
 		  isc_time_t *now)
 {
-	dns_bcentry_t *bad, *prev, *next;
+	dns_bcpart_t *part;
+	dns_bcentry_t *bad = NULL;
 	bool answer = false;
-	unsigned int i;
+	unsigned int i, hashval;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 	REQUIRE(now != NULL);
 
-	LOCK(&bc->lock);
+	hashval = dns_name_hash(name, false);
+	part = PART(bc, hashval);
 
-	/*
-	 * XXXMUKS: dns_name_equal() is expensive as it does a
-	 * octet-by-octet comparison, and it can be made better in two
-	 * ways here. First, lowercase the names (use
-	 * dns_name_downcase() instead of dns_name_copy() in
-	 * dns_badcache_add()) so that dns_name_caseequal() can be used
-	 * which the compiler will emit as SIMD instructions. Second,
-	 * don't put multiple copies of the same name in the chain (or
-	 * multiple names will have to be matched for equality), but use
-	 * name->link to store the type specific part.
-	 */
+	LOCK(&part->lock);
 
-	if (bc->count == 0)
+	if (part->count == 0)
 		goto skip;
 
-	i = dns_name_hash(name, false) % bc->size;
-	prev = NULL;
-	for (bad = bc->table[i]; bad != NULL; bad = next) {
-		next = bad->next;
-		/*
-		 * Search the hash list. Clean out expired records as we go.
-		 */
-		if (isc_time_compare(&bad->expire, now) < 0) {
-			if (prev != NULL)
-				prev->next = bad->next;
-			else
-				bc->table[i] = bad->next;
+	part_migrate(bc, part, now);
 
-			isc_mem_put(bc->mctx, bad, sizeof(*bad) +
-				    bad->name.length);
-			bc->count--;
-			continue;
-		}
-		if (bad->type == type && dns_name_equal(name, &bad->name)) {
-			if (flagp != NULL)
-				*flagp = bad->flags;
-			answer = true;
-			break;
-		}
-		prev = bad;
+	bad = chain_find(bc, part, &part->table[BUCKET(hashval, part->size)],
+			 name, hashval, type, now);
+	if (bad == NULL && part->oldtable != NULL) {
+		bad = chain_find(bc, part,
+				 &part->oldtable[BUCKET(hashval,
+							part->oldsize)],
+				 name, hashval, type, now);
+	}
+	if (bad != NULL) {
+		if (flagp != NULL)
+			*flagp = bad->flags;
+		answer = true;
 	}
  skip:
 
 	/*
 	 * Slow sweep to clean out stale records.
 	 */
-	i = bc->sweep++ % bc->size;
-	bad = bc->table[i];
+	i = part->sweep++ % part->size;
+	bad = part->table[i];
 	if (bad != NULL && isc_time_compare(&bad->expire, now) < 0) {
-		bc->table[i] = bad->next;
-		isc_mem_put(bc->mctx, bad, sizeof(*bad) + bad->name.length);
-		bc->count--;
+		part->table[i] = bad->next;
+		bcentry_free(bc, part, bad);
 	}
 
-	UNLOCK(&bc->lock);
+	UNLOCK(&part->lock);
 	return (answer);
 }
 
 void
 dns_badcache_flush(dns_badcache_t *bc) {
+	dns_bcpart_t *part;
 	dns_bcentry_t *entry, *next;
-	unsigned int i;
+	unsigned int i, p;
 
 	REQUIRE(VALID_BADCACHE(bc));
 
-	for (i = 0; bc->count > 0 && i < bc->size; i++) {
-		for (entry = bc->table[i]; entry != NULL; entry = next) {
-			next = entry->next;
-			isc_mem_put(bc->mctx, entry, sizeof(*entry) +
-				    entry->name.length);
-			bc->count--;
+	for (p = 0; p < DNS_BADCACHE_NPARTS; p++) {
+		part = &bc->parts[p];
+		LOCK(&part->lock);
+		for (i = 0; part->count > 0 && i < part->size; i++) {
+			for (entry = part->table[i]; entry != NULL;
+			     entry = next)
+			{
+				next = entry->next;
+				bcentry_free(bc, part, entry);
+			}
+			part->table[i] = NULL;
+		}
+		if (part->oldtable != NULL) {
+			for (i = part->oldnext; i < part->oldsize; i++) {
+				for (entry = part->oldtable[i]; entry != NULL;
+				     entry = next)
+				{
+					next = entry->next;
+					bcentry_free(bc, part, entry);
+				}
+			}
+			isc_mem_put(bc->mctx, part->oldtable,
+				    sizeof(dns_bcentry_t *) * part->oldsize);
+			part->oldtable = NULL;
+			part->oldsize = 0;
+			part->oldnext = 0;
 		}
-		bc->table[i] = NULL;
+		INSIST(part->count == 0);
+		UNLOCK(&part->lock);
 	}
 }
 
 void
 dns_badcache_flushname(dns_badcache_t *bc, const dns_name_t *name) {
-	dns_bcentry_t *bad, *prev, *next;
+	dns_bcpart_t *part;
 	isc_result_t result;
 	isc_time_t now;
-	unsigned int i;
+	unsigned int hashval;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 
-	LOCK(&bc->lock);
-
 	result = isc_time_now(&now);
 	if (result != ISC_R_SUCCESS)
 		isc_time_settoepoch(&now);
-	i = dns_name_hash(name, false) % bc->size;
-	prev = NULL;
-	for (bad = bc->table[i]; bad != NULL; bad = next) {
-		int n;
-		next = bad->next;
-		n = isc_time_compare(&bad->expire, &now);
-		if (n < 0 || dns_name_equal(name, &bad->name)) {
-			if (prev == NULL)
-				bc->table[i] = bad->next;
-			else
-				prev->next = bad->next;
-
-			isc_mem_put(bc->mctx, bad, sizeof(*bad) +
-				    bad->name.length);
-			bc->count--;
-		} else
-			prev = bad;
-	}
 
-	UNLOCK(&bc->lock);
+	hashval = dns_name_hash(name, false);
+	part = PART(bc, hashval);
+
+	LOCK(&part->lock);
+	chain_flush(bc, part, &part->table[BUCKET(hashval, part->size)],
+		    name, false, &now);
+	if (part->oldtable != NULL)
+		chain_flush(bc, part,
+			    &part->oldtable[BUCKET(hashval, part->oldsize)],
+			    name, false, &now);
+	UNLOCK(&part->lock);
 }
 
 void
 dns_badcache_flushtree(dns_badcache_t *bc, const dns_name_t *name) {
-	dns_bcentry_t *bad, *prev, *next;
-	unsigned int i;
-	int n;
+	dns_bcpart_t *part;
+	unsigned int i, p;
 	isc_time_t now;
 	isc_result_t result;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 
-	LOCK(&bc->lock);
-
 	result = isc_time_now(&now);
 	if (result != ISC_R_SUCCESS)
 		isc_time_settoepoch(&now);
 
-	for (i = 0; bc->count > 0 && i < bc->size; i++) {
-		prev = NULL;
-		for (bad = bc->table[i]; bad != NULL; bad = next) {
-			next = bad->next;
-			n = isc_time_compare(&bad->expire, &now);
-			if (n < 0 || dns_name_issubdomain(&bad->name, name)) {
-				if (prev == NULL)
-					bc->table[i] = bad->next;
-				else
-					prev->next = bad->next;
-
-				isc_mem_put(bc->mctx, bad, sizeof(*bad) +
-					    bad->name.length);
-				bc->count--;
-			} else
-				prev = bad;
+	for (p = 0; p < DNS_BADCACHE_NPARTS; p++) {
+		part = &bc->parts[p];
+		LOCK(&part->lock);
+		for (i = 0; part->count > 0 && i < part->size; i++)
+			chain_flush(bc, part, &part->table[i], name, true,
+				    &now);
+		if (part->oldtable != NULL) {
+			for (i = part->oldnext;
+			     part->count > 0 && i < part->oldsize; i++)
+			{
+				chain_flush(bc, part, &part->oldtable[i],
+					    name, true, &now);
+			}
 		}
+		UNLOCK(&part->lock);
 	}
-
-	UNLOCK(&bc->lock);
 }
 
-
-void
-dns_badcache_print(dns_badcache_t *bc, const char *cachename, FILE *fp) {
+static void
+chain_print(dns_badcache_t *bc, dns_bcpart_t *part, dns_bcentry_t **chainp,
+	    isc_time_t *now, FILE *fp)
+{
 	char namebuf[DNS_NAME_FORMATSIZE];
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
 	dns_bcentry_t *bad, *next, *prev;
-	isc_time_t now;
-	unsigned int i;
 	uint64_t t;
 
+	prev = NULL;
+	for (bad = *chainp; bad != NULL; bad = next) {
+		next = bad->next;
+		if (isc_time_compare(&bad->expire, now) < 0) {
+			if (prev != NULL)
+				prev->next = bad->next;
+			else
+				*chainp = bad->next;
+			bcentry_free(bc, part, bad);
+			continue;
+		}
+		prev = bad;
+		dns_name_format(&bad->name, namebuf, sizeof(namebuf));
+		dns_rdatatype_format(bad->type, typebuf, sizeof(typebuf));
+		t = isc_time_microdiff(&bad->expire, now);
+		t /= 1000;
+		fprintf(fp, "; %s/%s [ttl "
+			"%" PRIu64 "]\n",
+			namebuf, typebuf, t);
+	}
+}
+
+void
+dns_badcache_print(dns_badcache_t *bc, const char *cachename, FILE *fp) {
+	dns_bcpart_t *part;
+	isc_time_t now;
+	unsigned int i, p;
+
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(cachename != NULL);
 	REQUIRE(fp != NULL);
 
-	LOCK(&bc->lock);
 	fprintf(fp, ";\n; %s\n;\n", cachename);
 
 	TIME_NOW(&now);
-	for (i = 0; bc->count > 0 && i < bc->size; i++) {
-		prev = NULL;
-		for (bad = bc->table[i]; bad != NULL; bad = next) {
-			next = bad->next;
-			if (isc_time_compare(&bad->expire, &now) < 0) {
-				if (prev != NULL)
-					prev->next = bad->next;
-				else
-					bc->table[i] = bad->next;
-
-				isc_mem_put(bc->mctx, bad, sizeof(*bad) +
-					    bad->name.length);
-				bc->count--;
-				continue;
+	for (p = 0; p < DNS_BADCACHE_NPARTS; p++) {
+		part = &bc->parts[p];
+		LOCK(&part->lock);
+		for (i = 0; part->count > 0 && i < part->size; i++)
+			chain_print(bc, part, &part->table[i], &now, fp);
+		if (part->oldtable != NULL) {
+			for (i = part->oldnext;
+			     part->count > 0 && i < part->oldsize; i++)
+			{
+				chain_print(bc, part, &part->oldtable[i],
+					    &now, fp);
 			}
-			prev = bad;
-			dns_name_format(&bad->name, namebuf, sizeof(namebuf));
-			dns_rdatatype_format(bad->type, typebuf,
-					     sizeof(typebuf));
-			t = isc_time_microdiff(&bad->expire, &now);
-			t /= 1000;
-			fprintf(fp, "; %s/%s [ttl "
-				"%" PRIu64 "]\n",
-				namebuf, typebuf, t);
 		}
+		UNLOCK(&part->lock);
 	}
-	UNLOCK(&bc->lock);
 }
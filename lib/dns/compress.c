@@ -18,13 +18,13 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/buffer.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
-#include <dns/fixedname.h>
-#include <dns/rbt.h>
 #include <dns/result.h>
 
 #define CCTX_MAGIC	ISC_MAGIC('C', 'C', 'T', 'X')
@@ -68,76 +68,6 @@ static unsigned char maptolower[] = {
 	0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
 };
 
-/*
- * The tableindex array below is of size 256, one entry for each
- * unsigned char value. The tableindex array elements are dependent on
- * DNS_COMPRESS_TABLESIZE. The table was created using the following
- * function.
- *
- * static void
- * gentable(unsigned char *table) {
- *         unsigned int i;
- *         const unsigned int left = DNS_COMPRESS_TABLESIZE - 38;
- *         long r;
- *
- *         for (i = 0; i < 26; i++) {
- *                 table['A' + i] = i;
- *                 table['a' + i] = i;
- *         }
- *
- *         for (i = 0; i <= 9; i++)
- *                 table['0' + i] = i + 26;
- *
- *         table['-'] = 36;
- *         table['_'] = 37;
- *
- *         for (i = 0; i < 256; i++) {
- *                 if ((i >= 'a' && i <= 'z') ||
- *                     (i >= 'A' && i <= 'Z') ||
- *                     (i >= '0' && i <= '9') ||
- *                     (i == '-') ||
- *                     (i == '_'))
- *                         continue;
- *                 r = random() % left;
- *                 table[i] = 38 + r;
- *         }
- * }
- */
-static unsigned char tableindex[256] = {
-	0x3e, 0x3e, 0x33, 0x2d, 0x30, 0x38, 0x31, 0x3c,
-	0x2b, 0x33, 0x30, 0x3f, 0x2d, 0x3c, 0x36, 0x3a,
-	0x28, 0x2c, 0x2a, 0x37, 0x3d, 0x34, 0x35, 0x2d,
-	0x39, 0x2b, 0x2f, 0x2c, 0x3b, 0x32, 0x2b, 0x39,
-	0x30, 0x38, 0x28, 0x3c, 0x32, 0x33, 0x39, 0x38,
-	0x27, 0x2b, 0x39, 0x30, 0x27, 0x24, 0x2f, 0x2b,
-	0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21,
-	0x22, 0x3a, 0x29, 0x36, 0x31, 0x3c, 0x35, 0x26,
-	0x31, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
-	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x3e, 0x3b, 0x39, 0x2f, 0x25,
-	0x27, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
-	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x36, 0x3b, 0x2f, 0x2f, 0x2e,
-	0x29, 0x33, 0x2a, 0x36, 0x28, 0x3f, 0x2e, 0x29,
-	0x2c, 0x29, 0x36, 0x2d, 0x32, 0x3d, 0x33, 0x2a,
-	0x2e, 0x2f, 0x3b, 0x30, 0x3d, 0x39, 0x2b, 0x36,
-	0x2a, 0x2f, 0x2c, 0x26, 0x3a, 0x37, 0x30, 0x3d,
-	0x2a, 0x36, 0x33, 0x2c, 0x38, 0x3d, 0x32, 0x3e,
-	0x26, 0x2a, 0x2c, 0x35, 0x27, 0x39, 0x3b, 0x31,
-	0x2a, 0x37, 0x3c, 0x27, 0x32, 0x29, 0x39, 0x37,
-	0x34, 0x3f, 0x39, 0x2e, 0x38, 0x2b, 0x2c, 0x3e,
-	0x3b, 0x3b, 0x2d, 0x33, 0x3b, 0x3b, 0x32, 0x3d,
-	0x3f, 0x3a, 0x34, 0x26, 0x35, 0x30, 0x31, 0x39,
-	0x27, 0x2f, 0x3d, 0x35, 0x35, 0x36, 0x2e, 0x29,
-	0x38, 0x27, 0x34, 0x32, 0x2c, 0x3c, 0x31, 0x28,
-	0x37, 0x38, 0x37, 0x34, 0x33, 0x29, 0x32, 0x34,
-	0x3f, 0x26, 0x34, 0x34, 0x32, 0x27, 0x30, 0x33,
-	0x33, 0x2d, 0x2b, 0x28, 0x3f, 0x33, 0x2b, 0x39,
-	0x37, 0x39, 0x2c, 0x3d, 0x35, 0x39, 0x27, 0x2f
-};
-
 /***
  ***	Compression
  ***/
@@ -152,7 +82,17 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 	cctx->count = 0;
 	cctx->allowed = DNS_COMPRESS_ENABLED;
 
-	memset(&cctx->table[0], 0, sizeof(cctx->table));
+	cctx->nodes = cctx->initialnodes;
+	cctx->nodesize = DNS_COMPRESS_INITIALNODES;
+	cctx->table = cctx->initialtable;
+	cctx->tablesize = DNS_COMPRESS_INITIALTABLE;
+	cctx->arena = cctx->initialarena;
+	cctx->arenaused = 0;
+	cctx->arenasize = DNS_COMPRESS_INITIALARENA;
+	cctx->hashed = NULL;
+	cctx->hashedlength = 0;
+
+	memset(cctx->table, 0, cctx->tablesize * sizeof(cctx->table[0]));
 
 	cctx->magic = CCTX_MAGIC;
 
@@ -161,23 +101,20 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
-	dns_compressnode_t *node;
-	unsigned int i;
-
 	REQUIRE(VALID_CCTX(cctx));
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		while (cctx->table[i] != NULL) {
-			node = cctx->table[i];
-			cctx->table[i] = cctx->table[i]->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count < DNS_COMPRESS_INITIALNODES)
-				continue;
-			isc_mem_put(cctx->mctx, node, sizeof(*node));
-		}
-	}
+	if (cctx->nodes != cctx->initialnodes)
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->nodesize * sizeof(cctx->nodes[0]));
+	if (cctx->table != cctx->initialtable)
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(cctx->table[0]));
+	if (cctx->arena != cctx->initialarena)
+		isc_mem_put(cctx->mctx, cctx->arena, cctx->arenasize);
+	cctx->nodes = NULL;
+	cctx->table = NULL;
+	cctx->arena = NULL;
+	cctx->count = 0;
 
 	cctx->magic = 0;
 	cctx->allowed = 0;
@@ -227,6 +164,200 @@ dns_compress_getedns(dns_compress_t *cctx) {
 	return (cctx->edns);
 }
 
+/*
+ * Fill in 'offsets' for 'name' if it does not carry its own, and
+ * return the offsets to use.
+ */
+static inline const unsigned char *
+name_offsets(const dns_name_t *name, unsigned char *offsets) {
+	unsigned int i, offset;
+
+	if (name->offsets != NULL)
+		return (name->offsets);
+
+	for (i = 0, offset = 0; i < name->labels; i++) {
+		offsets[i] = offset;
+		offset += name->ndata[offset] + 1;
+	}
+	return (offsets);
+}
+
+/*
+ * Compute the hash of each suffix of 'name' other than the root,
+ * from the shortest to the longest, so that each label is hashed
+ * only once.  'hashes[n]' is the hash of the suffix starting at label
+ * 'n'.  The hash ignores case, so that the same suffix is found in
+ * both case sensitive and insensitive mode.
+ */
+static inline void
+hash_suffixes(const dns_name_t *name, const unsigned char *offsets,
+	      uint32_t *hashes)
+{
+	const unsigned char *label, *end;
+	unsigned int n;
+	uint32_t hash;
+
+	/*
+	 * FNV-1a, as in isc_hash_function(), with its random offset
+	 * basis; inlined here as it is applied to every label rendered.
+	 */
+	hash = *(const uint32_t *)isc_hash_get_initializer();
+	n = name->labels - 1;
+	while (n-- > 0) {
+		label = name->ndata + offsets[n];
+		end = label + label[0] + 1;
+		while (label < end) {
+			hash ^= maptolower[*label++];
+			hash *= 16777619;
+		}
+		hashes[n] = hash;
+	}
+}
+
+static inline bool
+suffix_equal(const dns_compress_t *cctx, const dns_compressnode_t *node,
+	     const unsigned char *data, unsigned int length,
+	     unsigned int labels)
+{
+	const unsigned char *ndata;
+
+	if (node->length != length || node->labels != labels)
+		return (false);
+
+	ndata = cctx->arena + node->data;
+	if (ISC_LIKELY((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0))
+		return (memcmp(ndata, data, length) == 0);
+
+	/*
+	 * Label lengths are never changed by maptolower[], so the
+	 * wire forms can be compared as a whole.
+	 */
+	while (ISC_LIKELY(length > 3)) {
+		if (maptolower[ndata[0]] != maptolower[data[0]] ||
+		    maptolower[ndata[1]] != maptolower[data[1]] ||
+		    maptolower[ndata[2]] != maptolower[data[2]] ||
+		    maptolower[ndata[3]] != maptolower[data[3]])
+			return (false);
+		length -= 4;
+		ndata += 4;
+		data += 4;
+	}
+	while (ISC_LIKELY(length-- > 0)) {
+		if (maptolower[*ndata++] != maptolower[*data++])
+			return (false);
+	}
+	return (true);
+}
+
+static inline dns_compressnode_t *
+table_find(const dns_compress_t *cctx, uint32_t hash,
+	   const unsigned char *data, unsigned int length,
+	   unsigned int labels)
+{
+	dns_compressnode_t *node;
+	unsigned int mask = cctx->tablesize - 1;
+	unsigned int i;
+
+	for (i = hash & mask; cctx->table[i] != 0; i = (i + 1) & mask) {
+		node = &cctx->nodes[cctx->table[i] - 1];
+		if (node->hash == hash &&
+		    suffix_equal(cctx, node, data, length, labels))
+			return (node);
+	}
+	return (NULL);
+}
+
+static inline void
+table_insert(uint16_t *table, unsigned int tablesize,
+	     uint32_t hash, unsigned int index)
+{
+	unsigned int mask = tablesize - 1;
+	unsigned int i;
+
+	for (i = hash & mask; table[i] != 0; i = (i + 1) & mask)
+		;
+	table[i] = index + 1;
+}
+
+/*
+ * Remove the most recently added node.  With linear probing, undoing
+ * insertions in reverse order only requires clearing their slots.
+ */
+static inline void
+table_remove_last(dns_compress_t *cctx) {
+	dns_compressnode_t *node = &cctx->nodes[cctx->count - 1];
+	unsigned int mask = cctx->tablesize - 1;
+	unsigned int i;
+
+	for (i = node->hash & mask; cctx->table[i] != cctx->count;
+	     i = (i + 1) & mask)
+		INSIST(cctx->table[i] != 0);
+	cctx->table[i] = 0;
+	cctx->count--;
+}
+
+/*
+ * Double the size of the node array and the table, rehashing the
+ * existing nodes in the order they were added.
+ */
+static bool
+grow_nodes(dns_compress_t *cctx) {
+	dns_compressnode_t *nodes;
+	uint16_t *table;
+	unsigned int nodesize, tablesize, i;
+
+	nodesize = cctx->nodesize * 2;
+	tablesize = cctx->tablesize * 2;
+	if (nodesize > 0x4000)
+		return (false);
+
+	nodes = isc_mem_get(cctx->mctx, nodesize * sizeof(nodes[0]));
+	if (nodes == NULL)
+		return (false);
+	table = isc_mem_get(cctx->mctx, tablesize * sizeof(table[0]));
+	if (table == NULL) {
+		isc_mem_put(cctx->mctx, nodes, nodesize * sizeof(nodes[0]));
+		return (false);
+	}
+
+	memmove(nodes, cctx->nodes, cctx->count * sizeof(nodes[0]));
+	memset(table, 0, tablesize * sizeof(table[0]));
+	for (i = 0; i < cctx->count; i++)
+		table_insert(table, tablesize, nodes[i].hash, i);
+
+	if (cctx->nodes != cctx->initialnodes)
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->nodesize * sizeof(cctx->nodes[0]));
+	if (cctx->table != cctx->initialtable)
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(cctx->table[0]));
+	cctx->nodes = nodes;
+	cctx->nodesize = nodesize;
+	cctx->table = table;
+	cctx->tablesize = tablesize;
+	return (true);
+}
+
+static bool
+grow_arena(dns_compress_t *cctx, unsigned int length) {
+	unsigned char *arena;
+	unsigned int arenasize = cctx->arenasize * 2;
+
+	while (arenasize - cctx->arenaused < length)
+		arenasize *= 2;
+
+	arena = isc_mem_get(cctx->mctx, arenasize);
+	if (arena == NULL)
+		return (false);
+
+	memmove(arena, cctx->arena, cctx->arenaused);
+	if (cctx->arena != cctx->initialarena)
+		isc_mem_put(cctx->mctx, cctx->arena, cctx->arenasize);
+	cctx->arena = arena;
+	cctx->arenasize = arenasize;
+	return (true);
+}
+
 /*
  * Find the longest match of name in the table.
  * If match is found return true. prefix, suffix and offset are updated.
@@ -236,11 +367,10 @@ bool
 dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 			dns_name_t *prefix, uint16_t *offset)
 {
-	dns_name_t tname;
 	dns_compressnode_t *node = NULL;
-	unsigned int labels, i, n;
-	unsigned int numlabels;
-	unsigned char *p;
+	dns_offsets_t odata;
+	const unsigned char *offsets;
+	unsigned int labels, n;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name) == true);
@@ -254,103 +384,21 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 
 	labels = dns_name_countlabels(name);
 	INSIST(labels > 0);
+	if (labels == 1)
+		return (false);
 
-	dns_name_init(&tname, NULL);
-
-	numlabels = labels > 3U ? 3U : labels;
-	p = name->ndata;
-
-	for (n = 0; n < numlabels - 1; n++) {
-		unsigned char ch, llen;
-		unsigned int firstoffset, length;
-
-		firstoffset = (unsigned int)(p - name->ndata);
-		length = name->length - firstoffset;
-
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of the suffix name.
-		 */
-		ch = p[1];
-		i = tableindex[ch];
-		if (ISC_LIKELY((cctx->allowed &
-				DNS_COMPRESS_CASESENSITIVE) != 0))
-		{
-			for (node = cctx->table[i];
-			     node != NULL;
-			     node = node->next)
-			{
-				if (ISC_UNLIKELY(node->name.length != length))
-					continue;
-
-				if (ISC_LIKELY(memcmp(node->name.ndata,
-						      p, length) == 0))
-					goto found;
-			}
-		} else {
-			for (node = cctx->table[i];
-			     node != NULL;
-			     node = node->next)
-			{
-				unsigned int l, count;
-				unsigned char c;
-				unsigned char *label1, *label2;
-
-				if (ISC_UNLIKELY(node->name.length != length))
-					continue;
-
-				l = labels - n;
-				if (ISC_UNLIKELY(node->name.labels != l))
-					continue;
-
-				label1 = node->name.ndata;
-				label2 = p;
-				while (ISC_LIKELY(l-- > 0)) {
-					count = *label1++;
-					if (count != *label2++)
-						goto cont1;
-
-					/* no bitstring support */
-					INSIST(count <= 63);
-
-					/* Loop unrolled for performance */
-					while (ISC_LIKELY(count > 3)) {
-						c = maptolower[label1[0]];
-						if (c != maptolower[label2[0]])
-							goto cont1;
-						c = maptolower[label1[1]];
-						if (c != maptolower[label2[1]])
-							goto cont1;
-						c = maptolower[label1[2]];
-						if (c != maptolower[label2[2]])
-							goto cont1;
-						c = maptolower[label1[3]];
-						if (c != maptolower[label2[3]])
-							goto cont1;
-						count -= 4;
-						label1 += 4;
-						label2 += 4;
-					}
-					while (ISC_LIKELY(count-- > 0)) {
-						c = maptolower[*label1++];
-						if (c != maptolower[*label2++])
-							goto cont1;
-					}
-				}
-				break;
- cont1:
-				continue;
-			}
-		}
+	offsets = name_offsets(name, odata);
+	hash_suffixes(name, offsets, cctx->hashes);
+	cctx->hashed = name->ndata;
+	cctx->hashedlength = name->length;
 
+	for (n = 0; n < labels - 1; n++) {
+		node = table_find(cctx, cctx->hashes[n], name->ndata + offsets[n],
+				  name->length - offsets[n], labels - n);
 		if (node != NULL)
 			break;
-
-		llen = *p;
-		p += llen + 1;
 	}
 
- found:
 	/*
 	 * If node == NULL, we found no match at all.
 	 */
@@ -362,32 +410,20 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	else
 		dns_name_getlabelsequence(name, 0, n, prefix);
 
-	*offset = (node->offset & 0x7fff);
+	*offset = node->offset;
 	return (true);
 }
 
-static inline unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
-}
-
 void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		 const dns_name_t *prefix, uint16_t offset)
 {
-	dns_name_t tname, xname;
-	unsigned int start;
-	unsigned int n;
-	unsigned int count;
-	unsigned int i;
 	dns_compressnode_t *node;
-	unsigned int length;
-	unsigned int tlength;
+	dns_offsets_t odata;
+	const unsigned char *offsets;
+	unsigned int labels, count, n;
+	unsigned int data;
 	uint16_t toffset;
-	unsigned char *tmp;
-	isc_region_t r;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name));
@@ -397,84 +433,61 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 
 	if (offset >= 0x4000)
 		return;
-	dns_name_init(&tname, NULL);
-	dns_name_init(&xname, NULL);
 
-	n = dns_name_countlabels(name);
+	labels = dns_name_countlabels(name);
 	count = dns_name_countlabels(prefix);
 	if (dns_name_isabsolute(prefix))
 		count--;
 	if (count == 0)
 		return;
-	start = 0;
-	dns_name_toregion(name, &r);
-	length = r.length;
-	tmp = isc_mem_get(cctx->mctx, length);
-	if (tmp == NULL)
+
+	if (cctx->arenasize - cctx->arenaused < name->length &&
+	    !grow_arena(cctx, name->length))
 		return;
+
+	/*
+	 * dns_name_towire() adds a name right after looking it up, so
+	 * its suffix hashes are usually known already.  A stale match
+	 * here could only cost a compression opportunity, as suffixes
+	 * are compared in full when looked up.
+	 */
+	offsets = name_offsets(name, odata);
+	if (cctx->hashed != name->ndata ||
+	    cctx->hashedlength != name->length)
+		hash_suffixes(name, offsets, cctx->hashes);
+	cctx->hashed = NULL;
+
 	/*
-	 * Copy name data to 'tmp' and make 'r' use 'tmp'.
+	 * Copy the name data to the arena; every suffix added below
+	 * refers to its tail.
 	 */
-	memmove(tmp, r.base, r.length);
-	r.base = tmp;
-	dns_name_fromregion(&xname, &r);
-
-	if (count > 2U)
-		count = 2U;
-
-	while (count > 0) {
-		unsigned char ch;
-
-		dns_name_getlabelsequence(&xname, start, n, &tname);
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of tname.
-		 */
-		ch = tname.ndata[1];
-		i = tableindex[ch];
-		tlength = name_length(&tname);
-		toffset = (uint16_t)(offset + (length - tlength));
+	data = cctx->arenaused;
+	memmove(cctx->arena + data, name->ndata, name->length);
+
+	for (n = 0; n < count; n++) {
+		toffset = (uint16_t)(offset + offsets[n]);
 		if (toffset >= 0x4000)
 			break;
-		/*
-		 * Create a new node and add it.
-		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
-				break;
-		}
-		node->count = cctx->count++;
-		/*
-		 * 'node->r.base' becomes 'tmp' when start == 0.
-		 * Record this by setting 0x8000 so it can be freed later.
-		 */
-		if (start == 0)
-			toffset |= 0x8000;
+		if (cctx->count == cctx->nodesize && !grow_nodes(cctx))
+			break;
+
+		node = &cctx->nodes[cctx->count];
+		node->hash = cctx->hashes[n];
+		node->data = data + offsets[n];
 		node->offset = toffset;
-		dns_name_toregion(&tname, &node->r);
-		dns_name_init(&node->name, NULL);
-		node->name.length = node->r.length;
-		node->name.ndata = node->r.base;
-		node->name.labels = tname.labels;
-		node->name.attributes = DNS_NAMEATTR_ABSOLUTE;
-		node->next = cctx->table[i];
-		cctx->table[i] = node;
-		start++;
-		n--;
-		count--;
+		node->length = name->length - offsets[n];
+		node->labels = labels - n;
+		table_insert(cctx->table, cctx->tablesize, node->hash,
+			     cctx->count);
+		cctx->count++;
 	}
 
-	if (start == 0)
-		isc_mem_put(cctx->mctx, tmp, length);
+	if (n != 0)
+		cctx->arenaused += name->length;
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, uint16_t offset) {
-	unsigned int i;
 	dns_compressnode_t *node;
 
 	REQUIRE(VALID_CCTX(cctx));
@@ -482,24 +495,24 @@ dns_compress_rollback(dns_compress_t *cctx, uint16_t offset) {
 	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
 		return;
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && (node->offset & 0x7fff) >= offset) {
-			cctx->table[i] = node->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			cctx->count--;
-			node = cctx->table[i];
-		}
+	/*
+	 * This relies on nodes being added in order of increasing
+	 * offset, which is the order in which the message is rendered.
+	 */
+	while (cctx->count > 0 &&
+	       cctx->nodes[cctx->count - 1].offset >= offset)
+		table_remove_last(cctx);
+
+	/*
+	 * The suffixes of a name all end where its copy in the arena
+	 * does, so the last remaining node marks the end of the
+	 * arena data still in use.
+	 */
+	if (cctx->count == 0) {
+		cctx->arenaused = 0;
+	} else {
+		node = &cctx->nodes[cctx->count - 1];
+		cctx->arenaused = node->data + node->length;
 	}
 }
 
@@ -28,6 +28,7 @@
 #include <isc/random.h>
 #include <isc/socket.h>
 #include <isc/stats.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/time.h>
@@ -55,11 +56,25 @@ typedef struct dns_qid {
 	unsigned int	magic;
 	unsigned int	qid_nbuckets;	/*%< hash table size */
 	unsigned int	qid_increment;	/*%< id increment on collision */
-	isc_mutex_t	lock;
+	isc_mutex_t	lock;		/*%< port tables and buffers */
+	unsigned int	qid_nlocks;	/*%< number of bucket locks */
+	isc_mutex_t	*qid_locks;	/*%< bucket locks */
 	dns_displist_t	*qid_table;	/*%< the table itself */
 	dispsocketlist_t *sock_table;	/*%< socket table */
 } dns_qid_t;
 
+/*%
+ * The buckets of a qid table are protected by a set of locks rather than
+ * by a single one, so that dispatches sharing the manager's table do not
+ * all serialize on it.  Bucket 'b' is protected by lock 'b % nlocks'.
+ */
+#ifndef DNS_QID_NLOCKS
+#define DNS_QID_NLOCKS		64
+#endif
+
+#define QID_LOCK(qid, bucket) \
+	(&(qid)->qid_locks[(bucket) % (qid)->qid_nlocks])
+
 struct dns_dispatchmgr {
 	/* Unlocked. */
 	unsigned int			magic;
@@ -155,18 +170,47 @@ struct dns_dispentry {
 #define DNS_DISPATCH_SOCKSQUOTA			3072
 #endif
 
+/*%
+ * A dispatch socket that is connected to a server when its transaction
+ * ends is kept open for a while, so that the next query to the same
+ * server can use it instead of opening, binding and connecting a new
+ * socket.  A socket is used for at most DNS_DISPATCH_SOCKREUSE
+ * transactions, and is closed once it has been idle for
+ * DNS_DISPATCH_SOCKIDLE seconds or when more than DNS_DISPATCH_IDLESOCKS
+ * sockets of the dispatch are idle.  Every query still gets a random ID,
+ * and a port is only ever reused towards the server it was chosen for.
+ */
+#ifndef DNS_DISPATCH_SOCKREUSE
+#define DNS_DISPATCH_SOCKREUSE			8
+#endif
+
+#ifndef DNS_DISPATCH_SOCKIDLE
+#define DNS_DISPATCH_SOCKIDLE			5
+#endif
+
+#ifndef DNS_DISPATCH_IDLESOCKS
+#define DNS_DISPATCH_IDLESOCKS			256
+#endif
+
+#ifndef DNS_DISPATCH_IDLETABLESIZE
+#define DNS_DISPATCH_IDLETABLESIZE		257
+#endif
+
 struct dispsocket {
 	unsigned int			magic;
 	isc_socket_t			*socket;
 	dns_dispatch_t			*disp;
 	isc_sockaddr_t			host;
-	in_port_t			localport; /* XXX: should be removed later */
+	in_port_t			localport;
 	dispportentry_t			*portentry;
 	dns_dispentry_t			*resp;
 	isc_task_t			*task;
 	ISC_LINK(dispsocket_t)		link;
 	unsigned int			bucket;
 	ISC_LINK(dispsocket_t)		blink;
+	unsigned int			uses;	  /*%< transactions served */
+	isc_stdtime_t			idlesince;
+	ISC_LINK(dispsocket_t)		ilink;	  /*%< idle_table chain */
 };
 
 /*%
@@ -232,6 +276,9 @@ struct dns_dispatch {
 	isc_result_t		shutdown_why;
 	ISC_LIST(dispsocket_t)	activesockets;
 	ISC_LIST(dispsocket_t)	inactivesockets;
+	ISC_LIST(dispsocket_t)	idlesockets;	/*%< oldest first */
+	dispsocketlist_t	*idle_table;	/*%< idle sockets by peer */
+	unsigned int		nidlesockets;
 	unsigned int		nsockets;
 	unsigned int		requests;	/*%< how many requests we have */
 	unsigned int		tcpbuffers;	/*%< allocated buffers */
@@ -277,7 +324,11 @@ static dns_dispentry_t *entry_search(dns_qid_t *, const isc_sockaddr_t *,
 static bool destroy_disp_ok(dns_dispatch_t *);
 static void destroy_disp(isc_task_t *task, isc_event_t *event);
 static void destroy_dispsocket(dns_dispatch_t *, dispsocket_t **);
-static void deactivate_dispsocket(dns_dispatch_t *, dispsocket_t *);
+static void deactivate_dispsocket(dns_dispatch_t *, dispsocket_t *,
+				  bool);
+static void release_dispsocket(dns_dispatch_t *, dispsocket_t *);
+static void unidle_dispsocket(dns_dispatch_t *, dispsocket_t *);
+static void purge_idlesockets(dns_dispatch_t *, isc_stdtime_t);
 static void udp_exrecv(isc_task_t *, isc_event_t *);
 static void udp_shrecv(isc_task_t *, isc_event_t *);
 static void udp_recv(isc_event_t *, dns_dispatch_t *, dispsocket_t *);
@@ -290,16 +341,14 @@ static void *allocate_udp_buffer(dns_dispatch_t *disp);
 static inline void free_devent(dns_dispatch_t *disp, dns_dispatchevent_t *ev);
 static inline dns_dispatchevent_t *allocate_devent(dns_dispatch_t *disp);
 static void do_cancel(dns_dispatch_t *disp);
-static dns_dispentry_t *linear_first(dns_qid_t *disp);
-static dns_dispentry_t *linear_next(dns_qid_t *disp,
-				    dns_dispentry_t *resp);
 static void dispatch_free(dns_dispatch_t **dispp);
 static isc_result_t get_udpsocket(dns_dispatchmgr_t *mgr,
 				  dns_dispatch_t *disp,
 				  isc_socketmgr_t *sockmgr,
 				  const isc_sockaddr_t *localaddr,
 				  isc_socket_t **sockp,
-				  isc_socket_t *dup_socket);
+				  isc_socket_t *dup_socket,
+				  bool reuseport);
 static isc_result_t dispatch_createudp(dns_dispatchmgr_t *mgr,
 				       isc_socketmgr_t *sockmgr,
 				       isc_taskmgr_t *taskmgr,
@@ -311,8 +360,8 @@ static isc_result_t dispatch_createudp(dns_dispatchmgr_t *mgr,
 static bool destroy_mgr_ok(dns_dispatchmgr_t *mgr);
 static void destroy_mgr(dns_dispatchmgr_t **mgrp);
 static isc_result_t qid_allocate(dns_dispatchmgr_t *mgr, unsigned int buckets,
-				 unsigned int increment, dns_qid_t **qidp,
-				 bool needaddrtable);
+				 unsigned int increment, unsigned int nlocks,
+				 dns_qid_t **qidp, bool needaddrtable);
 static void qid_destroy(isc_mem_t *mctx, dns_qid_t **qidp);
 static isc_result_t open_socket(isc_socketmgr_t *mgr,
 				const isc_sockaddr_t *local,
@@ -429,51 +478,6 @@ dns_hash(dns_qid_t *qid, const isc_sockaddr_t *dest, dns_messageid_t id,
 	return (ret);
 }
 
-/*
- * Find the first entry in 'qid'.  Returns NULL if there are no entries.
- */
-static dns_dispentry_t *
-linear_first(dns_qid_t *qid) {
-	dns_dispentry_t *ret;
-	unsigned int bucket;
-
-	bucket = 0;
-
-	while (bucket < qid->qid_nbuckets) {
-		ret = ISC_LIST_HEAD(qid->qid_table[bucket]);
-		if (ret != NULL)
-			return (ret);
-		bucket++;
-	}
-
-	return (NULL);
-}
-
-/*
- * Find the next entry after 'resp' in 'qid'.  Return NULL if there are
- * no more entries.
- */
-static dns_dispentry_t *
-linear_next(dns_qid_t *qid, dns_dispentry_t *resp) {
-	dns_dispentry_t *ret;
-	unsigned int bucket;
-
-	ret = ISC_LIST_NEXT(resp, link);
-	if (ret != NULL)
-		return (ret);
-
-	bucket = resp->bucket;
-	bucket++;
-	while (bucket < qid->qid_nbuckets) {
-		ret = ISC_LIST_HEAD(qid->qid_table[bucket]);
-		if (ret != NULL)
-			return (ret);
-		bucket++;
-	}
-
-	return (NULL);
-}
-
 /*
  * The dispatch must be locked.
  */
@@ -530,6 +534,10 @@ destroy_disp(isc_task_t *task, isc_event_t *event) {
 
 	if (disp->socket != NULL)
 		isc_socket_detach(&disp->socket);
+	while ((dispsocket = ISC_LIST_HEAD(disp->idlesockets)) != NULL) {
+		unidle_dispsocket(disp, dispsocket);
+		destroy_dispsocket(disp, &dispsocket);
+	}
 	while ((dispsocket = ISC_LIST_HEAD(disp->inactivesockets)) != NULL) {
 		ISC_LIST_UNLINK(disp->inactivesockets, dispsocket, link);
 		destroy_dispsocket(disp, &dispsocket);
@@ -612,10 +620,6 @@ deref_portentry(dns_dispatch_t *disp, dispportentry_t **portentryp) {
 		isc_mempool_put(disp->portpool, portentry);
 	}
 
-	/*
-	 * Set '*portentryp' to NULL inside the lock so that
-	 * dispsock->portentry does not change in socket_search.
-	 */
 	*portentryp = NULL;
 
 	UNLOCK(&qid->lock);
@@ -623,7 +627,8 @@ deref_portentry(dns_dispatch_t *disp, dispportentry_t **portentryp) {
 
 /*%
  * Find a dispsocket for socket address 'dest', and port number 'port'.
- * Return NULL if no such entry exists.  Requires qid->lock to be held.
+ * Return NULL if no such entry exists.  Requires the lock of 'bucket'
+ * to be held.
  */
 static dispsocket_t *
 socket_search(dns_qid_t *qid, const isc_sockaddr_t *dest, in_port_t port,
@@ -637,8 +642,7 @@ socket_search(dns_qid_t *qid, const isc_sockaddr_t *dest, in_port_t port,
 	dispsock = ISC_LIST_HEAD(qid->sock_table[bucket]);
 
 	while (dispsock != NULL) {
-		if (dispsock->portentry != NULL &&
-		    dispsock->portentry->port == port &&
+		if (dispsock->localport == port &&
 		    isc_sockaddr_equal(dest, &dispsock->host))
 			return (dispsock);
 		dispsock = ISC_LIST_NEXT(dispsock, blink);
@@ -648,7 +652,28 @@ socket_search(dns_qid_t *qid, const isc_sockaddr_t *dest, in_port_t port,
 }
 
 /*%
- * Make a new socket for a single dispatch with a random port number.
+ * Find an idle dispsocket of 'disp' that is connected to 'dest'.
+ * The caller must hold the disp->lock.
+ */
+static dispsocket_t *
+idle_search(dns_dispatch_t *disp, const isc_sockaddr_t *dest) {
+	dispsocket_t *dispsock;
+	unsigned int bucket;
+
+	bucket = isc_sockaddr_hash(dest, false) % DNS_DISPATCH_IDLETABLESIZE;
+	dispsock = ISC_LIST_HEAD(disp->idle_table[bucket]);
+	while (dispsock != NULL) {
+		if (isc_sockaddr_equal(dest, &dispsock->host))
+			return (dispsock);
+		dispsock = ISC_LIST_NEXT(dispsock, ilink);
+	}
+
+	return (NULL);
+}
+
+/*%
+ * Make a new socket for a single dispatch with a random port number,
+ * or reuse an idle one that is already connected to 'dest'.
  * The caller must hold the disp->lock
  */
 static isc_result_t
@@ -669,6 +694,7 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 	isc_socket_options_t bindoptions;
 	dispportentry_t *portentry = NULL;
 	dns_qid_t *qid;
+	isc_stdtime_t now;
 
 	if (isc_sockaddr_pf(&disp->local) == AF_INET) {
 		nports = disp->mgr->nv4ports;
@@ -680,6 +706,20 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 	if (nports == 0)
 		return (ISC_R_ADDRNOTAVAIL);
 
+	if (disp->nidlesockets > 0) {
+		isc_stdtime_get(&now);
+		purge_idlesockets(disp, now);
+		dispsock = idle_search(disp, dest);
+		if (dispsock != NULL) {
+			unidle_dispsocket(disp, dispsock);
+			dispsock->uses++;
+			inc_stats(mgr, dns_resstatscounter_dispsockreuse);
+			*dispsockp = dispsock;
+			*portp = dispsock->localport;
+			return (ISC_R_SUCCESS);
+		}
+	}
+
 	dispsock = ISC_LIST_HEAD(disp->inactivesockets);
 	if (dispsock != NULL) {
 		ISC_LIST_UNLINK(disp->inactivesockets, dispsock, link);
@@ -700,6 +740,7 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 				&dispsock->task);
 		ISC_LINK_INIT(dispsock, link);
 		ISC_LINK_INIT(dispsock, blink);
+		ISC_LINK_INIT(dispsock, ilink);
 		dispsock->magic = DISPSOCK_MAGIC;
 	}
 
@@ -715,13 +756,13 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 		port = ports[isc_random_uniform(nports)];
 		isc_sockaddr_setport(&localaddr, port);
 
-		LOCK(&qid->lock);
 		bucket = dns_hash(qid, dest, 0, port);
+		LOCK(QID_LOCK(qid, bucket));
 		if (socket_search(qid, dest, port, bucket) != NULL) {
-			UNLOCK(&qid->lock);
+			UNLOCK(QID_LOCK(qid, bucket));
 			continue;
 		}
-		UNLOCK(&qid->lock);
+		UNLOCK(QID_LOCK(qid, bucket));
 		bindoptions = 0;
 		portentry = port_search(disp, port);
 
@@ -755,11 +796,13 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 	if (result == ISC_R_SUCCESS) {
 		dispsock->socket = sock;
 		dispsock->host = *dest;
+		dispsock->localport = port;
 		dispsock->portentry = portentry;
 		dispsock->bucket = bucket;
-		LOCK(&qid->lock);
+		dispsock->uses = 1;
+		LOCK(QID_LOCK(qid, bucket));
 		ISC_LIST_APPEND(qid->sock_table[bucket], dispsock, blink);
-		UNLOCK(&qid->lock);
+		UNLOCK(QID_LOCK(qid, bucket));
 		*dispsockp = dispsock;
 		*portp = port;
 	} else {
@@ -791,20 +834,21 @@ destroy_dispsocket(dns_dispatch_t *disp, dispsocket_t **dispsockp) {
 	REQUIRE(dispsockp != NULL && *dispsockp != NULL);
 	dispsock = *dispsockp;
 	REQUIRE(!ISC_LINK_LINKED(dispsock, link));
+	REQUIRE(!ISC_LINK_LINKED(dispsock, ilink));
 
 	disp->nsockets--;
 	dispsock->magic = 0;
-	if (dispsock->portentry != NULL)
-		deref_portentry(disp, &dispsock->portentry);
-	if (dispsock->socket != NULL)
-		isc_socket_detach(&dispsock->socket);
 	if (ISC_LINK_LINKED(dispsock, blink)) {
 		qid = DNS_QID(disp);
-		LOCK(&qid->lock);
+		LOCK(QID_LOCK(qid, dispsock->bucket));
 		ISC_LIST_UNLINK(qid->sock_table[dispsock->bucket], dispsock,
 				blink);
-		UNLOCK(&qid->lock);
+		UNLOCK(QID_LOCK(qid, dispsock->bucket));
 	}
+	if (dispsock->portentry != NULL)
+		deref_portentry(disp, &dispsock->portentry);
+	if (dispsock->socket != NULL)
+		isc_socket_detach(&dispsock->socket);
 	if (dispsock->task != NULL)
 		isc_task_detach(&dispsock->task);
 	isc_mempool_put(disp->mgr->spool, dispsock);
@@ -813,13 +857,16 @@ destroy_dispsocket(dns_dispatch_t *disp, dispsocket_t **dispsockp) {
 }
 
 /*%
- * Deactivate a dedicated dispatch socket.  Move it to the inactive list for
- * future reuse unless the total number of sockets are exceeding the maximum.
+ * Deactivate a dedicated dispatch socket.  If 'reuse' is true and it is
+ * still connected to its server and may serve more transactions, keep
+ * it open on the idle list; otherwise release it.
  */
 static void
-deactivate_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
-	isc_result_t result;
-	dns_qid_t *qid;
+deactivate_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock,
+		      bool reuse)
+{
+	isc_sockaddr_t peer;
+	unsigned int bucket;
 
 	/*
 	 * The dispatch must be locked.
@@ -828,10 +875,48 @@ deactivate_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
 	if (dispsock->resp != NULL) {
 		INSIST(dispsock->resp->dispsocket == dispsock);
 		dispsock->resp->dispsocket = NULL;
+		dispsock->resp = NULL;
 	}
 
 	INSIST(dispsock->portentry != NULL);
-	deref_portentry(disp, &dispsock->portentry);
+
+	if (reuse && disp->shutting_down == 0 &&
+	    dispsock->uses < DNS_DISPATCH_SOCKREUSE &&
+	    isc_socket_getpeername(dispsock->socket, &peer) == ISC_R_SUCCESS &&
+	    isc_sockaddr_equal(&peer, &dispsock->host))
+	{
+		/*
+		 * The socket keeps its port and its place in the socket
+		 * table while it is idle, so that no other socket can be
+		 * bound to the same port for the same server.
+		 */
+		bucket = isc_sockaddr_hash(&dispsock->host, false) %
+			 DNS_DISPATCH_IDLETABLESIZE;
+		isc_stdtime_get(&dispsock->idlesince);
+		ISC_LIST_APPEND(disp->idlesockets, dispsock, link);
+		ISC_LIST_PREPEND(disp->idle_table[bucket], dispsock, ilink);
+		disp->nidlesockets++;
+		purge_idlesockets(disp, dispsock->idlesince);
+		return;
+	}
+
+	release_dispsocket(disp, dispsock);
+}
+
+/*%
+ * Give up the port of a dedicated dispatch socket that is on no list.
+ * Move it to the inactive list for future reuse unless the total number
+ * of sockets are exceeding the maximum.
+ */
+static void
+release_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
+	isc_result_t result;
+	dns_qid_t *qid;
+
+	/*
+	 * The dispatch must be locked.
+	 */
+	REQUIRE(!ISC_LINK_LINKED(dispsock, link));
 
 	if (disp->nsockets > DNS_DISPATCH_POOLSOCKS)
 		destroy_dispsocket(disp, &dispsock);
@@ -839,10 +924,11 @@ deactivate_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
 		result = isc_socket_close(dispsock->socket);
 
 		qid = DNS_QID(disp);
-		LOCK(&qid->lock);
+		LOCK(QID_LOCK(qid, dispsock->bucket));
 		ISC_LIST_UNLINK(qid->sock_table[dispsock->bucket], dispsock,
 				blink);
-		UNLOCK(&qid->lock);
+		UNLOCK(QID_LOCK(qid, dispsock->bucket));
+		deref_portentry(disp, &dispsock->portentry);
 
 		if (result == ISC_R_SUCCESS)
 			ISC_LIST_APPEND(disp->inactivesockets, dispsock, link);
@@ -858,6 +944,41 @@ deactivate_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
 	}
 }
 
+/*%
+ * Take an idle dispatch socket off the idle lists.
+ * The dispatch must be locked.
+ */
+static void
+unidle_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
+	unsigned int bucket;
+
+	INSIST(disp->nidlesockets > 0);
+
+	bucket = isc_sockaddr_hash(&dispsock->host, false) %
+		 DNS_DISPATCH_IDLETABLESIZE;
+	ISC_LIST_UNLINK(disp->idlesockets, dispsock, link);
+	ISC_LIST_UNLINK(disp->idle_table[bucket], dispsock, ilink);
+	disp->nidlesockets--;
+}
+
+/*%
+ * Release the idle sockets that have been idle for too long, and the
+ * oldest ones if there are too many.
+ * The dispatch must be locked.
+ */
+static void
+purge_idlesockets(dns_dispatch_t *disp, isc_stdtime_t now) {
+	dispsocket_t *dispsock;
+
+	while ((dispsock = ISC_LIST_HEAD(disp->idlesockets)) != NULL) {
+		if (disp->nidlesockets <= DNS_DISPATCH_IDLESOCKS &&
+		    dispsock->idlesince + DNS_DISPATCH_SOCKIDLE > now)
+			break;
+		unidle_dispsocket(disp, dispsock);
+		release_dispsocket(disp, dispsock);
+	}
+}
+
 /*
  * Find an entry for query ID 'id', socket address 'dest', and port number
  * 'port'.
@@ -1072,7 +1193,7 @@ udp_recv(isc_event_t *ev_in, dns_dispatch_t *disp, dispsocket_t *dispsock) {
 		 * event the canceled event should have been no effect.  So
 		 * we can (and should) deactivate the socket right now.
 		 */
-		deactivate_dispsocket(disp, dispsock);
+		deactivate_dispsocket(disp, dispsock, true);
 		dispsock = NULL;
 	}
 
@@ -1103,7 +1224,9 @@ udp_recv(isc_event_t *ev_in, dns_dispatch_t *disp, dispsocket_t *dispsock) {
 				 * connected socket.  It makes no sense to
 				 * check the address or parse the packet, but it
 				 * will help to return the error to the caller.
+				 * Don't reuse the socket afterwards.
 				 */
+				dispsock->uses = DNS_DISPATCH_SOCKREUSE;
 				goto sendresponse;
 			}
 		} else {
@@ -1180,7 +1303,7 @@ udp_recv(isc_event_t *ev_in, dns_dispatch_t *disp, dispsocket_t *dispsock) {
 	 */
 	if (resp == NULL) {
 		bucket = dns_hash(qid, &ev->address, id, disp->localport);
-		LOCK(&qid->lock);
+		LOCK(QID_LOCK(qid, bucket));
 		qidlocked = true;
 		resp = entry_search(qid, &ev->address, id, disp->localport,
 				    bucket);
@@ -1281,7 +1404,7 @@ udp_recv(isc_event_t *ev_in, dns_dispatch_t *disp, dispsocket_t *dispsock) {
 	}
  unlock:
 	if (qidlocked)
-		UNLOCK(&qid->lock);
+		UNLOCK(QID_LOCK(qid, bucket));
 
 	/*
 	 * Restart recv() to get the next packet.
@@ -1293,9 +1416,10 @@ udp_recv(isc_event_t *ev_in, dns_dispatch_t *disp, dispsocket_t *dispsock) {
 		 * XXX: wired. There seems to be no recovery process other than
 		 * deactivate this socket anyway (since we cannot start
 		 * receiving, we won't be able to receive a cancel event
-		 * from the user).
+		 * from the user).  A socket that cannot receive must not
+		 * be reused either.
 		 */
-		deactivate_dispsocket(disp, dispsock);
+		deactivate_dispsocket(disp, dispsock, false);
 	}
 	isc_event_free(&ev_in);
 	UNLOCK(&disp->lock);
@@ -1436,7 +1560,7 @@ tcp_recv(isc_task_t *task, isc_event_t *ev_in) {
 	 * Response.
 	 */
 	bucket = dns_hash(qid, &tcpmsg->address, id, disp->localport);
-	LOCK(&qid->lock);
+	LOCK(QID_LOCK(qid, bucket));
 	resp = entry_search(qid, &tcpmsg->address, id, disp->localport, bucket);
 	dispatch_log(disp, LVL(90),
 		     "search for response in bucket %d: %s",
@@ -1472,7 +1596,7 @@ tcp_recv(isc_task_t *task, isc_event_t *ev_in) {
 		isc_task_send(resp->task, ISC_EVENT_PTR(&rev));
 	}
  unlock:
-	UNLOCK(&qid->lock);
+	UNLOCK(QID_LOCK(qid, bucket));
 
 	/*
 	 * Restart recv() to get the next packet.
@@ -2060,7 +2184,8 @@ dns_dispatchmgr_setudp(dns_dispatchmgr_t *mgr,
 	isc_mempool_associatelock(mgr->spool, &mgr->spool_lock);
 	isc_mempool_setfillcount(mgr->spool, 32);
 
-	result = qid_allocate(mgr, buckets, increment, &mgr->qid, true);
+	result = qid_allocate(mgr, buckets, increment, DNS_QID_NLOCKS,
+			      &mgr->qid, true);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
 
@@ -2252,7 +2377,7 @@ dispatch_find(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *local,
 
 static isc_result_t
 qid_allocate(dns_dispatchmgr_t *mgr, unsigned int buckets,
-	     unsigned int increment, dns_qid_t **qidp,
+	     unsigned int increment, unsigned int nlocks, dns_qid_t **qidp,
 	     bool needsocktable)
 {
 	dns_qid_t *qid;
@@ -2262,6 +2387,7 @@ qid_allocate(dns_dispatchmgr_t *mgr, unsigned int buckets,
 	REQUIRE(VALID_DISPATCHMGR(mgr));
 	REQUIRE(buckets < 2097169);  /* next prime > 65536 * 32 */
 	REQUIRE(increment > buckets);
+	REQUIRE(nlocks > 0);
 	REQUIRE(qidp != NULL && *qidp == NULL);
 
 	qid = isc_mem_get(mgr->mctx, sizeof(*qid));
@@ -2287,16 +2413,31 @@ qid_allocate(dns_dispatchmgr_t *mgr, unsigned int buckets,
 		}
 	}
 
+	nlocks = ISC_MIN(nlocks, buckets);
+	qid->qid_locks = isc_mem_get(mgr->mctx, nlocks * sizeof(isc_mutex_t));
+	if (qid->qid_locks == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_tables;
+	}
+	for (i = 0; i < nlocks; i++) {
+		result = isc_mutex_init(&qid->qid_locks[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				DESTROYLOCK(&qid->qid_locks[i]);
+			isc_mem_put(mgr->mctx, qid->qid_locks,
+				    nlocks * sizeof(isc_mutex_t));
+			goto cleanup_tables;
+		}
+	}
+	qid->qid_nlocks = nlocks;
+
 	result = isc_mutex_init(&qid->lock);
 	if (result != ISC_R_SUCCESS) {
-		if (qid->sock_table != NULL) {
-			isc_mem_put(mgr->mctx, qid->sock_table,
-				    buckets * sizeof(dispsocketlist_t));
-		}
-		isc_mem_put(mgr->mctx, qid->qid_table,
-			    buckets * sizeof(dns_displist_t));
-		isc_mem_put(mgr->mctx, qid, sizeof(*qid));
-		return (result);
+		for (i = 0; i < nlocks; i++)
+			DESTROYLOCK(&qid->qid_locks[i]);
+		isc_mem_put(mgr->mctx, qid->qid_locks,
+			    nlocks * sizeof(isc_mutex_t));
+		goto cleanup_tables;
 	}
 
 	for (i = 0; i < buckets; i++) {
@@ -2310,11 +2451,22 @@ qid_allocate(dns_dispatchmgr_t *mgr, unsigned int buckets,
 	qid->magic = QID_MAGIC;
 	*qidp = qid;
 	return (ISC_R_SUCCESS);
+
+ cleanup_tables:
+	if (qid->sock_table != NULL) {
+		isc_mem_put(mgr->mctx, qid->sock_table,
+			    buckets * sizeof(dispsocketlist_t));
+	}
+	isc_mem_put(mgr->mctx, qid->qid_table,
+		    buckets * sizeof(dns_displist_t));
+	isc_mem_put(mgr->mctx, qid, sizeof(*qid));
+	return (result);
 }
 
 static void
 qid_destroy(isc_mem_t *mctx, dns_qid_t **qidp) {
 	dns_qid_t *qid;
+	unsigned int i;
 
 	REQUIRE(qidp != NULL);
 	qid = *qidp;
@@ -2329,6 +2481,10 @@ qid_destroy(isc_mem_t *mctx, dns_qid_t **qidp) {
 		isc_mem_put(mctx, qid->sock_table,
 			    qid->qid_nbuckets * sizeof(dispsocketlist_t));
 	}
+	for (i = 0; i < qid->qid_nlocks; i++)
+		DESTROYLOCK(&qid->qid_locks[i]);
+	isc_mem_put(mctx, qid->qid_locks,
+		    qid->qid_nlocks * sizeof(isc_mutex_t));
 	DESTROYLOCK(&qid->lock);
 	isc_mem_put(mctx, qid, sizeof(*qid));
 }
@@ -2375,6 +2531,9 @@ dispatch_allocate(dns_dispatchmgr_t *mgr, unsigned int maxrequests,
 	disp->qid = NULL;
 	ISC_LIST_INIT(disp->activesockets);
 	ISC_LIST_INIT(disp->inactivesockets);
+	ISC_LIST_INIT(disp->idlesockets);
+	disp->idle_table = NULL;
+	disp->nidlesockets = 0;
 	disp->nsockets = 0;
 	disp->port_table = NULL;
 	disp->portpool = NULL;
@@ -2433,6 +2592,7 @@ dispatch_free(dns_dispatch_t **dispp) {
 	INSIST(disp->recv_pending == 0);
 	INSIST(ISC_LIST_EMPTY(disp->activesockets));
 	INSIST(ISC_LIST_EMPTY(disp->inactivesockets));
+	INSIST(ISC_LIST_EMPTY(disp->idlesockets));
 
 	isc_mempool_put(mgr->depool, disp->failsafe_ev);
 	disp->failsafe_ev = NULL;
@@ -2451,6 +2611,12 @@ dispatch_free(dns_dispatch_t **dispp) {
 	if (disp->portpool != NULL)
 		isc_mempool_destroy(&disp->portpool);
 
+	if (disp->idle_table != NULL) {
+		isc_mem_put(mgr->mctx, disp->idle_table,
+			    sizeof(disp->idle_table[0]) *
+			    DNS_DISPATCH_IDLETABLESIZE);
+	}
+
 	disp->mgr = NULL;
 	DESTROYLOCK(&disp->lock);
 	disp->magic = 0;
@@ -2492,7 +2658,7 @@ dns_dispatch_createtcp(dns_dispatchmgr_t *mgr, isc_socket_t *sock,
 		return (result);
 	}
 
-	result = qid_allocate(mgr, buckets, increment, &disp->qid, false);
+	result = qid_allocate(mgr, buckets, increment, 1, &disp->qid, false);
 	if (result != ISC_R_SUCCESS)
 		goto deallocate_dispatch;
 
@@ -2682,9 +2848,12 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	}
 
 	/*
-	 * See if we have a dispatcher that matches.
+	 * See if we have a dispatcher that matches.  Dispatchers sharded
+	 * with SO_REUSEPORT always get a socket of their own.
 	 */
-	if (dup_dispatch == NULL) {
+	if (dup_dispatch == NULL &&
+	    (attributes & DNS_DISPATCHATTR_REUSEPORT) == 0)
+	{
 		result = dispatch_find(mgr, localaddr, attributes, mask, &disp);
 		if (result == ISC_R_SUCCESS) {
 			disp->refcount++;
@@ -2758,7 +2927,7 @@ dns_dispatch_getudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 static isc_result_t
 get_udpsocket(dns_dispatchmgr_t *mgr, dns_dispatch_t *disp,
 	      isc_socketmgr_t *sockmgr, const isc_sockaddr_t *localaddr,
-	      isc_socket_t **sockp, isc_socket_t *dup_socket)
+	      isc_socket_t **sockp, isc_socket_t *dup_socket, bool reuseport)
 {
 	unsigned int i, j;
 	isc_socket_t *held[DNS_DISPATCH_HELD];
@@ -2814,9 +2983,17 @@ get_udpsocket(dns_dispatchmgr_t *mgr, dns_dispatch_t *disp,
 		 * choosing one.
 		 */
 	} else {
-		/* Allow to reuse address for non-random ports. */
-		result = open_socket(sockmgr, localaddr,
-				     ISC_SOCKET_REUSEADDRESS, &sock,
+		unsigned int options = ISC_SOCKET_REUSEADDRESS;
+
+		/*
+		 * Allow to reuse address for non-random ports, and
+		 * optionally share the port itself with sibling sockets.
+		 */
+		if (reuseport) {
+			INSIST(dup_socket == NULL);
+			options |= ISC_SOCKET_REUSEPORT;
+		}
+		result = open_socket(sockmgr, localaddr, options, &sock,
 				     dup_socket);
 
 		if (result == ISC_R_SUCCESS)
@@ -2886,7 +3063,9 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 
 	if ((attributes & DNS_DISPATCHATTR_EXCLUSIVE) == 0) {
 		result = get_udpsocket(mgr, disp, sockmgr, localaddr, &sock,
-				       dup_socket);
+				       dup_socket,
+				       ((attributes &
+					 DNS_DISPATCHATTR_REUSEPORT) != 0));
 		if (result != ISC_R_SUCCESS)
 			goto deallocate_dispatch;
 
@@ -2932,6 +3111,16 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 			goto deallocate_dispatch;
 		isc_mempool_setname(disp->portpool, "disp_portpool");
 		isc_mempool_setfreemax(disp->portpool, 128);
+
+		disp->idle_table = isc_mem_get(mgr->mctx,
+					       sizeof(disp->idle_table[0]) *
+					       DNS_DISPATCH_IDLETABLESIZE);
+		if (disp->idle_table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto deallocate_dispatch;
+		}
+		for (i = 0; i < DNS_DISPATCH_IDLETABLESIZE; i++)
+			ISC_LIST_INIT(disp->idle_table[i]);
 	}
 	disp->socket = sock;
 	disp->local = *localaddr;
@@ -3109,6 +3298,17 @@ dns_dispatch_addresponse(dns_dispatch_t *disp, unsigned int options,
 		return (ISC_R_QUOTA);
 	}
 
+	/*
+	 * Idle sockets are the first to go when there are too many.
+	 */
+	while ((disp->attributes & DNS_DISPATCHATTR_EXCLUSIVE) != 0 &&
+	       disp->nsockets > DNS_DISPATCH_SOCKSQUOTA &&
+	       (dispsocket = ISC_LIST_HEAD(disp->idlesockets)) != NULL)
+	{
+		unidle_dispsocket(disp, dispsocket);
+		destroy_dispsocket(disp, &dispsocket);
+	}
+
 	if ((disp->attributes & DNS_DISPATCHATTR_EXCLUSIVE) != 0 &&
 	    disp->nsockets > DNS_DISPATCH_SOCKSQUOTA) {
 		dispsocket_t *oldestsocket;
@@ -3167,9 +3367,10 @@ dns_dispatch_addresponse(dns_dispatch_t *disp, unsigned int options,
 
 	/*
 	 * Try somewhat hard to find an unique ID unless FIXEDID is set
-	 * in which case we use the id passed in via *idp.
+	 * in which case we use the id passed in via *idp.  The bucket
+	 * lock is held from a successful search until the response has
+	 * been inserted, so that no other caller can claim the same ID.
 	 */
-	LOCK(&qid->lock);
 	if ((options & DNS_DISPATCHOPT_FIXEDID) != 0) {
 		id = *idp;
 	} else {
@@ -3179,16 +3380,17 @@ dns_dispatch_addresponse(dns_dispatch_t *disp, unsigned int options,
 	i = 0;
 	do {
 		bucket = dns_hash(qid, dest, id, localport);
+		LOCK(QID_LOCK(qid, bucket));
 		if (entry_search(qid, dest, id, localport, bucket) == NULL) {
 			ok = true;
 			break;
 		}
+		UNLOCK(QID_LOCK(qid, bucket));
 		if ((disp->attributes & DNS_DISPATCHATTR_FIXEDID) != 0)
 			break;
 		id += qid->qid_increment;
 		id &= 0x0000ffff;
 	} while (i++ < 64);
-	UNLOCK(&qid->lock);
 
 	if (!ok) {
 		UNLOCK(&disp->lock);
@@ -3197,6 +3399,7 @@ dns_dispatch_addresponse(dns_dispatch_t *disp, unsigned int options,
 
 	res = isc_mempool_get(disp->mgr->rpool);
 	if (res == NULL) {
+		UNLOCK(QID_LOCK(qid, bucket));
 		if (dispsocket != NULL)
 			destroy_dispsocket(disp, &dispsocket);
 		UNLOCK(&disp->lock);
@@ -3222,9 +3425,8 @@ dns_dispatch_addresponse(dns_dispatch_t *disp, unsigned int options,
 	ISC_LINK_INIT(res, link);
 	res->magic = RESPONSE_MAGIC;
 
-	LOCK(&qid->lock);
 	ISC_LIST_APPEND(qid->qid_table[bucket], res, link);
-	UNLOCK(&qid->lock);
+	UNLOCK(QID_LOCK(qid, bucket));
 
 	inc_stats(disp->mgr, (qid == disp->mgr->qid) ?
 			     dns_resstatscounter_disprequdp :
@@ -3237,9 +3439,9 @@ dns_dispatch_addresponse(dns_dispatch_t *disp, unsigned int options,
 	    ((disp->attributes & DNS_DISPATCHATTR_CONNECTED) != 0)) {
 		result = startrecv(disp, dispsocket);
 		if (result != ISC_R_SUCCESS) {
-			LOCK(&qid->lock);
+			LOCK(QID_LOCK(qid, bucket));
 			ISC_LIST_UNLINK(qid->qid_table[bucket], res, link);
-			UNLOCK(&qid->lock);
+			UNLOCK(QID_LOCK(qid, bucket));
 
 			if (dispsocket != NULL)
 				destroy_dispsocket(disp, &dispsocket);
@@ -3389,9 +3591,9 @@ dns_dispatch_removeresponse(dns_dispentry_t **resp,
 
 	bucket = res->bucket;
 
-	LOCK(&qid->lock);
+	LOCK(QID_LOCK(qid, bucket));
 	ISC_LIST_UNLINK(qid->qid_table[bucket], res, link);
-	UNLOCK(&qid->lock);
+	UNLOCK(QID_LOCK(qid, bucket));
 
 	if (ev == NULL && res->item_out) {
 		/*
@@ -3452,8 +3654,9 @@ dns_dispatch_removeresponse(dns_dispentry_t **resp,
 static void
 do_cancel(dns_dispatch_t *disp) {
 	dns_dispatchevent_t *ev;
-	dns_dispentry_t *resp;
+	dns_dispentry_t *resp = NULL;
 	dns_qid_t *qid;
+	unsigned int bucket;
 
 	if (disp->shutdown_out == 1)
 		return;
@@ -3462,19 +3665,25 @@ do_cancel(dns_dispatch_t *disp) {
 
 	/*
 	 * Search for the first response handler without packets outstanding
-	 * unless a specific hander is given.
+	 * unless a specific hander is given.  The lock of the bucket it is
+	 * found in is kept until the event is sent.
 	 */
-	LOCK(&qid->lock);
-	for (resp = linear_first(qid);
-	     resp != NULL && resp->item_out;
-	     /* Empty. */)
-		resp = linear_next(qid, resp);
+	for (bucket = 0; bucket < qid->qid_nbuckets; bucket++) {
+		LOCK(QID_LOCK(qid, bucket));
+		for (resp = ISC_LIST_HEAD(qid->qid_table[bucket]);
+		     resp != NULL && resp->item_out;
+		     resp = ISC_LIST_NEXT(resp, link))
+			;
+		if (resp != NULL)
+			break;
+		UNLOCK(QID_LOCK(qid, bucket));
+	}
 
 	/*
 	 * No one to send the cancel event to, so nothing to do.
 	 */
 	if (resp == NULL)
-		goto unlock;
+		return;
 
 	/*
 	 * Send the shutdown failsafe event to this resp.
@@ -3491,8 +3700,7 @@ do_cancel(dns_dispatch_t *disp) {
 		    ev, resp->task);
 	resp->item_out = true;
 	isc_task_send(resp->task, ISC_EVENT_PTR(&ev));
- unlock:
-	UNLOCK(&qid->lock);
+	UNLOCK(QID_LOCK(qid, bucket));
 }
 
 isc_socket_t *
@@ -0,0 +1,684 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <isc/event.h>
+#include <isc/heap.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/task.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/events.h>
+#include <dns/fixedname.h>
+#include <dns/hotnames.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/resolver.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+/*%
+ * The table is split into partitions, each with its own lock, hash
+ * table and heap, so that clients answering from the cache on
+ * different threads rarely contend.  A (name, type) pair picks its
+ * partition and its bucket from the case insensitive name hash.
+ */
+#ifndef DNS_HOTNAMES_NPARTS
+#define DNS_HOTNAMES_NPARTS	16
+#endif
+
+/*%
+ * Hit counts are halved every HOTNAMES_DECAY scans.
+ */
+#define HOTNAMES_DECAY		10
+
+typedef struct dns_hnentry dns_hnentry_t;
+typedef ISC_LIST(dns_hnentry_t) dns_hnlist_t;
+
+struct dns_hnentry {
+	dns_fixedname_t		fixed;
+	dns_name_t		*name;
+	dns_rdatatype_t		type;
+	bool			refreshing;
+	unsigned int		hits;
+	isc_stdtime_t		expire;
+	unsigned int		bucket;
+	unsigned int		index;		/*%< heap index */
+	ISC_LINK(dns_hnentry_t)	hlink;		/*%< hash chain */
+};
+
+typedef struct dns_hnpart {
+	isc_mutex_t		lock;
+	dns_hnlist_t		*table;
+	unsigned int		nbuckets;
+	isc_heap_t		*heap;		/*%< coldest first */
+	unsigned int		count;
+	unsigned int		maxcount;
+} dns_hnpart_t;
+
+typedef struct dns_hnrefresh dns_hnrefresh_t;
+
+struct dns_hnrefresh {
+	dns_hotnames_t		*hn;
+	dns_fixedname_t		fixed;
+	dns_name_t		*name;
+	dns_rdatatype_t		type;
+	dns_fetch_t		*fetch;
+	dns_rdataset_t		rdataset;
+	dns_rdataset_t		sigrdataset;
+	ISC_LINK(dns_hnrefresh_t) link;
+};
+
+/*%
+ * A refresh candidate found during a scan.  The hit count is copied so
+ * that the candidates can be sorted without holding the partition
+ * locks.
+ */
+typedef struct dns_hndue {
+	dns_hnentry_t		*entry;
+	unsigned int		hits;
+	unsigned int		part;
+} dns_hndue_t;
+
+struct dns_hotnames {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	isc_refcount_t		references;
+	dns_view_t		*view;		/*%< not attached */
+	unsigned int		rate;
+	isc_task_t		*task;
+	isc_event_t		*sevent;
+	/* Locked by lock. */
+	isc_mutex_t		lock;
+	bool			shuttingdown;
+	isc_timer_t		*timer;
+	ISC_LIST(dns_hnrefresh_t) refreshes;
+	/* Only used by the task. */
+	unsigned int		scans;
+	dns_hndue_t		*due;
+	unsigned int		maxdue;
+	dns_hnpart_t		parts[DNS_HOTNAMES_NPARTS];
+};
+
+#define HOTNAMES_MAGIC			ISC_MAGIC('H', 'o', 't', 'N')
+#define VALID_HOTNAMES(m)		ISC_MAGIC_VALID(m, HOTNAMES_MAGIC)
+
+static void hotnames_scan(isc_task_t *task, isc_event_t *event);
+static void hotnames_shutdowndone(isc_task_t *task, isc_event_t *event);
+
+/*
+ * The heap keeps the least popular entry of a partition at the top,
+ * ready to be replaced.
+ */
+static bool
+colder(void *v1, void *v2) {
+	dns_hnentry_t *e1 = v1;
+	dns_hnentry_t *e2 = v2;
+
+	return (e1->hits < e2->hits);
+}
+
+static void
+set_index(void *what, unsigned int idx) {
+	dns_hnentry_t *entry = what;
+
+	entry->index = idx;
+}
+
+static void
+part_destroy(dns_hotnames_t *hn, dns_hnpart_t *part) {
+	dns_hnentry_t *entry;
+
+	while ((entry = isc_heap_element(part->heap, 1)) != NULL) {
+		isc_heap_delete(part->heap, 1);
+		isc_mem_put(hn->mctx, entry, sizeof(*entry));
+	}
+	isc_heap_destroy(&part->heap);
+	DESTROYLOCK(&part->lock);
+	isc_mem_put(hn->mctx, part->table,
+		    part->nbuckets * sizeof(part->table[0]));
+}
+
+static isc_result_t
+part_init(dns_hotnames_t *hn, dns_hnpart_t *part, unsigned int maxcount) {
+	isc_result_t result;
+	unsigned int i;
+
+	part->maxcount = maxcount;
+	part->count = 0;
+	part->nbuckets = maxcount;
+	part->table = isc_mem_get(hn->mctx,
+				  part->nbuckets * sizeof(part->table[0]));
+	if (part->table == NULL)
+		return (ISC_R_NOMEMORY);
+	for (i = 0; i < part->nbuckets; i++)
+		ISC_LIST_INIT(part->table[i]);
+
+	part->heap = NULL;
+	result = isc_heap_create(hn->mctx, colder, set_index, 0, &part->heap);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_table;
+
+	result = isc_mutex_init(&part->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_heap;
+
+	return (ISC_R_SUCCESS);
+
+ cleanup_heap:
+	isc_heap_destroy(&part->heap);
+ cleanup_table:
+	isc_mem_put(hn->mctx, part->table,
+		    part->nbuckets * sizeof(part->table[0]));
+	return (result);
+}
+
+isc_result_t
+dns_hotnames_create(isc_mem_t *mctx, dns_view_t *view,
+		    isc_taskmgr_t *taskmgr, isc_timermgr_t *timermgr,
+		    unsigned int size, unsigned int rate,
+		    dns_hotnames_t **hnp)
+{
+	isc_result_t result;
+	dns_hotnames_t *hn;
+	isc_interval_t interval;
+	unsigned int i, maxcount;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(size > 0 && rate > 0);
+	REQUIRE(hnp != NULL && *hnp == NULL);
+
+	hn = isc_mem_get(mctx, sizeof(*hn));
+	if (hn == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(hn, 0, sizeof(*hn));
+	isc_mem_attach(mctx, &hn->mctx);
+	hn->view = view;
+	hn->rate = rate;
+	ISC_LIST_INIT(hn->refreshes);
+
+	maxcount = (size + DNS_HOTNAMES_NPARTS - 1) / DNS_HOTNAMES_NPARTS;
+	for (i = 0; i < DNS_HOTNAMES_NPARTS; i++) {
+		result = part_init(hn, &hn->parts[i], maxcount);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_parts;
+	}
+
+	hn->maxdue = maxcount * DNS_HOTNAMES_NPARTS;
+	hn->due = isc_mem_get(mctx, hn->maxdue * sizeof(hn->due[0]));
+	if (hn->due == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_parts;
+	}
+
+	result = isc_mutex_init(&hn->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_due;
+
+	result = isc_task_create(taskmgr, 0, &hn->task);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+	isc_task_setname(hn->task, "hotnames", hn);
+
+	hn->sevent = isc_event_allocate(mctx, hn, DNS_EVENT_HOTNAMESSHUTDOWN,
+					hotnames_shutdowndone, hn,
+					sizeof(isc_event_t));
+	if (hn->sevent == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_task;
+	}
+
+	/*
+	 * One reference for the caller and one for the timer, which is
+	 * dropped on the task once the timer is gone.
+	 */
+	isc_refcount_init(&hn->references, 2);
+
+	isc_interval_set(&interval, 1, 0);
+	result = isc_timer_create(timermgr, isc_timertype_ticker, NULL,
+				  &interval, hn->task, hotnames_scan, hn,
+				  &hn->timer);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_event;
+
+	hn->magic = HOTNAMES_MAGIC;
+	*hnp = hn;
+	return (ISC_R_SUCCESS);
+
+ cleanup_event:
+	isc_refcount_decrement(&hn->references);
+	isc_refcount_decrement(&hn->references);
+	isc_refcount_destroy(&hn->references);
+	isc_event_free(&hn->sevent);
+ cleanup_task:
+	isc_task_detach(&hn->task);
+ cleanup_lock:
+	DESTROYLOCK(&hn->lock);
+ cleanup_due:
+	isc_mem_put(mctx, hn->due, hn->maxdue * sizeof(hn->due[0]));
+ cleanup_parts:
+	while (i-- > 0)
+		part_destroy(hn, &hn->parts[i]);
+	isc_mem_putanddetach(&hn->mctx, hn, sizeof(*hn));
+	return (result);
+}
+
+static void
+destroy(dns_hotnames_t *hn) {
+	unsigned int i;
+
+	INSIST(ISC_LIST_EMPTY(hn->refreshes));
+	INSIST(hn->timer == NULL);
+
+	hn->magic = 0;
+	isc_refcount_destroy(&hn->references);
+	if (hn->sevent != NULL)
+		isc_event_free(&hn->sevent);
+	isc_task_detach(&hn->task);
+	DESTROYLOCK(&hn->lock);
+	isc_mem_put(hn->mctx, hn->due, hn->maxdue * sizeof(hn->due[0]));
+	for (i = 0; i < DNS_HOTNAMES_NPARTS; i++)
+		part_destroy(hn, &hn->parts[i]);
+	isc_mem_putanddetach(&hn->mctx, hn, sizeof(*hn));
+}
+
+void
+dns_hotnames_attach(dns_hotnames_t *source, dns_hotnames_t **targetp) {
+	REQUIRE(VALID_HOTNAMES(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references);
+
+	*targetp = source;
+}
+
+void
+dns_hotnames_detach(dns_hotnames_t **hnp) {
+	dns_hotnames_t *hn;
+
+	REQUIRE(hnp != NULL && VALID_HOTNAMES(*hnp));
+
+	hn = *hnp;
+	*hnp = NULL;
+
+	if (isc_refcount_decrement(&hn->references) == 1)
+		destroy(hn);
+}
+
+void
+dns_hotnames_shutdown(dns_hotnames_t *hn) {
+	dns_hnrefresh_t *refresh;
+	isc_event_t *event;
+
+	REQUIRE(VALID_HOTNAMES(hn));
+
+	LOCK(&hn->lock);
+	if (!hn->shuttingdown) {
+		hn->shuttingdown = true;
+		isc_timer_detach(&hn->timer);
+		for (refresh = ISC_LIST_HEAD(hn->refreshes);
+		     refresh != NULL;
+		     refresh = ISC_LIST_NEXT(refresh, link))
+		{
+			dns_resolver_cancelfetch(refresh->fetch);
+		}
+
+		/*
+		 * A scan may already be queued or running on the task;
+		 * drop the timer's reference behind it.
+		 */
+		event = hn->sevent;
+		hn->sevent = NULL;
+		isc_task_send(hn->task, &event);
+	}
+	UNLOCK(&hn->lock);
+}
+
+static void
+hotnames_shutdowndone(isc_task_t *task, isc_event_t *event) {
+	dns_hotnames_t *hn = event->ev_arg;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	dns_hotnames_detach(&hn);
+}
+
+static dns_hnpart_t *
+getpart(dns_hotnames_t *hn, const dns_name_t *name, dns_rdatatype_t type,
+	unsigned int *bucketp)
+{
+	dns_hnpart_t *part;
+	unsigned int hash;
+
+	hash = dns_name_hash(name, false) + type;
+	part = &hn->parts[hash % DNS_HOTNAMES_NPARTS];
+	*bucketp = (hash / DNS_HOTNAMES_NPARTS) % part->nbuckets;
+
+	return (part);
+}
+
+static dns_hnentry_t *
+part_search(dns_hnpart_t *part, unsigned int bucket, const dns_name_t *name,
+	    dns_rdatatype_t type)
+{
+	dns_hnentry_t *entry;
+
+	for (entry = ISC_LIST_HEAD(part->table[bucket]);
+	     entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, hlink))
+	{
+		if (entry->type == type && dns_name_equal(entry->name, name))
+			return (entry);
+	}
+
+	return (NULL);
+}
+
+void
+dns_hotnames_hit(dns_hotnames_t *hn, const dns_name_t *name,
+		 dns_rdatatype_t type, dns_ttl_t ttl)
+{
+	dns_hnpart_t *part;
+	dns_hnentry_t *entry;
+	unsigned int bucket;
+	isc_stdtime_t now;
+
+	REQUIRE(VALID_HOTNAMES(hn));
+	REQUIRE(dns_name_isabsolute(name));
+
+	isc_stdtime_get(&now);
+	part = getpart(hn, name, type, &bucket);
+
+	LOCK(&part->lock);
+	entry = part_search(part, bucket, name, type);
+	if (entry != NULL) {
+		if (entry->hits < UINT_MAX)
+			entry->hits++;
+		entry->expire = now + ttl;
+		isc_heap_decreased(part->heap, entry->index);
+		goto unlock;
+	}
+
+	if (part->count < part->maxcount) {
+		entry = isc_mem_get(hn->mctx, sizeof(*entry));
+		if (entry == NULL)
+			goto unlock;
+		entry->name = dns_fixedname_initname(&entry->fixed);
+		entry->hits = 0;
+		ISC_LINK_INIT(entry, hlink);
+		if (isc_heap_insert(part->heap, entry) != ISC_R_SUCCESS) {
+			isc_mem_put(hn->mctx, entry, sizeof(*entry));
+			goto unlock;
+		}
+		part->count++;
+	} else {
+		/*
+		 * Replace the least popular entry.  The newcomer starts
+		 * from the count it replaces, so the popular entries are
+		 * not displaced by names that are queried only once.
+		 */
+		entry = isc_heap_element(part->heap, 1);
+		ISC_LIST_UNLINK(part->table[entry->bucket], entry, hlink);
+	}
+
+	dns_name_copy(name, entry->name, NULL);
+	entry->type = type;
+	entry->refreshing = false;
+	entry->hits++;
+	entry->expire = now + ttl;
+	entry->bucket = bucket;
+	ISC_LIST_PREPEND(part->table[bucket], entry, hlink);
+	isc_heap_decreased(part->heap, entry->index);
+
+ unlock:
+	UNLOCK(&part->lock);
+}
+
+unsigned int
+dns_hotnames_count(dns_hotnames_t *hn, const dns_name_t *name,
+		   dns_rdatatype_t type)
+{
+	dns_hnpart_t *part;
+	dns_hnentry_t *entry;
+	unsigned int bucket, hits = 0;
+
+	REQUIRE(VALID_HOTNAMES(hn));
+
+	part = getpart(hn, name, type, &bucket);
+
+	LOCK(&part->lock);
+	entry = part_search(part, bucket, name, type);
+	if (entry != NULL)
+		hits = entry->hits;
+	UNLOCK(&part->lock);
+
+	return (hits);
+}
+
+static void
+refresh_done(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *devent = (dns_fetchevent_t *)event;
+	dns_hnrefresh_t *refresh = devent->ev_arg;
+	dns_hotnames_t *hn = refresh->hn;
+	isc_result_t eresult = devent->result;
+	dns_hnpart_t *part;
+	dns_hnentry_t *entry;
+	unsigned int bucket;
+	isc_stdtime_t now;
+	dns_ttl_t ttl = 0;
+
+	UNUSED(task);
+
+	if (eresult == ISC_R_SUCCESS &&
+	    dns_rdataset_isassociated(&refresh->rdataset))
+		ttl = refresh->rdataset.ttl;
+	if (dns_rdataset_isassociated(&refresh->rdataset))
+		dns_rdataset_disassociate(&refresh->rdataset);
+	if (dns_rdataset_isassociated(&refresh->sigrdataset))
+		dns_rdataset_disassociate(&refresh->sigrdataset);
+	if (devent->node != NULL)
+		dns_db_detachnode(devent->db, &devent->node);
+	if (devent->db != NULL)
+		dns_db_detach(&devent->db);
+	dns_resolver_destroyfetch(&refresh->fetch);
+	isc_event_free(&event);
+
+	LOCK(&hn->lock);
+	ISC_LIST_UNLINK(hn->refreshes, refresh, link);
+	UNLOCK(&hn->lock);
+
+	/*
+	 * A failed refresh is not retried: the entry waits for the next
+	 * hit, and the query path takes over in the meantime.
+	 */
+	isc_stdtime_get(&now);
+	part = getpart(hn, refresh->name, refresh->type, &bucket);
+	LOCK(&part->lock);
+	entry = part_search(part, bucket, refresh->name, refresh->type);
+	if (entry != NULL) {
+		entry->refreshing = false;
+		entry->expire = now + ttl;
+	}
+	UNLOCK(&part->lock);
+
+	isc_mem_put(hn->mctx, refresh, sizeof(*refresh));
+	dns_hotnames_detach(&hn);
+}
+
+/*
+ * Start refreshing 'name'/'type'.  Called with hn->lock held.
+ */
+static isc_result_t
+refresh_start(dns_hotnames_t *hn, const dns_name_t *name,
+	      dns_rdatatype_t type)
+{
+	isc_result_t result;
+	dns_hnrefresh_t *refresh;
+	dns_view_t *view = hn->view;
+
+	refresh = isc_mem_get(hn->mctx, sizeof(*refresh));
+	if (refresh == NULL)
+		return (ISC_R_NOMEMORY);
+	refresh->hn = NULL;
+	refresh->name = dns_fixedname_initname(&refresh->fixed);
+	dns_name_copy(name, refresh->name, NULL);
+	refresh->type = type;
+	refresh->fetch = NULL;
+	dns_rdataset_init(&refresh->rdataset);
+	dns_rdataset_init(&refresh->sigrdataset);
+	ISC_LINK_INIT(refresh, link);
+
+	dns_hotnames_attach(hn, &refresh->hn);
+	result = dns_resolver_createfetch(view->resolver, refresh->name, type,
+					  NULL, NULL, NULL, NULL, 0,
+					  DNS_FETCHOPT_PREFETCH, 0, NULL,
+					  hn->task, refresh_done, refresh,
+					  &refresh->rdataset,
+					  &refresh->sigrdataset,
+					  &refresh->fetch);
+	if (result != ISC_R_SUCCESS) {
+		dns_hotnames_detach(&refresh->hn);
+		isc_mem_put(hn->mctx, refresh, sizeof(*refresh));
+		return (result);
+	}
+
+	ISC_LIST_APPEND(hn->refreshes, refresh, link);
+	if (view->resstats != NULL)
+		isc_stats_increment(view->resstats,
+				    dns_resstatscounter_hotprefetch);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Make qsort happy.
+ */
+static int
+hotter(const void *v1, const void *v2) {
+	const dns_hndue_t *d1 = v1;
+	const dns_hndue_t *d2 = v2;
+
+	if (d1->hits != d2->hits)
+		return (d1->hits > d2->hits ? -1 : 1);
+	return (0);
+}
+
+static inline bool
+isdue(dns_hnentry_t *entry, isc_stdtime_t now, unsigned int window) {
+	return (!entry->refreshing && entry->hits > 0 &&
+		entry->expire > now && entry->expire <= now + window);
+}
+
+/*
+ * Once a second, refresh the hottest entries which would otherwise
+ * drop into the query triggered prefetch window before the next scan.
+ */
+static void
+hotnames_scan(isc_task_t *task, isc_event_t *event) {
+	dns_hotnames_t *hn = event->ev_arg;
+	dns_view_t *view;
+	dns_hnpart_t *part;
+	dns_hnentry_t *entry;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdatatype_t type = 0;
+	isc_stdtime_t now;
+	unsigned int i, p, ndue = 0, sent = 0, window;
+	bool decay, start;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+
+	LOCK(&hn->lock);
+	view = hn->view;
+	if (hn->shuttingdown || view->resolver == NULL ||
+	    view->prefetch_trigger == 0)
+		goto unlock;
+
+	isc_stdtime_get(&now);
+	window = view->prefetch_trigger + 1;
+	decay = (++hn->scans % HOTNAMES_DECAY) == 0;
+
+	for (p = 0; p < DNS_HOTNAMES_NPARTS; p++) {
+		part = &hn->parts[p];
+		LOCK(&part->lock);
+		for (i = 1; i <= part->count; i++) {
+			entry = isc_heap_element(part->heap, i);
+			/*
+			 * Halving every count keeps the heap ordered.
+			 */
+			if (decay)
+				entry->hits /= 2;
+			if (isdue(entry, now, window) && ndue < hn->maxdue) {
+				hn->due[ndue].entry = entry;
+				hn->due[ndue].hits = entry->hits;
+				hn->due[ndue].part = p;
+				ndue++;
+			}
+		}
+		UNLOCK(&part->lock);
+	}
+
+	if (ndue == 0)
+		goto unlock;
+
+	if (ndue > hn->rate)
+		qsort(hn->due, ndue, sizeof(hn->due[0]), hotter);
+
+	name = dns_fixedname_initname(&fixed);
+	for (i = 0; i < ndue && sent < hn->rate; i++) {
+		/*
+		 * Entries are never freed while the table exists, but
+		 * this one may have been given to another name or hit
+		 * again since the scan.
+		 */
+		part = &hn->parts[hn->due[i].part];
+		entry = hn->due[i].entry;
+		LOCK(&part->lock);
+		start = isdue(entry, now, window);
+		if (start) {
+			entry->refreshing = true;
+			dns_name_copy(entry->name, name, NULL);
+			type = entry->type;
+		}
+		UNLOCK(&part->lock);
+
+		if (!start)
+			continue;
+		if (refresh_start(hn, name, type) != ISC_R_SUCCESS) {
+			LOCK(&part->lock);
+			entry->refreshing = false;
+			UNLOCK(&part->lock);
+			continue;
+		}
+		sent++;
+	}
+
+ unlock:
+	UNLOCK(&hn->lock);
+}
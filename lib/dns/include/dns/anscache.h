@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef DNS_ANSCACHE_H
+#define DNS_ANSCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/anscache.h
+ * \brief
+ * Defines dns_anscache_t, a cache of rendered responses.
+ *
+ * Notes:
+ *\li	An answer cache holds complete responses in wire format, as they
+ *	were rendered for an earlier query, keyed by the query name (as
+ *	sent, including its case), the query type and a caller-defined
+ *	32-bit "variant" describing everything else that the rendered
+ *	response depends on.  A server can send a copy of a cached
+ *	response after patching its message ID, without looking up or
+ *	rendering any data.
+ *
+ *\li	Each zone may own an answer cache.  The cache is emptied
+ *	whenever the zone's contents change: dns_anscache_dbupdate() is
+ *	registered as an update listener on the zone database, so that
+ *	it is called when a new version is committed, and the zone
+ *	flushes the cache itself when it replaces its database.
+ *
+ *\li	Every flush advances the cache's generation.  A caller that is
+ *	about to build a response which may be added to the cache notes
+ *	the generation first, and passes it to dns_anscache_add(); if
+ *	the cache has been flushed in the meantime, the response may
+ *	have been rendered from outdated data and is not added.
+ *
+ *\li	The cache holds at most a fixed number of responses.  When it
+ *	is full, the oldest response that has not been used since the
+ *	replacement hand last passed it is evicted ("CLOCK").
+ *
+ * MP:
+ *\li	All functions may be called concurrently from multiple threads.
+ *	Lookups only take the cache lock for reading.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *
+ * Security:
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/region.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/*%
+ * Responses longer than this are never cached.
+ */
+#define DNS_ANSCACHE_MAXLENGTH		4096
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_anscache_create(isc_mem_t *mctx, unsigned int maxentries,
+		    dns_anscache_t **cachep);
+/*%<
+ * Create an answer cache which holds up to 'maxentries' responses.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'maxentries' > 0.
+ *\li	'cachep' != NULL && '*cachep' == NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_anscache_attach(dns_anscache_t *source, dns_anscache_t **targetp);
+
+void
+dns_anscache_detach(dns_anscache_t **cachep);
+/*%<
+ * Attach to and detach from an answer cache.  The cache is freed
+ * when its last reference goes away.
+ */
+
+unsigned int
+dns_anscache_getmaxentries(dns_anscache_t *cache);
+/*%<
+ * Return the number of responses 'cache' was created to hold.
+ */
+
+uint32_t
+dns_anscache_generation(dns_anscache_t *cache);
+/*%<
+ * Return the current generation of 'cache'.
+ */
+
+void
+dns_anscache_flush(dns_anscache_t *cache);
+/*%<
+ * Remove every response from 'cache' and advance its generation.
+ */
+
+isc_result_t
+dns_anscache_dbupdate(dns_db_t *db, void *fn_arg);
+/*%<
+ * A dns_dbupdate_callback_t which flushes the answer cache 'fn_arg'.
+ */
+
+isc_result_t
+dns_anscache_find(dns_anscache_t *cache, const dns_name_t *qname,
+		  dns_rdatatype_t qtype, uint32_t variant,
+		  isc_buffer_t *target, unsigned int *infop);
+/*%<
+ * Look for a cached response to a query for 'qname'/'qtype' with
+ * variant 'variant'.  If one is found, copy it to 'target' and, if
+ * 'infop' is not NULL, store the value passed as 'info' to
+ * dns_anscache_add() in '*infop'.
+ *
+ * 'qname' is compared case-sensitively.
+ *
+ * Requires:
+ *\li	'qname' is absolute.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND
+ *\li	#ISC_R_NOSPACE	a response was found but 'target' is too small;
+ *			'target' is unchanged.
+ */
+
+isc_result_t
+dns_anscache_add(dns_anscache_t *cache, const dns_name_t *qname,
+		 dns_rdatatype_t qtype, uint32_t variant,
+		 uint32_t generation, unsigned int info,
+		 const isc_region_t *wire);
+/*%<
+ * Add the rendered response 'wire' for a query for 'qname'/'qtype'
+ * with variant 'variant' to 'cache'.  'generation' is the value
+ * dns_anscache_generation() returned before the data in the response
+ * was looked up.
+ *
+ * Requires:
+ *\li	'qname' is absolute.
+ *\li	'wire' != NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_EXISTS	a response with the same key is already cached.
+ *\li	#ISC_R_CANCELED	the cache has been flushed since 'generation'.
+ *\li	#ISC_R_RANGE	'wire' is longer than #DNS_ANSCACHE_MAXLENGTH.
+ *\li	#ISC_R_NOMEMORY
+ */
+
+unsigned int
+dns_anscache_count(dns_anscache_t *cache);
+/*%<
+ * Return the number of responses in 'cache'.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_ANSCACHE_H */
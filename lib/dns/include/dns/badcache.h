@@ -28,6 +28,13 @@
  *	cache" in the resolver and for the "servfail cache" in
  *	the view.
  *
+ *\li	The table is split into independently locked partitions, each
+ *	of which grows and shrinks incrementally with the number of
+ *	entries it holds.
+ *
+ * MP:
+ *\li	All functions may be called concurrently from multiple threads.
+ *
  * Reliability:
  *
  * Resources:
@@ -56,6 +63,8 @@ isc_result_t
 dns_badcache_init(isc_mem_t *mctx, unsigned int size, dns_badcache_t **bcp);
 /*%
  * Allocate and initialize a badcache and store it in '*bcp'.
+ * 'size' is the initial number of hash buckets, shared among the
+ * partitions; the table never shrinks below it.
  *
  * Requires:
  * \li	mctx != NULL
@@ -45,33 +45,51 @@ ISC_LANG_BEGINDECLS
 #define DNS_COMPRESS_ENABLED		0x04
 
 /*
- * DNS_COMPRESS_TABLESIZE must be a power of 2. The compress code
- * utilizes this assumption.
+ * The global compression table indexes every suffix of every name
+ * added to it by a hash of the whole suffix, using open addressing
+ * with linear probing.  It starts out using the storage embedded in
+ * the context and grows into allocated memory for large messages.
+ *
+ * DNS_COMPRESS_INITIALTABLE must be a power of 2 and at least twice
+ * DNS_COMPRESS_INITIALNODES; the table is kept at most half full.
  */
-#define DNS_COMPRESS_TABLEBITS 6
-#define DNS_COMPRESS_TABLESIZE (1U << DNS_COMPRESS_TABLEBITS)
-#define DNS_COMPRESS_TABLEMASK (DNS_COMPRESS_TABLESIZE - 1)
-#define DNS_COMPRESS_INITIALNODES 16
+#define DNS_COMPRESS_INITIALNODES	64
+#define DNS_COMPRESS_INITIALTABLE	(2 * DNS_COMPRESS_INITIALNODES)
+#define DNS_COMPRESS_INITIALARENA	1024
 
 typedef struct dns_compressnode dns_compressnode_t;
 
 struct dns_compressnode {
-	dns_compressnode_t	*next;
-	uint16_t		offset;
-	uint16_t		count;
-	isc_region_t            r;
-	dns_name_t              name;
+	uint32_t		hash;		/*%< Hash of the suffix. */
+	uint32_t		data;		/*%< Suffix offset in arena. */
+	uint16_t		offset;		/*%< Suffix offset in message. */
+	uint8_t			length;		/*%< Suffix length. */
+	uint8_t			labels;		/*%< Suffix label count. */
 };
 
 struct dns_compress {
 	unsigned int		magic;		/*%< Magic number. */
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
-	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated nodes for the table. */
+	/*% Suffixes, in the order they were added. */
+	dns_compressnode_t	*nodes;
+	unsigned int		count;		/*%< Number of nodes. */
+	unsigned int		nodesize;	/*%< Capacity of 'nodes'. */
+	/*% Global compression table; node index + 1, or 0 if empty. */
+	uint16_t		*table;
+	unsigned int		tablesize;	/*%< Slots in 'table'. */
+	/*% Copies of the wire form of the added names. */
+	unsigned char		*arena;
+	unsigned int		arenaused;
+	unsigned int		arenasize;
+	/*% Suffix hashes of the name last looked up, for reuse when adding. */
+	const unsigned char	*hashed;
+	unsigned int		hashedlength;
+	uint32_t		hashes[128];
+	/*% Embedded storage for the above. */
 	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
-	uint16_t		count;		/*%< Number of nodes. */
+	uint16_t		initialtable[DNS_COMPRESS_INITIALTABLE];
+	unsigned char		initialarena[DNS_COMPRESS_INITIALARENA];
 	isc_mem_t		*mctx;		/*%< Memory context. */
 };
 
@@ -188,6 +206,7 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 			dns_name_t *prefix, uint16_t *offset);
 /*%<
  *	Finds longest possible match of 'name' in the global compression table.
+ *	Every suffix of 'name' is considered, longest first.
  *
  *	Requires:
  *\li		'cctx' to be initialized.
@@ -206,14 +225,14 @@ void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		 const dns_name_t *prefix, uint16_t offset);
 /*%<
- *	Add compression pointers for 'name' to the compression table,
- *	not replacing existing pointers.
+ *	Add compression pointers for each suffix of 'name' that starts
+ *	within 'prefix' to the compression table, not replacing existing
+ *	pointers.  The name data is copied into the context.
  *
  *	Requires:
  *\li		'cctx' initialized
  *
- *\li		'name' must be initialized and absolute, and must remain
- *		valid until the message compression is complete.
+ *\li		'name' must be initialized and absolute.
  *
  *\li		'prefix' must be a prefix returned by
  *		dns_compress_findglobal(), or the same as 'name'.
@@ -129,6 +129,12 @@ struct dns_dispatchset {
  *
  * _EXCLUSIVE
  *	A separate socket will be used on-demand for each transaction.
+ *
+ * _REUSEPORT
+ *	The dispatcher gets its own socket bound with SO_REUSEPORT rather
+ *	than sharing an existing dispatcher or duplicating its socket, so
+ *	that several dispatchers can listen on the same address and port
+ *	and have the kernel distribute incoming packets between them.
  */
 #define DNS_DISPATCHATTR_PRIVATE	0x00000001U
 #define DNS_DISPATCHATTR_TCP		0x00000002U
@@ -140,6 +146,7 @@ struct dns_dispatchset {
 #define DNS_DISPATCHATTR_CONNECTED	0x00000080U
 #define DNS_DISPATCHATTR_FIXEDID	0x00000100U
 #define DNS_DISPATCHATTR_EXCLUSIVE	0x00000200U
+#define DNS_DISPATCHATTR_REUSEPORT	0x00000400U
 /*@}*/
 
 /*
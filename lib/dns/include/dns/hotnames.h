@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef DNS_HOTNAMES_H
+#define DNS_HOTNAMES_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/hotnames.h
+ * \brief
+ * Defines dns_hotnames_t, the refresh-ahead scheduler for popular
+ * cached RRsets.
+ *
+ * Notes:
+ *\li	Prefetch as triggered from query processing only refreshes an
+ *	RRset if a query for it happens to arrive during the last few
+ *	seconds of its TTL.  A hot names table counts cache hits on
+ *	prefetch-eligible RRsets and, once a second, refreshes the most
+ *	popular ones that are about to expire, whether or not a query
+ *	arrives in time.
+ *
+ *\li	The table keeps at most a configured number of (name, type)
+ *	pairs.  When it is full, a new pair replaces the least popular
+ *	one and inherits its count ("space saving"), so names which stay
+ *	popular are not pushed out by a long tail of names queried
+ *	once.  Counts are halved every few seconds so that names which
+ *	have gone cold eventually make way.
+ *
+ *\li	At most a configured number of refresh queries are started per
+ *	second, hottest first.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	About 400 bytes per tracked name.
+ *
+ * Security:
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/task.h>
+#include <isc/timer.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_hotnames_create(isc_mem_t *mctx, dns_view_t *view,
+		    isc_taskmgr_t *taskmgr, isc_timermgr_t *timermgr,
+		    unsigned int size, unsigned int rate,
+		    dns_hotnames_t **hnp);
+/*%
+ * Create a hot names table for 'view' tracking at most 'size' names, and
+ * refreshing at most 'rate' of them per second using the view's
+ * resolver.  The table does not hold a reference to 'view';
+ * dns_hotnames_shutdown() must be called before the view goes away.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	'view' is a valid view
+ * \li	'taskmgr' and 'timermgr' are valid
+ * \li	size > 0 && rate > 0
+ * \li	hnp != NULL && *hnp == NULL
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOMEMORY
+ * \li	Others if the task or the timer cannot be created
+ */
+
+void
+dns_hotnames_attach(dns_hotnames_t *source, dns_hotnames_t **targetp);
+/*%
+ * Attach '*targetp' to 'source'.
+ *
+ * Requires:
+ * \li	'source' to be a valid hot names table
+ * \li	targetp != NULL && *targetp == NULL
+ */
+
+void
+dns_hotnames_detach(dns_hotnames_t **hnp);
+/*%
+ * Detach '*hnp' from its hot names table, freeing it when the last
+ * reference goes away.
+ *
+ * Requires:
+ * \li	'*hnp' to be a valid hot names table
+ */
+
+void
+dns_hotnames_shutdown(dns_hotnames_t *hn);
+/*%
+ * Stop refreshing and cancel the refresh queries in progress.  After
+ * this returns the table no longer touches the view it was created
+ * for.
+ *
+ * Requires:
+ * \li	'hn' to be a valid hot names table
+ */
+
+void
+dns_hotnames_hit(dns_hotnames_t *hn, const dns_name_t *name,
+		 dns_rdatatype_t type, dns_ttl_t ttl);
+/*%
+ * Record that the cached RRset 'name'/'type', which has 'ttl' seconds
+ * left to live, has been used to answer a query.
+ *
+ * Requires:
+ * \li	'hn' to be a valid hot names table
+ * \li	'name' to be a valid absolute name
+ */
+
+unsigned int
+dns_hotnames_count(dns_hotnames_t *hn, const dns_name_t *name,
+		   dns_rdatatype_t type);
+/*%
+ * Return the (decayed) hit count of 'name'/'type', or 0 if it is not
+ * being tracked.
+ *
+ * Requires:
+ * \li	'hn' to be a valid hot names table
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_HOTNAMES_H */
@@ -159,6 +159,11 @@ typedef int dns_messagetextflag_t;
 #define DNS_MESSAGE_INTENTPARSE		1 /*%< parsing messages */
 #define DNS_MESSAGE_INTENTRENDER	2 /*%< rendering */
 
+/*
+ * Control behavior of message creation
+ */
+#define DNS_MESSAGECREATE_ARENA		0x0001	/*%< allocate from an arena */
+
 /*
  * Control behavior of parsing
  */
@@ -224,6 +229,7 @@ struct dns_message {
 	unsigned int			cc_bad : 1;
 	unsigned int			tkey : 1;
 	unsigned int			rdclass_set : 1;
+	unsigned int			arena : 1;
 
 	unsigned int			opt_reserved;
 	unsigned int			sig_reserved;
@@ -245,9 +251,12 @@ struct dns_message {
 	ISC_LIST(dns_msgblock_t)	rdatas;
 	ISC_LIST(dns_msgblock_t)	rdatalists;
 	ISC_LIST(dns_msgblock_t)	offsets;
+	ISC_LIST(dns_msgblock_t)	arenablocks;
 
 	ISC_LIST(dns_rdata_t)		freerdata;
 	ISC_LIST(dns_rdatalist_t)	freerdatalist;
+	ISC_LIST(dns_name_t)		freename;
+	ISC_LIST(dns_rdataset_t)	freerdataset;
 
 	dns_rcode_t			tsigstatus;
 	dns_rcode_t			querytsigstatus;
@@ -283,12 +292,27 @@ ISC_LANG_BEGINDECLS
 isc_result_t
 dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp);
 
+isc_result_t
+dns_message_create2(isc_mem_t *mctx, unsigned int intent,
+		    unsigned int options, dns_message_t **msgp);
 /*%<
  * Create msg structure.
  *
  * This function will allocate some internal blocks of memory that are
  * expected to be needed for parsing or rendering nearly any type of message.
  *
+ * If 'options' includes #DNS_MESSAGECREATE_ARENA, the names, rdatasets,
+ * rdata, rdatalists, offsets and scratch buffers the message uses are
+ * carved sequentially out of large blocks of memory ("the arena")
+ * instead of coming from memory pools and separate allocations.
+ * Objects returned with dns_message_puttemp*() are kept for reuse by
+ * the same message, and all of them are reclaimed at once by
+ * dns_message_reset().  The reset keeps a single arena block, sized
+ * (within a limit) for everything the message last used.  This suits
+ * a message that is reset and reused for one query after another.
+ *
+ * dns_message_create() is dns_message_create2() with no options.
+ *
  * Requires:
  *\li	'mctx' be a valid memory context.
  *
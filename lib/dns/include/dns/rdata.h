@@ -590,6 +590,19 @@ dns_rdatatype_isknown(dns_rdatatype_t type);
  *
  */
 
+bool
+dns_rdatatype_towirecopy(dns_rdataclass_t rdclass, dns_rdatatype_t type);
+/*%<
+ * Return true iff dns_rdata_towire() renders rdata of class 'rdclass'
+ * and type 'type' as an unmodified copy of its data, so that callers
+ * may copy the data into a message themselves.
+ *
+ * Such rdata contains no compressible domain names.  The signer name
+ * in RRSIG is rendered uncompressed; as it is always an ancestor of
+ * (or equal to) the owner name, every suffix of it is already known
+ * to a compression context that has seen the owner.
+ */
+
 
 isc_result_t
 dns_rdata_additionaldata(dns_rdata_t *rdata, dns_additionaldatafunc_t add,
@@ -415,6 +415,18 @@ dns_resolver_socketmgr(dns_resolver_t *resolver);
 isc_taskmgr_t *
 dns_resolver_taskmgr(dns_resolver_t *resolver);
 
+isc_task_t *
+dns_resolver_verifytask(dns_resolver_t *resolver);
+/*%<
+ * Return one of the tasks on which the validator runs signature
+ * verifications for 'resolver'.  The tasks are handed out in turn.
+ * The caller does not attach to the task; the resolver keeps it until
+ * it is destroyed, which cannot happen while a validator is running.
+ *
+ * Requires:
+ *\li	'resolver' to be valid.
+ */
+
 uint32_t
 dns_resolver_getlamettl(dns_resolver_t *resolver);
 /*%<
@@ -610,6 +622,22 @@ dns_resolver_setnonbackofftries(dns_resolver_t *resolver, unsigned int tries);
  * \li  tries > 0.
  */
 
+bool
+dns_resolver_gethedging(dns_resolver_t *resolver);
+
+void
+dns_resolver_sethedging(dns_resolver_t *resolver, bool hedge);
+/*%<
+ * Turn hedged queries on or off.  With hedging on, if a server has not
+ * answered a query within the resolver's running median response time
+ * (or the server's own smoothed RTT, if that is longer), the query is
+ * also sent to the next server, and the first acceptable answer is
+ * used.  Hedging is off by default.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ */
+
 unsigned int
 dns_resolver_getoptions(dns_resolver_t *resolver);
 /*%<
@@ -737,6 +765,20 @@ void
 dns_resolver_dumpfetches(dns_resolver_t *resolver,
 			 isc_statsformat_t format, FILE *fp);
 
+void
+dns_resolver_dumpbuckets(dns_resolver_t *resolver,
+			 isc_statsformat_t format, FILE *fp);
+/*%<
+ * Write the occupancy of each fetch context bucket that has been used
+ * to 'fp': the number of active fetch contexts, the most it has held,
+ * and the current size of its hash table.
+ *
+ * Requires:
+ * \li	'resolver' to be valid.
+ * \li	'format' to be isc_statsformat_file.
+ * \li	'fp' to be a valid stream.
+ */
+
 
 #ifdef ENABLE_AFL
 /*%
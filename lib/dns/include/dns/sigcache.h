@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef DNS_SIGCACHE_H
+#define DNS_SIGCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * Defines dns_sigcache_t, the signature verification cache.
+ *
+ * Notes:
+ *\li	A signature cache remembers which (RRset, RRSIG, DNSKEY) tuples
+ *	have recently been verified successfully, so that the validator
+ *	does not have to repeat the public key operation when the same
+ *	RRset is validated again (e.g. by another fetch, or after it was
+ *	re-fetched when it expired from the cache).
+ *
+ *\li	Tuples are identified by a SHA-256 digest of the owner name,
+ *	the RRset in canonical form, the RRSIG rdata and the DNSKEY rdata.
+ *	Only successful verifications are cached, each for no longer than
+ *	the caller allows.  The number of entries is bounded; when the
+ *	cache is full the oldest entries are evicted first.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	About 64 bytes per entry.
+ *
+ * Security:
+ *\li	A hit is only possible for the exact tuple that was verified, so
+ *	a forged RRset or signature cannot be validated from the cache.
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <stdbool.h>
+
+#include <isc/sha2.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+#define DNS_SIGCACHE_DIGESTLENGTH	ISC_SHA256_DIGESTLENGTH
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, unsigned int maxentries,
+		    dns_sigcache_t **scp);
+/*%
+ * Create a signature cache holding at most 'maxentries' entries and
+ * store it in '*scp'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	maxentries > 0
+ * \li	scp != NULL && *scp == NULL
+ */
+
+void
+dns_sigcache_destroy(dns_sigcache_t **scp);
+/*%
+ * Flush and then free the signature cache in '*scp'.  '*scp' is set
+ * to NULL on return.
+ *
+ * Requires:
+ * \li	'*scp' to be a valid signature cache
+ */
+
+isc_result_t
+dns_sigcache_digest(const dns_name_t *name, dns_rdataset_t *rdataset,
+		    dst_key_t *key, dns_rdata_t *sigrdata, isc_mem_t *mctx,
+		    unsigned char *digest);
+/*%
+ * Compute the digest identifying the verification of the RRset
+ * 'name'/'rdataset' by signature 'sigrdata' with key 'key'.  The digest
+ * does not depend on the case of 'name' or on the order of the rdatas.
+ *
+ * Requires:
+ * \li	'digest' points to DNS_SIGCACHE_DIGESTLENGTH bytes
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOMEMORY
+ * \li	Others if the key cannot be converted to wire format
+ */
+
+bool
+dns_sigcache_find(dns_sigcache_t *sc, const unsigned char *digest,
+		  isc_stdtime_t now);
+/*%
+ * Return true if a verification identified by 'digest' has succeeded
+ * and its entry has not yet expired at 'now'.
+ *
+ * Requires:
+ * \li	'sc' to be a valid signature cache
+ */
+
+void
+dns_sigcache_add(dns_sigcache_t *sc, const unsigned char *digest,
+		 isc_stdtime_t now, isc_stdtime_t expire);
+/*%
+ * Record that the verification identified by 'digest' succeeded and
+ * can be trusted until 'expire'.  Nothing is added if 'expire' is not
+ * after 'now'.
+ *
+ * Requires:
+ * \li	'sc' to be a valid signature cache
+ */
+
+void
+dns_sigcache_flush(dns_sigcache_t *sc);
+/*%
+ * Remove all entries from the signature cache 'sc'.
+ *
+ * Requires:
+ * \li	'sc' to be a valid signature cache
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SIGCACHE_H */
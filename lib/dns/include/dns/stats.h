@@ -70,7 +70,14 @@ enum {
 	dns_resstatscounter_serverquota = 42,
 	dns_resstatscounter_nextitem = 43,
 	dns_resstatscounter_priming = 44,
-	dns_resstatscounter_max = 45,
+	dns_resstatscounter_bucketmax = 45,
+	dns_resstatscounter_hedgesent = 46,
+	dns_resstatscounter_hedgewon = 47,
+	dns_resstatscounter_dispsockreuse = 48,
+	dns_resstatscounter_sigcachehit = 49,
+	dns_resstatscounter_sigcachemiss = 50,
+	dns_resstatscounter_hotprefetch = 51,
+	dns_resstatscounter_max = 52,
 
 	/*
 	 * DNSSEC stats.
@@ -36,6 +36,7 @@ typedef ISC_LIST(dns_adbaddrinfo_t)		dns_adbaddrinfolist_t;
 typedef struct dns_adbentry			dns_adbentry_t;
 typedef struct dns_adbfind			dns_adbfind_t;
 typedef ISC_LIST(dns_adbfind_t)			dns_adbfindlist_t;
+typedef struct dns_anscache			dns_anscache_t;
 typedef struct dns_badcache 			dns_badcache_t;
 typedef struct dns_byaddr			dns_byaddr_t;
 typedef struct dns_catz_zonemodmethods		dns_catz_zonemodmethods_t;
@@ -88,6 +89,7 @@ typedef struct dns_fixedname			dns_fixedname_t;
 typedef struct dns_forwarders			dns_forwarders_t;
 typedef struct dns_forwarder			dns_forwarder_t;
 typedef struct dns_fwdtable			dns_fwdtable_t;
+typedef struct dns_hotnames			dns_hotnames_t;
 typedef struct dns_iptable			dns_iptable_t;
 typedef uint32_t				dns_iterations_t;
 typedef uint16_t				dns_keyflags_t;
@@ -129,6 +131,7 @@ typedef struct dns_resolver			dns_resolver_t;
 typedef struct dns_sdbimplementation		dns_sdbimplementation_t;
 typedef uint8_t					dns_secalg_t;
 typedef uint8_t					dns_secproto_t;
+typedef struct dns_sigcache			dns_sigcache_t;
 typedef struct dns_signature			dns_signature_t;
 typedef struct dns_sortlist_arg			dns_sortlist_arg_t;
 typedef struct dns_ssurule			dns_ssurule_t;
@@ -161,6 +161,7 @@ struct dns_validator {
 	unsigned int			authcount;
 	unsigned int			authfail;
 	isc_stdtime_t			start;
+	isc_result_t			verifyresult;
 };
 
 /*%
@@ -159,6 +159,7 @@ struct dns_view {
 	char				*nta_file;
 	dns_ttl_t			prefetch_trigger;
 	dns_ttl_t			prefetch_eligible;
+	dns_hotnames_t			*hotnames;
 	in_port_t			dstport;
 	dns_aclenv_t			aclenv;
 	dns_rdatatype_t			preferred_glue;
@@ -188,6 +189,7 @@ struct dns_view {
 	dns_dlzdblist_t 		dlz_unsearched;
 	uint32_t			fail_ttl;
 	dns_badcache_t			*failcache;
+	dns_sigcache_t			*sigcache;
 
 	/*
 	 * Configurable data for server use only,
@@ -2447,6 +2447,36 @@ dns_zone_get_parentcatz(const dns_zone_t *zone);
  * \li	'zone' is a valid zone object
  */
 
+isc_result_t
+dns_zone_setanswercache(dns_zone_t *zone, unsigned int maxentries);
+/*%<
+ * Keep up to 'maxentries' rendered responses for 'zone' in an answer
+ * cache (see dns/anscache.h), or stop caching responses if
+ * 'maxentries' is zero.  The cache is flushed whenever a new version
+ * of the zone database is committed or the database is replaced, and
+ * also by every call to this function.
+ *
+ * Requires:
+ *
+ * \li	'zone' is a valid zone object
+ *
+ * Returns:
+ *
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_zone_getanswercache(dns_zone_t *zone, dns_anscache_t **anscachep);
+/*%<
+ * Attach '*anscachep' to the answer cache of 'zone', if it has one.
+ *
+ * Requires:
+ *
+ * \li	'zone' is a valid zone object
+ * \li	'anscachep' != NULL && '*anscachep' == NULL
+ */
+
 
 void
 dns_zone_setstatlevel(dns_zone_t *zone, dns_zonestat_level_t level);
@@ -108,6 +108,19 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
 #define RDATALIST_COUNT		  8
 #define RDATASET_COUNT	         64
 
+/*%
+ * Size of each arena block used by a message created with
+ * DNS_MESSAGECREATE_ARENA, and the alignment of the objects allocated
+ * from it.
+ */
+#define ARENA_SIZE		8192
+#define ARENA_ALIGN		sizeof(void *)
+
+/*%
+ * Largest arena block a message keeps across dns_message_reset().
+ */
+#define ARENA_MAXSIZE		65536
+
 /*%
  * Text representation of the different items, for message_totext
  * functions.
@@ -240,6 +253,36 @@ msgblock_free(isc_mem_t *mctx, dns_msgblock_t *block, unsigned int sizeof_type)
 	isc_mem_put(mctx, block, length);
 }
 
+/*
+ * Return 'size' bytes from the message's arena, starting a new arena
+ * block if the current one is full.  An arena block is a msgblock of
+ * bytes which is used from the front.  If no memory is free, return NULL.
+ */
+static inline void *
+arenaget(dns_message_t *msg, unsigned int size) {
+	dns_msgblock_t *block;
+	unsigned char *ptr;
+
+	INSIST(msg->arena);
+
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	block = ISC_LIST_TAIL(msg->arenablocks);
+	if (block == NULL || block->remaining < size) {
+		block = msgblock_allocate(msg->mctx, 1,
+					  ISC_MAX(size, ARENA_SIZE));
+		if (block == NULL)
+			return (NULL);
+		ISC_LIST_APPEND(msg->arenablocks, block, link);
+	}
+
+	ptr = ((unsigned char *)block) + sizeof(dns_msgblock_t) +
+	      (block->count - block->remaining);
+	block->remaining -= size;
+
+	return (ptr);
+}
+
 /*
  * Allocate a new dynamic buffer, and attach it to this message as the
  * "current" buffer.  (which is always the last on the list, for our
@@ -250,6 +293,15 @@ newbuffer(dns_message_t *msg, unsigned int size) {
 	isc_result_t result;
 	isc_buffer_t *dynbuf;
 
+	if (msg->arena) {
+		dynbuf = arenaget(msg, sizeof(*dynbuf) + size);
+		if (dynbuf == NULL)
+			return (ISC_R_NOMEMORY);
+		isc_buffer_init(dynbuf, dynbuf + 1, size);
+		ISC_LIST_APPEND(msg->scratchpad, dynbuf, link);
+		return (ISC_R_SUCCESS);
+	}
+
 	dynbuf = NULL;
 	result = isc_buffer_allocate(msg->mctx, &dynbuf, size);
 	if (result != ISC_R_SUCCESS)
@@ -285,6 +337,13 @@ newrdata(dns_message_t *msg) {
 		return (rdata);
 	}
 
+	if (msg->arena) {
+		rdata = arenaget(msg, sizeof(*rdata));
+		if (rdata == NULL)
+			return (NULL);
+		goto out;
+	}
+
 	msgblock = ISC_LIST_TAIL(msg->rdatas);
 	rdata = msgblock_get(msgblock, dns_rdata_t);
 	if (rdata == NULL) {
@@ -298,6 +357,7 @@ newrdata(dns_message_t *msg) {
 		rdata = msgblock_get(msgblock, dns_rdata_t);
 	}
 
+ out:
 	dns_rdata_init(rdata);
 	return (rdata);
 }
@@ -318,6 +378,11 @@ newrdatalist(dns_message_t *msg) {
 		goto out;
 	}
 
+	if (msg->arena) {
+		rdatalist = arenaget(msg, sizeof(*rdatalist));
+		goto out;
+	}
+
 	msgblock = ISC_LIST_TAIL(msg->rdatalists);
 	rdatalist = msgblock_get(msgblock, dns_rdatalist_t);
 	if (rdatalist == NULL) {
@@ -343,6 +408,9 @@ newoffsets(dns_message_t *msg) {
 	dns_msgblock_t *msgblock;
 	dns_offsets_t *offsets;
 
+	if (msg->arena)
+		return (arenaget(msg, sizeof(*offsets)));
+
 	msgblock = ISC_LIST_TAIL(msg->offsets);
 	offsets = msgblock_get(msgblock, dns_offsets_t);
 	if (offsets == NULL) {
@@ -360,6 +428,65 @@ newoffsets(dns_message_t *msg) {
 	return (offsets);
 }
 
+/*
+ * Names and rdatasets come from the message's memory pools, or in arena
+ * mode from the arena; those released before the message is reset are
+ * kept on a free list for reuse.
+ */
+static inline dns_name_t *
+newname(dns_message_t *msg) {
+	dns_name_t *name;
+
+	if (!msg->arena)
+		return (isc_mempool_get(msg->namepool));
+
+	name = ISC_LIST_HEAD(msg->freename);
+	if (name != NULL) {
+		ISC_LIST_UNLINK(msg->freename, name, link);
+		return (name);
+	}
+
+	return (arenaget(msg, sizeof(*name)));
+}
+
+static inline void
+releasename(dns_message_t *msg, dns_name_t *name) {
+	if (!msg->arena) {
+		isc_mempool_put(msg->namepool, name);
+		return;
+	}
+
+	ISC_LINK_INIT(name, link);
+	ISC_LIST_PREPEND(msg->freename, name, link);
+}
+
+static inline dns_rdataset_t *
+newrdataset(dns_message_t *msg) {
+	dns_rdataset_t *rdataset;
+
+	if (!msg->arena)
+		return (isc_mempool_get(msg->rdspool));
+
+	rdataset = ISC_LIST_HEAD(msg->freerdataset);
+	if (rdataset != NULL) {
+		ISC_LIST_UNLINK(msg->freerdataset, rdataset, link);
+		return (rdataset);
+	}
+
+	return (arenaget(msg, sizeof(*rdataset)));
+}
+
+static inline void
+releaserdataset(dns_message_t *msg, dns_rdataset_t *rdataset) {
+	if (!msg->arena) {
+		isc_mempool_put(msg->rdspool, rdataset);
+		return;
+	}
+
+	ISC_LINK_INIT(rdataset, link);
+	ISC_LIST_PREPEND(msg->freerdataset, rdataset, link);
+}
+
 static inline void
 msginitheader(dns_message_t *m) {
 	m->id = 0;
@@ -456,12 +583,12 @@ msgresetnames(dns_message_t *msg, unsigned int first_section) {
 
 				INSIST(dns_rdataset_isassociated(rds));
 				dns_rdataset_disassociate(rds);
-				isc_mempool_put(msg->rdspool, rds);
+				releaserdataset(msg, rds);
 				rds = next_rds;
 			}
 			if (dns_name_dynamic(name))
 				dns_name_free(name, msg->mctx);
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			name = next_name;
 		}
 	}
@@ -477,7 +604,7 @@ msgresetopt(dns_message_t *msg)
 		}
 		INSIST(dns_rdataset_isassociated(msg->opt));
 		dns_rdataset_disassociate(msg->opt);
-		isc_mempool_put(msg->rdspool, msg->opt);
+		releaserdataset(msg, msg->opt);
 		msg->opt = NULL;
 		msg->cc_ok = 0;
 		msg->cc_bad = 0;
@@ -498,30 +625,30 @@ msgresetsigs(dns_message_t *msg, bool replying) {
 			msg->querytsig = msg->tsig;
 		} else {
 			dns_rdataset_disassociate(msg->tsig);
-			isc_mempool_put(msg->rdspool, msg->tsig);
+			releaserdataset(msg, msg->tsig);
 			if (msg->querytsig != NULL) {
 				dns_rdataset_disassociate(msg->querytsig);
-				isc_mempool_put(msg->rdspool, msg->querytsig);
+				releaserdataset(msg, msg->querytsig);
 			}
 		}
 		if (dns_name_dynamic(msg->tsigname))
 			dns_name_free(msg->tsigname, msg->mctx);
-		isc_mempool_put(msg->namepool, msg->tsigname);
+		releasename(msg, msg->tsigname);
 		msg->tsig = NULL;
 		msg->tsigname = NULL;
 	} else if (msg->querytsig != NULL && !replying) {
 		dns_rdataset_disassociate(msg->querytsig);
-		isc_mempool_put(msg->rdspool, msg->querytsig);
+		releaserdataset(msg, msg->querytsig);
 		msg->querytsig = NULL;
 	}
 	if (msg->sig0 != NULL) {
 		INSIST(dns_rdataset_isassociated(msg->sig0));
 		dns_rdataset_disassociate(msg->sig0);
-		isc_mempool_put(msg->rdspool, msg->sig0);
+		releaserdataset(msg, msg->sig0);
 		if (msg->sig0name != NULL) {
 			if (dns_name_dynamic(msg->sig0name))
 				dns_name_free(msg->sig0name, msg->mctx);
-			isc_mempool_put(msg->namepool, msg->sig0name);
+			releasename(msg, msg->sig0name);
 		}
 		msg->sig0 = NULL;
 		msg->sig0name = NULL;
@@ -534,10 +661,11 @@ msgresetsigs(dns_message_t *msg, bool replying) {
  */
 static void
 msgreset(dns_message_t *msg, bool everything) {
-	dns_msgblock_t *msgblock, *next_msgblock;
+	dns_msgblock_t *msgblock, *next_msgblock, *block;
 	isc_buffer_t *dynbuf, *next_dynbuf;
 	dns_rdata_t *rdata;
 	dns_rdatalist_t *rdatalist;
+	unsigned int used;
 
 	msgresetnames(msg, 0);
 	msgresetopt(msg);
@@ -562,7 +690,13 @@ msgreset(dns_message_t *msg, bool everything) {
 		ISC_LIST_UNLINK(msg->freerdatalist, rdatalist, link);
 		rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
 	}
+	ISC_LIST_INIT(msg->freename);
+	ISC_LIST_INIT(msg->freerdataset);
 
+	/*
+	 * The first scratchpad buffer is always allocated separately;
+	 * in arena mode the rest live in the arena.
+	 */
 	dynbuf = ISC_LIST_HEAD(msg->scratchpad);
 	INSIST(dynbuf != NULL);
 	if (!everything) {
@@ -572,10 +706,49 @@ msgreset(dns_message_t *msg, bool everything) {
 	while (dynbuf != NULL) {
 		next_dynbuf = ISC_LIST_NEXT(dynbuf, link);
 		ISC_LIST_UNLINK(msg->scratchpad, dynbuf, link);
-		isc_buffer_free(&dynbuf);
+		if (dynbuf->mctx == NULL)
+			isc_buffer_invalidate(dynbuf);
+		else
+			isc_buffer_free(&dynbuf);
 		dynbuf = next_dynbuf;
 	}
 
+	/*
+	 * Keep one arena block.  If the message outgrew it, replace it
+	 * with one large enough for everything the message used (up to
+	 * ARENA_MAXSIZE), so that a message which keeps handling large
+	 * queries stops allocating blocks.
+	 */
+	msgblock = ISC_LIST_HEAD(msg->arenablocks);
+	if (!everything && msgblock != NULL) {
+		if (ISC_LIST_NEXT(msgblock, link) != NULL) {
+			used = 0;
+			for (block = msgblock;
+			     block != NULL;
+			     block = ISC_LIST_NEXT(block, link))
+			{
+				used += block->count - block->remaining;
+			}
+			used = ISC_MIN(used, ARENA_MAXSIZE);
+			if (used > msgblock->count) {
+				block = msgblock_allocate(msg->mctx, 1, used);
+				if (block != NULL) {
+					ISC_LIST_PREPEND(msg->arenablocks,
+							 block, link);
+					msgblock = block;
+				}
+			}
+		}
+		msgblock_reset(msgblock);
+		msgblock = ISC_LIST_NEXT(msgblock, link);
+	}
+	while (msgblock != NULL) {
+		next_msgblock = ISC_LIST_NEXT(msgblock, link);
+		ISC_LIST_UNLINK(msg->arenablocks, msgblock, link);
+		msgblock_free(msg->mctx, msgblock, 1);
+		msgblock = next_msgblock;
+	}
+
 	msgblock = ISC_LIST_HEAD(msg->rdatas);
 	if (!everything && msgblock != NULL) {
 		msgblock_reset(msgblock);
@@ -702,10 +875,18 @@ spacefortsig(dns_tsigkey_t *key, int otherlen) {
 
 isc_result_t
 dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
+{
+	return (dns_message_create2(mctx, intent, 0, msgp));
+}
+
+isc_result_t
+dns_message_create2(isc_mem_t *mctx, unsigned int intent,
+		    unsigned int options, dns_message_t **msgp)
 {
 	dns_message_t *m;
 	isc_result_t result;
 	isc_buffer_t *dynbuf;
+	dns_msgblock_t *msgblock;
 	unsigned int i;
 
 	REQUIRE(mctx != NULL);
@@ -725,6 +906,7 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 
 	m->magic = DNS_MESSAGE_MAGIC;
 	m->from_to_wire = intent;
+	m->arena = ((options & DNS_MESSAGECREATE_ARENA) != 0);
 	msginit(m);
 
 	for (i = 0; i < DNS_SECTION_MAX; i++)
@@ -740,8 +922,11 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 	ISC_LIST_INIT(m->rdatas);
 	ISC_LIST_INIT(m->rdatalists);
 	ISC_LIST_INIT(m->offsets);
+	ISC_LIST_INIT(m->arenablocks);
 	ISC_LIST_INIT(m->freerdata);
 	ISC_LIST_INIT(m->freerdatalist);
+	ISC_LIST_INIT(m->freename);
+	ISC_LIST_INIT(m->freerdataset);
 
 	/*
 	 * Ok, it is safe to allocate (and then "goto cleanup" if failure)
@@ -768,6 +953,15 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 		goto cleanup;
 	ISC_LIST_APPEND(m->scratchpad, dynbuf, link);
 
+	if (m->arena) {
+		msgblock = msgblock_allocate(mctx, 1, ARENA_SIZE);
+		if (msgblock == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		ISC_LIST_APPEND(m->arenablocks, msgblock, link);
+	}
+
 	m->cctx = NULL;
 
 	*msgp = m;
@@ -1016,7 +1210,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	rdatalist = NULL;
 
 	for (count = 0; count < msg->counts[DNS_SECTION_QUESTION]; count++) {
-		name = isc_mempool_get(msg->namepool);
+		name = newname(msg);
 		if (name == NULL)
 			return (ISC_R_NOMEMORY);
 		free_name = true;
@@ -1061,7 +1255,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			ISC_LIST_APPEND(*section, name, link);
 			free_name = false;
 		} else {
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			name = name2;
 			name2 = NULL;
 			free_name = false;
@@ -1109,7 +1303,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			result = ISC_R_NOMEMORY;
 			goto cleanup;
 		}
-		rdataset =  isc_mempool_get(msg->rdspool);
+		rdataset = newrdataset(msg);
 		if (rdataset == NULL) {
 			result = ISC_R_NOMEMORY;
 			goto cleanup;
@@ -1140,14 +1334,14 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
  cleanup:
 	if (rdataset != NULL) {
 		INSIST(!dns_rdataset_isassociated(rdataset));
-		isc_mempool_put(msg->rdspool, rdataset);
+		releaserdataset(msg, rdataset);
 	}
 #if 0
 	if (rdatalist != NULL)
 		isc_mempool_put(msg->rdlpool, rdatalist);
 #endif
 	if (free_name)
-		isc_mempool_put(msg->namepool, name);
+		releasename(msg, name);
 
 	return (result);
 }
@@ -1254,7 +1448,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		skip_type_search = false;
 		free_rdataset = false;
 
-		name = isc_mempool_get(msg->namepool);
+		name = newname(msg);
 		if (name == NULL)
 			return (ISC_R_NOMEMORY);
 		free_name = true;
@@ -1484,7 +1678,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			 * If it is a new name, append to the section.
 			 */
 			if (result == ISC_R_SUCCESS) {
-				isc_mempool_put(msg->namepool, name);
+				releasename(msg, name);
 				name = name2;
 			} else {
 				ISC_LIST_APPEND(*section, name, link);
@@ -1536,7 +1730,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		}
 
 		if (result == ISC_R_NOTFOUND) {
-			rdataset = isc_mempool_get(msg->rdspool);
+			rdataset = newrdataset(msg);
 			if (rdataset == NULL) {
 				result = ISC_R_NOMEMORY;
 				goto cleanup;
@@ -1605,7 +1799,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 				((msg->opt->ttl & DNS_MESSAGE_EDNSRCODE_MASK)
 				 >> 20);
 			msg->rcode |= ercode;
-			isc_mempool_put(msg->namepool, name);
+			releasename(msg, name);
 			free_name = false;
 		} else if (issigzero && msg->sig0 == NULL) {
 			msg->sig0 = rdataset;
@@ -1625,9 +1819,9 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 
 		if (seen_problem) {
 			if (free_name)
-				isc_mempool_put(msg->namepool, name);
+				releasename(msg, name);
 			if (free_rdataset)
-				isc_mempool_put(msg->rdspool, rdataset);
+				releaserdataset(msg, rdataset);
 			free_name = free_rdataset = false;
 		}
 		INSIST(free_name == false);
@@ -1653,9 +1847,9 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 
  cleanup:
 	if (free_name)
-		isc_mempool_put(msg->namepool, name);
+		releasename(msg, name);
 	if (free_rdataset)
-		isc_mempool_put(msg->rdspool, rdataset);
+		releaserdataset(msg, rdataset);
 
 	return (result);
 }
@@ -2576,7 +2770,7 @@ dns_message_gettempname(dns_message_t *msg, dns_name_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	*item = isc_mempool_get(msg->namepool);
+	*item = newname(msg);
 	if (*item == NULL)
 		return (ISC_R_NOMEMORY);
 	dns_name_init(*item, NULL);
@@ -2613,7 +2807,7 @@ dns_message_gettemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	*item = isc_mempool_get(msg->rdspool);
+	*item = newrdataset(msg);
 	if (*item == NULL)
 		return (ISC_R_NOMEMORY);
 
@@ -2647,7 +2841,7 @@ dns_message_puttempname(dns_message_t *msg, dns_name_t **itemp) {
 	*itemp = NULL;
 	if (dns_name_dynamic(item))
 		dns_name_free(item, msg->mctx);
-	isc_mempool_put(msg->namepool, item);
+	releasename(msg, item);
 }
 
 void
@@ -2665,7 +2859,7 @@ dns_message_puttemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(item != NULL && *item != NULL);
 
 	REQUIRE(!dns_rdataset_isassociated(*item));
-	isc_mempool_put(msg->rdspool, *item);
+	releaserdataset(msg, *item);
 	*item = NULL;
 }
 
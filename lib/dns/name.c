@@ -34,6 +34,20 @@
 #include <dns/name.h>
 #include <dns/result.h>
 
+/*
+ * SSE2 is part of the x86-64 baseline; AVX2 code is compiled separately
+ * and only used if the CPU supports it.
+ */
+#if defined(__GNUC__) && defined(__SSE2__)
+#define NAME_SSE2 1
+#include <emmintrin.h>
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ >= 5)
+#define NAME_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
 #define VALID_NAME(n)	ISC_MAGIC_VALID(n, DNS_NAME_MAGIC)
 
 typedef enum {
@@ -143,6 +157,244 @@ do { \
 	((name->attributes & (DNS_NAMEATTR_READONLY|DNS_NAMEATTR_DYNAMIC)) \
 	 == 0)
 
+/*
+ * Case-insensitive comparison and downcasing of name data.
+ *
+ * Only the letters A-Z are changed by folding, and label length bytes
+ * (0-63) are not, so these work on whole names as well as on single
+ * labels.  With SSE2 they handle 16 bytes at a time, or 32 with AVX2
+ * if the CPU has it; inputs shorter than that use maptolower[].  The
+ * vector loops finish with one load covering the last 16 (or 32) bytes,
+ * overlapping the previous one, so that they never read outside the
+ * data they are given.
+ */
+static inline unsigned int
+caseless_diff_scalar(const unsigned char *a, const unsigned char *b,
+		     unsigned int length)
+{
+	unsigned int i;
+
+	for (i = 0; i < length; i++) {
+		if (maptolower[a[i]] != maptolower[b[i]])
+			break;
+	}
+
+	return (i);
+}
+
+static inline void
+caseless_copy_scalar(unsigned char *dst, const unsigned char *src,
+		     unsigned int length)
+{
+	while (length-- > 0)
+		*dst++ = maptolower[*src++];
+}
+
+#ifdef NAME_SSE2
+static inline __m128i
+fold_sse2(__m128i v) {
+	/* 'A'-'Z' become the only bytes below -102 when signed. */
+	__m128i t = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - 'A')));
+	__m128i upper = _mm_cmplt_epi8(t, _mm_set1_epi8(-128 + 26));
+
+	return (_mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+}
+
+/*
+ * Return a mask of the positions at which the 16 bytes at 'a' and 'b'
+ * differ after folding.
+ */
+static inline unsigned int
+diffmask_sse2(const unsigned char *a, const unsigned char *b) {
+	__m128i va = fold_sse2(_mm_loadu_si128((const __m128i *)a));
+	__m128i vb = fold_sse2(_mm_loadu_si128((const __m128i *)b));
+
+	return (~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) &
+		0xffff);
+}
+
+static inline void
+copy_sse2(unsigned char *dst, const unsigned char *src) {
+	_mm_storeu_si128((__m128i *)dst,
+			 fold_sse2(_mm_loadu_si128((const __m128i *)src)));
+}
+#endif /* NAME_SSE2 */
+
+#ifdef NAME_AVX2
+static bool caseless_initialized = false;
+static bool caseless_avx2 = false;
+static isc_once_t caseless_once = ISC_ONCE_INIT;
+
+static void
+caseless_initialize(void) {
+	__builtin_cpu_init();
+	caseless_avx2 = __builtin_cpu_supports("avx2");
+	caseless_initialized = true;
+}
+
+static inline bool
+use_avx2(void) {
+	if (ISC_UNLIKELY(!caseless_initialized)) {
+		RUNTIME_CHECK(isc_once_do(&caseless_once,
+					  caseless_initialize) ==
+			      ISC_R_SUCCESS);
+	}
+	return (caseless_avx2);
+}
+
+static inline __attribute__((target("avx2"))) __m256i
+fold_avx2(__m256i v) {
+	__m256i t = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - 'A')));
+	__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), t);
+
+	return (_mm256_or_si256(v, _mm256_and_si256(upper,
+						    _mm256_set1_epi8(0x20))));
+}
+
+static inline __attribute__((target("avx2"))) unsigned int
+diffmask_avx2(const unsigned char *a, const unsigned char *b) {
+	__m256i va = fold_avx2(_mm256_loadu_si256((const __m256i *)a));
+	__m256i vb = fold_avx2(_mm256_loadu_si256((const __m256i *)b));
+
+	return (~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va,
+								       vb)));
+}
+
+/*
+ * caseless_diff() and caseless_copy() for 'length' >= 32.
+ */
+static __attribute__((target("avx2"))) unsigned int
+caseless_diff_avx2(const unsigned char *a, const unsigned char *b,
+		   unsigned int length)
+{
+	unsigned int i, mask;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		mask = diffmask_avx2(a + i, b + i);
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+	}
+	if (i < length) {
+		i = length - 32;
+		mask = diffmask_avx2(a + i, b + i);
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+	}
+
+	return (length);
+}
+
+static __attribute__((target("avx2"))) void
+caseless_copy_avx2(unsigned char *dst, const unsigned char *src,
+		   unsigned int length)
+{
+	unsigned int i;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		_mm256_storeu_si256((__m256i *)(dst + i),
+			fold_avx2(_mm256_loadu_si256((const __m256i *)
+						     (src + i))));
+	}
+	if (i < length) {
+		i = length - 32;
+		_mm256_storeu_si256((__m256i *)(dst + i),
+			fold_avx2(_mm256_loadu_si256((const __m256i *)
+						     (src + i))));
+	}
+}
+#endif /* NAME_AVX2 */
+
+/*
+ * Return the offset of the first of the 'length' bytes at 'a' and 'b'
+ * which differ after case folding, or 'length' if they are all equal.
+ */
+static inline unsigned int
+caseless_diff(const unsigned char *a, const unsigned char *b,
+	      unsigned int length)
+{
+#ifdef NAME_SSE2
+	unsigned int i, mask;
+
+#ifdef NAME_AVX2
+	if (length >= 32 && use_avx2())
+		return (caseless_diff_avx2(a, b, length));
+#endif
+	if (length < 16)
+		return (caseless_diff_scalar(a, b, length));
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		mask = diffmask_sse2(a + i, b + i);
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+	}
+	if (i < length) {
+		i = length - 16;
+		mask = diffmask_sse2(a + i, b + i);
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+	}
+
+	return (length);
+#else
+	return (caseless_diff_scalar(a, b, length));
+#endif
+}
+
+/*
+ * Like caseless_diff() for the 'length' bytes of a label, where
+ * 'avail' >= 'length' bytes can safely be read at 'a' and 'b'.
+ */
+static inline unsigned int
+caseless_labeldiff(const unsigned char *a, const unsigned char *b,
+		   unsigned int length, unsigned int avail)
+{
+#ifdef NAME_SSE2
+	unsigned int mask;
+
+	/* Short labels are quicker to compare a byte at a time. */
+	if (length < 8)
+		return (caseless_diff_scalar(a, b, length));
+	if (length < 16 && avail >= 16) {
+		mask = diffmask_sse2(a, b) & ((1U << length) - 1);
+		return (mask != 0 ? (unsigned int)__builtin_ctz(mask) : length);
+	}
+#else
+	UNUSED(avail);
+#endif
+	return (caseless_diff(a, b, length));
+}
+
+/*
+ * Copy 'length' bytes from 'src' to 'dst', which may be equal but must
+ * not otherwise overlap, folding them to lower case.
+ */
+static inline void
+caseless_copy(unsigned char *dst, const unsigned char *src,
+	      unsigned int length)
+{
+#ifdef NAME_SSE2
+	unsigned int i;
+
+#ifdef NAME_AVX2
+	if (length >= 32 && use_avx2()) {
+		caseless_copy_avx2(dst, src, length);
+		return;
+	}
+#endif
+	if (length < 16) {
+		caseless_copy_scalar(dst, src, length);
+		return;
+	}
+
+	for (i = 0; i + 16 <= length; i += 16)
+		copy_sse2(dst + i, src + i);
+	if (i < length)
+		copy_sse2(dst + length - 16, src + length - 16);
+#else
+	caseless_copy_scalar(dst, src, length);
+#endif
+}
+
 /*%
  * Note that the name data must be a char array, not a string
  * literal, to avoid compiler warnings about discarding
@@ -487,8 +739,8 @@ dns_namereln_t
 dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		     int *orderp, unsigned int *nlabelsp)
 {
-	unsigned int l1, l2, l, count1, count2, count, nlabels;
-	int cdiff, ldiff, chdiff;
+	unsigned int l1, l2, l, count1, count2, count, nlabels, avail, i;
+	int cdiff, ldiff;
 	unsigned char *label1, *label2;
 	unsigned char *offsets1, *offsets2;
 	dns_offsets_t odata1, odata2;
@@ -544,6 +796,8 @@ dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		offsets2--;
 		label1 = &name1->ndata[*offsets1];
 		label2 = &name2->ndata[*offsets2];
+		avail = ISC_MIN(name1->length - *offsets1,
+				name2->length - *offsets2) - 1;
 		count1 = *label1++;
 		count2 = *label2++;
 
@@ -559,43 +813,11 @@ dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		else
 			count = count2;
 
-		/* Loop unrolled for performance */
-		while (ISC_LIKELY(count > 3)) {
-			chdiff = (int)maptolower[label1[0]] -
-				 (int)maptolower[label2[0]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[1]] -
-				 (int)maptolower[label2[1]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[2]] -
-				 (int)maptolower[label2[2]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[3]] -
-				 (int)maptolower[label2[3]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (ISC_LIKELY(count-- > 0)) {
-			chdiff = (int)maptolower[*label1++] -
-				 (int)maptolower[*label2++];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
+		i = caseless_labeldiff(label1, label2, count, avail);
+		if (i < count) {
+			*orderp = (int)maptolower[label1[i]] -
+				  (int)maptolower[label2[i]];
+			goto done;
 		}
 		if (cdiff != 0) {
 			*orderp = cdiff;
@@ -644,9 +866,6 @@ dns_name_compare(const dns_name_t *name1, const dns_name_t *name2) {
 
 bool
 dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l, count;
-	unsigned char c;
-	unsigned char *label1, *label2;
 
 	/*
 	 * Are 'name1' and 'name2' equal?
@@ -671,46 +890,15 @@ dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
 	if (name1->length != name2->length)
 		return (false);
 
-	l = name1->labels;
-
-	if (l != name2->labels)
+	if (name1->labels != name2->labels)
 		return (false);
 
-	label1 = name1->ndata;
-	label2 = name2->ndata;
-	while (ISC_LIKELY(l-- > 0)) {
-		count = *label1++;
-		if (count != *label2++)
-			return (false);
-
-		INSIST(count <= 63); /* no bitstring support */
-
-		/* Loop unrolled for performance */
-		while (ISC_LIKELY(count > 3)) {
-			c = maptolower[label1[0]];
-			if (c != maptolower[label2[0]])
-				return (false);
-			c = maptolower[label1[1]];
-			if (c != maptolower[label2[1]])
-				return (false);
-			c = maptolower[label1[2]];
-			if (c != maptolower[label2[2]])
-				return (false);
-			c = maptolower[label1[3]];
-			if (c != maptolower[label2[3]])
-				return (false);
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (ISC_LIKELY(count-- > 0)) {
-			c = maptolower[*label1++];
-			if (c != maptolower[*label2++])
-				return (false);
-		}
-	}
-
-	return (true);
+	/*
+	 * Label lengths are unaffected by case folding, so if the whole
+	 * of both names compare equal, so do their labels.
+	 */
+	return (caseless_diff(name1->ndata, name2->ndata,
+			      name1->length) == name1->length);
 }
 
 bool
@@ -744,9 +932,8 @@ dns_name_caseequal(const dns_name_t *name1, const dns_name_t *name2) {
 
 int
 dns_name_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l1, l2, l, count1, count2, count;
+	unsigned int length, i;
 	unsigned char c1, c2;
-	unsigned char *label1, *label2;
 
 	/*
 	 * Compare two absolute names as rdata.
@@ -759,43 +946,29 @@ dns_name_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
 	REQUIRE(name2->labels > 0);
 	REQUIRE((name2->attributes & DNS_NAMEATTR_ABSOLUTE) != 0);
 
-	l1 = name1->labels;
-	l2 = name2->labels;
-
-	l = (l1 < l2) ? l1 : l2;
-
-	label1 = name1->ndata;
-	label2 = name2->ndata;
-	while (l > 0) {
-		l--;
-		count1 = *label1++;
-		count2 = *label2++;
-
-		/* no bitstring support */
-		INSIST(count1 <= 63 && count2 <= 63);
-
-		if (count1 != count2)
-			return ((count1 < count2) ? -1 : 1);
-		count = count1;
-		while (count > 0) {
-			count--;
-			c1 = maptolower[*label1++];
-			c2 = maptolower[*label2++];
-			if (c1 < c2)
-				return (-1);
-			else if (c1 > c2)
-				return (1);
-		}
+	/*
+	 * The names are compared label by label from the left, first by
+	 * length and then by content.  Up to the first difference both
+	 * names have the same labels, so the first differing byte is
+	 * either a length byte in both or a content byte in both, and as
+	 * lengths are unaffected by case folding it is enough to find
+	 * the first byte that differs after folding.
+	 */
+	length = ISC_MIN(name1->length, name2->length);
+	i = caseless_diff(name1->ndata, name2->ndata, length);
+	if (i < length) {
+		c1 = maptolower[name1->ndata[i]];
+		c2 = maptolower[name2->ndata[i]];
+		return ((c1 < c2) ? -1 : 1);
 	}
 
 	/*
-	 * If one name had more labels than the other, their common
-	 * prefix must have been different because the shorter name
-	 * ended with the root label and the longer one can't have
-	 * a root label in the middle of it.  Therefore, if we get
-	 * to this point, the lengths must be equal.
+	 * If one name were longer than the other, their common prefix
+	 * would have been different because the shorter name ends with
+	 * the root label and the longer one can't have a root label in
+	 * the middle of it.
 	 */
-	INSIST(l1 == l2);
+	INSIST(name1->length == name2->length);
 
 	return (0);
 }
@@ -1625,8 +1798,7 @@ isc_result_t
 dns_name_downcase(const dns_name_t *source, dns_name_t *name,
 		  isc_buffer_t *target)
 {
-	unsigned char *sndata, *ndata;
-	unsigned int nlen, count, labels;
+	unsigned char *ndata;
 	isc_buffer_t buffer;
 
 	/*
@@ -1652,33 +1824,15 @@ dns_name_downcase(const dns_name_t *source, dns_name_t *name,
 		name->ndata = ndata;
 	}
 
-	sndata = source->ndata;
-	nlen = source->length;
-	labels = source->labels;
-
-	if (nlen > (target->length - target->used)) {
+	if (source->length > (target->length - target->used)) {
 		MAKE_EMPTY(name);
 		return (ISC_R_NOSPACE);
 	}
 
-	while (labels > 0 && nlen > 0) {
-		labels--;
-		count = *sndata++;
-		*ndata++ = count;
-		nlen--;
-		if (count < 64) {
-			INSIST(nlen >= count);
-			while (count > 0) {
-				*ndata++ = maptolower[(*sndata++)];
-				nlen--;
-				count--;
-			}
-		} else {
-			FATAL_ERROR(__FILE__, __LINE__,
-				    "Unexpected label type %02x", count);
-			/* Does not return. */
-		}
-	}
+	/*
+	 * Label lengths are unaffected by case folding.
+	 */
+	caseless_copy(ndata, source->ndata, source->length);
 
 	if (source != name) {
 		name->labels = source->labels;
@@ -19,6 +19,7 @@
 #include <stdbool.h>
 
 #include <isc/crc64.h>
+#include <isc/drwlock.h>
 #include <isc/event.h>
 #include <isc/heap.h>
 #include <isc/file.h>
@@ -140,41 +141,35 @@ typedef uint32_t                    rbtdb_rdatatype_t;
 #define RBTDB_UNLOCK(l, t)      RWUNLOCK((l), (t))
 
 /*
- * Since node locking is sensitive to both performance and memory footprint,
- * we need some trick here.  If we have both high-performance rwlock and
- * high performance and small-memory reference counters, we use rwlock for
- * node lock and isc_refcount for node references.  In this case, we don't have
- * to protect the access to the counters by locks.
- * Otherwise, we simply use ordinary mutex lock for node locking, and use
- * simple integers as reference counters which is protected by the lock.
- * In most cases, we can simply use wrapper macros such as NODE_LOCK and
- * NODE_UNLOCK.  In some other cases, however, we need to protect reference
- * counters first and then protect other parts of a node as read-only data.
- * Special additional macros, NODE_STRONGLOCK(), NODE_WEAKLOCK(), etc, are also
- * provided for these special cases.  When we can use the efficient backend
- * routines, we should only protect the "other members" by NODE_WEAKLOCK(read).
- * Otherwise, we should use NODE_STRONGLOCK() to protect the entire critical
- * section including the access to the reference counter.
- * Note that we cannot use NODE_LOCK()/NODE_UNLOCK() wherever the protected
- * section is also protected by NODE_STRONGLOCK().
+ * The tree lock and the node locks are distributed reader-writer locks
+ * (see isc/drwlock.h): in a cache database, where lookups from every
+ * worker thread land on the same few hot nodes, a reader only touches a
+ * per-CPU counter, so concurrent lookups do not contend on the lock's
+ * cache lines.  Zone databases, which may be numerous, give each lock a
+ * single reader slot to keep their footprint small.  Node reference
+ * counts are isc_refcount_t, so they can be updated under a read lock.
  */
-typedef isc_rwlock_t nodelock_t;
-
-#define NODE_INITLOCK(l)        isc_rwlock_init((l), 0, 0)
-#define NODE_DESTROYLOCK(l)     isc_rwlock_destroy(l)
-#define NODE_LOCK(l, t)         RWLOCK((l), (t))
-#define NODE_UNLOCK(l, t)       RWUNLOCK((l), (t))
-#define NODE_TRYUPGRADE(l)      isc_rwlock_tryupgrade(l)
-#define NODE_DOWNGRADE(l)   isc_rwlock_downgrade(l)
+#define TREE_LOCK(l, t) \
+	RUNTIME_CHECK(isc_drwlock_lock((l), (t)) == ISC_R_SUCCESS)
+#define TREE_UNLOCK(l, t) \
+	RUNTIME_CHECK(isc_drwlock_unlock((l), (t)) == ISC_R_SUCCESS)
+
+typedef isc_drwlock_t nodelock_t;
+
+#define NODE_INITLOCK(l, m, n)  isc_drwlock_init((l), (m), (n))
+#define NODE_DESTROYLOCK(l)     isc_drwlock_destroy(l)
+#define NODE_LOCK(l, t) \
+	RUNTIME_CHECK(isc_drwlock_lock((l), (t)) == ISC_R_SUCCESS)
+#define NODE_UNLOCK(l, t) \
+	RUNTIME_CHECK(isc_drwlock_unlock((l), (t)) == ISC_R_SUCCESS)
+#define NODE_TRYUPGRADE(l)      isc_drwlock_tryupgrade(l)
+#define NODE_DOWNGRADE(l)       isc_drwlock_downgrade(l)
 
 /*%
- * Whether to rate-limit updating the LRU to avoid possible thread contention.
- * Our performance measurement has shown the cost is marginal, so it's defined
- * to be 0 by default either with or without threads.
+ * How many recently used headers overmem_purge() may pass over in one
+ * LRU list before it purges one anyway.
  */
-#ifndef DNS_RBTDB_LIMITLRUUPDATE
-#define DNS_RBTDB_LIMITLRUUPDATE 0
-#endif
+#define RBTDB_LRU_SCAN 32
 
 /*
  * Allow clients with a virtual time of up to 5 minutes in the past to see
@@ -233,7 +228,11 @@ typedef struct rdatasetheader {
 	 */
 
 	dns_rbtnode_t                   *node;
-	isc_stdtime_t                   last_used;
+	atomic_uint_fast32_t            last_used;
+	/*%<
+	 * Time of the last cache hit since overmem_purge() last looked at
+	 * this header, or 0.  Set by readers with a relaxed store.
+	 */
 	ISC_LINK(struct rdatasetheader) link;
 
 	unsigned int                    heap_index;
@@ -426,7 +425,7 @@ struct dns_rbtdb {
 	/* Locks the data in this struct */
 	isc_rwlock_t                    lock;
 	/* Locks the tree structure (prevents nodes appearing/disappearing) */
-	isc_rwlock_t                    tree_lock;
+	isc_drwlock_t                   tree_lock;
 	/* Locks for individual tree nodes */
 	unsigned int                    node_lock_count;
 	rbtdb_nodelock_t *              node_locks;
@@ -539,10 +538,8 @@ static isc_result_t rdataset_getclosest(dns_rdataset_t *rdataset,
 					dns_name_t *name,
 					dns_rdataset_t *neg,
 					dns_rdataset_t *negsig);
-static inline bool need_headerupdate(rdatasetheader_t *header,
-					      isc_stdtime_t now);
-static void update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
-			  isc_stdtime_t now);
+static inline void touch_header(rdatasetheader_t *header,
+				isc_stdtime_t now);
 static void expire_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
 			  bool tree_locked, expire_t reason);
 static void overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
@@ -1093,7 +1090,7 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 
 	isc_mem_put(rbtdb->common.mctx, rbtdb->node_locks,
 		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
-	isc_rwlock_destroy(&rbtdb->tree_lock);
+	isc_drwlock_destroy(&rbtdb->tree_lock);
 	isc_refcount_destroy(&rbtdb->references);
 	if (rbtdb->task != NULL)
 		isc_task_detach(&rbtdb->task);
@@ -1981,9 +1978,9 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		 * we only do a trylock.
 		 */
 		if (tlock == isc_rwlocktype_read)
-			result = isc_rwlock_tryupgrade(&rbtdb->tree_lock);
+			result = isc_drwlock_tryupgrade(&rbtdb->tree_lock);
 		else
-			result = isc_rwlock_trylock(&rbtdb->tree_lock,
+			result = isc_drwlock_trylock(&rbtdb->tree_lock,
 						    isc_rwlocktype_write);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS ||
 			      result == ISC_R_LOCKBUSY);
@@ -2077,11 +2074,11 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	 */
 	if (tlock == isc_rwlocktype_none)
 		if (write_locked)
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	if (tlock == isc_rwlocktype_read)
 		if (write_locked)
-			isc_rwlock_downgrade(&rbtdb->tree_lock);
+			isc_drwlock_downgrade(&rbtdb->tree_lock);
 
 	return (no_reference);
 }
@@ -2104,7 +2101,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 
 	isc_event_free(&event);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	locknum = node->locknum;
 	NODE_LOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
 	do {
@@ -2144,7 +2141,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 		node = parent;
 	} while (node != NULL);
 	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	detach((dns_db_t **)&rbtdb);
 }
@@ -2262,7 +2259,7 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
 	unsigned int count, length;
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	version->havensec3 = false;
 	node = rbtdb->origin_node;
 	NODE_LOCK(&(rbtdb->node_locks[node->locknum].lock),
@@ -2339,7 +2336,7 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
  unlock:
 	NODE_UNLOCK(&(rbtdb->node_locks[node->locknum].lock),
 		    isc_rwlocktype_read);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 }
 
 static void
@@ -2348,7 +2345,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	bool again = false;
 	unsigned int locknum;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	for (locknum = 0; locknum < rbtdb->node_lock_count; locknum++) {
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
 			  isc_rwlocktype_write);
@@ -2358,7 +2355,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 			    isc_rwlocktype_write);
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	if (again)
 		isc_task_send(task, &event);
 	else {
@@ -2598,7 +2595,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 			 * expensive, but this event should be rare enough
 			 * to justify the cost.
 			 */
-			RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 			tlock = isc_rwlocktype_write;
 		}
 
@@ -2634,7 +2631,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 			isc_refcount_increment(&rbtdb->references);
 			isc_task_send(rbtdb->task, &event);
 		} else
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
 
  end:
@@ -2719,11 +2716,11 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 	INSIST(tree == rbtdb->tree || tree == rbtdb->nsec3);
 
 	dns_name_init(&nodename, NULL);
-	RWLOCK(&rbtdb->tree_lock, locktype);
+	TREE_LOCK(&rbtdb->tree_lock, locktype);
 	result = dns_rbt_findnode(tree, name, NULL, &node, NULL,
 				  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
 	if (result != ISC_R_SUCCESS) {
-		RWUNLOCK(&rbtdb->tree_lock, locktype);
+		TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 		if (!create) {
 			if (result == DNS_R_PARTIALMATCH)
 				result = ISC_R_NOTFOUND;
@@ -2734,7 +2731,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 		 * unlocking then relocking.
 		 */
 		locktype = isc_rwlocktype_write;
-		RWLOCK(&rbtdb->tree_lock, locktype);
+		TREE_LOCK(&rbtdb->tree_lock, locktype);
 		node = NULL;
 		result = dns_rbt_addnode(tree, name, &node);
 		if (result == ISC_R_SUCCESS) {
@@ -2747,7 +2744,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 					result = add_wildcard_magic(rbtdb,
 								    name);
 					if (result != ISC_R_SUCCESS) {
-						RWUNLOCK(&rbtdb->tree_lock,
+						TREE_UNLOCK(&rbtdb->tree_lock,
 							 locktype);
 						return (result);
 					}
@@ -2756,7 +2753,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 			if (tree == rbtdb->nsec3)
 				node->nsec = DNS_RBT_NSEC_NSEC3;
 		} else if (result != ISC_R_EXISTS) {
-			RWUNLOCK(&rbtdb->tree_lock, locktype);
+			TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 			return (result);
 		}
 	}
@@ -2766,7 +2763,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 
 	reactivate_node(rbtdb, node, locktype);
 
-	RWUNLOCK(&rbtdb->tree_lock, locktype);
+	TREE_UNLOCK(&rbtdb->tree_lock, locktype);
 
 	*nodep = (dns_dbnode_t *)node;
 
@@ -3854,7 +3851,7 @@ zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	 */
 	wild = false;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -4278,7 +4275,7 @@ zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	NODE_UNLOCK(lock, isc_rwlocktype_read);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -4562,24 +4559,9 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 			if (foundsig != NULL)
 				bind_rdataset(search->rbtdb, node, foundsig,
 					      search->now, sigrdataset);
-			if (need_headerupdate(found, search->now) ||
-			    (foundsig != NULL &&
-			     need_headerupdate(foundsig, search->now))) {
-				if (locktype != isc_rwlocktype_write) {
-					NODE_UNLOCK(lock, locktype);
-					NODE_LOCK(lock, isc_rwlocktype_write);
-					locktype = isc_rwlocktype_write;
-					POST(locktype);
-				}
-				if (need_headerupdate(found, search->now))
-					update_header(search->rbtdb, found,
-						      search->now);
-				if (foundsig != NULL &&
-				    need_headerupdate(foundsig, search->now)) {
-					update_header(search->rbtdb, foundsig,
-						      search->now);
-				}
-			}
+			touch_header(found, search->now);
+			if (foundsig != NULL)
+				touch_header(foundsig, search->now);
 		}
 
 	node_exit:
@@ -4596,91 +4578,131 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 	return (result);
 }
 
+/*
+ * Find the NSEC record which may cover 'name', for use in synthesizing
+ * negative answers from the cache.
+ *
+ * The auxiliary NSEC tree holds the owner names of all cached NSEC
+ * records in DNSSEC order, so the closest preceding NSEC owner is found
+ * directly, however many other names sort between it and 'name' in the
+ * main tree.  Whether the NSEC actually covers 'name' is left to the
+ * caller.
+ */
 static isc_result_t
-find_coveringnsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
-		  isc_stdtime_t now, dns_name_t *foundname,
-		  dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+find_coveringnsec(rbtdb_search_t *search, const dns_name_t *name,
+		  dns_dbnode_t **nodep, isc_stdtime_t now,
+		  dns_name_t *foundname, dns_rdataset_t *rdataset,
+		  dns_rdataset_t *sigrdataset)
 {
 	dns_rbtnode_t *node;
 	rdatasetheader_t *header, *header_next, *header_prev;
 	rdatasetheader_t *found, *foundsig;
-	bool empty_node;
 	isc_result_t result;
-	dns_fixedname_t fname, forigin;
-	dns_name_t *name, *origin;
+	dns_fixedname_t fprefix, forigin, ftarget;
+	dns_name_t *prefix, *origin, *target;
 	rbtdb_rdatatype_t matchtype, sigmatchtype;
 	nodelock_t *lock;
 	isc_rwlocktype_t locktype;
 	dns_rbtnodechain_t chain;
 
-	chain = search->chain;
-
 	matchtype = RBTDB_RDATATYPE_VALUE(dns_rdatatype_nsec, 0);
 	sigmatchtype = RBTDB_RDATATYPE_VALUE(dns_rdatatype_rrsig,
 					     dns_rdatatype_nsec);
 
-	do {
+	prefix = dns_fixedname_initname(&fprefix);
+	origin = dns_fixedname_initname(&forigin);
+	target = dns_fixedname_initname(&ftarget);
+
+	/*
+	 * Nodes in the auxiliary tree carry no data, so this never
+	 * matches exactly and leaves the chain at the predecessor of
+	 * 'name' (or at an interior node named 'name', which is skipped
+	 * below).
+	 */
+	dns_rbtnodechain_init(&chain, NULL);
+	node = NULL;
+	result = dns_rbt_findnode(search->rbtdb->nsec, name, NULL, &node,
+				  &chain, DNS_RBTFIND_NOOPTIONS, NULL, NULL);
+	if (result != ISC_R_NOTFOUND && result != DNS_R_PARTIALMATCH) {
+		dns_rbtnodechain_invalidate(&chain);
+		return (ISC_R_NOTFOUND);
+	}
+
+	for (;;) {
 		node = NULL;
-		name = dns_fixedname_initname(&fname);
-		origin = dns_fixedname_initname(&forigin);
-		result = dns_rbtnodechain_current(&chain, name, origin, &node);
+		result = dns_rbtnodechain_current(&chain, prefix, origin,
+						  &node);
+		if (result == ISC_R_SUCCESS)
+			result = dns_name_concatenate(prefix, origin,
+						      target, NULL);
 		if (result != ISC_R_SUCCESS)
-			return (result);
-		locktype = isc_rwlocktype_read;
-		lock = &(search->rbtdb->node_locks[node->locknum].lock);
-		NODE_LOCK(lock, locktype);
-		found = NULL;
-		foundsig = NULL;
-		empty_node = true;
-		header_prev = NULL;
-		for (header = node->data; header != NULL; header = header_next)
+			goto done;
+
+		/*
+		 * Interior nodes of the auxiliary tree, and nodes awaiting
+		 * deletion, have no counterpart holding data in the main
+		 * tree; step back over them.
+		 */
+		if (!dns_name_equal(target, name)) {
+			node = NULL;
+			result = dns_rbt_findnode(search->rbtdb->tree, target,
+						  NULL, &node, NULL,
+						  DNS_RBTFIND_NOOPTIONS,
+						  NULL, NULL);
+			if (result == ISC_R_SUCCESS)
+				break;
+		}
+
+		result = dns_rbtnodechain_prev(&chain, NULL, NULL);
+		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN)
+			goto done;
+	}
+
+	/*
+	 * Only the closest NSEC owner can cover 'name'; if its NSEC has
+	 * gone, there is nothing to synthesize from.
+	 */
+	locktype = isc_rwlocktype_read;
+	lock = &(search->rbtdb->node_locks[node->locknum].lock);
+	NODE_LOCK(lock, locktype);
+	found = NULL;
+	foundsig = NULL;
+	header_prev = NULL;
+	for (header = node->data; header != NULL; header = header_next) {
+		header_next = header->next;
+		if (check_stale_header(node, header, &locktype, lock, search,
+				       &header_prev))
 		{
-			header_next = header->next;
-			if (check_stale_header(node, header,
-					       &locktype, lock, search,
-					       &header_prev)) {
-				continue;
-			}
-			if (NONEXISTENT(header) ||
-			    RBTDB_RDATATYPE_BASE(header->type) == 0) {
-				header_prev = header;
-				continue;
-			}
-			/*
-			 * Don't stop on provable noqname / RRSIG.
-			 */
-			if (header->noqname == NULL &&
-			    RBTDB_RDATATYPE_BASE(header->type)
-			     != dns_rdatatype_rrsig)
-			{
-				empty_node = false;
-			}
-			if (header->type == matchtype)
-				found = header;
-			else if (header->type == sigmatchtype)
-				foundsig = header;
+			continue;
+		}
+		if (NONEXISTENT(header) ||
+		    RBTDB_RDATATYPE_BASE(header->type) == 0) {
 			header_prev = header;
+			continue;
 		}
-		if (found != NULL) {
-			result = dns_name_concatenate(name, origin,
-						      foundname, NULL);
-			if (result != ISC_R_SUCCESS)
-				goto unlock_node;
-			bind_rdataset(search->rbtdb, node, found,
-				      now, rdataset);
-			if (foundsig != NULL)
-				bind_rdataset(search->rbtdb, node, foundsig,
-					      now, sigrdataset);
-			new_reference(search->rbtdb, node);
-			*nodep = node;
-			result = DNS_R_COVERINGNSEC;
-		} else if (!empty_node) {
-			result = ISC_R_NOTFOUND;
-		} else
-			result = dns_rbtnodechain_prev(&chain, NULL, NULL);
+		if (header->type == matchtype)
+			found = header;
+		else if (header->type == sigmatchtype)
+			foundsig = header;
+		header_prev = header;
+	}
+	if (found != NULL) {
+		result = dns_name_copy(target, foundname, NULL);
+		if (result != ISC_R_SUCCESS)
+			goto unlock_node;
+		bind_rdataset(search->rbtdb, node, found, now, rdataset);
+		if (foundsig != NULL)
+			bind_rdataset(search->rbtdb, node, foundsig,
+				      now, sigrdataset);
+		new_reference(search->rbtdb, node);
+		*nodep = node;
+		result = DNS_R_COVERINGNSEC;
+	} else
+		result = ISC_R_NOTFOUND;
  unlock_node:
-		NODE_UNLOCK(lock, locktype);
-	} while (empty_node && result == ISC_R_SUCCESS);
+	NODE_UNLOCK(lock, locktype);
+ done:
+	dns_rbtnodechain_invalidate(&chain);
 	return (result);
 }
 
@@ -4700,7 +4722,6 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	rdatasetheader_t *header, *header_prev, *header_next;
 	rdatasetheader_t *found, *nsheader;
 	rdatasetheader_t *foundsig, *nssig, *cnamesig;
-	rdatasetheader_t *update, *updatesig;
 	rdatasetheader_t *nsecheader, *nsecsig;
 	rbtdb_rdatatype_t sigtype, negtype;
 
@@ -4724,10 +4745,8 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	dns_fixedname_init(&search.zonecut_name);
 	dns_rbtnodechain_init(&search.chain, search.rbtdb->common.mctx);
 	search.now = now;
-	update = NULL;
-	updatesig = NULL;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -4740,7 +4759,7 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 
 	if (result == DNS_R_PARTIALMATCH) {
 		if ((search.options & DNS_DBFIND_COVERINGNSEC) != 0) {
-			result = find_coveringnsec(&search, nodep, now,
+			result = find_coveringnsec(&search, name, nodep, now,
 						   foundname, rdataset,
 						   sigrdataset);
 			if (result == DNS_R_COVERINGNSEC)
@@ -4900,13 +4919,11 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsecheader,
 				      search.now, rdataset);
-			if (need_headerupdate(nsecheader, search.now))
-				update = nsecheader;
+			touch_header(nsecheader, search.now);
 			if (nsecsig != NULL) {
 				bind_rdataset(search.rbtdb, node, nsecsig,
 					      search.now, sigrdataset);
-				if (need_headerupdate(nsecsig, search.now))
-					updatesig = nsecsig;
+				touch_header(nsecsig, search.now);
 			}
 			result = DNS_R_COVERINGNSEC;
 			goto node_exit;
@@ -4924,13 +4941,11 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsheader, search.now,
 				      rdataset);
-			if (need_headerupdate(nsheader, search.now))
-				update = nsheader;
+			touch_header(nsheader, search.now);
 			if (nssig != NULL) {
 				bind_rdataset(search.rbtdb, node, nssig,
 					      search.now, sigrdataset);
-				if (need_headerupdate(nssig, search.now))
-					updatesig = nssig;
+				touch_header(nssig, search.now);
 			}
 			result = DNS_R_DELEGATION;
 			goto node_exit;
@@ -4981,33 +4996,19 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	    result == DNS_R_NCACHENXRRSET) {
 		bind_rdataset(search.rbtdb, node, found, search.now,
 			      rdataset);
-		if (need_headerupdate(found, search.now))
-			update = found;
+		touch_header(found, search.now);
 		if (!NEGATIVE(found) && foundsig != NULL) {
 			bind_rdataset(search.rbtdb, node, foundsig, search.now,
 				      sigrdataset);
-			if (need_headerupdate(foundsig, search.now))
-				updatesig = foundsig;
+			touch_header(foundsig, search.now);
 		}
 	}
 
  node_exit:
-	if ((update != NULL || updatesig != NULL) &&
-	    locktype != isc_rwlocktype_write) {
-		NODE_UNLOCK(lock, locktype);
-		NODE_LOCK(lock, isc_rwlocktype_write);
-		locktype = isc_rwlocktype_write;
-		POST(locktype);
-	}
-	if (update != NULL && need_headerupdate(update, search.now))
-		update_header(search.rbtdb, update, search.now);
-	if (updatesig != NULL && need_headerupdate(updatesig, search.now))
-		update_header(search.rbtdb, updatesig, search.now);
-
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -5067,7 +5068,7 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	if ((options & DNS_DBFIND_NOEXACT) != 0)
 		rbtoptions |= DNS_RBTFIND_NOEXACT;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.
@@ -5143,26 +5144,14 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 		bind_rdataset(search.rbtdb, node, foundsig, search.now,
 			      sigrdataset);
 
-	if (need_headerupdate(found, search.now) ||
-	    (foundsig != NULL &&  need_headerupdate(foundsig, search.now))) {
-		if (locktype != isc_rwlocktype_write) {
-			NODE_UNLOCK(lock, locktype);
-			NODE_LOCK(lock, isc_rwlocktype_write);
-			locktype = isc_rwlocktype_write;
-			POST(locktype);
-		}
-		if (need_headerupdate(found, search.now))
-			update_header(search.rbtdb, found, search.now);
-		if (foundsig != NULL &&
-		    need_headerupdate(foundsig, search.now)) {
-			update_header(search.rbtdb, foundsig, search.now);
-		}
-	}
+	touch_header(found, search.now);
+	if (foundsig != NULL)
+		touch_header(foundsig, search.now);
 
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	INSIST(!search.need_cleanup);
 
@@ -6471,9 +6460,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		return (result);
 
 	name = dns_fixedname_initname(&fixed);
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	dns_rbt_fullnamefromnode(node, name);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	dns_rdataset_getownercase(rdataset, name);
 
 	newheader = (rdatasetheader_t *)region.base;
@@ -6489,7 +6478,12 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->closest = NULL;
 	newheader->count = init_count++;
 	newheader->trust = rdataset->trust;
-	newheader->last_used = now;
+	/*
+	 * A new header starts at the head of the LRU list, so it has a
+	 * full lap of the CLOCK before it can be purged; it needs no
+	 * second chance on top of that.
+	 */
+	atomic_init(&newheader->last_used, 0);
 	newheader->node = rbtnode;
 	if (rbtversion != NULL) {
 		newheader->serial = rbtversion->serial;
@@ -6563,7 +6557,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		cache_is_overmem = true;
 	if (delegating || newnsec || cache_is_overmem) {
 		tree_locked = true;
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
 
 	if (cache_is_overmem)
@@ -6592,7 +6586,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		 * node lock.
 		 */
 		if (tree_locked && !delegating && !newnsec) {
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 			tree_locked = false;
 		}
 	}
@@ -6623,7 +6617,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		    isc_rwlocktype_write);
 
 	if (tree_locked)
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 
 	/*
 	 * Update the zone's secure status.  If version is non-NULL
@@ -6675,7 +6669,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
-	newheader->last_used = 0;
+	atomic_init(&newheader->last_used, 0);
 	newheader->node = rbtnode;
 	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
 		newheader->attributes |= RDATASET_ATTR_RESIGN;
@@ -6785,7 +6779,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			newheader->node = rbtnode;
 			newheader->resign = 0;
 			newheader->resign_lsb = 0;
-			newheader->last_used = 0;
+			atomic_init(&newheader->last_used, 0);
 		} else {
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			goto unlock;
@@ -6873,7 +6867,7 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	else
 		newheader->serial = 0;
 	newheader->count = 0;
-	newheader->last_used = 0;
+	atomic_init(&newheader->last_used, 0);
 	newheader->node = rbtnode;
 
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
@@ -7059,7 +7053,7 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
-	newheader->last_used = 0;
+	atomic_init(&newheader->last_used, 0);
 	newheader->node = node;
 	setownercase(newheader, name);
 
@@ -7588,9 +7582,9 @@ issecure(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	secure = (rbtdb->current_version->secure == dns_db_secure);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (secure);
 }
@@ -7604,9 +7598,9 @@ isdnssec(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	dnssec = (rbtdb->current_version->secure != dns_db_insecure);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (dnssec);
 }
@@ -7620,9 +7614,9 @@ nodecount(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	count = dns_rbt_nodecount(rbtdb->tree);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (count);
 }
@@ -7636,9 +7630,9 @@ hashsize(dns_db_t *db) {
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	size = dns_rbt_hashsize(rbtdb->tree);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (size);
 }
@@ -7702,7 +7696,7 @@ getnsec3parameters(dns_db_t *db, dns_dbversion_t *version, dns_hash_t *hash,
 	REQUIRE(VALID_RBTDB(rbtdb));
 	INSIST(rbtversion == NULL || rbtversion->rbtdb == rbtdb);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	if (rbtversion == NULL)
 		rbtversion = rbtdb->current_version;
@@ -7723,7 +7717,7 @@ getnsec3parameters(dns_db_t *db, dns_dbversion_t *version, dns_hash_t *hash,
 			*flags = rbtversion->flags;
 		result = ISC_R_SUCCESS;
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (result);
 }
@@ -7816,7 +7810,7 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	for (i = 0; i < rbtdb->node_lock_count; i++) {
 		NODE_LOCK(&rbtdb->node_locks[i].lock, isc_rwlocktype_read);
@@ -7852,7 +7846,7 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 	result = ISC_R_SUCCESS;
 
  unlock:
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (result);
 }
@@ -7882,7 +7876,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	if (header->heap_index == 0)
 		return;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	NODE_LOCK(&rbtdb->node_locks[node->locknum].lock,
 		  isc_rwlocktype_write);
 	/*
@@ -7892,7 +7886,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	resign_delete(rbtdb, rbtversion, header);
 	NODE_UNLOCK(&rbtdb->node_locks[node->locknum].lock,
 		    isc_rwlocktype_write);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 }
 
 static isc_result_t
@@ -7939,9 +7933,9 @@ nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
 	REQUIRE(node != NULL);
 	REQUIRE(name != NULL);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	result = dns_rbt_fullnamefromnode(rbtnode, name);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 
 	return (result);
 }
@@ -8083,6 +8077,7 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	dns_name_t name;
 	bool (*sooner)(void *, void *);
 	isc_mem_t *hmctx = mctx;
+	unsigned int lockslots;
 
 	/* Keep the compiler happy. */
 	UNUSED(driverarg);
@@ -8117,7 +8112,11 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbtdb;
 
-	result = isc_rwlock_init(&rbtdb->tree_lock, 0, 0);
+	/*
+	 * Caches get a reader slot per CPU in each lock; zones get one.
+	 */
+	lockslots = IS_CACHE(rbtdb) ? 0 : 1;
+	result = isc_drwlock_init(&rbtdb->tree_lock, mctx, lockslots);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_lock;
 
@@ -8197,7 +8196,8 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	rbtdb->active = rbtdb->node_lock_count;
 
 	for (i = 0; i < (int)(rbtdb->node_lock_count); i++) {
-		result = NODE_INITLOCK(&rbtdb->node_locks[i].lock);
+		result = NODE_INITLOCK(&rbtdb->node_locks[i].lock, mctx,
+				       lockslots);
 		if (result == ISC_R_SUCCESS) {
 			isc_refcount_init(&rbtdb->node_locks[i].references, 0);
 		}
@@ -8390,7 +8390,7 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
 
  cleanup_tree_lock:
-	isc_rwlock_destroy(&rbtdb->tree_lock);
+	isc_drwlock_destroy(&rbtdb->tree_lock);
 
  cleanup_lock:
 	RBTDB_DESTROYLOCK(&rbtdb->lock);
@@ -8913,10 +8913,10 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 			      dns_rbt_nodecount(rbtdb->tree));
 
 		if (rbtdbiter->tree_locked == isc_rwlocktype_read) {
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+			TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 			was_read_locked = true;
 		}
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 		rbtdbiter->tree_locked = isc_rwlocktype_write;
 
 		for (i = 0; i < rbtdbiter->delcnt; i++) {
@@ -8932,9 +8932,9 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 
 		rbtdbiter->delcnt = 0;
 
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 		if (was_read_locked) {
-			RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+			TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 			rbtdbiter->tree_locked = isc_rwlocktype_read;
 
 		} else {
@@ -8950,7 +8950,7 @@ resume_iteration(rbtdb_dbiterator_t *rbtdbiter) {
 	REQUIRE(rbtdbiter->paused);
 	REQUIRE(rbtdbiter->tree_locked == isc_rwlocktype_none);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	TREE_LOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 	rbtdbiter->tree_locked = isc_rwlocktype_read;
 
 	rbtdbiter->paused = false;
@@ -8963,7 +8963,7 @@ dbiterator_destroy(dns_dbiterator_t **iteratorp) {
 	dns_db_t *db = NULL;
 
 	if (rbtdbiter->tree_locked == isc_rwlocktype_read) {
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 		rbtdbiter->tree_locked = isc_rwlocktype_none;
 	} else
 		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_none);
@@ -9332,7 +9332,7 @@ dbiterator_pause(dns_dbiterator_t *iterator) {
 
 	if (rbtdbiter->tree_locked != isc_rwlocktype_none) {
 		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_read);
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		TREE_UNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 		rbtdbiter->tree_locked = isc_rwlocktype_none;
 	}
 
@@ -10074,70 +10074,28 @@ no_glue:
  */
 
 /*%
- * See if a given cache entry that is being reused needs to be updated
- * in the LRU-list.  From the LRU management point of view, this function is
- * expected to return true for almost all cases.  When used with threads,
- * however, this may cause a non-negligible performance penalty because a
- * writer lock will have to be acquired before updating the list.
- * If DNS_RBTDB_LIMITLRUUPDATE is defined to be non 0 at compilation time, this
- * function returns true if the entry has not been updated for some period of
- * time.  We differentiate the NS or glue address case and the others since
- * experiments have shown that the former tends to be accessed relatively
- * infrequently and the cost of cache miss is higher (e.g., a missing NS records
- * may cause external queries at a higher level zone, involving more
- * transactions).
+ * Record a cache hit on 'header' for overmem_purge(), which gives headers
+ * used since it last looked at them a second chance.  This only stores
+ * the current time in the header, and not even that if the time is
+ * already there, so a hit needs no write lock and a hot header's cache
+ * line is not dirtied on every hit.
  *
  * Caller must hold the node (read or write) lock.
  */
-static inline bool
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
+static inline void
+touch_header(rdatasetheader_t *header, isc_stdtime_t now) {
 	if ((header->attributes &
 	     (RDATASET_ATTR_NONEXISTENT |
 	      RDATASET_ATTR_ANCIENT |
 	      RDATASET_ATTR_ZEROTTL)) != 0)
-		return (false);
+		return;
 
-#if DNS_RBTDB_LIMITLRUUPDATE
-	if (header->type == dns_rdatatype_ns ||
-	    (header->trust == dns_trust_glue &&
-	     (header->type == dns_rdatatype_a ||
-	      header->type == dns_rdatatype_aaaa))) {
-		/*
-		 * Glue records are updated if at least 60 seconds have passed
-		 * since the previous update time.
-		 */
-		return (header->last_used + 60 <= now);
+	if (atomic_load_explicit(&header->last_used,
+				 memory_order_relaxed) != now)
+	{
+		atomic_store_explicit(&header->last_used, now,
+				      memory_order_relaxed);
 	}
-
-	/* Other records are updated if 5 minutes have passed. */
-	return (header->last_used + 300 <= now);
-#else
-	UNUSED(now);
-
-	return (true);
-#endif
-}
-
-/*%
- * Update the timestamp of a given cache entry and move it to the head
- * of the corresponding LRU list.
- *
- * Caller must hold the node (write) lock.
- *
- * Note that the we do NOT touch the heap here, as the TTL has not changed.
- */
-static void
-update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
-	      isc_stdtime_t now)
-{
-	INSIST(IS_CACHE(rbtdb));
-
-	/* To be checked: can we really assume this? XXXMLG */
-	INSIST(ISC_LINK_LINKED(header, link));
-
-	ISC_LIST_UNLINK(rbtdb->rdatasets[header->node->locknum], header, link);
-	header->last_used = now;
-	ISC_LIST_PREPEND(rbtdb->rdatasets[header->node->locknum], header, link);
 }
 
 /*%
@@ -10149,13 +10107,20 @@ update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
  * entries of the same name of different RR types while adding RRsets from a
  * single response (consider the case where we're adding A and AAAA glue records
  * of the same NS name).
+ *
+ * Each LRU list works as a CLOCK whose hand is the tail of the list: a
+ * header that has been used since the hand last reached it is moved to
+ * the head with its use cleared, and the first one that has not is purged.
+ * After passing over RBTDB_LRU_SCAN used headers in one list we purge the
+ * next one regardless, so that every call makes progress.
  */
 static void
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
 	      isc_stdtime_t now, bool tree_locked)
 {
-	rdatasetheader_t *header, *header_prev;
+	rdatasetheader_t *header, *header_prev, *spared;
 	unsigned int locknum;
+	unsigned int scanned;
 	int purgecount = 2;
 
 	for (locknum = (locknum_start + 1) % rbtdb->node_lock_count;
@@ -10171,10 +10136,29 @@ overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
 			purgecount--;
 		}
 
+		/*
+		 * 'spared' is the first header given a second chance; if
+		 * we come round to it again, every header left in the list
+		 * has been used, so move on to the next list.
+		 */
+		spared = NULL;
+		scanned = 0;
 		for (header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
-		     header != NULL && purgecount > 0;
+		     header != NULL && header != spared && purgecount > 0;
 		     header = header_prev) {
 			header_prev = ISC_LIST_PREV(header, link);
+			if (atomic_exchange_explicit(&header->last_used, 0,
+						     memory_order_relaxed) != 0 &&
+			    scanned++ < RBTDB_LRU_SCAN)
+			{
+				ISC_LIST_UNLINK(rbtdb->rdatasets[locknum],
+						header, link);
+				ISC_LIST_PREPEND(rbtdb->rdatasets[locknum],
+						 header, link);
+				if (spared == NULL)
+					spared = header;
+				continue;
+			}
 			/*
 			 * Unlink the entry at this point to avoid checking it
 			 * again even if it's currently used someone else and
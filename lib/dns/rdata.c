@@ -2325,6 +2325,42 @@ dns_rdatatype_isknown(dns_rdatatype_t type) {
 	return (false);
 }
 
+bool
+dns_rdatatype_towirecopy(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	switch (type) {
+	case dns_rdatatype_a:
+	case dns_rdatatype_aaaa:
+	case dns_rdatatype_dhcid:
+		/* CH A contains a domain name. */
+		return (rdclass == dns_rdataclass_in);
+	case dns_rdatatype_hinfo:
+	case dns_rdatatype_null:
+	case dns_rdatatype_txt:
+	case dns_rdatatype_key:
+	case dns_rdatatype_ds:
+	case dns_rdatatype_sshfp:
+	case dns_rdatatype_rrsig:
+	case dns_rdatatype_dnskey:
+	case dns_rdatatype_nsec3:
+	case dns_rdatatype_nsec3param:
+	case dns_rdatatype_tlsa:
+	case dns_rdatatype_smimea:
+	case dns_rdatatype_cds:
+	case dns_rdatatype_cdnskey:
+	case dns_rdatatype_openpgpkey:
+	case dns_rdatatype_spf:
+	case dns_rdatatype_eui48:
+	case dns_rdatatype_eui64:
+	case dns_rdatatype_uri:
+	case dns_rdatatype_caa:
+	case dns_rdatatype_dlv:
+		return (true);
+	default:
+		/* Unknown types are rendered as they are. */
+		return (!dns_rdatatype_isknown(type));
+	}
+}
+
 void
 dns_rdata_exists(dns_rdata_t *rdata, dns_rdatatype_t type) {
 
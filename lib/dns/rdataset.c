@@ -331,6 +331,7 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	unsigned int headlen;
 	bool question = false;
 	bool shuffle = false, sort = false;
+	bool copy;
 	bool want_random, want_cyclic;
 	dns_rdata_t in_fixed[MAX_SHUFFLE];
 	dns_rdata_t *in = in_fixed;
@@ -451,6 +452,13 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 		}
 	}
 
+	/*
+	 * Rdata which dns_rdata_towire() would copy unchanged is copied
+	 * straight into 'target', behind a length taken from the rdata.
+	 */
+	copy = !question &&
+	       dns_rdatatype_towirecopy(rdataset->rdclass, rdataset->type);
+
 	savedbuffer = *target;
 	i = 0;
 	added = 0;
@@ -489,29 +497,42 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 
 			isc_buffer_putuint32(target, rdataset->ttl);
 
-			/*
-			 * Save space for rdlen.
-			 */
-			rdlen = *target;
-			isc_buffer_add(target, 2);
-
-			/*
-			 * Copy out the rdata
-			 */
 			if (shuffle || sort) {
 				rdata = *(out[i].rdata);
 			} else {
-				dns_rdata_reset(&rdata);
 				dns_rdataset_current(rdataset, &rdata);
 			}
-			result = dns_rdata_towire(&rdata, cctx, target);
-			if (result != ISC_R_SUCCESS)
-				goto rollback;
-			INSIST((target->used >= rdlen.used + 2) &&
-			       (target->used - rdlen.used - 2 < 65536));
-			isc_buffer_putuint16(&rdlen,
-					     (uint16_t)(target->used -
-							    rdlen.used - 2));
+
+			if (copy) {
+				isc_buffer_availableregion(target, &r);
+				if (r.length < 2 + rdata.length) {
+					result = ISC_R_NOSPACE;
+					goto rollback;
+				}
+				isc_buffer_putuint16(target, rdata.length);
+				isc_buffer_putmem(target, rdata.data,
+						  rdata.length);
+			} else {
+				/*
+				 * Save space for rdlen.
+				 */
+				rdlen = *target;
+				isc_buffer_add(target, 2);
+
+				/*
+				 * Copy out the rdata
+				 */
+				result = dns_rdata_towire(&rdata, cctx,
+							  target);
+				if (result != ISC_R_SUCCESS)
+					goto rollback;
+				INSIST((target->used >= rdlen.used + 2) &&
+				       (target->used - rdlen.used - 2 <
+					65536));
+				isc_buffer_putuint16(&rdlen,
+					(uint16_t)(target->used -
+						   rdlen.used - 2));
+			}
 			added++;
 		}
 
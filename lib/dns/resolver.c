@@ -17,8 +17,10 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/counter.h>
 #include <isc/log.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/string.h>
@@ -184,6 +186,35 @@
 #endif
 #define RES_NOBUCKET		0xffffffff
 
+/*
+ * Sizing of the per-bucket fetch context hash tables: a table starts
+ * with RES_FCTX_MINCHAINS chains and doubles whenever it holds more than
+ * RES_FCTX_LOAD contexts per chain, up to RES_FCTX_MAXCHAINS chains.
+ */
+#ifndef RES_FCTX_MINCHAINS
+#define RES_FCTX_MINCHAINS	4
+#endif
+#ifndef RES_FCTX_MAXCHAINS
+#define RES_FCTX_MAXCHAINS	65536
+#endif
+#define RES_FCTX_LOAD		2
+
+/*
+ * Hedged queries: the running median of response times starts out at
+ * RES_HEDGE_INITRTT, and a hedge is never sent sooner than
+ * RES_HEDGE_MINDELAY after the query it backs up.  Both are in
+ * microseconds.
+ */
+#ifndef RES_HEDGE_INITRTT
+#define RES_HEDGE_INITRTT	100000
+#endif
+#ifndef RES_HEDGE_MINDELAY
+#define RES_HEDGE_MINDELAY	10000
+#endif
+
+#define FCTX_CHAIN(res, bucket, hashval) \
+	(((hashval) / (res)->nbuckets) & ((bucket)->nchains - 1))
+
 /*%
  * Maximum EDNS0 input packet size.
  */
@@ -239,11 +270,14 @@ struct tried {
 #define VALID_QUERY(query)		ISC_MAGIC_VALID(query, QUERY_MAGIC)
 
 #define RESQUERY_ATTR_CANCELED          0x02
+#define RESQUERY_ATTR_HEDGE             0x04
 
 #define RESQUERY_CONNECTING(q)          ((q)->connects > 0)
 #define RESQUERY_CANCELED(q)            (((q)->attributes & \
 					  RESQUERY_ATTR_CANCELED) != 0)
 #define RESQUERY_SENDING(q)             ((q)->sends > 0)
+#define RESQUERY_HEDGE(q)               (((q)->attributes & \
+					  RESQUERY_ATTR_HEDGE) != 0)
 
 typedef enum {
 	fetchstate_init = 0,            /*%< Start event has not run yet. */
@@ -264,10 +298,12 @@ struct fetchctx {
 	dns_name_t			fullname;
 	dns_rdatatype_t			fulltype;
 	unsigned int			options;
+	unsigned int			hashval;
 	unsigned int			bucketnum;
 	unsigned int			dbucketnum;
 	char *				info;
 	isc_mem_t *			mctx;
+	isc_task_t *			task;
 	isc_stdtime_t			now;
 
 	/*% Locked by appropriate bucket lock. */
@@ -278,6 +314,7 @@ struct fetchctx {
 	unsigned int			references;
 	isc_event_t			control_event;
 	ISC_LINK(struct fetchctx)       link;
+	ISC_LINK(struct fetchctx)       hlink;
 	ISC_LIST(dns_fetchevent_t)      events;
 
 	/*% Locked by task event serialization. */
@@ -285,6 +322,7 @@ struct fetchctx {
 	dns_rdataset_t			nameservers;
 	unsigned int			attributes;
 	isc_timer_t *			timer;
+	isc_timer_t *			hedgetimer;
 	isc_time_t			expires;
 	isc_interval_t			interval;
 	dns_message_t *			qmessage;
@@ -398,6 +436,7 @@ struct fetchctx {
 #define FCTX_ATTR_NEEDEDNS0             0x0040
 #define FCTX_ATTR_TRIEDFIND             0x0080
 #define FCTX_ATTR_TRIEDALT              0x0100
+#define FCTX_ATTR_HEDGEARMED            0x0200
 
 #define HAVE_ANSWER(f)          (((f)->attributes & FCTX_ATTR_HAVEANSWER) != \
 				 0)
@@ -412,6 +451,7 @@ struct fetchctx {
 #define NEEDEDNS0(f)            (((f)->attributes & FCTX_ATTR_NEEDEDNS0) != 0)
 #define TRIEDFIND(f)            (((f)->attributes & FCTX_ATTR_TRIEDFIND) != 0)
 #define TRIEDALT(f)             (((f)->attributes & FCTX_ATTR_TRIEDALT) != 0)
+#define HEDGEARMED(f)           (((f)->attributes & FCTX_ATTR_HEDGEARMED) != 0)
 
 typedef struct {
 	dns_adbaddrinfo_t *		addrinfo;
@@ -427,10 +467,22 @@ struct dns_fetch {
 #define DNS_FETCH_MAGIC			ISC_MAGIC('F', 't', 'c', 'h')
 #define DNS_FETCH_VALID(fetch)		ISC_MAGIC_VALID(fetch, DNS_FETCH_MAGIC)
 
+typedef ISC_LIST(fetchctx_t) fctxlist_t;
+
+/*%
+ * A bucket is a lock stripe of the fetch context table.  Its contexts
+ * are kept both on a list, for walking, and in a chained hash table
+ * for lookups; the hash table doubles in size as the bucket fills up.
+ * The task that runs a fetch context is picked independently of its
+ * bucket (see fctx_create()).
+ */
 typedef struct fctxbucket {
-	isc_task_t *			task;
 	isc_mutex_t			lock;
 	ISC_LIST(fetchctx_t)		fctxs;
+	fctxlist_t *			chains;
+	unsigned int			nchains;
+	unsigned int			count;
+	unsigned int			maxcount;
 	bool			exiting;
 	isc_mem_t *			mctx;
 } fctxbucket_t;
@@ -485,6 +537,12 @@ struct dns_resolver {
 	isc_dscp_t			querydscp4;
 	isc_dscp_t			querydscp6;
 	bool			exclusivev6;
+	unsigned int			ntasks;
+	isc_task_t **			tasks;
+	atomic_uint_fast32_t		nexttask;
+	unsigned int			nverifytasks;
+	isc_task_t **			verifytasks;
+	atomic_uint_fast32_t		nextverifytask;
 	unsigned int			nbuckets;
 	fctxbucket_t *			buckets;
 	zonebucket_t *			dbuckets;
@@ -513,6 +571,9 @@ struct dns_resolver {
 	unsigned int			retryinterval; /* in milliseconds */
 	unsigned int			nonbackofftries;
 
+	bool				hedge;
+	atomic_uint_fast32_t		rttmedian;	/* in microseconds */
+
 	/* Locked by lock. */
 	unsigned int			references;
 	bool			exiting;
@@ -528,6 +589,7 @@ struct dns_resolver {
 	dns_fetch_t *			primefetch;
 	/* Locked by nlock. */
 	unsigned int			nfctx;
+	unsigned int			maxbucket;
 };
 
 #define RES_MAGIC			ISC_MAGIC('R', 'e', 's', '!')
@@ -577,6 +639,7 @@ static void resquery_response(isc_task_t *task, isc_event_t *event);
 static void resquery_connected(isc_task_t *task, isc_event_t *event);
 static void fctx_try(fetchctx_t *fctx, bool retrying,
 		     bool badcache);
+static void fctx_hedge(isc_task_t *task, isc_event_t *event);
 void fctx_minimize_qname(fetchctx_t *fctx);
 static void fctx_destroy(fetchctx_t *fctx);
 static bool fctx_unlink(fetchctx_t *fctx);
@@ -1101,6 +1164,40 @@ fctx_startidletimer(fetchctx_t *fctx, isc_interval_t *interval) {
  */
 #define fctx_stopidletimer      fctx_starttimer
 
+/*
+ * Arm the hedge timer to go off after 'delay' microseconds, creating
+ * it the first time it is needed.
+ */
+static inline isc_result_t
+fctx_starthedgetimer(fetchctx_t *fctx, unsigned int delay) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	isc_interval_set(&interval, delay / US_PER_SEC,
+			 (delay % US_PER_SEC) * 1000);
+	if (fctx->hedgetimer == NULL) {
+		result = isc_timer_create(fctx->res->timermgr,
+					  isc_timertype_once, NULL,
+					  &interval, fctx->task, fctx_hedge,
+					  fctx, &fctx->hedgetimer);
+	} else {
+		result = isc_timer_reset(fctx->hedgetimer, isc_timertype_once,
+					 NULL, &interval, true);
+	}
+	if (result == ISC_R_SUCCESS)
+		fctx->attributes |= FCTX_ATTR_HEDGEARMED;
+	return (result);
+}
+
+static inline void
+fctx_stophedgetimer(fetchctx_t *fctx) {
+	if (!HEDGEARMED(fctx))
+		return;
+	fctx->attributes &= ~FCTX_ATTR_HEDGEARMED;
+	(void)isc_timer_reset(fctx->hedgetimer, isc_timertype_inactive,
+			      NULL, NULL, true);
+}
+
 static inline void
 resquery_destroy(resquery_t **queryp) {
 	dns_resolver_t *res;
@@ -1133,6 +1230,26 @@ resquery_destroy(resquery_t **queryp) {
 		empty_bucket(res);
 }
 
+/*
+ * Nudge the resolver's running median of response times towards 'rtt'
+ * by a small fraction of the current estimate.  Updates that race with
+ * each other may be lost, which does the estimate no harm.
+ */
+static inline void
+update_rttmedian(dns_resolver_t *res, unsigned int rtt) {
+	uint_fast32_t median, step;
+
+	median = atomic_load_explicit(&res->rttmedian, memory_order_relaxed);
+	step = median / 32 + 1;
+	if (rtt > median)
+		median += step;
+	else if (rtt < median)
+		median -= ISC_MIN(step, median);
+	else
+		return;
+	atomic_store_explicit(&res->rttmedian, median, memory_order_relaxed);
+}
+
 static void
 fctx_cancelquery(resquery_t **queryp, dns_dispatchevent_t **deventp,
 		 isc_time_t *finish, bool no_response,
@@ -1168,6 +1285,7 @@ fctx_cancelquery(resquery_t **queryp, dns_dispatchevent_t **deventp,
 			rtt = (unsigned int)isc_time_microdiff(finish,
 							       &query->start);
 			factor = DNS_ADB_RTTADJDEFAULT;
+			update_rttmedian(fctx->res, rtt);
 
 			rttms = rtt / 1000;
 			if (rttms < DNS_RESOLVER_QRYRTTCLASS0) {
@@ -1344,6 +1462,8 @@ fctx_cancelqueries(fetchctx_t *fctx, bool no_response,
 
 	FCTXTRACE("cancelqueries");
 
+	fctx_stophedgetimer(fctx);
+
 	for (query = ISC_LIST_HEAD(fctx->queries);
 	     query != NULL;
 	     query = next_query) {
@@ -1827,10 +1947,10 @@ fctx_addopt(dns_message_t *message, unsigned int version,
 	return (dns_message_setopt(message, rdataset));
 }
 
-static inline void
+static inline unsigned int
 fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
 	unsigned int seconds;
-	unsigned int us;
+	unsigned int us, total;
 
 	us = fctx->res->retryinterval * 1000;
 	/*
@@ -1866,14 +1986,22 @@ fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
 	if (us > MAX_SINGLE_QUERY_TIMEOUT_US)
 		us = MAX_SINGLE_QUERY_TIMEOUT_US;
 
+	total = us;
 	seconds = us / US_PER_SEC;
 	us -= seconds * US_PER_SEC;
 	isc_interval_set(&fctx->interval, seconds, us * 1000);
+
+	return (total);
 }
 
+/*
+ * Send a query to 'addrinfo'.  A hedge is sent while an earlier query is
+ * still outstanding and leaves the retry timer alone, so that the earlier
+ * query keeps its own deadline.
+ */
 static isc_result_t
 fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
-	   unsigned int options)
+	   unsigned int options, bool hedge)
 {
 	dns_resolver_t *res;
 	isc_task_t *task;
@@ -1881,13 +2009,13 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	resquery_t *query;
 	isc_sockaddr_t addr;
 	bool have_addr = false;
-	unsigned int srtt;
+	unsigned int srtt, retry = 0;
 	isc_dscp_t dscp = -1;
 
 	FCTXTRACE("query");
 
 	res = fctx->res;
-	task = res->buckets[fctx->bucketnum].task;
+	task = fctx->task;
 
 	srtt = addrinfo->srtt;
 
@@ -1898,10 +2026,12 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	if (ISFORWARDER(addrinfo) && srtt < 1000000)
 		srtt = 1000000;
 
-	fctx_setretryinterval(fctx, srtt);
-	result = fctx_startidletimer(fctx, &fctx->interval);
-	if (result != ISC_R_SUCCESS)
-		return (result);
+	if (!hedge) {
+		retry = fctx_setretryinterval(fctx, srtt);
+		result = fctx_startidletimer(fctx, &fctx->interval);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
 
 	INSIST(ISC_LIST_EMPTY(fctx->validators));
 
@@ -1914,7 +2044,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	}
 	query->mctx = fctx->mctx;
 	query->options = options;
-	query->attributes = 0;
+	query->attributes = hedge ? RESQUERY_ATTR_HEDGE : 0;
 	query->sends = 0;
 	query->connects = 0;
 	query->dscp = addrinfo->dscp;
@@ -2108,6 +2238,24 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		dns_rdatatypestats_increment(res->view->resquerystats,
 					     fctx->type);
 
+	/*
+	 * If hedging is on, arrange to try another server if this one
+	 * has not answered by the time most servers would have.  A hedge
+	 * that would go out after the retry timer fires is pointless.
+	 */
+	if (hedge) {
+		inc_stats(res, dns_resstatscounter_hedgesent);
+	} else if (res->hedge && (query->options & DNS_FETCHOPT_TCP) == 0) {
+		unsigned int delay;
+
+		delay = atomic_load_explicit(&res->rttmedian,
+					     memory_order_relaxed);
+		delay = ISC_MAX(delay, addrinfo->srtt);
+		delay = ISC_MAX(delay, RES_HEDGE_MINDELAY);
+		if (delay < retry)
+			(void)fctx_starthedgetimer(fctx, delay);
+	}
+
 	return (ISC_R_SUCCESS);
 
  cleanup_socket:
@@ -2124,7 +2272,8 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	}
 
  stop_idle_timer:
-	RUNTIME_CHECK(fctx_stopidletimer(fctx) == ISC_R_SUCCESS);
+	if (!hedge)
+		RUNTIME_CHECK(fctx_stopidletimer(fctx) == ISC_R_SUCCESS);
 
 	return (result);
 }
@@ -2363,7 +2512,7 @@ resquery_send(resquery_t *query) {
 	QTRACE("send");
 
 	res = fctx->res;
-	task = res->buckets[fctx->bucketnum].task;
+	task = fctx->task;
 	address = NULL;
 
 	if (tcp) {
@@ -3333,7 +3482,7 @@ findname(fetchctx_t *fctx, const dns_name_t *name, in_port_t port,
 	 */
 	find = NULL;
 	result = dns_adb_createfind(fctx->adb,
-				    res->buckets[fctx->bucketnum].task,
+				    fctx->task,
 				    fctx_finddone, fctx, name,
 				    &fctx->name, fctx->type,
 				    options, now, NULL,
@@ -4007,7 +4156,7 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 
 	bucketnum = fctx->bucketnum;
 	fctx_increference(fctx);
-	result = fctx_query(fctx, addrinfo, fctx->options);
+	result = fctx_query(fctx, addrinfo, fctx->options, false);
 	if (result != ISC_R_SUCCESS) {
 		fctx_done(fctx, result, __LINE__);
 		LOCK(&res->buckets[bucketnum].lock);
@@ -4019,6 +4168,86 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 		inc_stats(res, dns_resstatscounter_retry);
 }
 
+/*
+ * Double the number of hash chains in 'bucket' and rehash its contexts.
+ * If memory is short the bucket just keeps its current chains.
+ *
+ * Caller must be holding the bucket lock.
+ */
+static void
+bucket_grow(dns_resolver_t *res, fctxbucket_t *bucket) {
+	fctxlist_t *chains, *oldchains;
+	unsigned int i, nchains, oldnchains;
+	fetchctx_t *fctx;
+
+	oldnchains = bucket->nchains;
+	nchains = oldnchains * 2;
+	chains = isc_mem_get(bucket->mctx, nchains * sizeof(fctxlist_t));
+	if (chains == NULL)
+		return;
+	for (i = 0; i < nchains; i++)
+		ISC_LIST_INIT(chains[i]);
+
+	oldchains = bucket->chains;
+	bucket->chains = chains;
+	bucket->nchains = nchains;
+	for (i = 0; i < oldnchains; i++) {
+		while ((fctx = ISC_LIST_HEAD(oldchains[i])) != NULL) {
+			ISC_LIST_UNLINK(oldchains[i], fctx, hlink);
+			ISC_LIST_APPEND(chains[FCTX_CHAIN(res, bucket,
+							  fctx->hashval)],
+					fctx, hlink);
+		}
+	}
+	isc_mem_put(bucket->mctx, oldchains, oldnchains * sizeof(fctxlist_t));
+}
+
+/*
+ * Caller must be holding the bucket lock.
+ */
+static void
+bucket_link(dns_resolver_t *res, fetchctx_t *fctx) {
+	fctxbucket_t *bucket = &res->buckets[fctx->bucketnum];
+	unsigned int count;
+
+	ISC_LIST_APPEND(bucket->fctxs, fctx, link);
+	ISC_LIST_APPEND(bucket->chains[FCTX_CHAIN(res, bucket,
+						  fctx->hashval)],
+			fctx, hlink);
+
+	count = ++bucket->count;
+	if (count > bucket->nchains * RES_FCTX_LOAD &&
+	    bucket->nchains < RES_FCTX_MAXCHAINS)
+		bucket_grow(res, bucket);
+
+	if (count > bucket->maxcount) {
+		bucket->maxcount = count;
+		LOCK(&res->nlock);
+		if (count > res->maxbucket) {
+			res->maxbucket = count;
+			if (res->view->resstats != NULL)
+				isc_stats_set(res->view->resstats, count,
+					      dns_resstatscounter_bucketmax);
+		}
+		UNLOCK(&res->nlock);
+	}
+}
+
+/*
+ * Caller must be holding the bucket lock.
+ */
+static void
+bucket_unlink(dns_resolver_t *res, fetchctx_t *fctx) {
+	fctxbucket_t *bucket = &res->buckets[fctx->bucketnum];
+
+	ISC_LIST_UNLINK(bucket->fctxs, fctx, link);
+	ISC_LIST_UNLINK(bucket->chains[FCTX_CHAIN(res, bucket,
+						  fctx->hashval)],
+			fctx, hlink);
+	INSIST(bucket->count > 0);
+	bucket->count--;
+}
+
 static bool
 fctx_unlink(fetchctx_t *fctx) {
 	dns_resolver_t *res;
@@ -4044,7 +4273,7 @@ fctx_unlink(fetchctx_t *fctx) {
 	res = fctx->res;
 	bucketnum = fctx->bucketnum;
 
-	ISC_LIST_UNLINK(res->buckets[bucketnum].fctxs, fctx, link);
+	bucket_unlink(res, fctx);
 
 	LOCK(&res->nlock);
 	res->nfctx--;
@@ -4113,6 +4342,8 @@ fctx_destroy(fetchctx_t *fctx) {
 	isc_counter_detach(&fctx->qc);
 	fcount_decr(fctx);
 	isc_timer_detach(&fctx->timer);
+	if (fctx->hedgetimer != NULL)
+		isc_timer_detach(&fctx->hedgetimer);
 	dns_message_destroy(&fctx->rmessage);
 	dns_message_destroy(&fctx->qmessage);
 	if (dns_name_countlabels(&fctx->domain) > 0)
@@ -4189,6 +4420,66 @@ fctx_timeout(isc_task_t *task, isc_event_t *event) {
 	isc_event_free(&event);
 }
 
+/*
+ * The query in flight has not been answered within the hedge delay:
+ * send the same question to the next server as well, and let whichever
+ * answers first win.  The loser is cancelled along with the other
+ * queries once the response has been dealt with.
+ */
+static void
+fctx_hedge(isc_task_t *task, isc_event_t *event) {
+	fetchctx_t *fctx = event->ev_arg;
+	dns_resolver_t *res;
+	dns_adbaddrinfo_t *addrinfo;
+	resquery_t *query;
+	isc_result_t result;
+	unsigned int bucketnum;
+	bool bucket_empty;
+
+	REQUIRE(VALID_FCTX(fctx));
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+
+	FCTXTRACE("hedge");
+
+	if (!HEDGEARMED(fctx))
+		return;
+	fctx->attributes &= ~FCTX_ATTR_HEDGEARMED;
+
+	res = fctx->res;
+	query = ISC_LIST_HEAD(fctx->queries);
+	if (fctx->state != fetchstate_active || ADDRWAIT(fctx) ||
+	    query == NULL || ISC_LIST_NEXT(query, link) != NULL ||
+	    !ISC_LIST_EMPTY(fctx->validators))
+		return;
+
+	addrinfo = fctx_nextaddress(fctx);
+	while (addrinfo != NULL && dns_adbentry_overquota(addrinfo->entry))
+		addrinfo = fctx_nextaddress(fctx);
+	if (addrinfo == NULL)
+		return;
+
+	if (dns_name_countlabels(&fctx->domain) > 2 &&
+	    isc_counter_increment(fctx->qc) != ISC_R_SUCCESS)
+		return;
+
+	bucketnum = fctx->bucketnum;
+	fctx_increference(fctx);
+	result = fctx_query(fctx, addrinfo, fctx->options, true);
+	if (result != ISC_R_SUCCESS) {
+		/*
+		 * The first query is still outstanding, so this is not
+		 * fatal to the fetch.
+		 */
+		LOCK(&res->buckets[bucketnum].lock);
+		bucket_empty = fctx_decreference(fctx);
+		UNLOCK(&res->buckets[bucketnum].lock);
+		INSIST(!bucket_empty);
+	}
+}
+
 static void
 fctx_shutdown(fetchctx_t *fctx) {
 	isc_event_t *cevent;
@@ -4216,7 +4507,7 @@ fctx_shutdown(fetchctx_t *fctx) {
 	 */
 	if (fctx->state != fetchstate_init) {
 		cevent = &fctx->control_event;
-		isc_task_send(fctx->res->buckets[fctx->bucketnum].task,
+		isc_task_send(fctx->task,
 			      &cevent);
 	}
 }
@@ -4446,10 +4737,12 @@ log_ns_ttl(fetchctx_t *fctx, const char *where) {
 static isc_result_t
 fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	    const dns_name_t *domain, dns_rdataset_t *nameservers,
-	    unsigned int options, unsigned int bucketnum, unsigned int depth,
+	    unsigned int options, unsigned int hashval, unsigned int depth,
 	    isc_counter_t *qc, fetchctx_t **fctxp)
 {
 	fetchctx_t *fctx;
+	unsigned int bucketnum = hashval % res->nbuckets;
+	unsigned int tasknum;
 	isc_result_t result;
 	isc_result_t iresult;
 	isc_interval_t interval;
@@ -4515,7 +4808,16 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	 */
 	fctx->res = res;
 	fctx->references = 0;
+	fctx->hashval = hashval;
 	fctx->bucketnum = bucketnum;
+	/*
+	 * Hand out the resolver's tasks in turn rather than by bucket, so
+	 * that a run of fetches which hash to the same bucket is still
+	 * spread across all the tasks (and so all the worker threads).
+	 */
+	tasknum = atomic_fetch_add_explicit(&res->nexttask, 1,
+					    memory_order_relaxed);
+	fctx->task = res->tasks[tasknum % res->ntasks];
 	fctx->dbucketnum = RES_NOBUCKET;
 	fctx->state = fetchstate_init;
 	fctx->want_shutdown = false;
@@ -4694,9 +4996,10 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	 * is actually started.
 	 */
 	fctx->timer = NULL;
+	fctx->hedgetimer = NULL;
 	iresult = isc_timer_create(res->timermgr, isc_timertype_inactive,
 				   NULL, NULL,
-				   res->buckets[bucketnum].task, fctx_timeout,
+				   fctx->task, fctx_timeout,
 				   fctx, &fctx->timer);
 	if (iresult != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4718,6 +5021,7 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 
 	ISC_LIST_INIT(fctx->events);
 	ISC_LINK_INIT(fctx, link);
+	ISC_LINK_INIT(fctx, hlink);
 	fctx->magic = FCTX_MAGIC;
 
 	/*
@@ -4731,7 +5035,7 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 		fctx_minimize_qname(fctx);
 	}
 
-	ISC_LIST_APPEND(res->buckets[bucketnum].fctxs, fctx, link);
+	bucket_link(res, fctx);
 
 	LOCK(&res->nlock);
 	res->nfctx++;
@@ -5649,7 +5953,7 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_adbaddrinfo_t *addrinfo,
 	/*
 	 * The appropriate bucket lock must be held.
 	 */
-	task = res->buckets[fctx->bucketnum].task;
+	task = fctx->task;
 
 	/*
 	 * Is DNSSEC validation required for this name?
@@ -6298,7 +6602,7 @@ ncache_message(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		 */
 		result = valcreate(fctx, addrinfo, name, fctx->type,
 				   NULL, NULL, valoptions,
-				   res->buckets[fctx->bucketnum].task);
+				   fctx->task);
 		/*
 		 * If validation is necessary, return now.  Otherwise continue
 		 * to process the message, letting the validation complete
@@ -9136,7 +9440,7 @@ rctx_resend(respctx_t *rctx, dns_adbaddrinfo_t *addrinfo) {
 	FCTXTRACE("resend");
 	inc_stats(fctx->res, dns_resstatscounter_retry);
 	fctx_increference(fctx);
-	result = fctx_query(fctx, addrinfo, rctx->retryopts);
+	result = fctx_query(fctx, addrinfo, rctx->retryopts, false);
 	if (result == ISC_R_SUCCESS) {
 		return;
 	}
@@ -9228,6 +9532,14 @@ rctx_done(respctx_t *rctx, isc_result_t result) {
 		   rctx->no_response ? "no response" : "responding",
 		   result);
 
+	/*
+	 * A hedge whose answer we are using beat the query it backed up.
+	 */
+	if (RESQUERY_HEDGE(query) && result == ISC_R_SUCCESS &&
+	    rctx->broken_server == ISC_R_SUCCESS &&
+	    !rctx->resend && !rctx->nextitem)
+		inc_stats(fctx->res, dns_resstatscounter_hedgewon);
+
 	/*
 	 * Cancel the query.
 	 *
@@ -9581,13 +9893,26 @@ destroy(dns_resolver_t *res) {
 	DESTROYLOCK(&res->lock);
 	for (i = 0; i < res->nbuckets; i++) {
 		INSIST(ISC_LIST_EMPTY(res->buckets[i].fctxs));
-		isc_task_shutdown(res->buckets[i].task);
-		isc_task_detach(&res->buckets[i].task);
+		INSIST(res->buckets[i].count == 0);
 		DESTROYLOCK(&res->buckets[i].lock);
+		isc_mem_put(res->buckets[i].mctx, res->buckets[i].chains,
+			    res->buckets[i].nchains * sizeof(fctxlist_t));
 		isc_mem_detach(&res->buckets[i].mctx);
 	}
 	isc_mem_put(res->mctx, res->buckets,
 		    res->nbuckets * sizeof(fctxbucket_t));
+	for (i = 0; i < res->ntasks; i++) {
+		isc_task_shutdown(res->tasks[i]);
+		isc_task_detach(&res->tasks[i]);
+	}
+	isc_mem_put(res->mctx, res->tasks,
+		    res->ntasks * sizeof(isc_task_t *));
+	for (i = 0; i < res->nverifytasks; i++) {
+		isc_task_shutdown(res->verifytasks[i]);
+		isc_task_detach(&res->verifytasks[i]);
+	}
+	isc_mem_put(res->mctx, res->verifytasks,
+		    res->nverifytasks * sizeof(isc_task_t *));
 	for (i = 0; i < RES_DOMAIN_BUCKETS; i++) {
 		INSIST(ISC_LIST_EMPTY(res->dbuckets[i].list));
 		isc_mem_detach(&res->dbuckets[i].mctx);
@@ -9701,9 +10026,10 @@ dns_resolver_create(dns_view_t *view,
 {
 	dns_resolver_t *res;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int i, buckets_created = 0, dbuckets_created = 0;
+	unsigned int i, j, tasks_created = 0, verifytasks_created = 0;
+	unsigned int buckets_created = 0, dbuckets_created = 0;
 	isc_task_t *task = NULL;
-	char name[16];
+	char name[32];
 	unsigned dispattr;
 
 	/*
@@ -9745,6 +10071,8 @@ dns_resolver_create(dns_view_t *view,
 	res->zero_no_soa_ttl = false;
 	res->retryinterval = 30000;
 	res->nonbackofftries = 3;
+	res->hedge = false;
+	atomic_init(&res->rttmedian, RES_HEDGE_INITRTT);
 	res->query_timeout = DEFAULT_QUERY_TIMEOUT;
 	res->maxdepth = DEFAULT_RECURSION_DEPTH;
 	res->maxqueries = DEFAULT_MAX_QUERIES;
@@ -9755,22 +10083,58 @@ dns_resolver_create(dns_view_t *view,
 		isc_stats_set(view->resstats, ntasks,
 			      dns_resstatscounter_buckets);
 	res->activebuckets = ntasks;
+	res->maxbucket = 0;
+
+	res->ntasks = ntasks;
+	atomic_init(&res->nexttask, 0);
+	res->tasks = isc_mem_get(view->mctx, ntasks * sizeof(isc_task_t *));
+	if (res->tasks == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_res;
+	}
+	for (i = 0; i < ntasks; i++) {
+		res->tasks[i] = NULL;
+		result = isc_task_create(taskmgr, 0, &res->tasks[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_tasks;
+		snprintf(name, sizeof(name), "res%u", i);
+		isc_task_setname(res->tasks[i], name, res);
+		tasks_created++;
+	}
+
+	/*
+	 * Signature verifications are run on their own tasks, so that
+	 * a burst of them does not hold up the other events queued on
+	 * the tasks of the fetches being validated.
+	 */
+	res->nverifytasks = isc_os_ncpus();
+	atomic_init(&res->nextverifytask, 0);
+	res->verifytasks = isc_mem_get(view->mctx, res->nverifytasks *
+				       sizeof(isc_task_t *));
+	if (res->verifytasks == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_tasks;
+	}
+	for (i = 0; i < res->nverifytasks; i++) {
+		res->verifytasks[i] = NULL;
+		result = isc_task_create(taskmgr, 0, &res->verifytasks[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_verifytasks;
+		snprintf(name, sizeof(name), "resverify%u", i);
+		isc_task_setname(res->verifytasks[i], name, res);
+		verifytasks_created++;
+	}
+
 	res->buckets = isc_mem_get(view->mctx,
 				   ntasks * sizeof(fctxbucket_t));
 	if (res->buckets == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_res;
+		goto cleanup_verifytasks;
 	}
 	for (i = 0; i < ntasks; i++) {
 		result = isc_mutex_init(&res->buckets[i].lock);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup_buckets;
-		res->buckets[i].task = NULL;
-		result = isc_task_create(taskmgr, 0, &res->buckets[i].task);
-		if (result != ISC_R_SUCCESS) {
-			DESTROYLOCK(&res->buckets[i].lock);
-			goto cleanup_buckets;
-		}
 		res->buckets[i].mctx = NULL;
 		snprintf(name, sizeof(name), "res%u", i);
 		/*
@@ -9780,13 +10144,25 @@ dns_resolver_create(dns_view_t *view,
 		 */
 		result = isc_mem_create(0, 0, &res->buckets[i].mctx);
 		if (result != ISC_R_SUCCESS) {
-			isc_task_detach(&res->buckets[i].task);
 			DESTROYLOCK(&res->buckets[i].lock);
 			goto cleanup_buckets;
 		}
 		isc_mem_setname(res->buckets[i].mctx, name, NULL);
-		isc_task_setname(res->buckets[i].task, name, res);
+		res->buckets[i].nchains = RES_FCTX_MINCHAINS;
+		res->buckets[i].chains =
+			isc_mem_get(res->buckets[i].mctx,
+				    RES_FCTX_MINCHAINS * sizeof(fctxlist_t));
+		if (res->buckets[i].chains == NULL) {
+			isc_mem_detach(&res->buckets[i].mctx);
+			DESTROYLOCK(&res->buckets[i].lock);
+			result = ISC_R_NOMEMORY;
+			goto cleanup_buckets;
+		}
+		for (j = 0; j < RES_FCTX_MINCHAINS; j++)
+			ISC_LIST_INIT(res->buckets[i].chains[j]);
 		ISC_LIST_INIT(res->buckets[i].fctxs);
+		res->buckets[i].count = 0;
+		res->buckets[i].maxcount = 0;
 		res->buckets[i].exiting = false;
 		buckets_created++;
 	}
@@ -9916,14 +10292,29 @@ dns_resolver_create(dns_view_t *view,
 
  cleanup_buckets:
 	for (i = 0; i < buckets_created; i++) {
+		isc_mem_put(res->buckets[i].mctx, res->buckets[i].chains,
+			    res->buckets[i].nchains * sizeof(fctxlist_t));
 		isc_mem_detach(&res->buckets[i].mctx);
 		DESTROYLOCK(&res->buckets[i].lock);
-		isc_task_shutdown(res->buckets[i].task);
-		isc_task_detach(&res->buckets[i].task);
 	}
 	isc_mem_put(view->mctx, res->buckets,
 		    res->nbuckets * sizeof(fctxbucket_t));
 
+ cleanup_verifytasks:
+	for (i = 0; i < verifytasks_created; i++) {
+		isc_task_shutdown(res->verifytasks[i]);
+		isc_task_detach(&res->verifytasks[i]);
+	}
+	isc_mem_put(view->mctx, res->verifytasks,
+		    res->nverifytasks * sizeof(isc_task_t *));
+
+ cleanup_tasks:
+	for (i = 0; i < tasks_created; i++) {
+		isc_task_shutdown(res->tasks[i]);
+		isc_task_detach(&res->tasks[i]);
+	}
+	isc_mem_put(view->mctx, res->tasks, ntasks * sizeof(isc_task_t *));
+
  cleanup_res:
 	isc_mem_put(view->mctx, res, sizeof(*res));
 
@@ -10027,7 +10418,7 @@ dns_resolver_prime(dns_resolver_t *res) {
 						  dns_rdatatype_ns,
 						  NULL, NULL, NULL, NULL, 0, 0,
 						  0, NULL,
-						  res->buckets[0].task,
+						  res->tasks[0],
 						  prime_done,
 						  res, rdataset, NULL,
 						  &res->primefetch);
@@ -10124,14 +10515,6 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 			     fctx != NULL;
 			     fctx = ISC_LIST_NEXT(fctx, link))
 				fctx_shutdown(fctx);
-			if (res->dispatches4 != NULL && !res->exclusivev4) {
-				dns_dispatchset_cancelall(res->dispatches4,
-							  res->buckets[i].task);
-			}
-			if (res->dispatches6 != NULL && !res->exclusivev6) {
-				dns_dispatchset_cancelall(res->dispatches6,
-							  res->buckets[i].task);
-			}
 			res->buckets[i].exiting = true;
 			if (ISC_LIST_EMPTY(res->buckets[i].fctxs)) {
 				INSIST(res->activebuckets > 0);
@@ -10139,6 +10522,16 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 			}
 			UNLOCK(&res->buckets[i].lock);
 		}
+		for (i = 0; i < res->ntasks; i++) {
+			if (res->dispatches4 != NULL && !res->exclusivev4) {
+				dns_dispatchset_cancelall(res->dispatches4,
+							  res->tasks[i]);
+			}
+			if (res->dispatches6 != NULL && !res->exclusivev6) {
+				dns_dispatchset_cancelall(res->dispatches6,
+							  res->tasks[i]);
+			}
+		}
 		if (res->activebuckets == 0)
 			send_shutdown_events(res);
 		result = isc_timer_reset(res->spillattimer,
@@ -10194,6 +10587,31 @@ fctx_match(fetchctx_t *fctx, const dns_name_t *name, dns_rdatatype_t type,
 	return (dns_name_equal(&fctx->fullname, name));
 }
 
+/*
+ * Find a fetch context that a new fetch for 'name' and 'type' can join.
+ *
+ * Caller must be holding the bucket lock.
+ */
+static fetchctx_t *
+bucket_find(dns_resolver_t *res, unsigned int hashval,
+	    const dns_name_t *name, dns_rdatatype_t type, unsigned int options)
+{
+	fctxbucket_t *bucket = &res->buckets[hashval % res->nbuckets];
+	fetchctx_t *fctx;
+
+	for (fctx = ISC_LIST_HEAD(bucket->chains[FCTX_CHAIN(res, bucket,
+							    hashval)]);
+	     fctx != NULL;
+	     fctx = ISC_LIST_NEXT(fctx, hlink))
+	{
+		if (fctx->hashval == hashval &&
+		    fctx_match(fctx, name, type, options))
+			break;
+	}
+
+	return (fctx);
+}
+
 static inline void
 log_fetch(const dns_name_t *name, dns_rdatatype_t type) {
 	char namebuf[DNS_NAME_FORMATSIZE];
@@ -10292,7 +10710,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	dns_fetch_t *fetch;
 	fetchctx_t *fctx = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int bucketnum;
+	unsigned int hashval, bucketnum;
 	bool new_fctx = false;
 	isc_event_t *event;
 	unsigned int count = 0;
@@ -10327,7 +10745,8 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	fetch->mctx = NULL;
 	isc_mem_attach(res->mctx, &fetch->mctx);
 
-	bucketnum = dns_name_fullhash(name, false) % res->nbuckets;
+	hashval = dns_name_fullhash(name, false);
+	bucketnum = hashval % res->nbuckets;
 
 	LOCK(&res->lock);
 	spillat = res->spillat;
@@ -10340,14 +10759,8 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 		goto unlock;
 	}
 
-	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
-		for (fctx = ISC_LIST_HEAD(res->buckets[bucketnum].fctxs);
-		     fctx != NULL;
-		     fctx = ISC_LIST_NEXT(fctx, link)) {
-			if (fctx_match(fctx, name, type, options))
-				break;
-		}
-	}
+	if ((options & DNS_FETCHOPT_UNSHARED) == 0)
+		fctx = bucket_find(res, hashval, name, type, options);
 
 	/*
 	 * Is this a duplicate?
@@ -10377,7 +10790,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 
 	if (fctx == NULL) {
 		result = fctx_create(res, name, type, domain, nameservers,
-				     options, bucketnum, depth, qc, &fctx);
+				     options, hashval, depth, qc, &fctx);
 		if (result != ISC_R_SUCCESS)
 			goto unlock;
 		new_fctx = true;
@@ -10396,7 +10809,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 				       DNS_EVENT_FETCHCONTROL,
 				       fctx_start, fctx, NULL,
 				       NULL, NULL);
-			isc_task_send(res->buckets[bucketnum].task, &event);
+			isc_task_send(fctx->task, &event);
 		} else {
 			/*
 			 * We don't care about the result of fctx_unlink()
@@ -10583,6 +10996,17 @@ dns_resolver_socketmgr(dns_resolver_t *resolver) {
 	return (resolver->socketmgr);
 }
 
+isc_task_t *
+dns_resolver_verifytask(dns_resolver_t *resolver) {
+	unsigned int tasknum;
+
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	tasknum = atomic_fetch_add_explicit(&resolver->nextverifytask, 1,
+					    memory_order_relaxed);
+	return (resolver->verifytasks[tasknum % resolver->nverifytasks]);
+}
+
 isc_taskmgr_t *
 dns_resolver_taskmgr(dns_resolver_t *resolver) {
 	REQUIRE(VALID_RESOLVER(resolver));
@@ -11187,6 +11611,28 @@ dns_resolver_dumpfetches(dns_resolver_t *resolver,
 	}
 }
 
+void
+dns_resolver_dumpbuckets(dns_resolver_t *resolver,
+			 isc_statsformat_t format, FILE *fp)
+{
+	unsigned int i;
+
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(fp != NULL);
+	REQUIRE(format == isc_statsformat_file);
+
+	for (i = 0; i < resolver->nbuckets; i++) {
+		fctxbucket_t *bucket = &resolver->buckets[i];
+		LOCK(&bucket->lock);
+		if (bucket->maxcount != 0) {
+			fprintf(fp, "bucket %u: %u active (%u peak, "
+				"%u chains)\n", i, bucket->count,
+				bucket->maxcount, bucket->nchains);
+		}
+		UNLOCK(&bucket->lock);
+	}
+}
+
 void
 dns_resolver_setquotaresponse(dns_resolver_t *resolver,
 			      dns_quotatype_t which, isc_result_t resp)
@@ -11237,3 +11683,17 @@ dns_resolver_setnonbackofftries(dns_resolver_t *resolver, unsigned int tries) {
 
 	resolver->nonbackofftries = tries;
 }
+
+bool
+dns_resolver_gethedging(dns_resolver_t *resolver) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	return (resolver->hedge);
+}
+
+void
+dns_resolver_sethedging(dns_resolver_t *resolver, bool hedge) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	resolver->hedge = hedge;
+}
@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/sha2.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+/*%
+ * The cache is split into partitions, each with its own lock, table
+ * and age list, so that validators running on different threads
+ * rarely contend.  A digest picks its partition and its bucket within
+ * the partition from a keyed hash of its bytes.
+ */
+#ifndef DNS_SIGCACHE_NPARTS
+#define DNS_SIGCACHE_NPARTS	16
+#endif
+
+typedef struct dns_scentry dns_scentry_t;
+typedef ISC_LIST(dns_scentry_t) dns_sclist_t;
+
+struct dns_scentry {
+	unsigned char		digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t		expire;
+	unsigned int		bucket;
+	ISC_LINK(dns_scentry_t)	hlink;		/*%< hash chain */
+	ISC_LINK(dns_scentry_t)	link;		/*%< age list */
+};
+
+typedef struct dns_scpart {
+	isc_mutex_t		lock;
+	dns_sclist_t		*table;
+	dns_sclist_t		entries;	/*%< oldest first */
+	unsigned int		count;
+	unsigned int		maxcount;
+	unsigned int		nbuckets;
+} dns_scpart_t;
+
+struct dns_sigcache {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	dns_scpart_t		parts[DNS_SIGCACHE_NPARTS];
+};
+
+#define SIGCACHE_MAGIC			ISC_MAGIC('S', 'g', 'C', 'a')
+#define VALID_SIGCACHE(m)		ISC_MAGIC_VALID(m, SIGCACHE_MAGIC)
+
+static void
+part_destroy(dns_sigcache_t *sc, dns_scpart_t *part) {
+	DESTROYLOCK(&part->lock);
+	isc_mem_put(sc->mctx, part->table,
+		    part->nbuckets * sizeof(part->table[0]));
+}
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, unsigned int maxentries,
+		    dns_sigcache_t **scp)
+{
+	isc_result_t result;
+	dns_sigcache_t *sc;
+	dns_scpart_t *part;
+	unsigned int i, j;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxentries > 0);
+	REQUIRE(scp != NULL && *scp == NULL);
+
+	sc = isc_mem_get(mctx, sizeof(*sc));
+	if (sc == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(sc, 0, sizeof(*sc));
+	isc_mem_attach(mctx, &sc->mctx);
+
+	for (i = 0; i < DNS_SIGCACHE_NPARTS; i++) {
+		part = &sc->parts[i];
+		part->maxcount = (maxentries + DNS_SIGCACHE_NPARTS - 1) /
+				 DNS_SIGCACHE_NPARTS;
+		part->nbuckets = part->maxcount;
+		part->table = isc_mem_get(mctx, part->nbuckets *
+					  sizeof(part->table[0]));
+		if (part->table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		result = isc_mutex_init(&part->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, part->table,
+				    part->nbuckets * sizeof(part->table[0]));
+			goto cleanup;
+		}
+		for (j = 0; j < part->nbuckets; j++)
+			ISC_LIST_INIT(part->table[j]);
+		ISC_LIST_INIT(part->entries);
+		part->count = 0;
+	}
+
+	sc->magic = SIGCACHE_MAGIC;
+	*scp = sc;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	while (i-- > 0)
+		part_destroy(sc, &sc->parts[i]);
+	isc_mem_putanddetach(&sc->mctx, sc, sizeof(*sc));
+	return (result);
+}
+
+void
+dns_sigcache_destroy(dns_sigcache_t **scp) {
+	dns_sigcache_t *sc;
+	unsigned int i;
+
+	REQUIRE(scp != NULL && VALID_SIGCACHE(*scp));
+	sc = *scp;
+	*scp = NULL;
+
+	dns_sigcache_flush(sc);
+
+	sc->magic = 0;
+	for (i = 0; i < DNS_SIGCACHE_NPARTS; i++)
+		part_destroy(sc, &sc->parts[i]);
+	isc_mem_putanddetach(&sc->mctx, sc, sizeof(*sc));
+}
+
+/*
+ * Make qsort happy.
+ */
+static int
+rdata_compare_wrapper(const void *rdata1, const void *rdata2) {
+	return (dns_rdata_compare((const dns_rdata_t *)rdata1,
+				  (const dns_rdata_t *)rdata2));
+}
+
+static void
+digest_region(isc_sha256_t *ctx, isc_region_t *r) {
+	unsigned char len[2];
+
+	len[0] = (r->length >> 8) & 0xff;
+	len[1] = r->length & 0xff;
+	isc_sha256_update(ctx, len, sizeof(len));
+	isc_sha256_update(ctx, r->base, r->length);
+}
+
+isc_result_t
+dns_sigcache_digest(const dns_name_t *name, dns_rdataset_t *rdataset,
+		    dst_key_t *key, dns_rdata_t *sigrdata, isc_mem_t *mctx,
+		    unsigned char *digest)
+{
+	isc_result_t result;
+	isc_sha256_t ctx;
+	dns_fixedname_t fixed;
+	dns_name_t *lname;
+	dns_rdataset_t rds;
+	dns_rdata_t *rdatas;
+	unsigned char keybuf[DST_KEY_MAXSIZE];
+	unsigned char header[4];
+	isc_buffer_t b;
+	isc_region_t r;
+	int count, i, n;
+
+	REQUIRE(name != NULL);
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(key != NULL);
+	REQUIRE(sigrdata != NULL);
+	REQUIRE(digest != NULL);
+
+	isc_buffer_init(&b, keybuf, sizeof(keybuf));
+	result = dst_key_todns(key, &b);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	count = dns_rdataset_count(rdataset);
+	rdatas = isc_mem_get(mctx, count * sizeof(dns_rdata_t));
+	if (rdatas == NULL)
+		return (ISC_R_NOMEMORY);
+
+	i = 0;
+	dns_rdataset_init(&rds);
+	dns_rdataset_clone(rdataset, &rds);
+	for (result = dns_rdataset_first(&rds);
+	     result == ISC_R_SUCCESS && i < count;
+	     result = dns_rdataset_next(&rds))
+	{
+		dns_rdata_init(&rdatas[i]);
+		dns_rdataset_current(&rds, &rdatas[i++]);
+	}
+	qsort(rdatas, i, sizeof(dns_rdata_t), rdata_compare_wrapper);
+
+	isc_sha256_init(&ctx);
+
+	lname = dns_fixedname_initname(&fixed);
+	RUNTIME_CHECK(dns_name_downcase(name, lname, NULL) == ISC_R_SUCCESS);
+	dns_name_toregion(lname, &r);
+	digest_region(&ctx, &r);
+
+	header[0] = (rdataset->type >> 8) & 0xff;
+	header[1] = rdataset->type & 0xff;
+	header[2] = (rdataset->rdclass >> 8) & 0xff;
+	header[3] = rdataset->rdclass & 0xff;
+	isc_sha256_update(&ctx, header, sizeof(header));
+
+	for (n = 0; n < i; n++) {
+		/*
+		 * Duplicates are not signed, so they must not count.
+		 */
+		if (n > 0 && dns_rdata_compare(&rdatas[n], &rdatas[n - 1]) == 0)
+			continue;
+		dns_rdata_toregion(&rdatas[n], &r);
+		digest_region(&ctx, &r);
+	}
+
+	dns_rdata_toregion(sigrdata, &r);
+	digest_region(&ctx, &r);
+
+	isc_buffer_usedregion(&b, &r);
+	digest_region(&ctx, &r);
+
+	isc_sha256_final(digest, &ctx);
+
+	dns_rdataset_disassociate(&rds);
+	isc_mem_put(mctx, rdatas, count * sizeof(dns_rdata_t));
+
+	return (ISC_R_SUCCESS);
+}
+
+static inline dns_scpart_t *
+getpart(dns_sigcache_t *sc, const unsigned char *digest,
+	unsigned int *bucketp)
+{
+	dns_scpart_t *part;
+	uint32_t hashval;
+
+	hashval = isc_hash_function(digest, DNS_SIGCACHE_DIGESTLENGTH,
+				    true, NULL);
+	part = &sc->parts[hashval % DNS_SIGCACHE_NPARTS];
+	*bucketp = (hashval / DNS_SIGCACHE_NPARTS) % part->nbuckets;
+	return (part);
+}
+
+/*
+ * The partition must be locked.
+ */
+static void
+unlink_entry(dns_sigcache_t *sc, dns_scpart_t *part, dns_scentry_t *entry) {
+	ISC_LIST_UNLINK(part->table[entry->bucket], entry, hlink);
+	ISC_LIST_UNLINK(part->entries, entry, link);
+	part->count--;
+	isc_mem_put(sc->mctx, entry, sizeof(*entry));
+}
+
+/*
+ * Search 'bucket' of 'part' for 'digest', cleaning out expired entries
+ * as we go.  The partition must be locked.
+ */
+static dns_scentry_t *
+part_search(dns_sigcache_t *sc, dns_scpart_t *part, unsigned int bucket,
+	    const unsigned char *digest, isc_stdtime_t now)
+{
+	dns_scentry_t *entry, *next;
+
+	for (entry = ISC_LIST_HEAD(part->table[bucket]);
+	     entry != NULL;
+	     entry = next)
+	{
+		next = ISC_LIST_NEXT(entry, hlink);
+		if (entry->expire <= now) {
+			unlink_entry(sc, part, entry);
+			continue;
+		}
+		if (memcmp(entry->digest, digest,
+			   DNS_SIGCACHE_DIGESTLENGTH) == 0)
+			return (entry);
+	}
+
+	return (NULL);
+}
+
+bool
+dns_sigcache_find(dns_sigcache_t *sc, const unsigned char *digest,
+		  isc_stdtime_t now)
+{
+	dns_scpart_t *part;
+	dns_scentry_t *entry;
+	unsigned int bucket;
+
+	REQUIRE(VALID_SIGCACHE(sc));
+	REQUIRE(digest != NULL);
+
+	part = getpart(sc, digest, &bucket);
+
+	LOCK(&part->lock);
+	entry = part_search(sc, part, bucket, digest, now);
+	UNLOCK(&part->lock);
+
+	return (entry != NULL);
+}
+
+void
+dns_sigcache_add(dns_sigcache_t *sc, const unsigned char *digest,
+		 isc_stdtime_t now, isc_stdtime_t expire)
+{
+	dns_scpart_t *part;
+	dns_scentry_t *entry;
+	unsigned int bucket;
+
+	REQUIRE(VALID_SIGCACHE(sc));
+	REQUIRE(digest != NULL);
+
+	if (expire <= now)
+		return;
+
+	part = getpart(sc, digest, &bucket);
+
+	LOCK(&part->lock);
+	entry = part_search(sc, part, bucket, digest, now);
+	if (entry != NULL) {
+		if (entry->expire < expire)
+			entry->expire = expire;
+		goto unlock;
+	}
+
+	/*
+	 * Make room by evicting the oldest entries.
+	 */
+	while (part->count >= part->maxcount)
+		unlink_entry(sc, part, ISC_LIST_HEAD(part->entries));
+
+	entry = isc_mem_get(sc->mctx, sizeof(*entry));
+	if (entry == NULL)
+		goto unlock;
+	memmove(entry->digest, digest, DNS_SIGCACHE_DIGESTLENGTH);
+	entry->expire = expire;
+	entry->bucket = bucket;
+	ISC_LINK_INIT(entry, hlink);
+	ISC_LINK_INIT(entry, link);
+	ISC_LIST_PREPEND(part->table[bucket], entry, hlink);
+	ISC_LIST_APPEND(part->entries, entry, link);
+	part->count++;
+
+ unlock:
+	UNLOCK(&part->lock);
+}
+
+void
+dns_sigcache_flush(dns_sigcache_t *sc) {
+	dns_scpart_t *part;
+	dns_scentry_t *entry;
+	unsigned int i;
+
+	REQUIRE(VALID_SIGCACHE(sc));
+
+	for (i = 0; i < DNS_SIGCACHE_NPARTS; i++) {
+		part = &sc->parts[i];
+		LOCK(&part->lock);
+		while ((entry = ISC_LIST_HEAD(part->entries)) != NULL)
+			unlink_entry(sc, part, entry);
+		INSIST(part->count == 0);
+		UNLOCK(&part->lock);
+	}
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/event.h>
+#include <isc/netaddr.h>
+#include <isc/sockaddr.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/task.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include <dns/adb.h>
+#include <dns/events.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+#define NADDRS	20000
+
+static dns_view_t *view = NULL;
+static dns_adb_t *adb = NULL;
+static bool shutdown_done = false;
+
+static void
+setup(void) {
+	isc_result_t result;
+
+	result = dns_test_begin(NULL, true);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_makeview("view", &view);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_adb_create(mctx, view, timermgr, taskmgr, &adb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+adb_shutdown(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	shutdown_done = true;
+	isc_event_free(&event);
+}
+
+static void
+teardown(void) {
+	isc_event_t *event;
+
+	/*
+	 * The ADB uses the view's statistics until it is gone, so wait
+	 * for it before detaching the view.
+	 */
+	shutdown_done = false;
+	event = isc_event_allocate(mctx, NULL, DNS_EVENT_VIEWADBSHUTDOWN,
+				   adb_shutdown, NULL, sizeof(*event));
+	ATF_REQUIRE(event != NULL);
+	dns_adb_whenshutdown(adb, maintask, &event);
+	dns_adb_shutdown(adb);
+	dns_adb_detach(&adb);
+	while (!shutdown_done)
+		dns_test_nap(1000);
+
+	dns_view_detach(&view);
+	dns_test_end();
+}
+
+static void
+mkaddr(unsigned int i, isc_sockaddr_t *sa) {
+	struct in_addr ina;
+
+	ina.s_addr = htonl(0x0a000000 | i);
+	isc_sockaddr_fromin(sa, &ina, 53);
+}
+
+static void
+getstat(isc_statscounter_t counter, uint64_t value, void *arg) {
+	uint64_t *values = arg;
+
+	values[counter] = value;
+}
+
+ATF_TC(grow);
+ATF_TC_HEAD(grow, tc) {
+	atf_tc_set_md_var(tc, "descr", "address table growth");
+}
+ATF_TC_BODY(grow, tc) {
+	static dns_adbaddrinfo_t *addrs[NADDRS];
+	uint64_t before[dns_adbstats_max], after[dns_adbstats_max];
+	dns_adbaddrinfo_t *addr;
+	isc_sockaddr_t sa;
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	setup();
+	isc_stdtime_get(&now);
+
+	isc_stats_dump(view->adbstats, getstat, before, ISC_STATSDUMP_VERBOSE);
+
+	/*
+	 * Enough addresses that every bucket has to grow its table.
+	 */
+	for (i = 0; i < NADDRS; i++) {
+		mkaddr(i, &sa);
+		addrs[i] = NULL;
+		result = dns_adb_findaddrinfo(adb, &sa, &addrs[i], now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	isc_stats_dump(view->adbstats, getstat, after, ISC_STATSDUMP_VERBOSE);
+	ATF_CHECK(after[dns_adbstats_nentries] >
+		  before[dns_adbstats_nentries]);
+	ATF_CHECK_EQ(after[dns_adbstats_entriescnt], NADDRS);
+
+	/*
+	 * Every address must still be found, and map to the same entry.
+	 */
+	for (i = 0; i < NADDRS; i++) {
+		mkaddr(i, &sa);
+		addr = NULL;
+		result = dns_adb_findaddrinfo(adb, &sa, &addr, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK_EQ(addr->entry, addrs[i]->entry);
+		dns_adb_freeaddrinfo(adb, &addr);
+	}
+
+	for (i = 0; i < NADDRS; i++)
+		dns_adb_freeaddrinfo(adb, &addrs[i]);
+
+	teardown();
+}
+
+ATF_TC(udpfetch);
+ATF_TC_HEAD(udpfetch, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_adb_beginudpfetch/endudpfetch");
+}
+ATF_TC_BODY(udpfetch, tc) {
+	dns_adbaddrinfo_t *addr = NULL;
+	isc_sockaddr_t sa;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+	isc_stdtime_get(&now);
+
+	dns_adb_setquota(adb, 2, 0, 0.1, 0.3, 0.7);
+
+	mkaddr(1, &sa);
+	result = dns_adb_findaddrinfo(adb, &sa, &addr, now);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK(!dns_adbentry_overquota(addr->entry));
+	dns_adb_beginudpfetch(adb, addr);
+	ATF_CHECK(!dns_adbentry_overquota(addr->entry));
+	dns_adb_beginudpfetch(adb, addr);
+	ATF_CHECK(dns_adbentry_overquota(addr->entry));
+
+	/*
+	 * The count of active fetches never goes below zero.
+	 */
+	dns_adb_endudpfetch(adb, addr);
+	dns_adb_endudpfetch(adb, addr);
+	dns_adb_endudpfetch(adb, addr);
+	dns_adb_beginudpfetch(adb, addr);
+	ATF_CHECK(!dns_adbentry_overquota(addr->entry));
+	dns_adb_endudpfetch(adb, addr);
+
+	dns_adb_freeaddrinfo(adb, &addr);
+
+	teardown();
+}
+
+ATF_TC(agesrtt);
+ATF_TC_HEAD(agesrtt, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_adb_agesrtt");
+}
+ATF_TC_BODY(agesrtt, tc) {
+	dns_adbaddrinfo_t *addr = NULL;
+	isc_sockaddr_t sa;
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int srtt;
+
+	UNUSED(tc);
+
+	setup();
+	isc_stdtime_get(&now);
+
+	mkaddr(1, &sa);
+	result = dns_adb_findaddrinfo(adb, &sa, &addr, now);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_adb_adjustsrtt(adb, addr, 100000, 0);
+	ATF_CHECK_EQ(addr->srtt, 100000);
+
+	/*
+	 * An entry is aged at most once a second.
+	 */
+	dns_adb_agesrtt(adb, addr, now);
+	srtt = addr->srtt;
+	ATF_CHECK(srtt < 100000);
+	dns_adb_agesrtt(adb, addr, now);
+	ATF_CHECK_EQ(addr->srtt, srtt);
+	dns_adb_agesrtt(adb, addr, now + 1);
+	ATF_CHECK(addr->srtt < srtt);
+
+	dns_adb_freeaddrinfo(adb, &addr);
+
+	teardown();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, grow);
+	ATF_TP_ADD_TC(tp, udpfetch);
+	ATF_TP_ADD_TC(tp, agesrtt);
+
+	return (atf_no_error());
+}
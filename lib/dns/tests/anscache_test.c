@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/print.h>
+#include <isc/util.h>
+
+#include <dns/anscache.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include "dnstest.h"
+
+ATF_TC(find);
+ATF_TC_HEAD(find, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "responses are found by exact name, type "
+			  "and variant");
+}
+ATF_TC_BODY(find, tc) {
+	dns_anscache_t *ac = NULL;
+	dns_fixedname_t fwww, fupper, fbig;
+	dns_name_t *www, *upper, *big;
+	unsigned char wire[DNS_ANSCACHE_MAXLENGTH + 1];
+	unsigned char data[DNS_ANSCACHE_MAXLENGTH];
+	isc_region_t r;
+	isc_buffer_t b;
+	isc_result_t result;
+	unsigned int info = 0;
+	uint32_t gen;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_anscache_create(mctx, 100, &ac);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("www.example.", &fwww);
+	www = dns_fixedname_name(&fwww);
+	dns_test_namefromstring("WWW.example.", &fupper);
+	upper = dns_fixedname_name(&fupper);
+	dns_test_namefromstring("big.example.", &fbig);
+	big = dns_fixedname_name(&fbig);
+
+	/*
+	 * The cached "responses" are just runs of one byte value.
+	 */
+	gen = dns_anscache_generation(ac);
+	memset(wire, 0xaa, 100);
+	r.base = wire;
+	r.length = 100;
+	result = dns_anscache_add(ac, www, dns_rdatatype_a, 512, gen, 7, &r);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	memset(wire, 0xbb, 200);
+	r.length = 200;
+	result = dns_anscache_add(ac, www, dns_rdatatype_a, 4096, gen, 8, &r);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	memset(wire, 0xcc, 100);
+	r.length = 100;
+	result = dns_anscache_add(ac, www, dns_rdatatype_a, 512, gen, 9, &r);
+	ATF_CHECK_EQ(result, ISC_R_EXISTS);
+	ATF_CHECK_EQ(dns_anscache_count(ac), 2);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_anscache_find(ac, www, dns_rdatatype_a, 512, &b, &info);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(info, 7);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), 100);
+	ATF_CHECK_EQ(data[0], 0xaa);
+	ATF_CHECK_EQ(data[99], 0xaa);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_anscache_find(ac, www, dns_rdatatype_a, 4096, &b, &info);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(info, 8);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), 200);
+	ATF_CHECK_EQ(data[0], 0xbb);
+
+	/* The query name is matched case-sensitively. */
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_anscache_find(ac, upper, dns_rdatatype_a, 512, &b, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = dns_anscache_find(ac, www, dns_rdatatype_aaaa, 512, &b, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = dns_anscache_find(ac, www, dns_rdatatype_a, 1232, &b, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), 0);
+
+	/* A buffer which is too small is left alone. */
+	isc_buffer_init(&b, data, 150);
+	result = dns_anscache_find(ac, www, dns_rdatatype_a, 4096, &b, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), 0);
+
+	/* Oversized responses are refused. */
+	memset(wire, 0, sizeof(wire));
+	r.length = DNS_ANSCACHE_MAXLENGTH + 1;
+	result = dns_anscache_add(ac, big, dns_rdatatype_txt, 0, gen, 0, &r);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	dns_anscache_detach(&ac);
+	dns_test_end();
+}
+
+ATF_TC(flush);
+ATF_TC_HEAD(flush, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "flushing empties the cache and refuses responses "
+			  "from earlier generations");
+}
+ATF_TC_BODY(flush, tc) {
+	dns_anscache_t *ac = NULL;
+	dns_fixedname_t fwww, fftp;
+	dns_name_t *www, *ftp;
+	unsigned char wire[50];
+	unsigned char data[DNS_ANSCACHE_MAXLENGTH];
+	isc_region_t r;
+	isc_buffer_t b;
+	isc_result_t result;
+	uint32_t gen;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_anscache_create(mctx, 100, &ac);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("www.example.", &fwww);
+	www = dns_fixedname_name(&fwww);
+	dns_test_namefromstring("ftp.example.", &fftp);
+	ftp = dns_fixedname_name(&fftp);
+
+	memset(wire, 1, sizeof(wire));
+	r.base = wire;
+	r.length = sizeof(wire);
+
+	gen = dns_anscache_generation(ac);
+	result = dns_anscache_add(ac, www, dns_rdatatype_a, 0, gen, 0, &r);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	/* An update to the database flushes the cache. */
+	result = dns_anscache_dbupdate(NULL, ac);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_anscache_count(ac), 0);
+	ATF_CHECK(dns_anscache_generation(ac) != gen);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_anscache_find(ac, www, dns_rdatatype_a, 0, &b, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* A response looked up before the flush is not cached. */
+	result = dns_anscache_add(ac, ftp, dns_rdatatype_a, 0, gen, 0, &r);
+	ATF_CHECK_EQ(result, ISC_R_CANCELED);
+	ATF_CHECK_EQ(dns_anscache_count(ac), 0);
+
+	gen = dns_anscache_generation(ac);
+	result = dns_anscache_add(ac, ftp, dns_rdatatype_a, 0, gen, 0, &r);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_anscache_count(ac), 1);
+
+	dns_anscache_detach(&ac);
+	dns_test_end();
+}
+
+ATF_TC(evict);
+ATF_TC_HEAD(evict, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "the cache stays within its size, keeping "
+			  "responses that are in use");
+}
+ATF_TC_BODY(evict, tc) {
+	dns_anscache_t *ac = NULL;
+	dns_fixedname_t fname, ffirst;
+	dns_name_t *name, *first;
+	unsigned char wire[64];
+	unsigned char data[DNS_ANSCACHE_MAXLENGTH];
+	char namestr[64];
+	isc_region_t r;
+	isc_buffer_t b;
+	isc_result_t result;
+	unsigned int i;
+	uint32_t gen;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_anscache_create(mctx, 10, &ac);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_anscache_getmaxentries(ac), 10);
+
+	dns_test_namefromstring("n0.example.", &ffirst);
+	first = dns_fixedname_name(&ffirst);
+
+	gen = dns_anscache_generation(ac);
+	for (i = 0; i < 1000; i++) {
+		snprintf(namestr, sizeof(namestr), "n%u.example.", i);
+		dns_test_namefromstring(namestr, &fname);
+		name = dns_fixedname_name(&fname);
+		memset(wire, i & 0xff, sizeof(wire));
+		r.base = wire;
+		r.length = sizeof(wire);
+		result = dns_anscache_add(ac, name, dns_rdatatype_a, 0, gen,
+					  i, &r);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+		/* Keep looking up the first response. */
+		isc_buffer_init(&b, data, sizeof(data));
+		result = dns_anscache_find(ac, first, dns_rdatatype_a, 0,
+					   &b, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+		ATF_CHECK(dns_anscache_count(ac) <= 10);
+	}
+	ATF_CHECK_EQ(dns_anscache_count(ac), 10);
+
+	/* The most recent response is still there. */
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_anscache_find(ac, name, dns_rdatatype_a, 0, &b, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_test_namefromstring("n500.example.", &fname);
+	name = dns_fixedname_name(&fname);
+	result = dns_anscache_find(ac, name, dns_rdatatype_a, 0, &b, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_anscache_detach(&ac);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, find);
+	ATF_TP_ADD_TC(tp, flush);
+	ATF_TP_ADD_TC(tp, evict);
+	return (atf_no_error());
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+
+#include <isc/print.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/badcache.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include "dnstest.h"
+
+ATF_TC(find);
+ATF_TC_HEAD(find, tc) {
+	atf_tc_set_md_var(tc, "descr", "entries are found by name and type");
+}
+ATF_TC_BODY(find, tc) {
+	dns_badcache_t *bc = NULL;
+	dns_fixedname_t fwww, fupper, fftp;
+	dns_name_t *www, *upper, *ftp;
+	isc_interval_t interval;
+	isc_time_t now, expire;
+	uint32_t flags = 0;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_badcache_init(mctx, 1021, &bc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	TIME_NOW(&now);
+	isc_interval_set(&interval, 600, 0);
+	result = isc_time_add(&now, &interval, &expire);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("www.example.", &fwww);
+	www = dns_fixedname_name(&fwww);
+	dns_test_namefromstring("WWW.Example.", &fupper);
+	upper = dns_fixedname_name(&fupper);
+	dns_test_namefromstring("ftp.example.", &fftp);
+	ftp = dns_fixedname_name(&fftp);
+
+	dns_badcache_add(bc, www, dns_rdatatype_a, false, 1, &expire);
+	dns_badcache_add(bc, www, dns_rdatatype_aaaa, false, 2, &expire);
+
+	ATF_CHECK(dns_badcache_find(bc, upper, dns_rdatatype_a, &flags, &now));
+	ATF_CHECK_EQ(flags, 1);
+	ATF_CHECK(dns_badcache_find(bc, www, dns_rdatatype_aaaa,
+				    &flags, &now));
+	ATF_CHECK_EQ(flags, 2);
+	ATF_CHECK(!dns_badcache_find(bc, www, dns_rdatatype_mx, NULL, &now));
+	ATF_CHECK(!dns_badcache_find(bc, ftp, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_destroy(&bc);
+	dns_test_end();
+}
+
+ATF_TC(flush);
+ATF_TC_HEAD(flush, tc) {
+	atf_tc_set_md_var(tc, "descr", "names and trees can be flushed");
+}
+ATF_TC_BODY(flush, tc) {
+	dns_badcache_t *bc = NULL;
+	dns_fixedname_t fwww, fftp, fnet, fexample;
+	dns_name_t *www, *ftp, *net, *example;
+	isc_interval_t interval;
+	isc_time_t now, expire;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_badcache_init(mctx, 1021, &bc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	TIME_NOW(&now);
+	isc_interval_set(&interval, 600, 0);
+	result = isc_time_add(&now, &interval, &expire);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("www.example.", &fwww);
+	www = dns_fixedname_name(&fwww);
+	dns_test_namefromstring("ftp.example.", &fftp);
+	ftp = dns_fixedname_name(&fftp);
+	dns_test_namefromstring("www.example.net.", &fnet);
+	net = dns_fixedname_name(&fnet);
+	dns_test_namefromstring("example.", &fexample);
+	example = dns_fixedname_name(&fexample);
+
+	dns_badcache_add(bc, www, dns_rdatatype_a, false, 0, &expire);
+	dns_badcache_add(bc, www, dns_rdatatype_aaaa, false, 0, &expire);
+	dns_badcache_add(bc, ftp, dns_rdatatype_a, false, 0, &expire);
+	dns_badcache_add(bc, net, dns_rdatatype_a, false, 0, &expire);
+
+	dns_badcache_flushname(bc, www);
+	ATF_CHECK(!dns_badcache_find(bc, www, dns_rdatatype_a, NULL, &now));
+	ATF_CHECK(!dns_badcache_find(bc, www, dns_rdatatype_aaaa, NULL, &now));
+	ATF_CHECK(dns_badcache_find(bc, ftp, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_flushtree(bc, example);
+	ATF_CHECK(!dns_badcache_find(bc, ftp, dns_rdatatype_a, NULL, &now));
+	ATF_CHECK(dns_badcache_find(bc, net, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_flush(bc);
+	ATF_CHECK(!dns_badcache_find(bc, net, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_destroy(&bc);
+	dns_test_end();
+}
+
+ATF_TC(resize);
+ATF_TC_HEAD(resize, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "entries survive the table growing and shrinking");
+}
+ATF_TC_BODY(resize, tc) {
+	dns_badcache_t *bc = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	isc_interval_t interval;
+	isc_time_t now, expire;
+	char namestr[64];
+	uint32_t flags;
+	unsigned int i, missing = 0;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * One bucket per partition, so the tables have to grow many
+	 * times over while entries are being added.
+	 */
+	result = dns_badcache_init(mctx, 1, &bc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	TIME_NOW(&now);
+	isc_interval_set(&interval, 600, 0);
+	result = isc_time_add(&now, &interval, &expire);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 5000; i++) {
+		snprintf(namestr, sizeof(namestr), "n%u.example.", i);
+		dns_test_namefromstring(namestr, &fname);
+		name = dns_fixedname_name(&fname);
+		dns_badcache_add(bc, name, dns_rdatatype_a, false, i, &expire);
+	}
+
+	for (i = 0; i < 5000; i++) {
+		snprintf(namestr, sizeof(namestr), "n%u.example.", i);
+		dns_test_namefromstring(namestr, &fname);
+		name = dns_fixedname_name(&fname);
+		flags = 0;
+		if (!dns_badcache_find(bc, name, dns_rdatatype_a,
+				       &flags, &now) || flags != i)
+		{
+			missing++;
+		}
+	}
+	ATF_CHECK_EQ(missing, 0);
+
+	/*
+	 * Flushing most names lets the tables shrink again as the
+	 * remaining ones are re-added.
+	 */
+	for (i = 0; i < 4900; i++) {
+		snprintf(namestr, sizeof(namestr), "n%u.example.", i);
+		dns_test_namefromstring(namestr, &fname);
+		dns_badcache_flushname(bc, dns_fixedname_name(&fname));
+	}
+	for (i = 4900; i < 5000; i++) {
+		snprintf(namestr, sizeof(namestr), "n%u.example.", i);
+		dns_test_namefromstring(namestr, &fname);
+		name = dns_fixedname_name(&fname);
+		dns_badcache_add(bc, name, dns_rdatatype_a, false, i, &expire);
+	}
+	missing = 0;
+	for (i = 0; i < 5000; i++) {
+		snprintf(namestr, sizeof(namestr), "n%u.example.", i);
+		dns_test_namefromstring(namestr, &fname);
+		name = dns_fixedname_name(&fname);
+		if (dns_badcache_find(bc, name, dns_rdatatype_a,
+				      NULL, &now) != (i >= 4900))
+		{
+			missing++;
+		}
+	}
+	ATF_CHECK_EQ(missing, 0);
+
+	dns_badcache_destroy(&bc);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, find);
+	ATF_TP_ADD_TC(tp, flush);
+	ATF_TP_ADD_TC(tp, resize);
+	return (atf_no_error());
+}
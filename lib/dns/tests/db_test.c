@@ -18,6 +18,10 @@
 #include <unistd.h>
 #include <stdlib.h>
 
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/stdtime.h>
+
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/journal.h>
@@ -262,6 +266,225 @@ ATF_TC_BODY(dns_dbfind_staleok, tc) {
 	isc_mem_detach(&mymctx);
 }
 
+static void
+water(void *arg, int mark) {
+	UNUSED(arg);
+	UNUSED(mark);
+}
+
+static isc_result_t
+lru_add(dns_db_t *db, const char *namestr, isc_stdtime_t now) {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	unsigned char data[] = { 0x0a, 0x00, 0x00, 0x01 };
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fixed);
+	result = dns_name_fromstring(name, namestr, 0, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	rdata.data = data;
+	rdata.length = sizeof(data);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.ttl = 3600;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.rdclass = dns_rdataclass_in;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = dns_db_findnode(db, name, true, &node);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0,
+					    NULL);
+		dns_db_detachnode(db, &node);
+	}
+	dns_rdataset_disassociate(&rdataset);
+
+	return (result);
+}
+
+static isc_result_t
+lru_find(dns_db_t *db, const char *namestr, isc_stdtime_t now) {
+	dns_fixedname_t fixed, foundfixed;
+	dns_name_t *name, *found;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fixed);
+	found = dns_fixedname_initname(&foundfixed);
+	result = dns_name_fromstring(name, namestr, 0, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, now, NULL,
+			     found, &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+
+	return (result);
+}
+
+ATF_TC(lru);
+ATF_TC_HEAD(lru, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "overmem purging spares recently used cache entries");
+}
+ATF_TC_BODY(lru, tc) {
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	isc_stdtime_t now;
+	char namestr[64];
+	int i, cold;
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+
+	result = lru_add(db, "hot.example", now);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < 200; i++) {
+		snprintf(namestr, sizeof(namestr), "cold%d.example", i);
+		result = lru_add(db, namestr, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * From now on every addition finds the cache over its memory
+	 * limit and purges older entries; keep using "hot.example".
+	 */
+	isc_mem_setwater(mymctx, water, NULL, 1, 0);
+	for (i = 0; i < 400; i++) {
+		snprintf(namestr, sizeof(namestr), "new%d.example", i);
+		result = lru_add(db, namestr, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = lru_find(db, "hot.example", now);
+		ATF_REQUIRE_EQ_MSG(result, ISC_R_SUCCESS,
+				   "hot.example purged after %d additions", i);
+	}
+	isc_mem_setwater(mymctx, NULL, NULL, 0, 0);
+
+	cold = 0;
+	for (i = 0; i < 200; i++) {
+		snprintf(namestr, sizeof(namestr), "cold%d.example", i);
+		if (lru_find(db, namestr, now) == ISC_R_SUCCESS)
+			cold++;
+	}
+	ATF_CHECK_MSG(cold < 100, "%d of 200 unused entries survived", cold);
+
+	dns_db_detach(&db);
+	isc_mem_detach(&mymctx);
+}
+
+ATF_TC(coveringnsec);
+ATF_TC_HEAD(coveringnsec, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "cached NSEC records cover names beyond other "
+			  "cached names");
+}
+ATF_TC_BODY(coveringnsec, tc) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed, foundfixed;
+	dns_name_t *name, *found;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	unsigned char data[BUFLEN];
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+
+	/*
+	 * "a.example" NSEC covers everything up to "d.example"; cache
+	 * an unrelated record for "b.example" in between.
+	 */
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in,
+					  dns_rdatatype_nsec, data,
+					  sizeof(data),
+					  "d.example. A RRSIG NSEC");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.ttl = 3600;
+	rdatalist.type = dns_rdatatype_nsec;
+	rdatalist.rdclass = dns_rdataclass_in;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	rdataset.trust = dns_trust_secure;
+
+	dns_test_namefromstring("a.example", &fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_db_findnode(db, name, true, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = lru_add(db, "b.example", now);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("c.example", &fixed);
+	found = dns_fixedname_initname(&foundfixed);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a,
+			     DNS_DBFIND_COVERINGNSEC, now, &node, found,
+			     &rdataset, NULL);
+	ATF_REQUIRE_EQ(result, DNS_R_COVERINGNSEC);
+	ATF_CHECK_EQ(rdataset.type, dns_rdatatype_nsec);
+	dns_test_namefromstring("a.example", &fixed);
+	ATF_CHECK(dns_name_equal(found, name));
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	/*
+	 * Names sorting before the first NSEC owner are not covered.
+	 */
+	dns_test_namefromstring("0.example", &fixed);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a,
+			     DNS_DBFIND_COVERINGNSEC, now, &node, found,
+			     &rdataset, NULL);
+	ATF_CHECK(result != DNS_R_COVERINGNSEC);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
 ATF_TC(class);
 ATF_TC_HEAD(class, tc) {
 	atf_tc_set_md_var(tc, "descr", "database class");
@@ -401,6 +624,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, getoriginnode);
 	ATF_TP_ADD_TC(tp, getsetservestalettl);
 	ATF_TP_ADD_TC(tp, dns_dbfind_staleok);
+	ATF_TP_ADD_TC(tp, lru);
+	ATF_TP_ADD_TC(tp, coveringnsec);
 	ATF_TP_ADD_TC(tp, class);
 	ATF_TP_ADD_TC(tp, dbtype);
 	ATF_TP_ADD_TC(tp, version);
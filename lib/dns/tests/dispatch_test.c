@@ -22,11 +22,13 @@
 #include <isc/app.h>
 #include <isc/buffer.h>
 #include <isc/socket.h>
+#include <isc/stats.h>
 #include <isc/task.h>
 #include <isc/timer.h>
 
 #include <dns/dispatch.h>
 #include <dns/name.h>
+#include <dns/stats.h>
 #include <dns/view.h>
 
 #include "dnstest.h"
@@ -330,6 +332,148 @@ ATF_TC_BODY(dispatch_getnext, tc) {
 	dns_test_end();
 }
 
+static bool connected = false;
+
+static void
+connectdone(isc_task_t *task, isc_event_t *event) {
+	isc_socket_connev_t *ev = (isc_socket_connev_t *)event;
+
+	UNUSED(task);
+
+	ATF_CHECK_EQ(ev->result, ISC_R_SUCCESS);
+	connected = true;
+	isc_event_free(&event);
+}
+
+static void
+noresponse(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+	UNUSED(event);
+
+	ATF_CHECK_MSG(false, "unexpected response");
+}
+
+static void
+connect_entry(dns_dispentry_t *entry, isc_task_t *task,
+	      isc_sockaddr_t *server)
+{
+	isc_result_t result;
+	int i;
+
+	connected = false;
+	result = isc_socket_connect(dns_dispatch_getentrysocket(entry),
+				    server, task, connectdone, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < 100 && !connected; i++)
+		dns_test_nap(10000);
+	ATF_REQUIRE(connected);
+}
+
+static void
+getstat(isc_statscounter_t counter, uint64_t value, void *arg) {
+	uint64_t *values = arg;
+
+	values[counter] = value;
+}
+
+static uint64_t
+sockreuse(isc_stats_t *stats) {
+	uint64_t values[dns_resstatscounter_max];
+
+	memset(values, 0, sizeof(values));
+	isc_stats_dump(stats, getstat, values, ISC_STATSDUMP_VERBOSE);
+	return (values[dns_resstatscounter_dispsockreuse]);
+}
+
+ATF_TC(dispatch_sockreuse);
+ATF_TC_HEAD(dispatch_sockreuse, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "reuse of connected exclusive sockets");
+}
+ATF_TC_BODY(dispatch_sockreuse, tc) {
+	isc_result_t result;
+	isc_stats_t *stats = NULL;
+	isc_task_t *task = NULL;
+	isc_sockaddr_t server1, server2, addr1, addr2;
+	struct in_addr ina;
+	dns_dispentry_t *entry = NULL;
+	unsigned int attrs;
+	uint16_t id;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, true);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mctx, &stats, dns_resstatscounter_max);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_dispatchmgr_create(mctx, &dispatchmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_dispatchmgr_setstats(dispatchmgr, stats);
+
+	ina.s_addr = htonl(INADDR_LOOPBACK);
+	isc_sockaddr_fromin(&local, &ina, 0);
+	isc_sockaddr_fromin(&server1, &ina, 53);
+	isc_sockaddr_fromin(&server2, &ina, 54);
+	attrs = DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_UDP |
+		DNS_DISPATCHATTR_EXCLUSIVE;
+	result = dns_dispatch_getudp(dispatchmgr, socketmgr, taskmgr,
+				     &local, 512, 6, 1024, 17, 19, attrs,
+				     attrs, &dispatch);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * A socket that was connected to a server is kept open when the
+	 * transaction ends...
+	 */
+	result = dns_dispatch_addresponse(dispatch, 0, &server1, task,
+					  noresponse, NULL, &id, &entry,
+					  socketmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(dns_dispatch_getentrysocket(entry),
+					&addr1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	connect_entry(entry, task, &server1);
+	dns_dispatch_removeresponse(&entry, NULL);
+
+	/*
+	 * ...and is used again for the next query to the same server...
+	 */
+	dns_test_nap(200000);
+	result = dns_dispatch_addresponse(dispatch, 0, &server1, task,
+					  noresponse, NULL, &id, &entry,
+					  socketmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(dns_dispatch_getentrysocket(entry),
+					&addr2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(isc_sockaddr_equal(&addr1, &addr2));
+	ATF_CHECK_EQ(sockreuse(stats), 1);
+	dns_dispatch_removeresponse(&entry, NULL);
+
+	/*
+	 * ...but never for another one.
+	 */
+	dns_test_nap(200000);
+	result = dns_dispatch_addresponse(dispatch, 0, &server2, task,
+					  noresponse, NULL, &id, &entry,
+					  socketmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(sockreuse(stats), 1);
+	dns_dispatch_removeresponse(&entry, NULL);
+
+	dns_dispatch_detach(&dispatch);
+	dns_dispatchmgr_destroy(&dispatchmgr);
+	isc_stats_detach(&stats);
+	isc_task_detach(&task);
+
+	dns_test_end();
+}
+
 /*
  * Main
  */
@@ -337,5 +481,6 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, dispatchset_create);
 	ATF_TP_ADD_TC(tp, dispatchset_get);
 	ATF_TP_ADD_TC(tp, dispatch_getnext);
+	ATF_TP_ADD_TC(tp, dispatch_sockreuse);
 	return (atf_no_error());
 }
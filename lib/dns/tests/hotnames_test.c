@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+
+#include <isc/print.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/hotnames.h>
+#include <dns/name.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+ATF_TC(count);
+ATF_TC_HEAD(count, tc) {
+	atf_tc_set_md_var(tc, "descr", "hits are counted per name and type");
+}
+ATF_TC_BODY(count, tc) {
+	dns_view_t *view = NULL;
+	dns_hotnames_t *hn = NULL;
+	dns_fixedname_t fwww, fupper, fftp;
+	dns_name_t *www, *upper, *ftp;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, true);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_makeview("view", &view);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_hotnames_create(mctx, view, taskmgr, timermgr, 100, 10,
+				     &hn);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("www.example.", &fwww);
+	www = dns_fixedname_name(&fwww);
+	dns_test_namefromstring("WWW.Example.", &fupper);
+	upper = dns_fixedname_name(&fupper);
+	dns_test_namefromstring("ftp.example.", &fftp);
+	ftp = dns_fixedname_name(&fftp);
+
+	dns_hotnames_hit(hn, www, dns_rdatatype_a, 300);
+	dns_hotnames_hit(hn, upper, dns_rdatatype_a, 300);
+	dns_hotnames_hit(hn, www, dns_rdatatype_a, 300);
+	dns_hotnames_hit(hn, www, dns_rdatatype_aaaa, 300);
+
+	ATF_CHECK_EQ(dns_hotnames_count(hn, www, dns_rdatatype_a), 3);
+	ATF_CHECK_EQ(dns_hotnames_count(hn, www, dns_rdatatype_aaaa), 1);
+	ATF_CHECK_EQ(dns_hotnames_count(hn, www, dns_rdatatype_mx), 0);
+	ATF_CHECK_EQ(dns_hotnames_count(hn, ftp, dns_rdatatype_a), 0);
+
+	dns_hotnames_shutdown(hn);
+	dns_hotnames_detach(&hn);
+	dns_view_detach(&view);
+	dns_test_end();
+}
+
+ATF_TC(popular);
+ATF_TC_HEAD(popular, tc) {
+	atf_tc_set_md_var(tc, "descr", "popular names are not pushed out");
+}
+ATF_TC_BODY(popular, tc) {
+	dns_view_t *view = NULL;
+	dns_hotnames_t *hn = NULL;
+	dns_fixedname_t fhot, fcold;
+	dns_name_t *hot, *cold;
+	char namestr[64];
+	unsigned int i, tracked = 0;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, true);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_makeview("view", &view);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_hotnames_create(mctx, view, taskmgr, timermgr, 64, 10,
+				     &hn);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("hot.example.", &fhot);
+	hot = dns_fixedname_name(&fhot);
+	for (i = 0; i < 50; i++)
+		dns_hotnames_hit(hn, hot, dns_rdatatype_a, 300);
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(namestr, sizeof(namestr), "cold%u.example.", i);
+		dns_test_namefromstring(namestr, &fcold);
+		cold = dns_fixedname_name(&fcold);
+		dns_hotnames_hit(hn, cold, dns_rdatatype_a, 300);
+	}
+
+	ATF_CHECK(dns_hotnames_count(hn, hot, dns_rdatatype_a) >= 50);
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(namestr, sizeof(namestr), "cold%u.example.", i);
+		dns_test_namefromstring(namestr, &fcold);
+		cold = dns_fixedname_name(&fcold);
+		if (dns_hotnames_count(hn, cold, dns_rdatatype_a) != 0)
+			tracked++;
+	}
+	ATF_CHECK(tracked > 0);
+	ATF_CHECK(tracked < 64);
+
+	dns_hotnames_shutdown(hn);
+	dns_hotnames_detach(&hn);
+	dns_view_detach(&view);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, count);
+	ATF_TP_ADD_TC(tp, popular);
+	return (atf_no_error());
+}
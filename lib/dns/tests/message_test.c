@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/print.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+
+#include "dnstest.h"
+
+/*
+ * Build a response to "example./A" with 'count' A records, each with
+ * a different, uncompressed owner name.
+ */
+static void
+make_response(isc_buffer_t *b, unsigned int count) {
+	char label[16];
+	unsigned int i;
+	size_t len;
+
+	isc_buffer_putuint16(b, 1);			/* id */
+	isc_buffer_putuint16(b, DNS_MESSAGEFLAG_QR);	/* flags */
+	isc_buffer_putuint16(b, 1);			/* qdcount */
+	isc_buffer_putuint16(b, count);			/* ancount */
+	isc_buffer_putuint16(b, 0);			/* nscount */
+	isc_buffer_putuint16(b, 0);			/* arcount */
+
+	isc_buffer_putuint8(b, 7);
+	isc_buffer_putmem(b, (const unsigned char *)"example", 7);
+	isc_buffer_putuint8(b, 0);
+	isc_buffer_putuint16(b, dns_rdatatype_a);
+	isc_buffer_putuint16(b, dns_rdataclass_in);
+
+	for (i = 0; i < count; i++) {
+		snprintf(label, sizeof(label), "host%u", i);
+		len = strlen(label);
+		isc_buffer_putuint8(b, (uint8_t)len);
+		isc_buffer_putmem(b, (const unsigned char *)label,
+				  (unsigned int)len);
+		isc_buffer_putuint8(b, 7);
+		isc_buffer_putmem(b, (const unsigned char *)"example", 7);
+		isc_buffer_putuint8(b, 0);
+		isc_buffer_putuint16(b, dns_rdatatype_a);
+		isc_buffer_putuint16(b, dns_rdataclass_in);
+		isc_buffer_putuint32(b, 300);
+		isc_buffer_putuint16(b, 4);
+		isc_buffer_putuint32(b, 0x0a000000 + i);
+	}
+}
+
+/*
+ * Parse 'wire' into 'msg' and return its text form in 'text'.
+ */
+static void
+parse_totext(dns_message_t *msg, isc_buffer_t *wire, char *text,
+	     size_t size)
+{
+	isc_buffer_t source, target;
+	isc_region_t r;
+	isc_result_t result;
+
+	isc_buffer_usedregion(wire, &r);
+	isc_buffer_init(&source, r.base, r.length);
+	isc_buffer_add(&source, r.length);
+
+	result = dns_message_parse(msg, &source, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&target, text, (unsigned int)size - 1);
+	result = dns_message_totext(msg, &dns_master_style_debug, 0, &target);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	text[isc_buffer_usedlength(&target)] = '\0';
+}
+
+ATF_TC(arena_parse);
+ATF_TC_HEAD(arena_parse, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a message using an arena parses like one that "
+			  "does not, across resets");
+}
+ATF_TC_BODY(arena_parse, tc) {
+	static const unsigned int counts[] = { 1, 20, 20, 3, 500, 500, 0 };
+	static const bool oneblock[] = { true, false, true, true,
+					 false, false, true };
+	static unsigned char wiredata[65535];
+	static char expected[256 * 1024], text[256 * 1024];
+	dns_message_t *pmsg = NULL, *amsg = NULL;
+	isc_buffer_t wire;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &pmsg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_create2(mctx, DNS_MESSAGE_INTENTPARSE,
+				     DNS_MESSAGECREATE_ARENA, &amsg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The large messages need several arena blocks and scratch
+	 * buffers.  The reset after a message with 20 records keeps one
+	 * block big enough for it, so the next one fits in that block;
+	 * 500 records need more than a message keeps, so they never do.
+	 */
+	for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		isc_buffer_init(&wire, wiredata, sizeof(wiredata));
+		make_response(&wire, counts[i]);
+
+		parse_totext(pmsg, &wire, expected, sizeof(expected));
+		parse_totext(amsg, &wire, text, sizeof(text));
+		ATF_CHECK_STREQ(text, expected);
+		ATF_CHECK_EQ(amsg->counts[DNS_SECTION_ANSWER], counts[i]);
+		ATF_CHECK_EQ(ISC_LIST_HEAD(amsg->arenablocks) ==
+			     ISC_LIST_TAIL(amsg->arenablocks), oneblock[i]);
+
+		dns_message_reset(pmsg, DNS_MESSAGE_INTENTPARSE);
+		dns_message_reset(amsg, DNS_MESSAGE_INTENTPARSE);
+		ATF_CHECK(ISC_LIST_HEAD(amsg->arenablocks) ==
+			  ISC_LIST_TAIL(amsg->arenablocks));
+	}
+
+	dns_message_destroy(&pmsg);
+	dns_message_destroy(&amsg);
+
+	dns_test_end();
+}
+
+ATF_TC(arena_temp);
+ATF_TC_HEAD(arena_temp, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "temporary names and rdatasets are reused by a "
+			  "message using an arena");
+}
+ATF_TC_BODY(arena_temp, tc) {
+	dns_message_t *msg = NULL;
+	dns_name_t *name = NULL, *name2 = NULL;
+	dns_rdataset_t *rdataset = NULL, *rdataset2 = NULL;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_message_create2(mctx, DNS_MESSAGE_INTENTRENDER,
+				     DNS_MESSAGECREATE_ARENA, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_message_gettempname(msg, &name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_gettemprdataset(msg, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(!dns_rdataset_isassociated(rdataset));
+
+	/* Returned objects are handed out again. */
+	name2 = name;
+	dns_message_puttempname(msg, &name);
+	ATF_CHECK_EQ(name, NULL);
+	result = dns_message_gettempname(msg, &name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(name, name2);
+
+	rdataset2 = rdataset;
+	dns_message_puttemprdataset(msg, &rdataset);
+	ATF_CHECK_EQ(rdataset, NULL);
+	result = dns_message_gettemprdataset(msg, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(rdataset, rdataset2);
+
+	dns_message_puttempname(msg, &name);
+	dns_message_puttemprdataset(msg, &rdataset);
+
+	/*
+	 * Get more objects than fit in one arena block, then reset and
+	 * start again from the first.
+	 */
+	for (i = 0; i < 1000; i++) {
+		result = dns_message_gettemprdataset(msg, &rdataset);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		rdataset = NULL;
+	}
+	dns_message_reset(msg, DNS_MESSAGE_INTENTRENDER);
+
+	result = dns_message_gettempname(msg, &name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_name_countlabels(name) == 0);
+	dns_message_puttempname(msg, &name);
+
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, arena_parse);
+	ATF_TP_ADD_TC(tp, arena_temp);
+	return (atf_no_error());
+}
@@ -13,6 +13,7 @@
 
 #include <config.h>
 
+#include <ctype.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -278,6 +279,122 @@ ATF_TC_BODY(compression, tc) {
 	dns_test_end();
 }
 
+static unsigned int
+render_name(dns_compress_t *cctx, isc_buffer_t *target, const char *namestr) {
+	dns_fixedname_t fname;
+	unsigned int used = target->used;
+
+	dns_test_namefromstring(namestr, &fname);
+	ATF_REQUIRE_EQ(dns_name_towire(dns_fixedname_name(&fname), cctx,
+				       target), ISC_R_SUCCESS);
+	return (target->used - used);
+}
+
+static void
+check_rendered(isc_buffer_t *source, const char **names, unsigned int count) {
+	dns_decompress_t dctx;
+	dns_fixedname_t fname, fexpected;
+	unsigned char buf[DNS_NAME_MAXWIRE];
+	isc_buffer_t target;
+	unsigned int i;
+
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+
+	isc_buffer_setactive(source, source->used);
+	for (i = 0; i < count; i++) {
+		isc_buffer_init(&target, buf, sizeof(buf));
+		dns_fixedname_init(&fname);
+		ATF_REQUIRE_EQ(dns_name_fromwire(dns_fixedname_name(&fname),
+						 source, &dctx, 0, &target),
+			       ISC_R_SUCCESS);
+		dns_test_namefromstring(names[i], &fexpected);
+		ATF_CHECK(dns_name_equal(dns_fixedname_name(&fname),
+					 dns_fixedname_name(&fexpected)));
+	}
+	dns_decompress_invalidate(&dctx);
+}
+
+ATF_TC(compression_suffixes);
+ATF_TC_HEAD(compression_suffixes, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "name compression finds any rendered suffix");
+}
+ATF_TC_BODY(compression_suffixes, tc) {
+	dns_compress_t cctx;
+	isc_buffer_t source;
+	unsigned char buf[65535];
+	const char *names[] = {
+		"a.b.c.example.org.", "x.y.c.example.org.",
+		"X.Y.C.Example.ORG.", "z.c.example.org.", "example.org."
+	};
+	const char *rolledback[] = {
+		"a.b.c.example.org.", "z.c.example.org.", "X.Y.C.Example.ORG."
+	};
+	const char *many[1000];
+	char manybuf[1000][sizeof("name999.example.org.")];
+	unsigned int i, length;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, false), ISC_R_SUCCESS);
+
+	/*
+	 * Suffixes deeper than the first two labels are found, and
+	 * case is ignored unless requested.
+	 */
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&source, buf, sizeof(buf));
+
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[0]), 19);
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[1]), 6);
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[2]), 2);
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[3]), 4);
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[4]), 2);
+	check_rendered(&source, names, 5);
+
+	/*
+	 * Names rendered after a rollback point are forgotten.
+	 */
+	dns_compress_rollback(&cctx, 19);
+	isc_buffer_subtract(&source, source.used - 19);
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[3]), 4);
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[2]), 6);
+	isc_buffer_first(&source);
+	check_rendered(&source, rolledback, 3);
+	dns_compress_invalidate(&cctx);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_compress_setsensitive(&cctx, true);
+	isc_buffer_init(&source, buf, sizeof(buf));
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[1]), 19);
+	ATF_CHECK_EQ(render_name(&cctx, &source, names[2]), 19);
+	dns_compress_invalidate(&cctx);
+
+	/*
+	 * Enough names to outgrow the embedded table.
+	 */
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&source, buf, sizeof(buf));
+	for (i = 0; i < 1000; i++) {
+		snprintf(manybuf[i], sizeof(manybuf[i]),
+			 "name%u.example.org.", i);
+		many[i] = manybuf[i];
+		length = render_name(&cctx, &source, many[i]);
+		if (i > 0)
+			ATF_CHECK_EQ(length, strcspn(many[i], ".") + 3);
+	}
+	for (i = 0; i < 1000; i++)
+		ATF_CHECK_EQ(render_name(&cctx, &source, many[i]), 2);
+	check_rendered(&source, many, 1000);
+	dns_compress_invalidate(&cctx);
+
+	dns_test_end();
+}
+
 ATF_TC(istat);
 ATF_TC_HEAD(istat, tc) {
 	atf_tc_set_md_var(tc, "descr", "is trust-anchor-telemetry test");
@@ -470,6 +587,219 @@ ATF_TC_BODY(hash, tc) {
 	}
 }
 
+/*
+ * Reference versions of the case-insensitive name functions, working
+ * a label and a byte at a time.
+ */
+static unsigned char
+ref_tolower(unsigned char c) {
+	return ((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+}
+
+static unsigned int
+ref_offsets(const unsigned char *ndata, unsigned int offsets[128]) {
+	unsigned int n = 0, off = 0;
+
+	for (;;) {
+		offsets[n++] = off;
+		if (ndata[off] == 0)
+			return (n);
+		off += ndata[off] + 1;
+	}
+}
+
+static int
+ref_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
+		unsigned int *nlabelsp)
+{
+	unsigned int o1[128], o2[128];
+	unsigned int l1, l2, nlabels = 0;
+	unsigned int i, c1, c2;
+	const unsigned char *p1, *p2;
+	int d;
+
+	l1 = ref_offsets(name1->ndata, o1);
+	l2 = ref_offsets(name2->ndata, o2);
+	while (l1 > 0 && l2 > 0) {
+		p1 = name1->ndata + o1[--l1];
+		p2 = name2->ndata + o2[--l2];
+		c1 = *p1++;
+		c2 = *p2++;
+		for (i = 0; i < ISC_MIN(c1, c2); i++) {
+			d = ref_tolower(p1[i]) - ref_tolower(p2[i]);
+			if (d != 0) {
+				*nlabelsp = nlabels;
+				return (d);
+			}
+		}
+		if (c1 != c2) {
+			*nlabelsp = nlabels;
+			return ((int)c1 - (int)c2);
+		}
+		nlabels++;
+	}
+	*nlabelsp = nlabels;
+	return ((int)l1 - (int)l2);
+}
+
+static int
+ref_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
+	const unsigned char *p1 = name1->ndata, *p2 = name2->ndata;
+	unsigned int i, c1, c2;
+
+	for (;;) {
+		c1 = *p1++;
+		c2 = *p2++;
+		if (c1 != c2)
+			return ((c1 < c2) ? -1 : 1);
+		if (c1 == 0)
+			return (0);
+		for (i = 0; i < c1; i++) {
+			if (ref_tolower(p1[i]) != ref_tolower(p2[i]))
+				return ((ref_tolower(p1[i]) <
+					 ref_tolower(p2[i])) ? -1 : 1);
+		}
+		p1 += c1;
+		p2 += c1;
+	}
+}
+
+static uint32_t lcg = 1;
+
+static unsigned int
+rnd(unsigned int n) {
+	lcg = lcg * 1103515245 + 12345;
+	return ((lcg >> 8) % n);
+}
+
+/*
+ * Make a random absolute name in wire format, using bytes that are
+ * letters of both cases or lie next to them.
+ */
+static unsigned int
+random_wire(unsigned char *wire) {
+	static const unsigned char chars[] =
+		"AMZamz@[`{09-_\x00\x7f\xc1\xda\xff";
+	unsigned int labels, len = 0, i, count;
+
+	labels = 1 + rnd(8);
+	while (labels-- > 0) {
+		count = 1 + rnd((rnd(4) == 0) ? 63 : 12);
+		if (len + count + 2 > DNS_NAME_MAXWIRE)
+			break;
+		wire[len++] = count;
+		for (i = 0; i < count; i++)
+			wire[len++] = chars[rnd(sizeof(chars) - 1)];
+	}
+	wire[len++] = 0;
+	return (len);
+}
+
+static void
+wire_toname(unsigned char *wire, unsigned int len, dns_fixedname_t *fixed) {
+	isc_region_t r;
+
+	r.base = wire;
+	r.length = len;
+	dns_name_fromregion(dns_fixedname_initname(fixed), &r);
+}
+
+static int
+sign(int x) {
+	return ((x > 0) - (x < 0));
+}
+
+ATF_TC(caseless);
+ATF_TC_HEAD(caseless, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "case-insensitive comparison, hashing and "
+			  "downcasing of names of all lengths");
+}
+ATF_TC_BODY(caseless, tc) {
+	unsigned char wire1[DNS_NAME_MAXWIRE], wire2[DNS_NAME_MAXWIRE];
+	unsigned int len1, len2, i, j, n, nlabels, refnlabels;
+	unsigned int offsets[128], labels;
+	dns_fixedname_t f1, f2, fd;
+	dns_name_t *n1, *n2, *nd;
+	isc_result_t result;
+	int order, reforder;
+
+	UNUSED(tc);
+
+	for (n = 0; n < 20000; n++) {
+		len1 = random_wire(wire1);
+		memmove(wire2, wire1, len1);
+		len2 = len1;
+
+		/*
+		 * Swap the case of some letters (label lengths are never
+		 * letters), then maybe make the names different.
+		 */
+		for (i = 0; i < len1; i++) {
+			if (isalpha(wire2[i]) && rnd(2) == 0)
+				wire2[i] ^= 0x20;
+		}
+		switch (rnd(4)) {
+		case 0:
+			break;
+		case 1:
+			/* Change one byte of label data. */
+			labels = ref_offsets(wire2, offsets);
+			j = offsets[rnd(labels - 1)];
+			wire2[j + 1 + rnd(wire2[j])] ^= 1 + rnd(0x7f);
+			break;
+		case 2:
+			/* A name ending in some of the same labels. */
+			labels = ref_offsets(wire1, offsets);
+			j = offsets[rnd(labels)];
+			len2 = random_wire(wire2) - 1;
+			if (len2 + len1 - j > sizeof(wire2))
+				len2 = 0;
+			memmove(wire2 + len2, wire1 + j, len1 - j);
+			len2 += len1 - j;
+			break;
+		case 3:
+			len2 = random_wire(wire2);
+			break;
+		}
+
+		wire_toname(wire1, len1, &f1);
+		wire_toname(wire2, len2, &f2);
+		n1 = dns_fixedname_name(&f1);
+		n2 = dns_fixedname_name(&f2);
+
+		reforder = ref_fullcompare(n1, n2, &refnlabels);
+		(void)dns_name_fullcompare(n1, n2, &order, &nlabels);
+		ATF_CHECK_EQ(sign(order), sign(reforder));
+		ATF_CHECK_EQ(nlabels, refnlabels);
+		ATF_CHECK_EQ(dns_name_equal(n1, n2), reforder == 0);
+		ATF_CHECK_EQ(dns_name_rdatacompare(n1, n2),
+			     ref_rdatacompare(n1, n2));
+		if (reforder == 0) {
+			ATF_CHECK_EQ(dns_name_hash(n1, false),
+				     dns_name_hash(n2, false));
+			ATF_CHECK_EQ(dns_name_fullhash(n1, false),
+				     dns_name_fullhash(n2, false));
+		}
+
+		nd = dns_fixedname_initname(&fd);
+		result = dns_name_downcase(n2, nd, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(nd->length, len2);
+		ATF_CHECK_EQ(nd->labels, n2->labels);
+		for (i = 0; i < len2; i++)
+			ATF_CHECK_EQ(nd->ndata[i], ref_tolower(wire2[i]));
+		ATF_CHECK(dns_name_caseequal(nd, n2) ==
+			  (memcmp(nd->ndata, wire2, len2) == 0));
+		ATF_CHECK(dns_name_equal(nd, n2));
+
+		/* Downcasing in place. */
+		result = dns_name_downcase(n2, n2, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_caseequal(nd, n2));
+	}
+}
+
 ATF_TC(issubdomain);
 ATF_TC_HEAD(issubdomain, tc) {
 	atf_tc_set_md_var(tc, "descr", "dns_nane_issubdomain");
@@ -742,6 +1072,195 @@ ATF_TC_BODY(benchmark, tc) {
 	dns_test_end();
 }
 
+ATF_TC(compression_benchmark);
+ATF_TC_HEAD(compression_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Benchmark name compression of a large response");
+}
+ATF_TC_BODY(compression_benchmark, tc) {
+	isc_result_t result;
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	unsigned char buf[65535];
+	dns_fixedname_t *fnames;
+	char namestr[DNS_NAME_FORMATSIZE];
+	unsigned int i, n, count = 0;
+	unsigned int iterations = 100000;
+	isc_time_t ts1, ts2;
+	double t;
+
+	UNUSED(tc);
+
+	debug_mem_record = false;
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	fnames = malloc(200 * sizeof(dns_fixedname_t));
+	ATF_REQUIRE(fnames != NULL);
+
+	/*
+	 * Owner and rdata names in the order they would appear in a
+	 * signed referral with glue, followed by a signed ANY answer
+	 * from deeper in the zone.
+	 */
+#define ADDNAME(...) \
+	do { \
+		snprintf(namestr, sizeof(namestr), __VA_ARGS__); \
+		dns_test_namefromstring(namestr, &fnames[count++]); \
+	} while (0)
+
+	ADDNAME("www.sub.example.com.");
+	for (i = 1; i <= 13; i++) {
+		ADDNAME("sub.example.com.");
+		ADDNAME("ns%u.dns.hosting.example.net.", i);
+	}
+	ADDNAME("sub.example.com.");
+	ADDNAME("example.com.");
+	for (i = 1; i <= 13; i++) {
+		ADDNAME("ns%u.dns.hosting.example.net.", i);
+		ADDNAME("ns%u.dns.hosting.example.net.", i);
+	}
+	for (i = 0; i < 24; i++) {
+		ADDNAME("host-%u.rack-%u.dc1.internal.sub.example.com.",
+			i % 8, i / 8);
+		ADDNAME("host-%u.rack-%u.dc1.internal.sub.example.com.",
+			i % 8, i / 8);
+		ADDNAME("sub.example.com.");
+	}
+#undef ADDNAME
+
+	result = isc_time_now(&ts1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (n = 0; n < iterations; n++) {
+		result = dns_compress_init(&cctx, -1, mctx);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+		isc_buffer_init(&target, buf, sizeof(buf));
+		isc_buffer_add(&target, 12);
+		for (i = 0; i < count; i++) {
+			result = dns_name_towire(dns_fixedname_name(&fnames[i]),
+						 &cctx, &target);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		dns_compress_invalidate(&cctx);
+	}
+
+	result = isc_time_now(&ts2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	t = isc_time_microdiff(&ts2, &ts1);
+
+	printf("%u names, %u bytes, %f ns/message, %f ns/name\n",
+	       count, target.used - 12, t * 1000.0 / iterations,
+	       t * 1000.0 / iterations / count);
+
+	free(fnames);
+
+	dns_test_end();
+}
+
+ATF_TC(caseless_benchmark);
+ATF_TC_HEAD(caseless_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Benchmark case-insensitive name comparison, "
+			  "hashing and downcasing");
+}
+ATF_TC_BODY(caseless_benchmark, tc) {
+	static const char *names[] = {
+		"example.com.",
+		"www.example.com.",
+		"WWW.Example.COM.",
+		"ns1.dns.hosting.example.net.",
+		"_ldap._tcp.dc._msdcs.corp.example.org.",
+		"host-3.rack-2.dc1.internal.sub.example.com.",
+		"2.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.8.b.d.0.1.0.0.2.ip6.arpa.",
+		"a-rather-long-label-used-by-some-cdn-0123456789.Example.COM.",
+	};
+	enum { NNAMES = sizeof(names) / sizeof(names[0]) };
+	dns_fixedname_t f1[NNAMES], f2[NNAMES], f3[NNAMES], fout;
+	dns_name_t *n1[NNAMES], *n2[NNAMES], *n3[NNAMES], *out;
+	unsigned int iterations = 5000000;
+	unsigned int i, n, nlabels;
+	unsigned int sum = 0;
+	isc_result_t result;
+	isc_time_t ts1, ts2;
+	int order;
+	double t;
+
+	UNUSED(tc);
+
+	debug_mem_record = false;
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * n2 is n1 with the case of every letter swapped; n3 differs
+	 * from n1 in the last character of its first label.
+	 */
+	for (i = 0; i < NNAMES; i++) {
+		char buf[DNS_NAME_FORMATSIZE];
+		size_t j, len = strlen(names[i]);
+
+		n1[i] = dns_fixedname_initname(&f1[i]);
+		n2[i] = dns_fixedname_initname(&f2[i]);
+		n3[i] = dns_fixedname_initname(&f3[i]);
+
+		result = dns_name_fromstring(n1[i], names[i], 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		for (j = 0; j <= len; j++) {
+			unsigned char c = names[i][j];
+			buf[j] = isalpha(c) ? (c ^ 0x20) : c;
+		}
+		result = dns_name_fromstring(n2[i], buf, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		memmove(buf, names[i], len + 1);
+		buf[strcspn(buf, ".") - 1] = '~';
+		result = dns_name_fromstring(n3[i], buf, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	out = dns_fixedname_initname(&fout);
+
+#define BENCH(what, expr) \
+	do { \
+		result = isc_time_now(&ts1); \
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS); \
+		for (n = 0; n < iterations; n++) { \
+			i = n % NNAMES; \
+			expr; \
+		} \
+		result = isc_time_now(&ts2); \
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS); \
+		t = isc_time_microdiff(&ts2, &ts1); \
+		printf("%-28s %f ns/call\n", what, t * 1000.0 / iterations); \
+	} while (0)
+
+	BENCH("dns_name_equal (equal)",
+	      sum += dns_name_equal(n1[i], n2[i]));
+	BENCH("dns_name_equal (different)",
+	      sum += dns_name_equal(n1[i], n3[i]));
+	BENCH("dns_name_fullcompare",
+	      sum += dns_name_fullcompare(n1[i], n3[i], &order, &nlabels));
+	BENCH("dns_name_rdatacompare",
+	      sum += dns_name_rdatacompare(n1[i], n3[i]));
+	BENCH("dns_name_hash",
+	      sum += dns_name_hash(n1[i], false));
+	BENCH("dns_name_fullhash",
+	      sum += dns_name_fullhash(n1[i], false));
+	BENCH("dns_name_downcase",
+	      sum += dns_name_downcase(n1[i], out, NULL));
+#undef BENCH
+
+	/* Keep the compiler from discarding the calls. */
+	printf("(%u)\n", sum);
+
+	dns_test_end();
+}
+
 #endif /* DNS_BENCHMARK_TESTS */
 
 /*
@@ -750,18 +1269,22 @@ ATF_TC_BODY(benchmark, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, fullcompare);
 	ATF_TP_ADD_TC(tp, compression);
+	ATF_TP_ADD_TC(tp, compression_suffixes);
 	ATF_TP_ADD_TC(tp, istat);
 	ATF_TP_ADD_TC(tp, init);
 	ATF_TP_ADD_TC(tp, invalidate);
 	ATF_TP_ADD_TC(tp, buffer);
 	ATF_TP_ADD_TC(tp, isabsolute);
 	ATF_TP_ADD_TC(tp, hash);
+	ATF_TP_ADD_TC(tp, caseless);
 	ATF_TP_ADD_TC(tp, issubdomain);
 	ATF_TP_ADD_TC(tp, countlabels);
 	ATF_TP_ADD_TC(tp, getlabel);
 	ATF_TP_ADD_TC(tp, getlabelsequence);
 #ifdef DNS_BENCHMARK_TESTS
 	ATF_TP_ADD_TC(tp, benchmark);
+	ATF_TP_ADD_TC(tp, compression_benchmark);
+	ATF_TP_ADD_TC(tp, caseless_benchmark);
 #endif /* DNS_BENCHMARK_TESTS */
 
 	return (atf_no_error());
@@ -16,8 +16,19 @@
 
 #include <atf-c.h>
 
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <isc/buffer.h>
+#include <isc/print.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 
@@ -114,11 +125,299 @@ ATF_TC_BODY(trimttl, tc) {
 	dns_test_end();
 }
 
+
+#define MAXRDATA	8
+
+/*
+ * An rdataset built from the text form of up to MAXRDATA rdata.
+ */
+typedef struct {
+	dns_rdatalist_t		rdatalist;
+	dns_rdataset_t		rdataset;
+	dns_rdata_t		rdata[MAXRDATA];
+	unsigned char		data[MAXRDATA][512];
+} testset_t;
+
+static void
+make_rdataset(testset_t *ts, dns_rdataclass_t rdclass,
+	      dns_rdatatype_t type, const char **texts)
+{
+	isc_result_t result;
+	unsigned int i;
+
+	dns_rdatalist_init(&ts->rdatalist);
+	ts->rdatalist.rdclass = rdclass;
+	ts->rdatalist.type = type;
+	ts->rdatalist.ttl = 3600;
+
+	for (i = 0; texts[i] != NULL; i++) {
+		ATF_REQUIRE(i < MAXRDATA);
+		dns_rdata_init(&ts->rdata[i]);
+		result = dns_test_rdatafromstring(&ts->rdata[i], rdclass, type,
+						  ts->data[i],
+						  sizeof(ts->data[i]),
+						  texts[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ISC_LIST_APPEND(ts->rdatalist.rdata, &ts->rdata[i], link);
+	}
+
+	dns_rdataset_init(&ts->rdataset);
+	result = dns_rdatalist_tordataset(&ts->rdatalist, &ts->rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static const char *a_texts[] = {
+	"192.0.2.1", "192.0.2.2", NULL
+};
+static const char *aaaa_texts[] = {
+	"2001:db8::1", "2001:db8::2", "2001:db8::3", NULL
+};
+static const char *txt_texts[] = {
+	"\"v=spf1 -all\"", "\"some\" \"strings\"", NULL
+};
+static const char *ds_texts[] = {
+	"12345 8 2 "
+	"49FD46E6C4B45C55D4AC69CBD3CD34AC1AFE51DE4C6D1E7F2A3B2C1D0E9F8A7B",
+	NULL
+};
+static const char *rrsig_texts[] = {
+	"A 8 3 3600 20181231000000 20181201000000 12345 example. "
+	"ZGVhZGJlZWZkZWFkYmVlZmRlYWRiZWVmZGVhZGJlZWZkZWFkYmVlZmRlYWRiZWVm",
+	NULL
+};
+
+ATF_TC(towirecopy);
+ATF_TC_HEAD(towirecopy, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "dns_rdata_towire() copies rdata for which "
+			  "dns_rdatatype_towirecopy() is true");
+}
+ATF_TC_BODY(towirecopy, tc) {
+	struct {
+		dns_rdatatype_t type;
+		const char **texts;
+	} tests[] = {
+		{ dns_rdatatype_a, a_texts },
+		{ dns_rdatatype_aaaa, aaaa_texts },
+		{ dns_rdatatype_txt, txt_texts },
+		{ dns_rdatatype_ds, ds_texts },
+		{ dns_rdatatype_rrsig, rrsig_texts },
+	};
+	unsigned char buf[1024];
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	isc_result_t result;
+	unsigned int i, j;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		testset_t ts;
+
+		ATF_CHECK(dns_rdatatype_towirecopy(dns_rdataclass_in,
+						   tests[i].type));
+		make_rdataset(&ts, dns_rdataclass_in, tests[i].type,
+			      tests[i].texts);
+
+		for (j = 0; tests[i].texts[j] != NULL; j++) {
+			result = dns_compress_init(&cctx, -1, mctx);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+			isc_buffer_init(&target, buf, sizeof(buf));
+			result = dns_rdata_towire(&ts.rdata[j], &cctx,
+						  &target);
+			ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+			ATF_CHECK_EQ(target.used, ts.rdata[j].length);
+			ATF_CHECK(memcmp(buf, ts.rdata[j].data,
+					 ts.rdata[j].length) == 0);
+			dns_compress_invalidate(&cctx);
+		}
+
+		dns_rdataset_disassociate(&ts.rdataset);
+	}
+
+	ATF_CHECK(!dns_rdatatype_towirecopy(dns_rdataclass_in,
+					    dns_rdatatype_ns));
+	ATF_CHECK(!dns_rdatatype_towirecopy(dns_rdataclass_in,
+					    dns_rdatatype_mx));
+	ATF_CHECK(!dns_rdatatype_towirecopy(dns_rdataclass_in,
+					    dns_rdatatype_soa));
+	ATF_CHECK(!dns_rdatatype_towirecopy(dns_rdataclass_in,
+					    dns_rdatatype_nsec));
+	ATF_CHECK(!dns_rdatatype_towirecopy(dns_rdataclass_chaos,
+					    dns_rdatatype_a));
+	ATF_CHECK(dns_rdatatype_towirecopy(dns_rdataclass_in, 65280));
+
+	dns_test_end();
+}
+
+ATF_TC(towire);
+ATF_TC_HEAD(towire, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "dns_rdataset_towire() renders copied rdata "
+			  "with correct lengths and compressed owners");
+}
+ATF_TC_BODY(towire, tc) {
+	static const unsigned char expect[] = {
+		/* www.example. AAAA 2001:db8::1 */
+		3, 'w', 'w', 'w', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0,
+		0, 28, 0, 1, 0, 0, 0x0e, 0x10, 0, 16,
+		0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 1,
+		/* www.example. AAAA 2001:db8::2 */
+		0xc0, 0,
+		0, 28, 0, 1, 0, 0, 0x0e, 0x10, 0, 16,
+		0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 2,
+		/* www.example. AAAA 2001:db8::3 */
+		0xc0, 0,
+		0, 28, 0, 1, 0, 0, 0x0e, 0x10, 0, 16,
+		0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 3,
+	};
+	unsigned char buf[1024];
+	dns_fixedname_t fname;
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	isc_result_t result;
+	unsigned int count = 0;
+	testset_t ts;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("www.example.", &fname);
+	make_rdataset(&ts, dns_rdataclass_in, dns_rdatatype_aaaa,
+		      aaaa_texts);
+
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&target, buf, sizeof(buf));
+	result = dns_rdataset_towire(&ts.rdataset, dns_fixedname_name(&fname),
+				     &cctx, &target, 0, &count);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count, 3);
+	ATF_CHECK_EQ(target.used, sizeof(expect));
+	ATF_CHECK(memcmp(buf, expect, sizeof(expect)) == 0);
+	dns_compress_invalidate(&cctx);
+
+	/*
+	 * Running out of space leaves the buffer as it was.
+	 */
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&target, buf, sizeof(expect) - 1);
+	count = 0;
+	result = dns_rdataset_towire(&ts.rdataset, dns_fixedname_name(&fname),
+				     &cctx, &target, 0, &count);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+	ATF_CHECK_EQ(count, 0);
+	ATF_CHECK_EQ(target.used, 0);
+	dns_compress_invalidate(&cctx);
+
+	dns_rdataset_disassociate(&ts.rdataset);
+
+	dns_test_end();
+}
+
+#ifdef DNS_BENCHMARK_TESTS
+
+ATF_TC(towire_benchmark);
+ATF_TC_HEAD(towire_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Benchmark dns_rdataset_towire() of "
+			  "uncompressible rdata");
+}
+ATF_TC_BODY(towire_benchmark, tc) {
+	struct {
+		dns_rdatatype_t type;
+		const char **texts;
+		testset_t ts;
+	} sets[] = {
+		{ dns_rdatatype_a, a_texts },
+		{ dns_rdatatype_aaaa, aaaa_texts },
+		{ dns_rdatatype_txt, txt_texts },
+		{ dns_rdatatype_ds, ds_texts },
+		{ dns_rdatatype_rrsig, rrsig_texts },
+	};
+	unsigned int nsets = sizeof(sets) / sizeof(sets[0]);
+	unsigned int iterations = 1000000;
+	unsigned char buf[65535];
+	dns_fixedname_t fname;
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	isc_result_t result;
+	isc_time_t ts1, ts2;
+	unsigned int i, n, count = 0;
+	double t;
+
+	UNUSED(tc);
+
+	debug_mem_record = false;
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("www.example.", &fname);
+	for (i = 0; i < nsets; i++) {
+		make_rdataset(&sets[i].ts, dns_rdataclass_in, sets[i].type,
+			      sets[i].texts);
+	}
+
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_time_now(&ts1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (n = 0; n < iterations; n++) {
+		isc_buffer_init(&target, buf, sizeof(buf));
+		for (i = 0; i < nsets; i++) {
+			result = dns_rdataset_towire(&sets[i].ts.rdataset,
+						     dns_fixedname_name(&fname),
+						     &cctx, &target, 0,
+						     &count);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		dns_compress_rollback(&cctx, 0);
+	}
+
+	result = isc_time_now(&ts2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	t = isc_time_microdiff(&ts2, &ts1);
+
+	printf("%u rdatasets, %u records, %u bytes, "
+	       "%f ns/rdataset, %f ns/record\n",
+	       nsets, count / iterations, target.used,
+	       t * 1000.0 / iterations / nsets,
+	       t * 1000.0 / count);
+
+	dns_compress_invalidate(&cctx);
+	for (i = 0; i < nsets; i++) {
+		dns_rdataset_disassociate(&sets[i].ts.rdataset);
+	}
+
+	dns_test_end();
+}
+
+#endif /* DNS_BENCHMARK_TESTS */
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, trimttl);
+	ATF_TP_ADD_TC(tp, towirecopy);
+	ATF_TP_ADD_TC(tp, towire);
+#ifdef DNS_BENCHMARK_TESTS
+	ATF_TP_ADD_TC(tp, towire_benchmark);
+#endif /* DNS_BENCHMARK_TESTS */
 
 	return (atf_no_error());
 }
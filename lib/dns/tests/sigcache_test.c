@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdbool.h>
+
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+#include "dnstest.h"
+
+#define RRSIG1	"A 1 1 300 20380119031407 20000101000000 54622 test. " \
+		"AQID"
+#define RRSIG2	"A 1 1 300 20380119031407 20000101000000 54622 test. " \
+		"BAUG"
+
+static dst_key_t *key = NULL;
+
+static void
+setup(void) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("test.", &fname);
+	result = dst_key_fromfile(dns_fixedname_name(&fname), 54622,
+				  DST_ALG_RSAMD5, DST_TYPE_PUBLIC,
+				  "testdata/dst", mctx, &key);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+teardown(void) {
+	dst_key_free(&key);
+	dns_test_end();
+}
+
+/*
+ * Compute the digest of the A RRset 'owner' made of 'addrs', in that
+ * order, signed by 'sigtext'.
+ */
+static void
+digest(const char *owner, const char **addrs, unsigned int naddrs,
+       const char *sigtext, unsigned char *out)
+{
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdatas[4];
+	unsigned char data[4][16];
+	dns_rdata_t sig = DNS_RDATA_INIT;
+	unsigned char sigdata[512];
+	unsigned int i;
+
+	REQUIRE(naddrs <= 4);
+
+	dns_test_namefromstring(owner, &fname);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	for (i = 0; i < naddrs; i++) {
+		dns_rdata_init(&rdatas[i]);
+		result = dns_test_rdatafromstring(&rdatas[i],
+						  dns_rdataclass_in,
+						  dns_rdatatype_a, data[i],
+						  sizeof(data[i]), addrs[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdatas[i], link);
+	}
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_rdatafromstring(&sig, dns_rdataclass_in,
+					  dns_rdatatype_rrsig, sigdata,
+					  sizeof(sigdata), sigtext);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_digest(dns_fixedname_name(&fname), &rdataset,
+				     key, &sig, mctx, out);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdataset_disassociate(&rdataset);
+}
+
+ATF_TC(digest);
+ATF_TC_HEAD(digest, tc) {
+	atf_tc_set_md_var(tc, "descr", "digests identify the verified tuple");
+}
+ATF_TC_BODY(digest, tc) {
+	const char *ab[] = { "10.0.0.1", "10.0.0.2" };
+	const char *ba[] = { "10.0.0.2", "10.0.0.1" };
+	const char *aba[] = { "10.0.0.1", "10.0.0.2", "10.0.0.1" };
+	const char *ac[] = { "10.0.0.1", "10.0.0.3" };
+	unsigned char d1[DNS_SIGCACHE_DIGESTLENGTH];
+	unsigned char d2[DNS_SIGCACHE_DIGESTLENGTH];
+
+	UNUSED(tc);
+
+	setup();
+
+	digest("www.test.", ab, 2, RRSIG1, d1);
+
+	/* Neither rdata order, owner case nor duplicates matter... */
+	digest("WWW.Test.", ba, 2, RRSIG1, d2);
+	ATF_CHECK(memcmp(d1, d2, sizeof(d1)) == 0);
+	digest("www.test.", aba, 3, RRSIG1, d2);
+	ATF_CHECK(memcmp(d1, d2, sizeof(d1)) == 0);
+
+	/* ...but the owner, the data and the signature do. */
+	digest("ftp.test.", ab, 2, RRSIG1, d2);
+	ATF_CHECK(memcmp(d1, d2, sizeof(d1)) != 0);
+	digest("www.test.", ac, 2, RRSIG1, d2);
+	ATF_CHECK(memcmp(d1, d2, sizeof(d1)) != 0);
+	digest("www.test.", ab, 2, RRSIG2, d2);
+	ATF_CHECK(memcmp(d1, d2, sizeof(d1)) != 0);
+
+	teardown();
+}
+
+ATF_TC(expire);
+ATF_TC_HEAD(expire, tc) {
+	atf_tc_set_md_var(tc, "descr", "entries expire");
+}
+ATF_TC_BODY(expire, tc) {
+	isc_result_t result;
+	dns_sigcache_t *sc = NULL;
+	unsigned char d1[DNS_SIGCACHE_DIGESTLENGTH];
+	unsigned char d2[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t now;
+
+	UNUSED(tc);
+
+	setup();
+
+	result = dns_sigcache_create(mctx, 100, &sc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	memset(d1, 1, sizeof(d1));
+	memset(d2, 2, sizeof(d2));
+	isc_stdtime_get(&now);
+
+	dns_sigcache_add(sc, d1, now, now + 10);
+	ATF_CHECK(dns_sigcache_find(sc, d1, now));
+	ATF_CHECK(dns_sigcache_find(sc, d1, now + 9));
+	ATF_CHECK(!dns_sigcache_find(sc, d1, now + 10));
+	ATF_CHECK(!dns_sigcache_find(sc, d2, now));
+
+	/* Nothing is added for a zero lifetime. */
+	dns_sigcache_add(sc, d2, now, now);
+	ATF_CHECK(!dns_sigcache_find(sc, d2, now));
+
+	dns_sigcache_add(sc, d2, now, now + 10);
+	ATF_CHECK(dns_sigcache_find(sc, d2, now));
+	dns_sigcache_flush(sc);
+	ATF_CHECK(!dns_sigcache_find(sc, d2, now));
+
+	dns_sigcache_destroy(&sc);
+	ATF_CHECK_EQ(sc, NULL);
+
+	teardown();
+}
+
+ATF_TC(bounded);
+ATF_TC_HEAD(bounded, tc) {
+	atf_tc_set_md_var(tc, "descr", "oldest entries are evicted");
+}
+ATF_TC_BODY(bounded, tc) {
+	isc_result_t result;
+	dns_sigcache_t *sc = NULL;
+	unsigned char d[DNS_SIGCACHE_DIGESTLENGTH];
+	unsigned char first[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t now;
+	unsigned int i, found;
+
+	UNUSED(tc);
+
+	setup();
+
+	result = dns_sigcache_create(mctx, 64, &sc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	memset(first, 0xff, sizeof(first));
+	dns_sigcache_add(sc, first, now, now + 3600);
+
+	memset(d, 0, sizeof(d));
+	for (i = 0; i < 10000; i++) {
+		memmove(d, &i, sizeof(i));
+		dns_sigcache_add(sc, d, now, now + 3600);
+	}
+
+	ATF_CHECK(!dns_sigcache_find(sc, first, now));
+
+	found = 0;
+	for (i = 0; i < 10000; i++) {
+		memmove(d, &i, sizeof(i));
+		if (dns_sigcache_find(sc, d, now))
+			found++;
+	}
+	ATF_CHECK(found > 0);
+	ATF_CHECK(found <= 64);
+
+	dns_sigcache_destroy(&sc);
+
+	teardown();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, digest);
+	ATF_TP_ADD_TC(tp, expire);
+	ATF_TP_ADD_TC(tp, bounded);
+	return (atf_no_error());
+}
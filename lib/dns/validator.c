@@ -17,7 +17,9 @@
 #include <isc/base32.h>
 #include <isc/mem.h>
 #include <isc/print.h>
+#include <isc/serial.h>
 #include <isc/sha2.h>
+#include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/util.h>
@@ -39,6 +41,8 @@
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
+#include <dns/sigcache.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
@@ -90,6 +94,8 @@
 						 * have attempted a verify. */
 #define VALATTR_INSECURITY		0x0010	/*%< Attempting proveunsecure. */
 #define VALATTR_DLVTRIED		0x0020	/*%< Looked for a DLV record. */
+#define VALATTR_VERIFYING		0x0040	/*%< Verification handed off. */
+#define VALATTR_VERIFIED		0x0080	/*%< 'verifyresult' is set. */
 
 /*!
  * NSEC proofs to be looked for.
@@ -137,6 +143,9 @@ get_dst_key(dns_validator_t *val, dns_rdata_rrsig_t *siginfo,
 static isc_result_t
 validate(dns_validator_t *val, bool resume);
 
+static void
+verified(isc_task_t *task, isc_event_t *event);
+
 static isc_result_t
 validatezonekey(dns_validator_t *val);
 
@@ -224,7 +233,8 @@ exit_check(dns_validator_t *val) {
 
 	INSIST(val->event == NULL);
 
-	if (val->fetch != NULL || val->subvalidator != NULL)
+	if (val->fetch != NULL || val->subvalidator != NULL ||
+	    (val->attributes & VALATTR_VERIFYING) != 0)
 		return (false);
 
 	return (true);
@@ -1489,36 +1499,102 @@ isselfsigned(dns_validator_t *val) {
 	return (answer);
 }
 
+static inline void
+inc_stats(dns_validator_t *val, isc_statscounter_t counter) {
+	if (val->view->resstats != NULL)
+		isc_stats_increment(val->view->resstats, counter);
+}
+
 /*%
- * Attempt to verify the rdataset using the given key and rdata (RRSIG).
- * The signature was good and from a wildcard record and the QNAME does
- * not match the wildcard we need to look for a NOQNAME proof.
- *
- * Returns:
- * \li	ISC_R_SUCCESS if the verification succeeds.
- * \li	Others if the verification fails.
+ * Remember that the signature 'rdata' over the rdataset was verified,
+ * for no longer than the rdataset's TTL, the signature's original TTL
+ * and the signature's remaining validity.
+ */
+static void
+cache_verify(dns_validator_t *val, dns_rdata_t *rdata,
+	     const unsigned char *digest)
+{
+	dns_rdata_rrsig_t sig;
+	uint32_t ttl;
+
+	if (dns_rdata_tostruct(rdata, &sig, NULL) != ISC_R_SUCCESS)
+		return;
+
+	ttl = ISC_MIN(val->event->rdataset->ttl, sig.originalttl);
+	if (!isc_serial_gt(sig.timeexpire, val->start))
+		ttl = 0;
+	else
+		ttl = ISC_MIN(ttl, sig.timeexpire - val->start);
+	dns_rdata_freestruct(&sig);
+
+	if (ttl > 0)
+		dns_sigcache_add(val->view->sigcache, digest, val->start,
+				 val->start + ttl);
+}
+
+/*%
+ * Verify 'rdataset' using 'key' and the RRSIG 'rdata', ignoring the
+ * signature's validity period if it has expired and 'acceptexpired'
+ * is set.  '*ignorep' is set if it was ignored.  This does not touch
+ * the validator, so it may run on any task.
  */
 static isc_result_t
-verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
-       uint16_t keyid)
+verify_rdataset(dns_name_t *name, dns_rdataset_t *rdataset, dst_key_t *key,
+		dns_rdata_t *rdata, unsigned int maxbits, bool acceptexpired,
+		isc_mem_t *mctx, bool *ignorep, dns_name_t *wild)
 {
 	isc_result_t result;
-	dns_fixedname_t fixed;
 	bool ignore = false;
-	dns_name_t *wild;
 
-	val->attributes |= VALATTR_TRIEDVERIFY;
-	wild = dns_fixedname_initname(&fixed);
  again:
-	result = dns_dnssec_verify(val->event->name, val->event->rdataset,
-				   key, ignore, val->view->maxbits,
-				   val->view->mctx, rdata, wild);
+	result = dns_dnssec_verify(name, rdataset, key, ignore, maxbits,
+				   mctx, rdata, wild);
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
-	    val->view->acceptexpired)
+	    acceptexpired && !ignore)
 	{
 		ignore = true;
 		goto again;
 	}
+	*ignorep = ignore;
+	return (result);
+}
+
+/*%
+ * Look for the verification of the rdataset using 'key' and 'rdata'
+ * in the signature cache.  Returns true on a hit; otherwise sets
+ * '*cacheablep' and 'digest' for verify_done().
+ */
+static bool
+verify_cached(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+	      uint16_t keyid, bool *cacheablep, unsigned char *digest)
+{
+	*cacheablep = (val->view->sigcache != NULL &&
+		       dns_sigcache_digest(val->event->name,
+					   val->event->rdataset, key, rdata,
+					   val->view->mctx,
+					   digest) == ISC_R_SUCCESS);
+	if (!*cacheablep)
+		return (false);
+
+	if (dns_sigcache_find(val->view->sigcache, digest, val->start)) {
+		inc_stats(val, dns_resstatscounter_sigcachehit);
+		validator_log(val, ISC_LOG_DEBUG(3),
+			      "verify rdataset (keyid=%u): success (cached)",
+			      keyid);
+		return (true);
+	}
+	inc_stats(val, dns_resstatscounter_sigcachemiss);
+	return (false);
+}
+
+/*%
+ * Act on the result of verify_rdataset().
+ */
+static isc_result_t
+verify_done(dns_validator_t *val, dns_rdata_t *rdata, uint16_t keyid,
+	    isc_result_t result, bool ignore, dns_name_t *wild,
+	    bool cacheable, const unsigned char *digest)
+{
 	if (ignore && (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD))
 		validator_log(val, ISC_LOG_INFO,
 			      "accepted expired %sRRSIG (keyid=%u)",
@@ -1532,6 +1608,8 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 		validator_log(val, ISC_LOG_DEBUG(3),
 			      "verify rdataset (keyid=%u): %s",
 			      keyid, isc_result_totext(result));
+	if (cacheable && !ignore && result == ISC_R_SUCCESS)
+		cache_verify(val, rdata, digest);
 	if (result == DNS_R_FROMWILDCARD) {
 		if (!dns_name_equal(val->event->name, wild)) {
 			dns_name_t *closest;
@@ -1552,6 +1630,185 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	return (result);
 }
 
+/*%
+ * Attempt to verify the rdataset using the given key and rdata (RRSIG).
+ * The signature was good and from a wildcard record and the QNAME does
+ * not match the wildcard we need to look for a NOQNAME proof.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS if the verification succeeds.
+ * \li	Others if the verification fails.
+ */
+static isc_result_t
+verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+       uint16_t keyid)
+{
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	bool ignore, cacheable;
+	dns_name_t *wild;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+
+	val->attributes |= VALATTR_TRIEDVERIFY;
+
+	/*
+	 * Skip the public key operation if this exact signature has
+	 * already been verified with this key over this RRset.
+	 */
+	if (verify_cached(val, key, rdata, keyid, &cacheable, digest))
+		return (ISC_R_SUCCESS);
+
+	wild = dns_fixedname_initname(&fixed);
+	result = verify_rdataset(val->event->name, val->event->rdataset,
+				 key, rdata, val->view->maxbits,
+				 val->view->acceptexpired, val->view->mctx,
+				 &ignore, wild);
+	return (verify_done(val, rdata, keyid, result, ignore, wild,
+			    cacheable, digest));
+}
+
+/*%
+ * A signature verification handed to one of the resolver's verify
+ * tasks.  The rdataset is a clone and the key is attached, so the
+ * verify task does not need to look at the validator.
+ */
+typedef struct verifyevent {
+	ISC_EVENT_COMMON(struct verifyevent);
+	dns_validator_t *	validator;
+	dns_name_t *		name;
+	dns_rdataset_t		rdataset;
+	dst_key_t *		key;
+	dns_rdata_t		rdata;
+	unsigned int		maxbits;
+	bool			acceptexpired;
+	isc_mem_t *		mctx;
+	uint16_t		keyid;
+	bool			cacheable;
+	unsigned char		digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_result_t		result;
+	bool			ignore;
+	dns_fixedname_t		wild;
+} verifyevent_t;
+
+/*%
+ * Run on a verify task: do the verification and send the event back
+ * to the validator's task.
+ */
+static void
+verify_work(isc_task_t *task, isc_event_t *event) {
+	verifyevent_t *vevent = (verifyevent_t *)event;
+	dns_validator_t *val = vevent->validator;
+	dns_name_t *wild;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_VALIDATORVERIFY);
+
+	wild = dns_fixedname_initname(&vevent->wild);
+	vevent->result = verify_rdataset(vevent->name, &vevent->rdataset,
+					 vevent->key, &vevent->rdata,
+					 vevent->maxbits,
+					 vevent->acceptexpired, vevent->mctx,
+					 &vevent->ignore, wild);
+
+	event->ev_action = verified;
+	isc_task_send(val->task, &event);
+}
+
+/*%
+ * Like verify(), but hand the verification to one of the resolver's
+ * verify tasks.  Returns DNS_R_WAIT if it was handed off; verified()
+ * will then resume validate() with the result.
+ */
+static isc_result_t
+verify_async(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+	     uint16_t keyid)
+{
+	verifyevent_t *vevent;
+	bool cacheable;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+
+	if (val->view->resolver == NULL)
+		return (verify(val, key, rdata, keyid));
+
+	val->attributes |= VALATTR_TRIEDVERIFY;
+
+	if (verify_cached(val, key, rdata, keyid, &cacheable, digest))
+		return (ISC_R_SUCCESS);
+
+	vevent = (verifyevent_t *)
+		isc_event_allocate(val->view->mctx, val,
+				   DNS_EVENT_VALIDATORVERIFY, verify_work,
+				   NULL, sizeof(verifyevent_t));
+	if (vevent == NULL)
+		return (verify(val, key, rdata, keyid));
+
+	vevent->validator = val;
+	vevent->name = val->event->name;
+	dns_rdataset_init(&vevent->rdataset);
+	dns_rdataset_clone(val->event->rdataset, &vevent->rdataset);
+	vevent->key = NULL;
+	dst_key_attach(key, &vevent->key);
+	vevent->rdata = *rdata;
+	ISC_LINK_INIT(&vevent->rdata, link);
+	vevent->maxbits = val->view->maxbits;
+	vevent->acceptexpired = val->view->acceptexpired;
+	vevent->mctx = val->view->mctx;
+	vevent->keyid = keyid;
+	vevent->cacheable = cacheable;
+	memmove(vevent->digest, digest, sizeof(digest));
+	vevent->result = ISC_R_UNEXPECTED;
+	vevent->ignore = false;
+
+	val->attributes |= VALATTR_VERIFYING;
+	isc_task_send(dns_resolver_verifytask(val->view->resolver),
+		      ISC_EVENT_PTR(&vevent));
+
+	return (DNS_R_WAIT);
+}
+
+/*%
+ * Callback when a verification handed off by verify_async() is done.
+ *
+ * Resumes validate() with its result.
+ */
+static void
+verified(isc_task_t *task, isc_event_t *event) {
+	verifyevent_t *vevent = (verifyevent_t *)event;
+	dns_validator_t *val = vevent->validator;
+	bool want_destroy;
+	isc_result_t result;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_VALIDATORVERIFY);
+
+	LOCK(&val->lock);
+	INSIST((val->attributes & VALATTR_VERIFYING) != 0);
+	val->attributes &= ~VALATTR_VERIFYING;
+	if (CANCELED(val)) {
+		validator_done(val, ISC_R_CANCELED);
+	} else {
+		val->verifyresult = verify_done(val, &vevent->rdata,
+						vevent->keyid, vevent->result,
+						vevent->ignore,
+						dns_fixedname_name(&vevent->wild),
+						vevent->cacheable,
+						vevent->digest);
+		val->attributes |= VALATTR_VERIFIED;
+		result = validate(val, true);
+		if (result != DNS_R_WAIT)
+			validator_done(val, result);
+	}
+	want_destroy = exit_check(val);
+	UNLOCK(&val->lock);
+
+	dns_rdataset_disassociate(&vevent->rdataset);
+	dst_key_free(&vevent->key);
+	isc_event_free(&event);
+
+	if (want_destroy)
+		destroy(val);
+}
+
 /*%
  * Attempts positive response validation of a normal RRset.
  *
@@ -1628,8 +1885,15 @@ validate(dns_validator_t *val, bool resume) {
 		}
 
 		do {
-			vresult = verify(val, val->key, &rdata,
-					val->siginfo->keyid);
+			if ((val->attributes & VALATTR_VERIFIED) != 0) {
+				val->attributes &= ~VALATTR_VERIFIED;
+				vresult = val->verifyresult;
+			} else {
+				vresult = verify_async(val, val->key, &rdata,
+						       val->siginfo->keyid);
+				if (vresult == DNS_R_WAIT)
+					return (DNS_R_WAIT);
+			}
 			if (vresult == ISC_R_SUCCESS)
 				break;
 			if (val->keynode != NULL) {
@@ -3772,6 +4036,7 @@ dns_validator_create(dns_view_t *view, dns_name_t *name, dns_rdatatype_t type,
 	val->fetch = NULL;
 	val->subvalidator = NULL;
 	val->parent = NULL;
+	val->verifyresult = ISC_R_UNEXPECTED;
 
 	val->keytable = NULL;
 	result = dns_view_getsecroots(val->view, &val->keytable);
@@ -3879,6 +4144,7 @@ destroy(dns_validator_t *val) {
 	REQUIRE(SHUTDOWN(val));
 	REQUIRE(val->event == NULL);
 	REQUIRE(val->fetch == NULL);
+	REQUIRE((val->attributes & VALATTR_VERIFYING) == 0);
 
 	if (val->keynode != NULL)
 		dns_keytable_detachkeynode(val->keytable, &val->keynode);
@@ -42,6 +42,7 @@
 #include <dns/dnssec.h>
 #include <dns/events.h>
 #include <dns/forward.h>
+#include <dns/hotnames.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
 #include <dns/master.h>
@@ -56,6 +57,7 @@
 #include <dns/result.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/tsig.h>
@@ -73,6 +75,7 @@
 
 #define DNS_VIEW_DELONLYHASH 111
 #define DNS_VIEW_FAILCACHESIZE 1021
+#define DNS_VIEW_SIGCACHESIZE 16384
 
 static void resolver_shutdown(isc_task_t *task, isc_event_t *event);
 static void adb_shutdown(isc_task_t *task, isc_event_t *event);
@@ -217,6 +220,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->nta_recheck = 0;
 	view->prefetch_eligible = 0;
 	view->prefetch_trigger = 0;
+	view->hotnames = NULL;
 	view->dstport = 53;
 	view->preferred_glue = 0;
 	view->flush = false;
@@ -256,6 +260,9 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->failcache = NULL;
 	(void)dns_badcache_init(view->mctx, DNS_VIEW_FAILCACHESIZE,
 				   &view->failcache);
+	view->sigcache = NULL;
+	(void)dns_sigcache_create(view->mctx, DNS_VIEW_SIGCACHESIZE,
+				  &view->sigcache);
 	view->v6bias = 0;
 	view->dtenv = NULL;
 	view->dttypes = 0;
@@ -540,6 +547,10 @@ destroy(dns_view_t *view) {
 	dns_aclenv_destroy(&view->aclenv);
 	if (view->failcache != NULL)
 		dns_badcache_destroy(&view->failcache);
+	if (view->sigcache != NULL)
+		dns_sigcache_destroy(&view->sigcache);
+	if (view->hotnames != NULL)
+		dns_hotnames_detach(&view->hotnames);
 	DESTROYLOCK(&view->new_zone_lock);
 	DESTROYLOCK(&view->lock);
 	isc_mem_free(view->mctx, view->nta_file);
@@ -588,6 +599,12 @@ view_flushanddetach(dns_view_t **viewp, bool flush) {
 		dns_zone_t *mkzone = NULL, *rdzone = NULL;
 
 		isc_refcount_destroy(&view->references);
+		/*
+		 * Refresh queries take the view lock when they start.
+		 */
+		if (view->hotnames != NULL) {
+			dns_hotnames_shutdown(view->hotnames);
+		}
 		LOCK(&view->lock);
 		if (!RESSHUTDOWN(view)) {
 			dns_resolver_shutdown(view->resolver);
@@ -1618,6 +1635,8 @@ dns_view_flushcache(dns_view_t *view, bool fixuponly) {
 		dns_resolver_flushbadcache(view->resolver, NULL);
 	if (view->failcache != NULL)
 		dns_badcache_flush(view->failcache);
+	if (view->sigcache != NULL)
+		dns_sigcache_flush(view->sigcache);
 
 	dns_adb_flush(view->adb);
 	return (ISC_R_SUCCESS);
@@ -38,6 +38,7 @@
 
 #include <dns/acl.h>
 #include <dns/adb.h>
+#include <dns/anscache.h>
 #include <dns/callbacks.h>
 #include <dns/catz.h>
 #include <dns/db.h>
@@ -388,6 +389,11 @@ struct dns_zone {
 	 */
 	dns_catz_zone_t		*parentcatz;
 
+	/*%
+	 * Rendered responses; flushed whenever the zone data changes.
+	 */
+	dns_anscache_t		*anscache;
+
 	/*%
 	 * Serial number update method.
 	 */
@@ -1041,6 +1047,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 
 	zone->catzs = NULL;
 	zone->parentcatz = NULL;
+	zone->anscache = NULL;
 
 	ISC_LIST_INIT(zone->forwards);
 	zone->raw = NULL;
@@ -1202,6 +1209,9 @@ zone_free(dns_zone_t *zone) {
 	if (zone->db != NULL) {
 		zone_detachdb(zone);
 	}
+	if (zone->anscache != NULL) {
+		dns_anscache_detach(&zone->anscache);
+	}
 	if (zone->rpzs != NULL) {
 		REQUIRE(zone->rpz_num < zone->rpzs->p.num_zones);
 		dns_rpz_detach_rpzs(&zone->rpzs);
@@ -1821,6 +1831,76 @@ dns_zone_catz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 	}
 }
 
+isc_result_t
+dns_zone_setanswercache(dns_zone_t *zone, unsigned int maxentries) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_anscache_t *anscache = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	if (zone->anscache != NULL &&
+	    dns_anscache_getmaxentries(zone->anscache) == maxentries)
+	{
+		/*
+		 * The responses may have been rendered under
+		 * different view options.
+		 */
+		dns_anscache_flush(zone->anscache);
+		goto unlock;
+	}
+
+	if (maxentries != 0) {
+		result = dns_anscache_create(zone->mctx, maxentries,
+					     &anscache);
+		if (result != ISC_R_SUCCESS) {
+			goto unlock;
+		}
+	}
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_write);
+	if (anscache != NULL && zone->db != NULL) {
+		result = dns_db_updatenotify_register(zone->db,
+						      dns_anscache_dbupdate,
+						      anscache);
+		if (result != ISC_R_SUCCESS) {
+			ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
+			goto unlock;
+		}
+	}
+	if (zone->anscache != NULL) {
+		if (zone->db != NULL) {
+			(void)dns_db_updatenotify_unregister(zone->db,
+							dns_anscache_dbupdate,
+							zone->anscache);
+		}
+		dns_anscache_detach(&zone->anscache);
+	}
+	if (anscache != NULL) {
+		dns_anscache_attach(anscache, &zone->anscache);
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
+
+ unlock:
+	UNLOCK_ZONE(zone);
+	if (anscache != NULL) {
+		dns_anscache_detach(&anscache);
+	}
+	return (result);
+}
+
+void
+dns_zone_getanswercache(dns_zone_t *zone, dns_anscache_t **anscachep) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(anscachep != NULL && *anscachep == NULL);
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->anscache != NULL) {
+		dns_anscache_attach(zone->anscache, anscachep);
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+}
+
 /*
  * Set catalog zone ownership of the zone
  */
@@ -15189,6 +15269,15 @@ zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(zone->db == NULL && db != NULL);
 
 	dns_db_attach(db, &zone->db);
+	if (zone->anscache != NULL) {
+		isc_result_t result;
+
+		result = dns_db_updatenotify_register(zone->db,
+						      dns_anscache_dbupdate,
+						      zone->anscache);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_anscache_flush(zone->anscache);
+	}
 }
 
 /* The caller must hold the dblock as a writer. */
@@ -15196,6 +15285,12 @@ static inline void
 zone_detachdb(dns_zone_t *zone) {
 	REQUIRE(zone->db != NULL);
 
+	if (zone->anscache != NULL) {
+		(void)dns_db_updatenotify_unregister(zone->db,
+						     dns_anscache_dbupdate,
+						     zone->anscache);
+		dns_anscache_flush(zone->anscache);
+	}
 	dns_db_detach(&zone->db);
 }
 
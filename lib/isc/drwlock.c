@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/drwlock.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/once.h>
+#include <isc/os.h>
+#include <isc/platform.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#define DRWLOCK_MAGIC		ISC_MAGIC('D', 'R', 'W', 'L')
+#define VALID_DRWLOCK(l)	ISC_MAGIC_VALID(l, DRWLOCK_MAGIC)
+
+#define DRWLOCK_MAXSLOTS	64
+#define DRWLOCK_LINESIZE	64
+
+/*%
+ * The number of readers that entered through a slot, less the number
+ * that left through it.  A reader may leave through a different slot
+ * from the one it entered by (if it is unlocked by another thread), so
+ * only the sum over all slots is meaningful.
+ */
+struct isc_drwslot {
+	atomic_int_fast32_t	readers;
+	char			pad[DRWLOCK_LINESIZE -
+				    sizeof(atomic_int_fast32_t)];
+};
+
+static isc_once_t		slots_once = ISC_ONCE_INIT;
+static unsigned int		defslots = 1;
+static atomic_uint_fast32_t	nextslot;
+
+#if defined(HAVE_TLS)
+#if defined(HAVE_THREAD_LOCAL)
+#include <threads.h>
+static thread_local int myslot = -1;
+#elif defined(HAVE___THREAD)
+static __thread int myslot = -1;
+#elif defined(HAVE___DECLSPEC_THREAD)
+static __declspec( thread ) int myslot = -1;
+#else
+#error "Unknown method for defining a TLS variable!"
+#endif
+#else
+/*
+ * Without thread-local storage every thread shares the first slot.
+ */
+static int myslot = 0;
+#endif
+
+static void
+init_slots(void) {
+#if defined(HAVE_TLS)
+	unsigned int ncpus = isc_os_ncpus();
+
+	defslots = ISC_MIN(ISC_MAX(ncpus, 1), DRWLOCK_MAXSLOTS);
+#endif
+}
+
+/*
+ * Return the calling thread's reader counter in 'rwl'.
+ */
+static inline atomic_int_fast32_t *
+reader_slot(isc_drwlock_t *rwl) {
+	if (ISC_UNLIKELY(myslot < 0)) {
+		myslot = atomic_fetch_add_explicit(&nextslot, 1,
+						   memory_order_relaxed) %
+			 DRWLOCK_MAXSLOTS;
+	}
+
+	return (&rwl->slots[myslot % rwl->nslots].readers);
+}
+
+/*
+ * Count the readers holding (or about to back away from) the lock.
+ * The caller must have raised the writer flag first; see reader_enter().
+ */
+static int_fast32_t
+readers(isc_drwlock_t *rwl) {
+	int_fast32_t count = 0;
+	unsigned int i;
+
+	for (i = 0; i < rwl->nslots; i++) {
+		count += atomic_load_explicit(&rwl->slots[i].readers,
+					      memory_order_seq_cst);
+	}
+
+	return (count);
+}
+
+/*
+ * Announce a reader and check for a writer.  Both sides use sequentially
+ * consistent operations, so either the writer sees our announcement when
+ * it counts the readers, or we see its flag and back away.
+ */
+static inline bool
+reader_enter(isc_drwlock_t *rwl, atomic_int_fast32_t *slot) {
+	atomic_fetch_add_explicit(slot, 1, memory_order_seq_cst);
+	return (atomic_load_explicit(&rwl->writer,
+				     memory_order_seq_cst) == 0);
+}
+
+static inline void
+reader_leave(isc_drwlock_t *rwl, atomic_int_fast32_t *slot) {
+	atomic_fetch_sub_explicit(slot, 1, memory_order_seq_cst);
+	if (ISC_UNLIKELY(atomic_load_explicit(&rwl->writer,
+					      memory_order_seq_cst) != 0))
+	{
+		LOCK(&rwl->lock);
+		BROADCAST(&rwl->drained);
+		UNLOCK(&rwl->lock);
+	}
+}
+
+isc_result_t
+isc_drwlock_init(isc_drwlock_t *rwl, isc_mem_t *mctx, unsigned int nslots) {
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(rwl != NULL);
+
+	RUNTIME_CHECK(isc_once_do(&slots_once, init_slots) == ISC_R_SUCCESS);
+
+	rwl->magic = 0;
+
+	if (nslots == 0) {
+		nslots = defslots;
+	}
+	rwl->nslots = ISC_MIN(nslots, DRWLOCK_MAXSLOTS);
+	atomic_init(&rwl->writer, 0);
+
+	rwl->slots = isc_mem_get(mctx, rwl->nslots * sizeof(isc_drwslot_t));
+	if (rwl->slots == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
+	for (i = 0; i < rwl->nslots; i++) {
+		atomic_init(&rwl->slots[i].readers, 0);
+	}
+
+	result = isc_mutex_init(&rwl->wlock);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup_slots;
+	}
+	result = isc_mutex_init(&rwl->lock);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup_wlock;
+	}
+	result = isc_condition_init(&rwl->drained);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init(drained) failed: %s",
+				 isc_result_totext(result));
+		result = ISC_R_UNEXPECTED;
+		goto cleanup_lock;
+	}
+
+	rwl->mctx = NULL;
+	isc_mem_attach(mctx, &rwl->mctx);
+	rwl->magic = DRWLOCK_MAGIC;
+
+	return (ISC_R_SUCCESS);
+
+ cleanup_lock:
+	DESTROYLOCK(&rwl->lock);
+ cleanup_wlock:
+	DESTROYLOCK(&rwl->wlock);
+ cleanup_slots:
+	isc_mem_put(mctx, rwl->slots, rwl->nslots * sizeof(isc_drwslot_t));
+
+	return (result);
+}
+
+void
+isc_drwlock_destroy(isc_drwlock_t *rwl) {
+	REQUIRE(VALID_DRWLOCK(rwl));
+	REQUIRE(atomic_load(&rwl->writer) == 0);
+	REQUIRE(readers(rwl) == 0);
+
+	rwl->magic = 0;
+	(void)isc_condition_destroy(&rwl->drained);
+	DESTROYLOCK(&rwl->lock);
+	DESTROYLOCK(&rwl->wlock);
+	isc_mem_putanddetach(&rwl->mctx, rwl->slots,
+			     rwl->nslots * sizeof(isc_drwslot_t));
+}
+
+isc_result_t
+isc_drwlock_lock(isc_drwlock_t *rwl, isc_rwlocktype_t type) {
+	atomic_int_fast32_t *slot;
+
+	REQUIRE(VALID_DRWLOCK(rwl));
+
+	if (type == isc_rwlocktype_read) {
+		slot = reader_slot(rwl);
+		while (!reader_enter(rwl, slot)) {
+			/*
+			 * A writer holds or wants the lock; wait for it
+			 * to finish by queueing on its mutex.
+			 */
+			reader_leave(rwl, slot);
+			LOCK(&rwl->wlock);
+			UNLOCK(&rwl->wlock);
+		}
+	} else {
+		LOCK(&rwl->wlock);
+		atomic_store_explicit(&rwl->writer, 1, memory_order_seq_cst);
+		LOCK(&rwl->lock);
+		while (readers(rwl) != 0) {
+			WAIT(&rwl->drained, &rwl->lock);
+		}
+		UNLOCK(&rwl->lock);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_drwlock_trylock(isc_drwlock_t *rwl, isc_rwlocktype_t type) {
+	atomic_int_fast32_t *slot;
+
+	REQUIRE(VALID_DRWLOCK(rwl));
+
+	if (type == isc_rwlocktype_read) {
+		slot = reader_slot(rwl);
+		if (!reader_enter(rwl, slot)) {
+			reader_leave(rwl, slot);
+			return (ISC_R_LOCKBUSY);
+		}
+	} else {
+		if (isc_mutex_trylock(&rwl->wlock) != ISC_R_SUCCESS) {
+			return (ISC_R_LOCKBUSY);
+		}
+		atomic_store_explicit(&rwl->writer, 1, memory_order_seq_cst);
+		if (readers(rwl) != 0) {
+			atomic_store_explicit(&rwl->writer, 0,
+					      memory_order_seq_cst);
+			UNLOCK(&rwl->wlock);
+			return (ISC_R_LOCKBUSY);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_drwlock_unlock(isc_drwlock_t *rwl, isc_rwlocktype_t type) {
+	REQUIRE(VALID_DRWLOCK(rwl));
+
+	if (type == isc_rwlocktype_read) {
+		reader_leave(rwl, reader_slot(rwl));
+	} else {
+		atomic_store_explicit(&rwl->writer, 0, memory_order_seq_cst);
+		UNLOCK(&rwl->wlock);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_drwlock_tryupgrade(isc_drwlock_t *rwl) {
+	REQUIRE(VALID_DRWLOCK(rwl));
+
+	if (isc_mutex_trylock(&rwl->wlock) != ISC_R_SUCCESS) {
+		return (ISC_R_LOCKBUSY);
+	}
+	atomic_store_explicit(&rwl->writer, 1, memory_order_seq_cst);
+
+	/*
+	 * Our own read lock is counted; any other count means another
+	 * reader got in first (or is just backing away), so give up.
+	 */
+	if (readers(rwl) != 1) {
+		atomic_store_explicit(&rwl->writer, 0, memory_order_seq_cst);
+		UNLOCK(&rwl->wlock);
+		return (ISC_R_LOCKBUSY);
+	}
+	atomic_fetch_sub_explicit(reader_slot(rwl), 1, memory_order_seq_cst);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+isc_drwlock_downgrade(isc_drwlock_t *rwl) {
+	REQUIRE(VALID_DRWLOCK(rwl));
+
+	atomic_fetch_add_explicit(reader_slot(rwl), 1, memory_order_seq_cst);
+	atomic_store_explicit(&rwl->writer, 0, memory_order_seq_cst);
+	UNLOCK(&rwl->wlock);
+}
@@ -28,28 +28,191 @@ typedef struct isc_ht_node isc_ht_node_t;
 #define ISC_HT_MAGIC			ISC_MAGIC('H', 'T', 'a', 'b')
 #define ISC_HT_VALID(ht)		ISC_MAGIC_VALID(ht, ISC_HT_MAGIC)
 
+/*%
+ * The table doubles once it holds more than one node per bucket, and
+ * halves (but never below its initial size) once it is less than a
+ * quarter full.  Nodes are moved to the new table a few buckets at a
+ * time by each later add or delete, and the new table's buckets are
+ * only initialized as the old buckets feeding them are moved, so no
+ * single call pays for the whole rehash.
+ */
+#define HT_MAXBITS			32
+#define HT_REHASH_BUCKETS		8
+
 struct isc_ht_node {
 	void *value;
 	isc_ht_node_t *next;
-	size_t keysize;
+	uint32_t hashval;
+	uint32_t keysize;
 	unsigned char key[FLEXIBLE_ARRAY_MEMBER];
 };
 
 struct isc_ht {
 	unsigned int magic;
 	isc_mem_t *mctx;
-	size_t size;
-	size_t mask;
+	uint8_t bits[2];
+	uint8_t minbits;
 	unsigned int count;
-	isc_ht_node_t **table;
+	unsigned int iterators;
+	size_t hiter;		/*%< next bucket of table[0] to rehash */
+	isc_ht_node_t **table[2];	/*%< table[1] != NULL while rehashing */
 };
 
 struct isc_ht_iter {
 	isc_ht_t *ht;
+	unsigned int t;
 	size_t i;
 	isc_ht_node_t *cur;
 };
 
+#define HT_SIZE(bits)			((size_t)1 << (bits))
+#define HT_BUCKET(ht, t, hashval)	((hashval) & (HT_SIZE((ht)->bits[t]) - 1))
+#define HT_REHASHING(ht)		((ht)->table[1] != NULL)
+
+/*
+ * While rehashing, nodes whose old bucket has already been moved live
+ * in the new table, and all others still live in the old one.
+ */
+static inline unsigned int
+ht_table(const isc_ht_t *ht, uint32_t hashval) {
+	if (HT_REHASHING(ht) && HT_BUCKET(ht, 0, hashval) < ht->hiter)
+		return (1);
+	return (0);
+}
+
+/*
+ * Has bucket 'b' of table 't' been initialized?
+ */
+static inline bool
+ht_ready(const isc_ht_t *ht, unsigned int t, size_t b) {
+	return (t == 0 || (b & (HT_SIZE(ht->bits[0]) - 1)) < ht->hiter);
+}
+
+/*
+ * Move up to HT_REHASH_BUCKETS buckets from the old table to the new
+ * one, and retire the old table once it is empty.
+ */
+static void
+ht_rehash_step(isc_ht_t *ht) {
+	isc_ht_node_t *node, *next;
+	size_t oldsize = HT_SIZE(ht->bits[0]);
+	size_t newsize = HT_SIZE(ht->bits[1]);
+	size_t bucket;
+	unsigned int n;
+
+	for (n = 0; n < HT_REHASH_BUCKETS && ht->hiter < oldsize; n++) {
+		/*
+		 * Initialize the new buckets this one feeds, unless an
+		 * earlier old bucket already did.
+		 */
+		if (newsize > oldsize) {
+			ht->table[1][ht->hiter] = NULL;
+			ht->table[1][ht->hiter + oldsize] = NULL;
+		} else if (ht->hiter < newsize) {
+			ht->table[1][ht->hiter] = NULL;
+		}
+
+		node = ht->table[0][ht->hiter];
+		while (node != NULL) {
+			next = node->next;
+			bucket = HT_BUCKET(ht, 1, node->hashval);
+			node->next = ht->table[1][bucket];
+			ht->table[1][bucket] = node;
+			node = next;
+		}
+		ht->table[0][ht->hiter] = NULL;
+		ht->hiter++;
+	}
+
+	if (ht->hiter == oldsize) {
+		isc_mem_put(ht->mctx, ht->table[0],
+			    oldsize * sizeof(isc_ht_node_t*));
+		ht->table[0] = ht->table[1];
+		ht->bits[0] = ht->bits[1];
+		ht->table[1] = NULL;
+		ht->bits[1] = 0;
+		ht->hiter = 0;
+	}
+}
+
+/*
+ * Start moving the nodes to a table of 2^bits buckets.  Failing to
+ * allocate the new table is not an error; we just carry on with the
+ * current one and try again later.
+ */
+static void
+ht_resize(isc_ht_t *ht, uint8_t bits) {
+	INSIST(!HT_REHASHING(ht));
+
+	ht->table[1] = isc_mem_get(ht->mctx,
+				   HT_SIZE(bits) * sizeof(isc_ht_node_t*));
+	if (ht->table[1] == NULL)
+		return;
+
+	ht->bits[1] = bits;
+	ht->hiter = 0;
+	ht_rehash_step(ht);
+}
+
+/*
+ * Called after every add and delete: continue a rehash in progress,
+ * or start one if the load factor has drifted out of bounds.  Both are
+ * put off while iterators exist, so an iteration sees every node once.
+ */
+static void
+ht_maintain(isc_ht_t *ht) {
+	if (ht->iterators > 0)
+		return;
+
+	if (HT_REHASHING(ht)) {
+		ht_rehash_step(ht);
+	} else if (ht->count > HT_SIZE(ht->bits[0]) &&
+		   ht->bits[0] < HT_MAXBITS)
+	{
+		ht_resize(ht, ht->bits[0] + 1);
+	} else if (ht->count < HT_SIZE(ht->bits[0]) / 4 &&
+		   ht->bits[0] > ht->minbits)
+	{
+		ht_resize(ht, ht->bits[0] - 1);
+	}
+}
+
+static isc_ht_node_t *
+ht_find(const isc_ht_t *ht, const unsigned char *key,
+	uint32_t keysize, uint32_t hashval)
+{
+	isc_ht_node_t *node;
+	unsigned int t;
+
+	t = ht_table(ht, hashval);
+	node = ht->table[t][HT_BUCKET(ht, t, hashval)];
+	while (node != NULL) {
+		if (keysize == node->keysize &&
+		    memcmp(key, node->key, keysize) == 0)
+		{
+			return (node);
+		}
+		node = node->next;
+	}
+
+	return (NULL);
+}
+
+static void
+ht_unlink(isc_ht_t *ht, isc_ht_node_t *node) {
+	isc_ht_node_t **nodep;
+	unsigned int t;
+
+	t = ht_table(ht, node->hashval);
+	nodep = &ht->table[t][HT_BUCKET(ht, t, node->hashval)];
+	while (*nodep != node) {
+		INSIST(*nodep != NULL);
+		nodep = &(*nodep)->next;
+	}
+	*nodep = node->next;
+	ht->count--;
+}
+
 isc_result_t
 isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, uint8_t bits) {
 	isc_ht_t *ht = NULL;
@@ -67,18 +230,26 @@ isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, uint8_t bits) {
 	ht->mctx = NULL;
 	isc_mem_attach(mctx, &ht->mctx);
 
-	ht->size = ((size_t)1<<bits);
-	ht->mask = ((size_t)1<<bits)-1;
+	if (bits > HT_MAXBITS)
+		bits = HT_MAXBITS;
+
+	ht->bits[0] = bits;
+	ht->bits[1] = 0;
+	ht->minbits = bits;
 	ht->count = 0;
+	ht->iterators = 0;
+	ht->hiter = 0;
+	ht->table[1] = NULL;
 
-	ht->table = isc_mem_get(ht->mctx, ht->size * sizeof(isc_ht_node_t*));
-	if (ht->table == NULL) {
+	ht->table[0] = isc_mem_get(ht->mctx,
+				   HT_SIZE(bits) * sizeof(isc_ht_node_t*));
+	if (ht->table[0] == NULL) {
 		isc_mem_putanddetach(&ht->mctx, ht, sizeof(struct isc_ht));
 		return (ISC_R_NOMEMORY);
 	}
 
-	for (i = 0; i < ht->size; i++) {
-		ht->table[i] = NULL;
+	for (i = 0; i < HT_SIZE(bits); i++) {
+		ht->table[0][i] = NULL;
 	}
 
 	ht->magic = ISC_HT_MAGIC;
@@ -90,6 +261,7 @@ isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, uint8_t bits) {
 void
 isc_ht_destroy(isc_ht_t **htp) {
 	isc_ht_t *ht;
+	unsigned int t;
 	size_t i;
 
 	REQUIRE(htp != NULL);
@@ -99,21 +271,27 @@ isc_ht_destroy(isc_ht_t **htp) {
 
 	ht->magic = 0;
 
-	for (i = 0; i < ht->size; i++) {
-		isc_ht_node_t *node = ht->table[i];
-		while (node != NULL) {
-			isc_ht_node_t *next = node->next;
-			ht->count--;
-			isc_mem_put(ht->mctx, node,
-				    offsetof(isc_ht_node_t, key) +
-				    node->keysize);
-			node = next;
+	for (t = 0; t < 2 && ht->table[t] != NULL; t++) {
+		for (i = 0; i < HT_SIZE(ht->bits[t]); i++) {
+			isc_ht_node_t *node;
+			if (!ht_ready(ht, t, i))
+				continue;
+			node = ht->table[t][i];
+			while (node != NULL) {
+				isc_ht_node_t *next = node->next;
+				ht->count--;
+				isc_mem_put(ht->mctx, node,
+					    offsetof(isc_ht_node_t, key) +
+					    node->keysize);
+				node = next;
+			}
 		}
+		isc_mem_put(ht->mctx, ht->table[t],
+			    HT_SIZE(ht->bits[t]) * sizeof(isc_ht_node_t*));
 	}
 
 	INSIST(ht->count == 0);
 
-	isc_mem_put(ht->mctx, ht->table, ht->size * sizeof(isc_ht_node_t*));
 	isc_mem_putanddetach(&ht->mctx, ht, sizeof(struct isc_ht));
 
 	*htp = NULL;
@@ -125,19 +303,15 @@ isc_ht_add(isc_ht_t *ht, const unsigned char *key,
 {
 	isc_ht_node_t *node;
 	uint32_t hash;
+	unsigned int t;
+	size_t bucket;
 
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
 
 	hash = isc_hash_function(key, keysize, true, NULL);
-	node = ht->table[hash & ht->mask];
-	while (node != NULL) {
-		if (keysize == node->keysize &&
-		    memcmp(key, node->key, keysize) == 0) {
-			return (ISC_R_EXISTS);
-		}
-		node = node->next;
-	}
+	if (ht_find(ht, key, keysize, hash) != NULL)
+		return (ISC_R_EXISTS);
 
 	node = isc_mem_get(ht->mctx, offsetof(isc_ht_node_t, key) + keysize);
 	if (node == NULL)
@@ -145,11 +319,17 @@ isc_ht_add(isc_ht_t *ht, const unsigned char *key,
 
 	memmove(node->key, key, keysize);
 	node->keysize = keysize;
-	node->next = ht->table[hash & ht->mask];
+	node->hashval = hash;
 	node->value = value;
 
+	t = ht_table(ht, hash);
+	bucket = HT_BUCKET(ht, t, hash);
+	node->next = ht->table[t][bucket];
+	ht->table[t][bucket] = node;
 	ht->count++;
-	ht->table[hash & ht->mask] = node;
+
+	ht_maintain(ht);
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -164,51 +344,35 @@ isc_ht_find(const isc_ht_t *ht, const unsigned char *key,
 	REQUIRE(key != NULL && keysize > 0);
 
 	hash = isc_hash_function(key, keysize, true, NULL);
-	node = ht->table[hash & ht->mask];
-	while (node != NULL) {
-		if (keysize == node->keysize &&
-		    memcmp(key, node->key, keysize) == 0)
-		{
-			if (valuep != NULL)
-				*valuep = node->value;
-			return (ISC_R_SUCCESS);
-		}
-		node = node->next;
-	}
+	node = ht_find(ht, key, keysize, hash);
+	if (node == NULL)
+		return (ISC_R_NOTFOUND);
 
-	return (ISC_R_NOTFOUND);
+	if (valuep != NULL)
+		*valuep = node->value;
+	return (ISC_R_SUCCESS);
 }
 
 isc_result_t
 isc_ht_delete(isc_ht_t *ht, const unsigned char *key, uint32_t keysize) {
-	isc_ht_node_t *node, *prev;
+	isc_ht_node_t *node;
 	uint32_t hash;
 
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
 
-	prev = NULL;
 	hash = isc_hash_function(key, keysize, true, NULL);
-	node = ht->table[hash & ht->mask];
-	while (node != NULL) {
-		if (keysize == node->keysize &&
-		    memcmp(key, node->key, keysize) == 0) {
-			if (prev == NULL)
-				ht->table[hash & ht->mask] = node->next;
-			else
-				prev->next = node->next;
-			isc_mem_put(ht->mctx, node,
-				    offsetof(isc_ht_node_t, key) +
-				    node->keysize);
-			ht->count--;
-
-			return (ISC_R_SUCCESS);
-		}
+	node = ht_find(ht, key, keysize, hash);
+	if (node == NULL)
+		return (ISC_R_NOTFOUND);
 
-		prev = node;
-		node = node->next;
-	}
-	return (ISC_R_NOTFOUND);
+	ht_unlink(ht, node);
+	isc_mem_put(ht->mctx, node,
+		    offsetof(isc_ht_node_t, key) + node->keysize);
+
+	ht_maintain(ht);
+
+	return (ISC_R_SUCCESS);
 }
 
 isc_result_t
@@ -223,9 +387,12 @@ isc_ht_iter_create(isc_ht_t *ht, isc_ht_iter_t **itp) {
 		return (ISC_R_NOMEMORY);
 
 	it->ht = ht;
+	it->t = 0;
 	it->i = 0;
 	it->cur = NULL;
 
+	ht->iterators++;
+
 	*itp = it;
 
 	return (ISC_R_SUCCESS);
@@ -240,25 +407,47 @@ isc_ht_iter_destroy(isc_ht_iter_t **itp) {
 
 	it = *itp;
 	ht = it->ht;
+	INSIST(ht->iterators > 0);
+	ht->iterators--;
 	isc_mem_put(ht->mctx, it, sizeof(isc_ht_iter_t));
 
 	*itp = NULL;
 }
 
+/*
+ * Advance 'it' to the first non-empty bucket at or after (it->t, it->i),
+ * walking the old table and then, while rehashing, the new one.
+ */
+static isc_result_t
+ht_iter_bucket(isc_ht_iter_t *it) {
+	isc_ht_t *ht = it->ht;
+
+	while (it->t < 2 && ht->table[it->t] != NULL) {
+		while (it->i < HT_SIZE(ht->bits[it->t])) {
+			if (ht_ready(ht, it->t, it->i) &&
+			    ht->table[it->t][it->i] != NULL)
+			{
+				it->cur = ht->table[it->t][it->i];
+				return (ISC_R_SUCCESS);
+			}
+			it->i++;
+		}
+		it->t++;
+		it->i = 0;
+	}
+
+	it->cur = NULL;
+	return (ISC_R_NOMORE);
+}
+
 isc_result_t
 isc_ht_iter_first(isc_ht_iter_t *it) {
 	REQUIRE(it != NULL);
 
+	it->t = 0;
 	it->i = 0;
-	while (it->i < it->ht->size && it->ht->table[it->i] == NULL)
-		it->i++;
 
-	if (it->i == it->ht->size)
-		return (ISC_R_NOMORE);
-
-	it->cur = it->ht->table[it->i];
-
-	return (ISC_R_SUCCESS);
+	return (ht_iter_bucket(it));
 }
 
 isc_result_t
@@ -268,12 +457,8 @@ isc_ht_iter_next(isc_ht_iter_t *it) {
 
 	it->cur = it->cur->next;
 	if (it->cur == NULL) {
-		do {
-			it->i++;
-		} while (it->i < it->ht->size && it->ht->table[it->i] == NULL);
-		if (it->i >= it->ht->size)
-			return (ISC_R_NOMORE);
-		it->cur = it->ht->table[it->i];
+		it->i++;
+		return (ht_iter_bucket(it));
 	}
 
 	return (ISC_R_SUCCESS);
@@ -283,42 +468,23 @@ isc_result_t
 isc_ht_iter_delcurrent_next(isc_ht_iter_t *it) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_ht_node_t *to_delete = NULL;
-	isc_ht_node_t *prev = NULL;
-	isc_ht_node_t *node = NULL;
-	uint32_t hash;
 	isc_ht_t *ht;
+
 	REQUIRE(it != NULL);
 	REQUIRE(it->cur != NULL);
+
 	to_delete = it->cur;
 	ht = it->ht;
 
 	it->cur = it->cur->next;
 	if (it->cur == NULL) {
-		do {
-			it->i++;
-		} while (it->i < ht->size && ht->table[it->i] == NULL);
-		if (it->i >= ht->size)
-			result = ISC_R_NOMORE;
-		else
-			it->cur = ht->table[it->i];
-	}
-
-	hash = isc_hash_function(to_delete->key, to_delete->keysize, true,
-				 NULL);
-	node = ht->table[hash & ht->mask];
-	while (node != to_delete) {
-		prev = node;
-		node = node->next;
-		INSIST(node != NULL);
+		it->i++;
+		result = ht_iter_bucket(it);
 	}
 
-	if (prev == NULL)
-		ht->table[hash & ht->mask] = node->next;
-	else
-		prev->next = node->next;
-	isc_mem_put(ht->mctx, node,
-		    offsetof(isc_ht_node_t, key) + node->keysize);
-	ht->count--;
+	ht_unlink(ht, to_delete);
+	isc_mem_put(ht->mctx, to_delete,
+		    offsetof(isc_ht_node_t, key) + to_delete->keysize);
 
 	return (result);
 }
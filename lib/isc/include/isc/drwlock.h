@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef ISC_DRWLOCK_H
+#define ISC_DRWLOCK_H 1
+
+/*! \file isc/drwlock.h
+ * \brief Distributed reader-writer lock.
+ *
+ * A drwlock gives readers a counter per CPU ("slot"), each on its own
+ * cache line, instead of the single shared counter of an isc_rwlock.
+ * Taking and releasing a read lock only writes the caller's own slot and
+ * reads the writer flag, so concurrent readers on different CPUs do not
+ * bounce any cache lines between them.
+ *
+ * Writers pay for this: a writer raises the writer flag, which turns
+ * new readers away, and then waits for every slot to drain, much like
+ * an RCU grace period.  Writers are served before waiting readers.
+ *
+ * The lock is meant for data that is read far more often than it is
+ * written, such as the cache database.  Each slot costs a cache line.
+ *
+ * Read locks do not nest: a thread that holds a read lock must not ask
+ * for another one on the same lock, since a writer may be waiting.
+ */
+
+#include <isc/atomic.h>
+#include <isc/condition.h>
+#include <isc/lang.h>
+#include <isc/mutex.h>
+#include <isc/rwlock.h>
+#include <isc/types.h>
+
+ISC_LANG_BEGINDECLS
+
+typedef struct isc_drwslot isc_drwslot_t;
+
+typedef struct isc_drwlock {
+	/* Unlocked. */
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	unsigned int		nslots;
+	isc_drwslot_t		*slots;
+
+	/* Read or modified atomically. */
+	atomic_int_fast32_t	writer;
+
+	/*% Held by the writer for as long as it holds the lock. */
+	isc_mutex_t		wlock;
+
+	/*% Protects the wait for readers to drain. */
+	isc_mutex_t		lock;
+	isc_condition_t		drained;
+} isc_drwlock_t;
+
+isc_result_t
+isc_drwlock_init(isc_drwlock_t *rwl, isc_mem_t *mctx, unsigned int nslots);
+/*%<
+ * Initialize a distributed reader-writer lock with 'nslots' reader
+ * slots, or one slot per CPU if 'nslots' is 0.  A lock with a single
+ * slot behaves like an ordinary reader-writer lock.
+ *
+ * Requires:
+ *\li	'rwl' is not NULL.
+ *\li	'mctx' is a valid memory context.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_UNEXPECTED
+ */
+
+void
+isc_drwlock_destroy(isc_drwlock_t *rwl);
+/*%<
+ * Destroy 'rwl', which must not be held.
+ */
+
+isc_result_t
+isc_drwlock_lock(isc_drwlock_t *rwl, isc_rwlocktype_t type);
+
+isc_result_t
+isc_drwlock_trylock(isc_drwlock_t *rwl, isc_rwlocktype_t type);
+/*%<
+ * Like isc_drwlock_lock(), but return #ISC_R_LOCKBUSY rather than
+ * wait.
+ */
+
+isc_result_t
+isc_drwlock_unlock(isc_drwlock_t *rwl, isc_rwlocktype_t type);
+
+isc_result_t
+isc_drwlock_tryupgrade(isc_drwlock_t *rwl);
+/*%<
+ * Turn a read lock held by the caller into a write lock, if the caller
+ * is the only reader and no writer is waiting; otherwise return
+ * #ISC_R_LOCKBUSY and keep the read lock.
+ */
+
+void
+isc_drwlock_downgrade(isc_drwlock_t *rwl);
+/*%<
+ * Turn a write lock held by the caller into a read lock.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* ISC_DRWLOCK_H */
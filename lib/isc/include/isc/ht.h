@@ -26,6 +26,12 @@ typedef struct isc_ht_iter isc_ht_iter_t;
 /*%
  * Initialize hashtable at *htp, using memory context and size of (1<<bits)
  *
+ * The table grows as nodes are added and shrinks again as they are
+ * deleted, but never below (1<<bits) buckets; 'bits' is only a sizing
+ * hint.  Nodes are moved to a resized table a few buckets at a time by
+ * later calls to isc_ht_add() and isc_ht_delete(), so that no single
+ * call has to rehash the whole table.
+ *
  * Requires:
  *\li	htp is not NULL
  *\li	*htp is NULL
@@ -95,6 +101,9 @@ isc_ht_delete(isc_ht_t *ht, const unsigned char *key, uint32_t keysize);
 
 /*%
  * Create an iterator for the hashtable; point '*itp' to it.
+ *
+ * The table is not resized while any iterator exists, so that an
+ * iteration visits every node exactly once.
  */
 isc_result_t
 isc_ht_iter_create(isc_ht_t *ht, isc_ht_iter_t **itp);
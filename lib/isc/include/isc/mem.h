@@ -65,6 +65,18 @@ typedef void (*isc_memfree_t)(void *, void *);
 #define ISC_MEMPOOL_NAMES 1
 #endif
 
+/*%
+ * Define ISC_MEM_MAGAZINES=1 to put a small per-thread cache of free
+ * blocks ("magazines") in front of each locked memory context and of
+ * each memory pool with an associated lock, so that most gets and puts
+ * of small fixed sizes do not take a shared lock.  Statistics and
+ * water marks are brought up to date whenever a magazine is refilled
+ * or emptied.
+ */
+#ifndef ISC_MEM_MAGAZINES
+#define ISC_MEM_MAGAZINES 1
+#endif
+
 LIBISC_EXTERNAL_DATA extern unsigned int isc_mem_debugging;
 LIBISC_EXTERNAL_DATA extern unsigned int isc_mem_defaultflags;
 
@@ -379,7 +391,8 @@ isc_mem_inuse(isc_mem_t *mctx);
 /*%<
  * Get an estimate of the amount of memory in use in 'mctx', in bytes.
  * This includes quantization overhead, but does not include memory
- * allocated from the system but not yet used.
+ * allocated from the system but not yet used.  Free blocks held in
+ * per-thread caches (see ISC_MEM_MAGAZINES) are counted as in use.
  */
 
 size_t
@@ -590,7 +603,10 @@ isc_mempool_associatelock(isc_mempool_t *mpctx, isc_mutex_t *lock);
  *
  * This lock is used when getting or putting items using this memory pool,
  * and it is also used to set or get internal state via the isc_mempool_get*()
- * and isc_mempool_set*() set of functions.
+ * and isc_mempool_set*() set of functions.  With ISC_MEM_MAGAZINES, a pool
+ * with an associated lock also gets per-thread caches, so that the lock is
+ * only taken to move a batch of items into or out of a thread's cache.
+ * Items in those caches count against 'maxalloc'.
  *
  * Multiple pools can each share a single lock.  For instance, if "manager"
  * type object contained pools for various sizes of events, and each of
@@ -660,7 +676,9 @@ isc_mempool_setmaxalloc(isc_mempool_t *mpctx, unsigned int limit);
 unsigned int
 isc_mempool_getallocated(isc_mempool_t *mpctx);
 /*%<
- * Returns the number of items allocated from this pool.
+ * Returns the number of items allocated from this pool.  Items held in
+ * per-thread caches are not counted; the result is exact once no other
+ * thread is using the pool.
  */
 
 unsigned int
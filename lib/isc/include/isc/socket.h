@@ -102,12 +102,14 @@
 #define isc_socket_ipv6only isc__socket_ipv6only
 #define isc_socket_setname isc__socket_setname
 #define isc_socketmgr_getmaxsockets isc__socketmgr_getmaxsockets
+#define isc_socketmgr_getnthreads isc__socketmgr_getnthreads
 #define isc_socketmgr_setstats isc__socketmgr_setstats
 #define isc_socketmgr_setreserved isc__socketmgr_setreserved
 #define isc__socketmgr_maxudp isc___socketmgr_maxudp
 #define isc_socket_fdwatchcreate isc__socket_fdwatchcreate
 #define isc_socket_fdwatchpoke isc__socket_fdwatchpoke
 #define isc_socket_dscp isc__socket_dscp
+#define isc_socket_setbatch isc__socket_setbatch
 
 #endif
 
@@ -123,6 +125,12 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_SOCKET_MAXSCATTERGATHER	8
 
+/*%
+ * Maximum number of datagrams handled by one batched system call,
+ * see isc_socket_setbatch().
+ */
+#define ISC_SOCKET_MAXBATCH		64
+
 /*@{*/
 /*!
  * Socket options:
@@ -130,9 +138,16 @@ ISC_LANG_BEGINDECLS
  * _REUSEADDRESS:	Set SO_REUSEADDR prior to calling bind(),
  * 			if a non-zero port is specified (applies to
  * 			AF_INET and AF_INET6).
+ *
+ * _REUSEPORT:		Set SO_REUSEPORT (SO_REUSEPORT_LB where
+ * 			available) prior to calling bind(), so that several
+ * 			sockets can be bound to the same address and port
+ * 			and have the kernel spread incoming datagrams
+ * 			between them.
  */
 typedef enum {
 	ISC_SOCKET_REUSEADDRESS	= 0x01U,
+	ISC_SOCKET_REUSEPORT	= 0x02U
 } isc_socket_options_t;
 /*@}*/
 
@@ -719,6 +734,8 @@ isc_socket_bind(isc_socket_t *sock, const isc_sockaddr_t *addressp,
  * \li	ISC_R_ADDRNOTAVAIL
  * \li	ISC_R_ADDRINUSE
  * \li	ISC_R_BOUND
+ * \li	ISC_R_NOTIMPLEMENTED	(ISC_SOCKET_REUSEPORT was requested but
+ *				 the system does not support it)
  * \li	ISC_R_UNEXPECTED
  */
 
@@ -1039,12 +1056,16 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		      unsigned int maxsocks);
+		      unsigned int maxsocks, int nthreads);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
+ * "nthreads" is the number of watcher threads; each one runs its own
+ * event loop over a share of the sockets.  Values less than one are
+ * treated as one, and platforms that can only use select() always run
+ * a single watcher thread.
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
- * "maxsocks" being zero.
+ * "maxsocks" being zero and "nthreads" being one.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
@@ -1088,6 +1109,17 @@ isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager, unsigned int *nsockp);
  *\li	#ISC_R_NOTIMPLEMENTED
  */
 
+int
+isc_socketmgr_getnthreads(isc_socketmgr_t *manager);
+/*%<
+ * Returns the number of watcher threads running event loops for
+ * 'manager'.
+ *
+ * Requires:
+ *
+ *\li	'*manager' is a valid isc_socketmgr_t.
+ */
+
 void
 isc_socketmgr_setstats(isc_socketmgr_t *manager, isc_stats_t *stats);
 /*%<
@@ -1164,6 +1196,36 @@ isc_socket_dscp(isc_socket_t *sock, isc_dscp_t dscp);
  *\li	'sock' is a valid socket.
  */
 
+isc_result_t
+isc_socket_setbatch(isc_socket_t *sock, unsigned int count,
+		    unsigned int size);
+/*%<
+ * Enable batched I/O on a UDP socket.  When the socket becomes
+ * readable, up to 'count' datagrams of at most 'size' bytes each are
+ * drained with a single recvmmsg() call into buffers owned by the
+ * socket; they are copied out to subsequent receive requests without
+ * further system calls.  Send requests are always queued and
+ * completed asynchronously: the first one schedules a flush on the
+ * sending task, which writes everything queued by then, up to 'count'
+ * datagrams per sendmmsg() call.  'count' is silently limited to
+ * ISC_SOCKET_MAXBATCH.
+ *
+ * Batching can only be enabled once, before any I/O is requested on
+ * the socket.  A 'count' of 0 or 1 leaves the socket unbatched.
+ *
+ * Requires:
+ *\li	'sock' is a valid UDP socket.
+ *\li	'size' is greater than zero.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_EXISTS		batching is already enabled or I/O has
+ *				already been requested on the socket.
+ *\li	#ISC_R_NOTIMPLEMENTED	neither recvmmsg() nor sendmmsg() is
+ *				available.
+ */
+
 isc_socketevent_t *
 isc_socket_socketevent(isc_mem_t *mctx, void *sender,
 		       isc_eventtype_t eventtype, isc_taskaction_t action,
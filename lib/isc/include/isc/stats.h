@@ -37,6 +37,10 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  * Create a statistics counter structure of general type.  It counts a general
  * set of counters indexed by an ID between 0 and ncounters -1.
  *
+ * To keep threads on different CPUs from contending for the same cache
+ * lines, the counters are kept in several per-CPU shards which are only
+ * summed by isc_stats_dump(); each shard costs a copy of the counters.
+ *
  * Requires:
  *\li	'mctx' must be a valid memory context.
  *
@@ -118,15 +122,9 @@ isc_stats_set(isc_stats_t *stats, uint64_t val,
 /*%<
  * Set the given counter to the specfied value.
  *
- * Requires:
- *\li	'stats' is a valid isc_stats_t.
- */
-
-void
-isc_stats_set(isc_stats_t *stats, uint64_t val,
-	      isc_statscounter_t counter);
-/*%<
- * Set the given counter to the specfied value.
+ * Note: this resets every shard, so it is not atomic with respect to a
+ * concurrent isc_stats_increment() or isc_stats_decrement() of the same
+ * counter, which may be lost.
  *
  * Requires:
  *\li	'stats' is a valid isc_stats_t.
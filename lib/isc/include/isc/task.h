@@ -73,6 +73,7 @@
  *** Imports.
  ***/
 
+#include <inttypes.h>
 #include <stdbool.h>
 
 #include <isc/eventclass.h>
@@ -832,6 +833,15 @@ isc__taskmgr_pause(isc_taskmgr_t *taskmgr);
 void
 isc__taskmgr_resume(isc_taskmgr_t *taskmgr);
 
+void
+isc__taskmgr_sendstats(isc_taskmgr_t *taskmgr, uint64_t *sends,
+		       uint64_t *locked, uint64_t *contended);
+/*%<
+ * Return the number of events sent to tasks of 'taskmgr', how many of
+ * those sends took the task lock, and how many of them found it held
+ * by somebody else.  Intended for unit tests and benchmarks.
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* ISC_TASK_H */
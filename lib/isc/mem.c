@@ -31,6 +31,7 @@
 #include <isc/string.h>
 #include <isc/mutex.h>
 #include <isc/print.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/xml.h>
 
@@ -53,6 +54,13 @@ LIBISC_EXTERNAL_DATA unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 #define NUM_BASIC_BLOCKS	64		/*%< must be > 1 */
 #define TABLE_INCREMENT		1024
 #define DEBUG_TABLE_COUNT	512U
+#define CACHE_SLOTS		128U	/*%< threads that can have a cache */
+#define CACHE_MAXSIZE		512U	/*%< largest size kept in a cache */
+#define CACHE_CLASSES		(CACHE_MAXSIZE / ALIGNMENT_SIZE)
+#define CACHE_BYTES		4096U	/*%< target size of a magazine */
+#define CACHE_MINROUNDS		4U
+#define CACHE_MAXROUNDS		32U
+#define CACHE_NODEBUG		(ISC_MEM_DEBUGTRACE|ISC_MEM_DEBUGRECORD)
 
 /*
  * Types.
@@ -102,6 +110,27 @@ struct stats {
 	unsigned long		freefrags;
 };
 
+/*%
+ * A magazine is a small stack of free blocks of one size belonging to
+ * a single thread.  Only the thread owning the cache slot touches it,
+ * so it needs no lock; the shared allocator is visited only to move
+ * half a magazine at a time.  Rounds in a magazine stay counted in
+ * the context's 'inuse' (or the pool's 'allocated') until they are
+ * handed back.
+ */
+typedef struct magazine magazine_t;
+struct magazine {
+	size_t			size;		/*%< size of each round */
+	unsigned int		capacity;	/*%< max. # of rounds */
+	unsigned int		rounds;		/*%< # of rounds loaded */
+	unsigned long		gets;		/*%< gets not yet in stats */
+	void *			round[CACHE_MAXROUNDS];
+};
+
+typedef struct {
+	magazine_t *		classes[CACHE_CLASSES];
+} memcache_t;
+
 #define MEM_MAGIC		ISC_MAGIC('M', 'e', 'm', 'C')
 #define VALID_CONTEXT(c)	ISC_MAGIC_VALID(c, MEM_MAGIC)
 
@@ -119,6 +148,15 @@ static isc_mutex_t 		createlock;
  */
 static uint64_t		totallost;
 
+/*%
+ * Thread cache slots.  A thread claims the lowest free slot the first
+ * time it touches a cache and gives it back when it exits; the slot
+ * number indexes the per-context and per-pool cache arrays.
+ */
+static isc_thread_key_t		cachekey;
+static isc_mutex_t		cachelock;
+static bool			cacheslot[CACHE_SLOTS];
+
 struct isc__mem {
 	isc_mem_t		common;
 	unsigned int		flags;
@@ -146,6 +184,7 @@ struct isc__mem {
 	void *			water_arg;
 	ISC_LIST(isc__mempool_t) pools;
 	unsigned int		poolcnt;
+	memcache_t **		caches;		/*%< thread caches, by slot */
 
 	/*  ISC_MEMFLAG_INTERNAL */
 	size_t			mem_target;
@@ -174,6 +213,7 @@ struct isc__mempool {
 	isc_mempool_t	common;		/*%< common header of mempool's */
 	isc_mutex_t    *lock;		/*%< optional lock */
 	isc__mem_t      *mctx;		/*%< our memory context */
+	magazine_t    **caches;		/*%< thread caches, by slot */
 	/*%< locked via the memory context's lock */
 	ISC_LINK(isc__mempool_t)	link;	/*%< next pool in this mem context */
 	/*%< optionally locked from here down */
@@ -833,6 +873,311 @@ mem_putstats(isc__mem_t *ctx, void *ptr, size_t size) {
 	ctx->malloced -= size;
 }
 
+/*!
+ * Get a block from the shared allocator.  The context lock must be held.
+ */
+static inline void *
+mem_getblock(isc__mem_t *ctx, size_t size) {
+	void *ptr;
+
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0)
+		return (mem_getunlocked(ctx, size));
+
+	ptr = mem_get(ctx, size);
+	if (ptr != NULL)
+		mem_getstats(ctx, size);
+	return (ptr);
+}
+
+/*!
+ * Return a block to the shared allocator.  The context lock must be held.
+ */
+static inline void
+mem_putblock(isc__mem_t *ctx, void *ptr, size_t size) {
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+		mem_putunlocked(ctx, ptr, size);
+	} else {
+		mem_putstats(ctx, ptr, size);
+		mem_put(ctx, ptr, size);
+	}
+}
+
+/*!
+ * Update the overmem state after 'inuse' has grown.  The context lock
+ * must be held; returns true if the high water callback is due.
+ */
+static inline bool
+mem_hiwater(isc__mem_t *ctx) {
+	bool call_water = false;
+
+	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water) {
+		ctx->is_overmem = true;
+		if (!ctx->hi_called)
+			call_water = true;
+	}
+	if (ctx->inuse > ctx->maxinuse) {
+		ctx->maxinuse = ctx->inuse;
+		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
+			fprintf(stderr, "maxinuse = %lu\n",
+				(unsigned long)ctx->inuse);
+	}
+
+	return (call_water);
+}
+
+/*!
+ * Update the overmem state after 'inuse' has shrunk.  The context lock
+ * must be held; returns true if the low water callback is due.
+ */
+static inline bool
+mem_lowater(isc__mem_t *ctx) {
+	bool call_water = false;
+
+	/*
+	 * The check against ctx->lo_water == 0 is for the condition
+	 * when the context was pushed over hi_water but then had
+	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
+	 */
+	if ((ctx->inuse < ctx->lo_water) || (ctx->lo_water == 0U)) {
+		ctx->is_overmem = false;
+		if (ctx->hi_called)
+			call_water = true;
+	}
+
+	return (call_water);
+}
+
+/*
+ * Thread caches.
+ */
+
+static void
+cache_release(void *value) {
+	unsigned int slot = (unsigned int)((uintptr_t)value - 1);
+
+	if (slot < CACHE_SLOTS) {
+		LOCK(&cachelock);
+		cacheslot[slot] = false;
+		UNLOCK(&cachelock);
+	}
+}
+
+/*!
+ * Return the calling thread's cache slot, claiming one on first use.
+ * Threads that find every slot taken get CACHE_SLOTS and do without.
+ */
+static inline unsigned int
+cache_slot(void) {
+	void *value;
+	unsigned int slot;
+
+	value = isc_thread_key_getspecific(cachekey);
+	if (ISC_LIKELY(value != NULL))
+		return ((unsigned int)((uintptr_t)value - 1));
+
+	LOCK(&cachelock);
+	for (slot = 0; slot < CACHE_SLOTS; slot++) {
+		if (!cacheslot[slot]) {
+			cacheslot[slot] = true;
+			break;
+		}
+	}
+	UNLOCK(&cachelock);
+
+	value = (void *)((uintptr_t)slot + 1);
+	if (isc_thread_key_setspecific(cachekey, value) != 0) {
+		cache_release(value);
+		return (CACHE_SLOTS);
+	}
+
+	return (slot);
+}
+
+static inline void
+magazine_init(magazine_t *mag, size_t size) {
+	size_t capacity = CACHE_BYTES / size;
+
+	if (capacity < CACHE_MINROUNDS)
+		capacity = CACHE_MINROUNDS;
+	if (capacity > CACHE_MAXROUNDS)
+		capacity = CACHE_MAXROUNDS;
+
+	mag->size = size;
+	mag->capacity = (unsigned int)capacity;
+	mag->rounds = 0;
+	mag->gets = 0;
+}
+
+static void *
+mem_cachealloc(isc__mem_t *ctx, size_t size) {
+	void *ptr;
+
+	ptr = (ctx->memalloc)(ctx->arg, size);
+
+	MCTXLOCK(ctx, &ctx->lock);
+	if (ptr == NULL) {
+		ctx->memalloc_failures++;
+	} else {
+		ctx->malloced += size;
+		if (ctx->malloced > ctx->maxmalloced)
+			ctx->maxmalloced = ctx->malloced;
+	}
+	MCTXUNLOCK(ctx, &ctx->lock);
+
+	return (ptr);
+}
+
+/*!
+ * Find the calling thread's magazine for 'size', creating it if need
+ * be.  Returns NULL if the request has to go to the shared allocator.
+ *
+ * The magazine may currently hold rounds of another size in the same
+ * size class; callers must check mag->size.
+ */
+static inline magazine_t *
+mem_magazine(isc__mem_t *ctx, size_t size) {
+	memcache_t *cache;
+	magazine_t *mag;
+	unsigned int slot, idx;
+
+	if (ctx->caches == NULL || size == 0U || size > CACHE_MAXSIZE ||
+	    quantize(size) >= ctx->max_size ||
+	    ISC_UNLIKELY((isc_mem_debugging & CACHE_NODEBUG) != 0))
+		return (NULL);
+
+	slot = cache_slot();
+	if (ISC_UNLIKELY(slot >= CACHE_SLOTS))
+		return (NULL);
+
+	cache = ctx->caches[slot];
+	if (ISC_UNLIKELY(cache == NULL)) {
+		cache = mem_cachealloc(ctx, sizeof(*cache));
+		if (cache == NULL)
+			return (NULL);
+		memset(cache, 0, sizeof(*cache));
+		ctx->caches[slot] = cache;
+	}
+
+	idx = (unsigned int)((size - 1) / ALIGNMENT_SIZE);
+	mag = cache->classes[idx];
+	if (ISC_UNLIKELY(mag == NULL)) {
+		mag = mem_cachealloc(ctx, sizeof(*mag));
+		if (mag == NULL)
+			return (NULL);
+		magazine_init(mag, size);
+		cache->classes[idx] = mag;
+	}
+
+	return (mag);
+}
+
+/*!
+ * Fold the gets served from 'mag' since the last visit into the
+ * context statistics.  The context lock must be held.
+ */
+static inline void
+mem_cachefold(isc__mem_t *ctx, magazine_t *mag) {
+	ctx->stats[mag->size].totalgets += mag->gets;
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) == 0)
+		ctx->total += mag->gets * mag->size;
+	mag->gets = 0;
+}
+
+/*!
+ * Load half a magazine from the shared allocator, first rebinding it
+ * to 'size' if it is empty and was last used for another size.
+ */
+static void
+mem_cachefill(isc__mem_t *ctx, magazine_t *mag, size_t size) {
+	bool call_water;
+	void *ptr;
+
+	INSIST(mag->rounds == 0);
+
+	MCTXLOCK(ctx, &ctx->lock);
+	mem_cachefold(ctx, mag);
+	if (mag->size != size)
+		magazine_init(mag, size);
+
+	while (mag->rounds < mag->capacity / 2) {
+		ptr = mem_getblock(ctx, size);
+		if (ptr == NULL)
+			break;
+		mag->round[mag->rounds++] = ptr;
+
+		/*
+		 * The round hasn't been handed out yet; it is counted
+		 * by mem_cachefold() once it is.
+		 */
+		ctx->stats[size].totalgets--;
+		if ((ctx->flags & ISC_MEMFLAG_INTERNAL) == 0)
+			ctx->total -= size;
+	}
+	call_water = mem_hiwater(ctx);
+	MCTXUNLOCK(ctx, &ctx->lock);
+
+	if (call_water && (ctx->water != NULL))
+		(ctx->water)(ctx->water_arg, ISC_MEM_HIWATER);
+}
+
+/*!
+ * Return the 'count' oldest rounds in 'mag' to the shared allocator.
+ */
+static void
+mem_cacheflush(isc__mem_t *ctx, magazine_t *mag, unsigned int count) {
+	bool call_water;
+	unsigned int i;
+
+	INSIST(count <= mag->rounds);
+
+	MCTXLOCK(ctx, &ctx->lock);
+	mem_cachefold(ctx, mag);
+	for (i = 0; i < count; i++)
+		mem_putblock(ctx, mag->round[i], mag->size);
+	call_water = mem_lowater(ctx);
+	MCTXUNLOCK(ctx, &ctx->lock);
+
+	mag->rounds -= count;
+	memmove(&mag->round[0], &mag->round[count],
+		mag->rounds * sizeof(mag->round[0]));
+
+	if (call_water && (ctx->water != NULL))
+		(ctx->water)(ctx->water_arg, ISC_MEM_LOWATER);
+}
+
+/*!
+ * Empty and free every thread cache of a context that is going away.
+ */
+static void
+mem_cachedestroy(isc__mem_t *ctx) {
+	memcache_t *cache;
+	magazine_t *mag;
+	unsigned int slot, idx, i;
+
+	for (slot = 0; slot < CACHE_SLOTS; slot++) {
+		cache = ctx->caches[slot];
+		if (cache == NULL)
+			continue;
+		for (idx = 0; idx < CACHE_CLASSES; idx++) {
+			mag = cache->classes[idx];
+			if (mag == NULL)
+				continue;
+			mem_cachefold(ctx, mag);
+			for (i = 0; i < mag->rounds; i++)
+				mem_putblock(ctx, mag->round[i], mag->size);
+			(ctx->memfree)(ctx->arg, mag);
+			ctx->malloced -= sizeof(*mag);
+		}
+		(ctx->memfree)(ctx->arg, cache);
+		ctx->malloced -= sizeof(*cache);
+	}
+
+	(ctx->memfree)(ctx->arg, ctx->caches);
+	ctx->malloced -= CACHE_SLOTS * sizeof(memcache_t *);
+	ctx->caches = NULL;
+}
+
 /*
  * Private.
  */
@@ -855,6 +1200,8 @@ static void
 initialize_action(void) {
 	RUNTIME_CHECK(isc_mutex_init(&createlock) == ISC_R_SUCCESS);
 	RUNTIME_CHECK(isc_mutex_init(&contextslock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_mutex_init(&cachelock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_thread_key_create(&cachekey, cache_release) == 0);
 	ISC_LIST_INIT(contexts);
 	totallost = 0;
 }
@@ -935,6 +1282,7 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 #endif
 	ISC_LIST_INIT(ctx->pools);
 	ctx->poolcnt = 0;
+	ctx->caches = NULL;
 	ctx->freelists = NULL;
 	ctx->basic_blocks = NULL;
 	ctx->basic_table = NULL;
@@ -953,6 +1301,18 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 	ctx->malloced += (ctx->max_size+1) * sizeof(struct stats);
 	ctx->maxmalloced += (ctx->max_size+1) * sizeof(struct stats);
 
+	if (ISC_MEM_MAGAZINES && (flags & ISC_MEMFLAG_NOLOCK) == 0) {
+		ctx->caches = (memalloc)(arg,
+					 CACHE_SLOTS * sizeof(memcache_t *));
+		if (ctx->caches == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto error;
+		}
+		memset(ctx->caches, 0, CACHE_SLOTS * sizeof(memcache_t *));
+		ctx->malloced += CACHE_SLOTS * sizeof(memcache_t *);
+		ctx->maxmalloced += CACHE_SLOTS * sizeof(memcache_t *);
+	}
+
 	if ((flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		if (target_size == 0U)
 			ctx->mem_target = DEF_MEM_TARGET;
@@ -1000,6 +1360,8 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 	if (ctx != NULL) {
 		if (ctx->stats != NULL)
 			(memfree)(arg, ctx->stats);
+		if (ctx->caches != NULL)
+			(memfree)(arg, ctx->caches);
 		if (ctx->freelists != NULL)
 			(memfree)(arg, ctx->freelists);
 #if ISC_MEM_TRACKLINES
@@ -1018,6 +1380,9 @@ static void
 destroy(isc__mem_t *ctx) {
 	unsigned int i;
 
+	if (ctx->caches != NULL)
+		mem_cachedestroy(ctx);
+
 	LOCK(&contextslock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
 	totallost += ctx->inuse;
@@ -1195,6 +1560,7 @@ isc__mem_destroy(isc_mem_t **ctxp) {
 void *
 isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
+	magazine_t *mag;
 	void *ptr;
 	bool call_water = false;
 
@@ -1204,6 +1570,20 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 			  (ISC_MEM_DEBUGSIZE|ISC_MEM_DEBUGCTX)) != 0))
 		return (isc__mem_allocate(ctx0, size FLARG_PASS));
 
+	mag = mem_magazine(ctx, size);
+	if (mag != NULL && (mag->size == size || mag->rounds == 0)) {
+		if (mag->rounds == 0) {
+			mem_cachefill(ctx, mag, size);
+			if (ISC_UNLIKELY(mag->rounds == 0))
+				return (NULL);
+		}
+		ptr = mag->round[--mag->rounds];
+		mag->gets++;
+		if (ISC_UNLIKELY((ctx->flags & ISC_MEMFLAG_FILL) != 0))
+			memset(ptr, 0xbe, size); /* Mnemonic for "beef". */
+		return (ptr);
+	}
+
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		ptr = mem_getunlocked(ctx, size);
@@ -1216,18 +1596,7 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 
 	ADD_TRACE(ctx, ptr, size, file, line);
 
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water) {
-		ctx->is_overmem = true;
-		if (!ctx->hi_called)
-			call_water = true;
-	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
-		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
-			fprintf(stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
-	}
+	call_water = mem_hiwater(ctx);
 	MCTXUNLOCK(ctx, &ctx->lock);
 
 	if (call_water && (ctx->water != NULL))
@@ -1239,6 +1608,7 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 void
 isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
+	magazine_t *mag;
 	bool call_water = false;
 	size_info *si;
 	size_t oldsize;
@@ -1260,6 +1630,16 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+	mag = mem_magazine(ctx, size);
+	if (mag != NULL && mag->size == size) {
+		if (mag->rounds == mag->capacity)
+			mem_cacheflush(ctx, mag, mag->capacity / 2);
+		if (ISC_UNLIKELY((ctx->flags & ISC_MEMFLAG_FILL) != 0))
+			memset(ptr, 0xde, size); /* Mnemonic for "dead". */
+		mag->round[mag->rounds++] = ptr;
+		return;
+	}
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
@@ -1271,16 +1651,7 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		mem_put(ctx, ptr, size);
 	}
 
-	/*
-	 * The check against ctx->lo_water == 0 is for the condition
-	 * when the context was pushed over hi_water but then had
-	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
-	 */
-	if ((ctx->inuse < ctx->lo_water) || (ctx->lo_water == 0U)) {
-		ctx->is_overmem = false;
-		if (ctx->hi_called)
-			call_water = true;
-	}
+	call_water = mem_lowater(ctx);
 
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1784,6 +2155,166 @@ isc_mem_gettag(isc_mem_t *ctx0) {
  * Memory pool stuff
  */
 
+/*!
+ * Fill the pool's free list from the memory context.  The pool lock,
+ * if any, must be held.
+ */
+static void
+mempool_fill(isc__mempool_t *mpctx) {
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item;
+	unsigned int i;
+
+	MCTXLOCK(mctx, &mctx->lock);
+	for (i = 0; i < mpctx->fillcount; i++) {
+		item = mem_getblock(mctx, mpctx->size);
+		if (ISC_UNLIKELY(item == NULL))
+			break;
+		item->next = mpctx->items;
+		mpctx->items = item;
+		mpctx->freecount++;
+	}
+	MCTXUNLOCK(mctx, &mctx->lock);
+}
+
+/*!
+ * Find the calling thread's magazine for 'mpctx', creating it if need
+ * be.  Returns NULL if the pool has to be used directly.
+ */
+static inline magazine_t *
+mempool_magazine(isc__mempool_t *mpctx) {
+	magazine_t *mag;
+	unsigned int slot;
+
+	if (mpctx->caches == NULL ||
+	    ISC_UNLIKELY((isc_mem_debugging & CACHE_NODEBUG) != 0))
+		return (NULL);
+
+	slot = cache_slot();
+	if (ISC_UNLIKELY(slot >= CACHE_SLOTS))
+		return (NULL);
+
+	mag = mpctx->caches[slot];
+	if (ISC_UNLIKELY(mag == NULL)) {
+		mag = isc_mem_get((isc_mem_t *)mpctx->mctx, sizeof(*mag));
+		if (mag == NULL)
+			return (NULL);
+		magazine_init(mag, mpctx->size);
+		mpctx->caches[slot] = mag;
+	}
+
+	return (mag);
+}
+
+/*!
+ * Load half a magazine from the pool.  The rounds are counted as
+ * allocated, so they count against 'maxalloc'.
+ */
+static void
+mempool_cachefill(isc__mempool_t *mpctx, magazine_t *mag) {
+	element *item;
+
+	INSIST(mag->rounds == 0);
+
+	LOCK(mpctx->lock);
+	mpctx->gets += mag->gets;
+	mag->gets = 0;
+	while (mag->rounds < mag->capacity / 2 &&
+	       mpctx->allocated < mpctx->maxalloc)
+	{
+		if (mpctx->items == NULL) {
+			mempool_fill(mpctx);
+			if (mpctx->items == NULL)
+				break;
+		}
+		item = mpctx->items;
+		mpctx->items = item->next;
+		INSIST(mpctx->freecount > 0);
+		mpctx->freecount--;
+		mpctx->allocated++;
+		mag->round[mag->rounds++] = item;
+	}
+	UNLOCK(mpctx->lock);
+}
+
+/*!
+ * Return the 'count' oldest rounds in 'mag' to the pool, passing
+ * whatever doesn't fit on the free list on to the memory context.
+ */
+static void
+mempool_cacheflush(isc__mempool_t *mpctx, magazine_t *mag,
+		   unsigned int count)
+{
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item, *spill = NULL;
+	unsigned int i;
+
+	INSIST(count <= mag->rounds);
+
+	LOCK(mpctx->lock);
+	mpctx->gets += mag->gets;
+	mag->gets = 0;
+	for (i = 0; i < count; i++) {
+		item = mag->round[i];
+		INSIST(mpctx->allocated > 0);
+		mpctx->allocated--;
+		if (mpctx->freecount >= mpctx->freemax) {
+			item->next = spill;
+			spill = item;
+		} else {
+			mpctx->freecount++;
+			item->next = mpctx->items;
+			mpctx->items = item;
+		}
+	}
+	UNLOCK(mpctx->lock);
+
+	mag->rounds -= count;
+	memmove(&mag->round[0], &mag->round[count],
+		mag->rounds * sizeof(mag->round[0]));
+
+	if (spill != NULL) {
+		MCTXLOCK(mctx, &mctx->lock);
+		while (spill != NULL) {
+			item = spill;
+			spill = item->next;
+			mem_putblock(mctx, item, mpctx->size);
+		}
+		MCTXUNLOCK(mctx, &mctx->lock);
+	}
+}
+
+/*!
+ * Move the rounds in every thread cache of 'mpctx' back onto its free
+ * list and free the caches.  The pool must no longer be in use.
+ */
+static void
+mempool_cachedestroy(isc__mempool_t *mpctx) {
+	magazine_t *mag;
+	element *item;
+	unsigned int slot, i;
+
+	for (slot = 0; slot < CACHE_SLOTS; slot++) {
+		mag = mpctx->caches[slot];
+		if (mag == NULL)
+			continue;
+		mpctx->gets += mag->gets;
+		for (i = 0; i < mag->rounds; i++) {
+			INSIST(mpctx->allocated > 0);
+			mpctx->allocated--;
+			item = mag->round[i];
+			item->next = mpctx->items;
+			mpctx->items = item;
+			mpctx->freecount++;
+		}
+		isc_mem_put((isc_mem_t *)mpctx->mctx, mag, sizeof(*mag));
+	}
+
+	isc_mem_put((isc_mem_t *)mpctx->mctx, mpctx->caches,
+		    CACHE_SLOTS * sizeof(magazine_t *));
+	mpctx->caches = NULL;
+}
+
 isc_result_t
 isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	isc__mem_t *mctx = (isc__mem_t *)mctx0;
@@ -1806,6 +2337,7 @@ isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	mpctx->common.magic = ISCAPI_MPOOL_MAGIC;
 	mpctx->lock = NULL;
 	mpctx->mctx = mctx;
+	mpctx->caches = NULL;
 	/*
 	 * Mempools are stored as a linked list of element.
 	 */
@@ -1865,6 +2397,10 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 	REQUIRE(mpctxp != NULL);
 	mpctx = (isc__mempool_t *)*mpctxp;
 	REQUIRE(VALID_MEMPOOL(mpctx));
+
+	if (mpctx->caches != NULL)
+		mempool_cachedestroy(mpctx);
+
 #if ISC_MEMPOOL_NAMES
 	if (mpctx->allocated > 0)
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1890,13 +2426,7 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 		mpctx->freecount--;
 		item = mpctx->items;
 		mpctx->items = item->next;
-
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			mem_putunlocked(mctx, item, mpctx->size);
-		} else {
-			mem_putstats(mctx, item, mpctx->size);
-			mem_put(mctx, item, mpctx->size);
-		}
+		mem_putblock(mctx, item, mpctx->size);
 	}
 	MCTXUNLOCK(mctx, &mctx->lock);
 
@@ -1928,19 +2458,43 @@ isc__mempool_associatelock(isc_mempool_t *mpctx0, isc_mutex_t *lock) {
 	REQUIRE(lock != NULL);
 
 	mpctx->lock = lock;
+
+	/*
+	 * A pool with a lock is shared between threads: give each
+	 * thread a magazine so most gets and puts avoid the lock.
+	 */
+	if (ISC_MEM_MAGAZINES) {
+		mpctx->caches = isc_mem_get((isc_mem_t *)mpctx->mctx,
+					    CACHE_SLOTS *
+					    sizeof(magazine_t *));
+		if (mpctx->caches != NULL)
+			memset(mpctx->caches, 0,
+			       CACHE_SLOTS * sizeof(magazine_t *));
+	}
 }
 
 void *
 isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
+	magazine_t *mag;
 	element *item;
 	isc__mem_t *mctx;
-	unsigned int i;
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
 	mctx = mpctx->mctx;
 
+	mag = mempool_magazine(mpctx);
+	if (mag != NULL) {
+		if (mag->rounds == 0) {
+			mempool_cachefill(mpctx, mag);
+			if (ISC_UNLIKELY(mag->rounds == 0))
+				return (NULL);
+		}
+		mag->gets++;
+		return (mag->round[--mag->rounds]);
+	}
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
@@ -1954,25 +2508,9 @@ isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 
 	if (ISC_UNLIKELY(mpctx->items == NULL)) {
 		/*
-		 * We need to dip into the well.  Lock the memory context
-		 * here and fill up our free list.
+		 * We need to dip into the well and fill up our free list.
 		 */
-		MCTXLOCK(mctx, &mctx->lock);
-		for (i = 0; i < mpctx->fillcount; i++) {
-			if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-				item = mem_getunlocked(mctx, mpctx->size);
-			} else {
-				item = mem_get(mctx, mpctx->size);
-				if (item != NULL)
-					mem_getstats(mctx, mpctx->size);
-			}
-			if (ISC_UNLIKELY(item == NULL))
-				break;
-			item->next = mpctx->items;
-			mpctx->items = item;
-			mpctx->freecount++;
-		}
-		MCTXUNLOCK(mctx, &mctx->lock);
+		mempool_fill(mpctx);
 	}
 
 	/*
@@ -2009,6 +2547,7 @@ isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 void
 isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
+	magazine_t *mag;
 	isc__mem_t *mctx;
 	element *item;
 
@@ -2017,6 +2556,14 @@ isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 
 	mctx = mpctx->mctx;
 
+	mag = mempool_magazine(mpctx);
+	if (mag != NULL) {
+		if (mag->rounds == mag->capacity)
+			mempool_cacheflush(mpctx, mag, mag->capacity / 2);
+		mag->round[mag->rounds++] = mem;
+		return;
+	}
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
@@ -2036,12 +2583,7 @@ isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	 */
 	if (mpctx->freecount >= mpctx->freemax) {
 		MCTXLOCK(mctx, &mctx->lock);
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			mem_putunlocked(mctx, mem, mpctx->size);
-		} else {
-			mem_putstats(mctx, mem, mpctx->size);
-			mem_put(mctx, mem, mpctx->size);
-		}
+		mem_putblock(mctx, mem, mpctx->size);
 		MCTXUNLOCK(mctx, &mctx->lock);
 		if (mpctx->lock != NULL)
 			UNLOCK(mpctx->lock);
@@ -2154,6 +2696,7 @@ unsigned int
 isc__mempool_getallocated(isc_mempool_t *mpctx0) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
 	unsigned int allocated;
+	unsigned int slot;
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
@@ -2162,6 +2705,19 @@ isc__mempool_getallocated(isc_mempool_t *mpctx0) {
 
 	allocated = mpctx->allocated;
 
+	/*
+	 * Rounds sitting in thread caches are counted as allocated but
+	 * haven't been handed out.  The caches are read without their
+	 * owners' cooperation, so this is only exact when the pool is
+	 * quiescent, which is when callers depend on it.
+	 */
+	if (mpctx->caches != NULL) {
+		for (slot = 0; slot < CACHE_SLOTS; slot++) {
+			if (mpctx->caches[slot] != NULL)
+				allocated -= mpctx->caches[slot]->rounds;
+		}
+	}
+
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
 
@@ -21,6 +21,8 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
@@ -32,20 +34,66 @@
 
 typedef atomic_int_fast64_t isc_stat_t;
 
+/*%
+ * Each statistics set keeps one copy of its counters per shard, and
+ * each thread updates the shard it was assigned on first use, so that
+ * threads on different CPUs do not fight over the same cache lines.
+ * Shards are summed only when the counters are dumped.  Every shard
+ * costs a full copy of the counters, so the number of shards is the
+ * number of CPUs, capped at STATS_MAXSHARDS.
+ */
+#define STATS_MAXSHARDS		8
+#define STATS_LINESIZE		64
+
+static isc_once_t		shards_once = ISC_ONCE_INIT;
+static unsigned int		nshards = 1;
+static atomic_uint_fast32_t	nextshard;
+
+#if defined(HAVE_TLS)
+#if defined(HAVE_THREAD_LOCAL)
+#include <threads.h>
+static thread_local int myshard = -1;
+#elif defined(HAVE___THREAD)
+static __thread int myshard = -1;
+#elif defined(HAVE___DECLSPEC_THREAD)
+static __declspec( thread ) int myshard = -1;
+#else
+#error "Unknown method for defining a TLS variable!"
+#endif
+#else
+/*
+ * Without thread-local storage every thread shares the one shard.
+ */
+static int myshard = 0;
+#endif
+
+static void
+init_shards(void) {
+#if defined(HAVE_TLS)
+	unsigned int ncpus = isc_os_ncpus();
+
+	nshards = ISC_MIN(ISC_MAX(ncpus, 1), STATS_MAXSHARDS);
+#endif
+}
+
 struct isc_stats {
 	/*% Unlocked */
 	unsigned int	magic;
 	isc_mem_t	*mctx;
 	int		ncounters;
+	unsigned int	nshards;
+	int		stride;		/*%< counters per shard, padded */
 
 	isc_mutex_t	lock;
 	unsigned int	references; /* locked by lock */
 
 	/*%
-	 * Locked by counterlock or unlocked if efficient rwlock is not
-	 * available.
+	 * 'nshards' arrays of 'stride' counters, starting on a cache
+	 * line boundary within 'countersmem'; unlocked.
 	 */
 	isc_stat_t	*counters;
+	void		*countersmem;
+	size_t		countersize;	/*%< allocated size of countersmem */
 
 	/*%
 	 * We don't want to lock the counters while we are dumping, so we first
@@ -61,6 +109,20 @@ struct isc_stats {
 	uint64_t	*copiedcounters;
 };
 
+/*
+ * Return this thread's counters in 'stats'.
+ */
+static inline isc_stat_t *
+stats_shard(isc_stats_t *stats) {
+	if (ISC_UNLIKELY(myshard < 0)) {
+		myshard = atomic_fetch_add_explicit(&nextshard, 1,
+						    memory_order_relaxed) %
+			  STATS_MAXSHARDS;
+	}
+
+	return (stats->counters + (myshard % stats->nshards) * stats->stride);
+}
+
 static isc_result_t
 create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	isc_stats_t *stats;
@@ -68,6 +130,8 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
+	RUNTIME_CHECK(isc_once_do(&shards_once, init_shards) == ISC_R_SUCCESS);
+
 	stats = isc_mem_get(mctx, sizeof(*stats));
 	if (stats == NULL)
 		return (ISC_R_NOMEMORY);
@@ -76,11 +140,35 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	stats->counters = isc_mem_get(mctx, sizeof(isc_stat_t) * ncounters);
-	if (stats->counters == NULL) {
+	/*
+	 * Pad each shard to a whole number of cache lines, and start
+	 * the first one on a cache line boundary, so that neighbouring
+	 * shards do not share a line.  isc_mem_get() only guarantees
+	 * pointer alignment, so allocate an extra line to align within.
+	 */
+	stats->nshards = nshards;
+	stats->stride = ncounters;
+	stats->countersize = sizeof(isc_stat_t) * ncounters;
+	if (nshards > 1) {
+		int perline = STATS_LINESIZE / sizeof(isc_stat_t);
+		stats->stride = (ncounters + perline - 1) / perline * perline;
+		stats->countersize = sizeof(isc_stat_t) * stats->stride *
+				     stats->nshards + STATS_LINESIZE;
+	}
+
+	stats->countersmem = isc_mem_get(mctx, stats->countersize);
+	if (stats->countersmem == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto clean_mutex;
 	}
+	stats->counters = stats->countersmem;
+	if (nshards > 1) {
+		uintptr_t base = (uintptr_t)stats->countersmem;
+
+		base = (base + STATS_LINESIZE - 1) &
+		       ~(uintptr_t)(STATS_LINESIZE - 1);
+		stats->counters = (isc_stat_t *)base;
+	}
 	stats->copiedcounters = isc_mem_get(mctx,
 					    sizeof(uint64_t) * ncounters);
 	if (stats->copiedcounters == NULL) {
@@ -89,7 +177,8 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	}
 
 	stats->references = 1;
-	memset(stats->counters, 0, sizeof(isc_stat_t) * ncounters);
+	memset(stats->counters, 0,
+	       sizeof(isc_stat_t) * stats->stride * stats->nshards);
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
@@ -100,7 +189,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	return (result);
 
 clean_counters:
-	isc_mem_put(mctx, stats->counters, sizeof(isc_stat_t) * ncounters);
+	isc_mem_put(mctx, stats->countersmem, stats->countersize);
 
 clean_mutex:
 	DESTROYLOCK(&stats->lock);
@@ -138,8 +227,8 @@ isc_stats_detach(isc_stats_t **statsp) {
 	if (stats->references == 0) {
 		isc_mem_put(stats->mctx, stats->copiedcounters,
 			    sizeof(isc_stat_t) * stats->ncounters);
-		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc_stat_t) * stats->ncounters);
+		isc_mem_put(stats->mctx, stats->countersmem,
+			    stats->countersize);
 		UNLOCK(&stats->lock);
 		DESTROYLOCK(&stats->lock);
 		isc_mem_putanddetach(&stats->mctx, stats, sizeof(*stats));
@@ -168,7 +257,7 @@ isc_stats_increment(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	atomic_fetch_add_explicit(&stats->counters[counter], 1,
+	atomic_fetch_add_explicit(&stats_shard(stats)[counter], 1,
 				  memory_order_relaxed);
 }
 
@@ -177,7 +266,7 @@ isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	atomic_fetch_sub_explicit(&stats->counters[counter], 1,
+	atomic_fetch_sub_explicit(&stats_shard(stats)[counter], 1,
 				  memory_order_relaxed);
 }
 
@@ -185,14 +274,25 @@ void
 isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn,
 	       void *arg, unsigned int options)
 {
+	unsigned int shard;
 	int i;
 
 	REQUIRE(ISC_STATS_VALID(stats));
 
+	/*
+	 * A counter may have been decremented in a different shard
+	 * from the one it was incremented in, so individual shards
+	 * can go negative; their (modular) sum is still right.
+	 */
 	for (i = 0; i < stats->ncounters; i++) {
-		stats->copiedcounters[i] =
-			atomic_load_explicit(&stats->counters[i],
-					     memory_order_relaxed);
+		uint64_t value = 0;
+		for (shard = 0; shard < stats->nshards; shard++) {
+			isc_stat_t *counters;
+			counters = stats->counters + shard * stats->stride;
+			value += atomic_load_explicit(&counters[i],
+						      memory_order_relaxed);
+		}
+		stats->copiedcounters[i] = value;
 	}
 
 	for (i = 0; i < stats->ncounters; i++) {
@@ -207,9 +307,20 @@ void
 isc_stats_set(isc_stats_t *stats, uint64_t val,
 	      isc_statscounter_t counter)
 {
+	unsigned int shard;
+
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	/*
+	 * The value lives in the first shard; clear the others so the
+	 * sum comes out as 'val'.
+	 */
+	for (shard = 1; shard < stats->nshards; shard++) {
+		atomic_store_explicit(&stats->counters[shard * stats->stride +
+						       counter],
+				      0, memory_order_relaxed);
+	}
 	atomic_store_explicit(&stats->counters[counter], val,
 			      memory_order_relaxed);
 }
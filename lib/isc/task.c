@@ -21,6 +21,7 @@
 #include <stdbool.h>
 
 #include <isc/app.h>
+#include <isc/atomic.h>
 #include <isc/condition.h>
 #include <isc/event.h>
 #include <isc/json.h>
@@ -66,6 +67,15 @@
 #define XTHREADTRACE(m)
 #endif
 
+/*%
+ * Events sent to a task are normally pushed onto a lock-free inbox
+ * which the worker running the task drains in bulk; the task lock is
+ * only taken by the sender which finds the inbox empty.  Define
+ * ISC_TASK_MUTEXSEND to append every event to the task's event list
+ * under the task lock instead, e.g. to compare the two with the
+ * counters returned by isc__taskmgr_sendstats().
+ */
+
 /***
  *** Types.
  ***/
@@ -104,8 +114,16 @@ struct isc__task {
 	isc_time_t			tnow;
 	char				name[16];
 	void *				tag;
+	unsigned int			nsent;
+	/* Not locked; fixed when the task is created. */
+	unsigned int			threadid;
+	/* Not locked; see task_post(). */
+	atomic_uintptr_t		inbox;
+	atomic_uint_fast32_t		sends_locked;
+	atomic_uint_fast32_t		sends_contended;
 	/* Locked by task manager lock. */
 	LINK(isc__task_t)		link;
+	/* Locked by the lock of queue 'threadid'. */
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
 };
@@ -121,6 +139,25 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+/*%
+ * Each worker thread owns a ready queue.  A task is always queued on
+ * the queue of the worker it has affinity with ('task->threadid'), so
+ * that making a task ready only touches that worker's lock; a worker
+ * which runs out of work of its own steals ready tasks from the other
+ * queues before going to sleep.
+ */
+typedef struct isc__taskqueue {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc__tasklist_t			ready_priority_tasks;
+	isc_condition_t			work_available;
+	bool				idle;
+} isc__taskqueue_t;
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
@@ -128,17 +165,27 @@ struct isc__taskmgr {
 	isc_mutex_t			lock;
 	unsigned int			workers;
 	isc_thread_t *			threads;
+	unsigned int			nqueues;
+	isc__taskqueue_t *		queues;
+	atomic_uint_fast32_t		tasks_count;
+	atomic_uint_fast32_t		tasks_running;
+	atomic_uint_fast32_t		tasks_ready;
+	atomic_uint_fast32_t		tasks_stolen;
+	atomic_uint_fast32_t		idle_workers;
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
 	LIST(isc__task_t)		tasks;
-	isc__tasklist_t			ready_tasks;
-	isc__tasklist_t			ready_priority_tasks;
+	uint64_t			sends;
+	uint64_t			sends_locked;
+	uint64_t			sends_contended;
+	unsigned int			curq;
+	isc_condition_t			halt_cond;
+	unsigned int			halted;
+	/*
+	 * Locked by task manager lock and by every queue lock when
+	 * written, so holding either is enough to read them.
+	 */
 	isc_taskmgrmode_t		mode;
-	isc_condition_t			work_available;
-	isc_condition_t			exclusive_granted;
-	isc_condition_t			paused;
-	unsigned int			tasks_running;
-	unsigned int			tasks_ready;
 	bool			pause_requested;
 	bool			exclusive_requested;
 	bool			exiting;
@@ -154,7 +201,9 @@ struct isc__taskmgr {
 
 #define DEFAULT_TASKMGR_QUANTUM		10
 #define DEFAULT_DEFAULT_QUANTUM		5
-#define FINISHED(m)			((m)->exiting && EMPTY((m)->tasks))
+#define FINISHED(m)			((m)->exiting && \
+					 atomic_load_explicit(&(m)->tasks_count, \
+							memory_order_acquire) == 0)
 
 /*%
  * The following are intended for internal use (indicated by "isc__"
@@ -228,14 +277,17 @@ isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
 
 static inline bool
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskmgr_t *manager, unsigned int threadid);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskmgr_t *manager, unsigned int threadid);
 
 static inline void
 push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
 
+static void
+wake_all_queues(isc__taskmgr_t *manager);
+
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
 
@@ -288,6 +340,7 @@ task_finished(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
 
 	REQUIRE(EMPTY(task->events));
+	REQUIRE(atomic_load_explicit(&task->inbox, memory_order_relaxed) == 0);
 	REQUIRE(task->nevents == 0);
 	REQUIRE(EMPTY(task->on_shutdown));
 	REQUIRE(task->references == 0);
@@ -297,6 +350,15 @@ task_finished(isc__task_t *task) {
 
 	LOCK(&manager->lock);
 	UNLINK(manager->tasks, task, link);
+	manager->sends += task->nsent;
+	manager->sends_locked +=
+		atomic_load_explicit(&task->sends_locked,
+				     memory_order_relaxed);
+	manager->sends_contended +=
+		atomic_load_explicit(&task->sends_contended,
+				     memory_order_relaxed);
+	atomic_fetch_sub_explicit(&manager->tasks_count, 1,
+				  memory_order_release);
 	if (FINISHED(manager)) {
 		/*
 		 * All tasks have completed and the
@@ -304,7 +366,7 @@ task_finished(isc__task_t *task) {
 		 * any idle worker threads so they
 		 * can exit.
 		 */
-		BROADCAST(&manager->work_available);
+		wake_all_queues(manager);
 	}
 	UNLOCK(&manager->lock);
 
@@ -341,12 +403,17 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	INIT_LIST(task->events);
 	INIT_LIST(task->on_shutdown);
 	task->nevents = 0;
+	task->nsent = 0;
+	atomic_init(&task->inbox, 0);
+	atomic_init(&task->sends_locked, 0);
+	atomic_init(&task->sends_contended, 0);
 	task->quantum = quantum;
 	task->flags = 0;
 	task->now = 0;
 	isc_time_settoepoch(&task->tnow);
 	memset(task->name, 0, sizeof(task->name));
 	task->tag = NULL;
+	task->threadid = 0;
 	INIT_LINK(task, link);
 	INIT_LINK(task, ready_link);
 	INIT_LINK(task, ready_priority_link);
@@ -356,7 +423,10 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+		task->threadid = manager->curq++ % manager->workers;
 		APPEND(manager->tasks, task, link);
+		atomic_fetch_add_explicit(&manager->tasks_count, 1,
+					  memory_order_relaxed);
 	} else
 		exiting = true;
 	UNLOCK(&manager->lock);
@@ -395,6 +465,76 @@ isc__task_attach(isc_task_t *source0, isc_task_t **targetp) {
 	*targetp = (isc_task_t *)source;
 }
 
+/*
+ * Take the task lock on behalf of a sender, counting whether somebody
+ * else was holding it.
+ */
+static inline void
+task_sendlock(isc__task_t *task) {
+	if (isc_mutex_trylock(&task->lock) != ISC_R_SUCCESS) {
+		atomic_fetch_add_explicit(&task->sends_contended, 1,
+					  memory_order_relaxed);
+		LOCK(&task->lock);
+	}
+	atomic_fetch_add_explicit(&task->sends_locked, 1,
+				  memory_order_relaxed);
+}
+
+/*
+ * Push 'event' onto the task's inbox without taking the task lock.
+ * The inbox is a LIFO stack linked through 'ev_link.next'.
+ *
+ * Returns true if the inbox was empty, in which case the caller must
+ * take the task lock and call task_drain() so that an idle task gets
+ * scheduled.  A sender which finds the inbox non-empty can rely on
+ * the sender which made it non-empty, or on the worker running the
+ * task, to get the event dispatched.
+ */
+static inline bool
+task_post(isc__task_t *task, isc_event_t *event) {
+	uintptr_t head;
+
+	head = atomic_load_explicit(&task->inbox, memory_order_relaxed);
+	do {
+		event->ev_link.next = (isc_event_t *)head;
+	} while (!atomic_compare_exchange_weak_explicit(&task->inbox, &head,
+							(uintptr_t)event,
+							memory_order_release,
+							memory_order_relaxed));
+
+	return (head == 0);
+}
+
+/*
+ * Move every event in the inbox onto the end of the task's event
+ * list, restoring the order in which they were posted.
+ *
+ * Caller must be holding the task lock.
+ */
+static inline void
+task_drain(isc__task_t *task) {
+	isc_eventlist_t events;
+	isc_event_t *event, *next;
+	uintptr_t head;
+
+	head = atomic_load_explicit(&task->inbox, memory_order_relaxed);
+	if (head == 0)
+		return;
+	while (!atomic_compare_exchange_weak_explicit(&task->inbox, &head, 0,
+						      memory_order_acquire,
+						      memory_order_relaxed))
+		;
+
+	INIT_LIST(events);
+	for (event = (isc_event_t *)head; event != NULL; event = next) {
+		next = event->ev_link.next;
+		ISC_LIST_INITANDPREPEND(events, event, ev_link);
+		task->nevents++;
+		task->nsent++;
+	}
+	ISC_LIST_APPENDLIST(task->events, events, ev_link);
+}
+
 static inline bool
 task_shutdown(isc__task_t *task) {
 	bool was_idle = false;
@@ -410,8 +550,13 @@ task_shutdown(isc__task_t *task) {
 		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				      ISC_MSG_SHUTTINGDOWN, "shutting down"));
 		task->flags |= TASK_F_SHUTTINGDOWN;
+		/*
+		 * Shutdown events go after anything already posted.  An
+		 * idle task may have posted events pending; see
+		 * task_post().
+		 */
+		task_drain(task);
 		if (task->state == task_state_idle) {
-			INSIST(EMPTY(task->events));
 			task->state = task_state_ready;
 			was_idle = true;
 		}
@@ -435,25 +580,66 @@ task_shutdown(isc__task_t *task) {
 }
 
 /*
- * Moves a task onto the appropriate run queue.
+ * Wake up one idle worker other than 'threadid' so that it can steal
+ * work which has just been queued for a busy worker.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+wake_idle_worker(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	for (i = 1; i < manager->workers; i++) {
+		if (atomic_load_explicit(&manager->idle_workers,
+					 memory_order_relaxed) == 0)
+			return;
+		queue = &manager->queues[(threadid + i) % manager->workers];
+		LOCK(&queue->lock);
+		if (queue->idle) {
+			queue->idle = false;
+			SIGNAL(&queue->work_available);
+			UNLOCK(&queue->lock);
+			return;
+		}
+		UNLOCK(&queue->lock);
+	}
+}
+
+/*
+ * Moves a task onto the run queue of the worker it has affinity with.
  *
- * Caller must NOT hold manager lock.
+ * Caller must NOT hold manager lock or any queue lock.
  */
 static inline void
 task_ready(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 	bool has_privilege = isc__task_privilege((isc_task_t *) task);
+	bool wakeup = false;
 
 	REQUIRE(VALID_MANAGER(manager));
 	REQUIRE(task->state == task_state_ready);
 
 	XTRACE("task_ready");
 
-	LOCK(&manager->lock);
+	queue = &manager->queues[task->threadid];
+	LOCK(&queue->lock);
 	push_readyq(manager, task);
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
-	UNLOCK(&manager->lock);
+	if (manager->mode == isc_taskmgrmode_normal || has_privilege) {
+		if (queue->idle) {
+			queue->idle = false;
+			SIGNAL(&queue->work_available);
+		} else
+			wakeup = true;
+	}
+	UNLOCK(&queue->lock);
+
+	/*
+	 * The owning worker is busy; let somebody else pick this up.
+	 */
+	if (wakeup)
+		wake_idle_worker(manager, task->threadid);
 }
 
 static inline bool
@@ -469,7 +655,6 @@ task_detach(isc__task_t *task) {
 
 	task->references--;
 	if (task->references == 0 && task->state == task_state_idle) {
-		INSIST(EMPTY(task->events));
 		/*
 		 * There are no references to this task, and no
 		 * pending events.  We could try to optimize and
@@ -528,20 +713,46 @@ task_send(isc__task_t *task, isc_event_t **eventp) {
 
 	XTRACE("task_send");
 
+	/*
+	 * Keep the events posted to the inbox by this thread ahead of
+	 * this one.
+	 */
+	task_drain(task);
 	if (task->state == task_state_idle) {
 		was_idle = true;
-		INSIST(EMPTY(task->events));
 		task->state = task_state_ready;
 	}
 	INSIST(task->state == task_state_ready ||
 	       task->state == task_state_running);
 	ENQUEUE(task->events, event, ev_link);
 	task->nevents++;
+	task->nsent++;
 	*eventp = NULL;
 
 	return (was_idle);
 }
 
+#ifndef ISC_TASK_MUTEXSEND
+/*
+ * Called by the sender which made the inbox non-empty: make the task
+ * ready if it is idle.
+ *
+ * Caller must be holding the task lock.
+ */
+static inline bool
+task_wake(isc__task_t *task) {
+	REQUIRE(task->state != task_state_done);
+
+	task_drain(task);
+	if (task->state == task_state_idle && !EMPTY(task->events)) {
+		task->state = task_state_ready;
+		return (true);
+	}
+
+	return (false);
+}
+#endif
+
 void
 isc__task_send(isc_task_t *task0, isc_event_t **eventp) {
 	isc__task_t *task = (isc__task_t *)task0;
@@ -560,9 +771,29 @@ isc__task_send(isc_task_t *task0, isc_event_t **eventp) {
 	 * We're also trying to hold as few locks as possible.  This is why
 	 * some processing is deferred until after the lock is released.
 	 */
-	LOCK(&task->lock);
+#ifdef ISC_TASK_MUTEXSEND
+	task_sendlock(task);
 	was_idle = task_send(task, eventp);
 	UNLOCK(&task->lock);
+#else
+	REQUIRE(eventp != NULL && *eventp != NULL);
+	REQUIRE((*eventp)->ev_type > 0);
+	REQUIRE(!ISC_LINK_LINKED(*eventp, ev_ratelink));
+
+	if (!task_post(task, *eventp)) {
+		/*
+		 * Somebody else is responsible for getting the inbox
+		 * drained.
+		 */
+		*eventp = NULL;
+		return;
+	}
+	*eventp = NULL;
+
+	task_sendlock(task);
+	was_idle = task_wake(task);
+	UNLOCK(&task->lock);
+#endif
 
 	if (was_idle) {
 		/*
@@ -600,7 +831,7 @@ isc__task_sendanddetach(isc_task_t **taskp, isc_event_t **eventp) {
 
 	XTRACE("isc_task_sendanddetach");
 
-	LOCK(&task->lock);
+	task_sendlock(task);
 	idle1 = task_send(task, eventp);
 	idle2 = task_detach(task);
 	UNLOCK(&task->lock);
@@ -642,6 +873,7 @@ dequeue_events(isc__task_t *task, void *sender, isc_eventtype_t first,
 	 */
 
 	LOCK(&task->lock);
+	task_drain(task);
 
 	for (event = HEAD(task->events); event != NULL; event = next_event) {
 		next_event = NEXT(event, ev_link);
@@ -731,6 +963,7 @@ isc_task_purgeevent(isc_task_t *task0, isc_event_t *event) {
 	 */
 
 	LOCK(&task->lock);
+	task_drain(task);
 	for (curr_event = HEAD(task->events);
 	     curr_event != NULL;
 	     curr_event = next_event) {
@@ -915,69 +1148,210 @@ isc__task_getcurrenttimex(isc_task_t *task0, isc_time_t *t) {
  ***/
 
 /*
- * Return true if the current ready list for the manager, which is
+ * Lock, or unlock, every queue of the manager.  Queue locks are always
+ * taken in ascending order, and after the manager lock if that is
+ * needed as well.
+ */
+static void
+lock_all_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->workers; i++)
+		LOCK(&manager->queues[i].lock);
+}
+
+static void
+unlock_all_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = manager->workers; i > 0; i--)
+		UNLOCK(&manager->queues[i - 1].lock);
+}
+
+/*
+ * Wake up every worker.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+wake_all_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->workers; i++) {
+		LOCK(&manager->queues[i].lock);
+		manager->queues[i].idle = false;
+		BROADCAST(&manager->queues[i].work_available);
+		UNLOCK(&manager->queues[i].lock);
+	}
+}
+
+/*
+ * Return true if the current ready list of queue 'threadid', which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
  * the manager is currently in normal or privileged execution mode.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline bool
-empty_readyq(isc__taskmgr_t *manager) {
+empty_readyq(isc__taskmgr_t *manager, unsigned int threadid) {
 	isc__tasklist_t queue;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
+		queue = manager->queues[threadid].ready_tasks;
 	else
-		queue = manager->ready_priority_tasks;
+		queue = manager->queues[threadid].ready_priority_tasks;
 
 	return (EMPTY(queue));
 }
 
 /*
  * Dequeue and return a pointer to the first task on the current ready
- * list for the manager.
+ * list of queue 'threadid'.
  * If the task is privileged, dequeue it from the other ready list
- * as well.
+ * as well.  The task is accounted as running before the queue lock
+ * is released, so that a worker holding every queue lock sees either
+ * the task on a queue or a running task.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue = &manager->queues[threadid];
 	isc__task_t *task;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		task = HEAD(manager->ready_tasks);
+		task = HEAD(queue->ready_tasks);
 	else
-		task = HEAD(manager->ready_priority_tasks);
+		task = HEAD(queue->ready_priority_tasks);
 
 	if (task != NULL) {
-		DEQUEUE(manager->ready_tasks, task, ready_link);
+		DEQUEUE(queue->ready_tasks, task, ready_link);
 		if (ISC_LINK_LINKED(task, ready_priority_link))
-			DEQUEUE(manager->ready_priority_tasks, task,
+			DEQUEUE(queue->ready_priority_tasks, task,
 				ready_priority_link);
+		atomic_fetch_sub_explicit(&manager->tasks_ready, 1,
+					  memory_order_relaxed);
+		atomic_fetch_add_explicit(&manager->tasks_running, 1,
+					  memory_order_relaxed);
 	}
 
 	return (task);
 }
 
 /*
- * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
- * flag set, then also push it onto the ready_priority_tasks queue.
+ * Push 'task' onto the ready_tasks queue of the worker it has affinity
+ * with.  If 'task' has the privilege flag set, then also push it onto
+ * that worker's ready_priority_tasks queue.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the lock of queue 'task->threadid'.
  */
 static inline void
 push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
-	ENQUEUE(manager->ready_tasks, task, ready_link);
+	isc__taskqueue_t *queue = &manager->queues[task->threadid];
+
+	ENQUEUE(queue->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	manager->tasks_ready++;
+	atomic_fetch_add_explicit(&manager->tasks_ready, 1,
+				  memory_order_relaxed);
+}
+
+/*
+ * Take a ready task from the queue of some other worker.  The victims
+ * are scanned starting with the next worker so that idle workers do
+ * not all pile onto the same queue.
+ *
+ * Caller must not hold any queue lock.
+ */
+static isc__task_t *
+steal_readyq(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue;
+	isc__task_t *task;
+	unsigned int i, victim;
+
+	for (i = 1; i < manager->workers; i++) {
+		victim = (threadid + i) % manager->workers;
+		queue = &manager->queues[victim];
+		LOCK(&queue->lock);
+		task = pop_readyq(manager, victim);
+		UNLOCK(&queue->lock);
+		if (task != NULL) {
+			atomic_fetch_add_explicit(&manager->tasks_stolen, 1,
+						  memory_order_relaxed);
+			return (task);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * If we are in privileged execution mode and there are no privileged
+ * tasks remaining on any ready queue and none running, then we're
+ * stuck.  Automatically drop privileges at that point and continue
+ * with the regular ready queues.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+check_privileged(isc__taskmgr_t *manager) {
+	unsigned int i;
+	bool drop = false;
+
+	LOCK(&manager->lock);
+	lock_all_queues(manager);
+	if (manager->mode == isc_taskmgrmode_privileged &&
+	    atomic_load_explicit(&manager->tasks_running,
+				 memory_order_relaxed) == 0)
+	{
+		drop = true;
+		for (i = 0; i < manager->workers; i++) {
+			if (!empty_readyq(manager, i)) {
+				drop = false;
+				break;
+			}
+		}
+	}
+	if (drop) {
+		manager->mode = isc_taskmgrmode_normal;
+		for (i = 0; i < manager->workers; i++) {
+			manager->queues[i].idle = false;
+			BROADCAST(&manager->queues[i].work_available);
+		}
+	}
+	unlock_all_queues(manager);
+	UNLOCK(&manager->lock);
 }
 
+/*
+ * Park the calling worker while a pause or exclusive mode has been
+ * requested.  Workers only halt between tasks, so once every other
+ * worker has halted nothing but the requester can be running.
+ *
+ * Caller must not hold any queue lock.
+ */
 static void
-dispatch(isc__taskmgr_t *manager) {
+halt(isc__taskmgr_t *manager) {
+	XTHREADTRACE("halting");
+
+	LOCK(&manager->lock);
+	manager->halted++;
+	BROADCAST(&manager->halt_cond);
+	while (manager->pause_requested || manager->exclusive_requested) {
+		WAIT(&manager->halt_cond, &manager->lock);
+	}
+	manager->halted--;
+	UNLOCK(&manager->lock);
+
+	XTHREADTRACE("resuming");
+}
+
+static void
+dispatch(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue = &manager->queues[threadid];
 	isc__task_t *task;
+	bool privileged;
 
 	REQUIRE(VALID_MANAGER(manager));
 
@@ -1029,37 +1403,83 @@ dispatch(isc__taskmgr_t *manager) {
 	 *
 	 * For N iterations of the loop, this code does N+1 locks and N+1
 	 * unlocks.  The while expression is always protected by the lock.
+	 *
+	 * The lock held here is the lock of this worker's own queue; the
+	 * manager lock is only taken to halt, to leave privileged mode,
+	 * or when a task finishes.
 	 */
 
-	LOCK(&manager->lock);
+	LOCK(&queue->lock);
 
 	while (!FINISHED(manager)) {
+		/*
+		 * If a pause or exclusive mode has been requested, don't
+		 * do any work until it's been released.
+		 */
+		if (manager->pause_requested || manager->exclusive_requested) {
+			UNLOCK(&queue->lock);
+			halt(manager);
+			LOCK(&queue->lock);
+			continue;
+		}
+
 		/*
 		 * For reasons similar to those given in the comment in
 		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
+		 * the task while only holding the queue lock, and then
 		 * change the task to running state while only holding the
 		 * task lock.
 		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
+		 * When our own queue is empty, try to steal a task from
+		 * another worker before going to sleep.
 		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
+		task = pop_readyq(manager, threadid);
+		if (task == NULL && manager->workers > 1) {
+			privileged = (manager->mode ==
+				      isc_taskmgrmode_privileged);
+			UNLOCK(&queue->lock);
+			task = steal_readyq(manager, threadid);
+			if (task == NULL && privileged)
+				check_privileged(manager);
+			LOCK(&queue->lock);
+		} else if (task == NULL &&
+			   manager->mode == isc_taskmgrmode_privileged)
 		{
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_GENERAL,
-						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_TASK,
-						    ISC_MSG_AWAKE, "awake"));
+			UNLOCK(&queue->lock);
+			check_privileged(manager);
+			LOCK(&queue->lock);
 		}
+
+		if (task == NULL) {
+			if (empty_readyq(manager, threadid) &&
+			    !manager->pause_requested &&
+			    !manager->exclusive_requested &&
+			    !FINISHED(manager))
+			{
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_GENERAL,
+							    ISC_MSG_WAIT,
+							    "wait"));
+				queue->idle = true;
+				atomic_fetch_add_explicit(
+						&manager->idle_workers, 1,
+						memory_order_relaxed);
+				WAIT(&queue->work_available, &queue->lock);
+				atomic_fetch_sub_explicit(
+						&manager->idle_workers, 1,
+						memory_order_relaxed);
+				queue->idle = false;
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_TASK,
+							    ISC_MSG_AWAKE,
+							    "awake"));
+			}
+			continue;
+		}
+
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
-
-		task = pop_readyq(manager);
-		if (task != NULL) {
+		{
 			unsigned int dispatch_count = 0;
 			bool done = false;
 			bool requeue = false;
@@ -1069,13 +1489,11 @@ dispatch(isc__taskmgr_t *manager) {
 			INSIST(VALID_TASK(task));
 
 			/*
-			 * Note we only unlock the manager lock if we actually
-			 * have a task to do.  We must reacquire the manager
-			 * lock before exiting the 'if (task != NULL)' block.
+			 * Note we only unlock the queue lock if we actually
+			 * have a task to do.  We must reacquire the queue
+			 * lock before going round the loop again.
 			 */
-			manager->tasks_ready--;
-			manager->tasks_running++;
-			UNLOCK(&manager->lock);
+			UNLOCK(&queue->lock);
 
 			LOCK(&task->lock);
 			INSIST(task->state == task_state_ready);
@@ -1085,6 +1503,15 @@ dispatch(isc__taskmgr_t *manager) {
 			TIME_NOW(&task->tnow);
 			task->now = isc_time_seconds(&task->tnow);
 			do {
+				/*
+				 * Only take from the inbox once the events
+				 * taken last time have all been handled:
+				 * meanwhile new events pile up in the inbox
+				 * and only the first of their senders needs
+				 * the task lock.
+				 */
+				if (EMPTY(task->events))
+					task_drain(task);
 				if (!EMPTY(task->events)) {
 					event = HEAD(task->events);
 					DEQUEUE(task->events, event, ev_link);
@@ -1105,6 +1532,8 @@ dispatch(isc__taskmgr_t *manager) {
 						LOCK(&task->lock);
 					}
 					dispatch_count++;
+					if (EMPTY(task->events))
+						task_drain(task);
 				}
 
 				if (task->references == 0 &&
@@ -1187,53 +1616,38 @@ dispatch(isc__taskmgr_t *manager) {
 			if (finished)
 				task_finished(task);
 
-			LOCK(&manager->lock);
-			manager->tasks_running--;
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
-			}
 			if (requeue) {
 				/*
-				 * We know we're awake, so we don't have
-				 * to wakeup any sleeping threads if the
-				 * ready queue is empty before we requeue.
-				 *
-				 * A possible optimization if the queue is
-				 * empty is to 'goto' the 'if (task != NULL)'
-				 * block, avoiding the ENQUEUE of the task
-				 * and the subsequent immediate DEQUEUE
-				 * (since it is the only executable task).
-				 * We don't do this because then we'd be
-				 * skipping the exit_requested check.  The
-				 * cost of ENQUEUE is low anyway, especially
-				 * when you consider that we'd have to do
-				 * an extra EMPTY check to see if we could
-				 * do the optimization.  If the ready queue
-				 * were usually nonempty, the 'optimization'
-				 * might even hurt rather than help.
+				 * The task goes back onto the queue of the
+				 * worker it has affinity with, even if we
+				 * stole it.  If that is our own queue we
+				 * know we're awake, so we don't have to
+				 * wake up anybody.
 				 */
+				isc__taskqueue_t *home;
+
+				home = &manager->queues[task->threadid];
+				LOCK(&home->lock);
 				push_readyq(manager, task);
+				if (home != queue && home->idle) {
+					home->idle = false;
+					SIGNAL(&home->work_available);
+				}
+				UNLOCK(&home->lock);
 			}
-		}
 
-		/*
-		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
-		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
-			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
+			/*
+			 * Only stop accounting the task as running once it
+			 * has been requeued; see pop_readyq().
+			 */
+			atomic_fetch_sub_explicit(&manager->tasks_running, 1,
+						  memory_order_relaxed);
 		}
+
+		LOCK(&queue->lock);
 	}
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 static isc_threadresult_t
@@ -1241,12 +1655,13 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
+	isc__taskmgr_t *manager = queue->manager;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	dispatch(manager, queue->threadid);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1261,10 +1676,15 @@ run(void *uap) {
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
+	unsigned int i;
 
-	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
-	(void)isc_condition_destroy(&manager->paused);
+	for (i = 0; i < manager->nqueues; i++) {
+		(void)isc_condition_destroy(&manager->queues[i].work_available);
+		DESTROYLOCK(&manager->queues[i].lock);
+	}
+	isc_mem_put(manager->mctx, manager->queues,
+		    manager->nqueues * sizeof(isc__taskqueue_t));
+	(void)isc_condition_destroy(&manager->halt_cond);
 	isc_mem_free(manager->mctx, manager->threads);
 	DESTROYLOCK(&manager->lock);
 	DESTROYLOCK(&manager->excl_lock);
@@ -1314,7 +1734,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		result = ISC_R_NOMEMORY;
 		goto cleanup_lock;
 	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
+	if (isc_condition_init(&manager->halt_cond) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_condition_init() %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
@@ -1322,30 +1742,55 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_threads;
 	}
-	if (isc_condition_init(&manager->exclusive_granted) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
+
+	manager->nqueues = 0;
+	manager->queues = isc_mem_get(mctx,
+				      workers * sizeof(isc__taskqueue_t));
+	if (manager->queues == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_haltcond;
 	}
-	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_exclusivegranted;
+	for (i = 0; i < workers; i++) {
+		isc__taskqueue_t *queue = &manager->queues[i];
+
+		queue->manager = manager;
+		queue->threadid = i;
+		result = isc_mutex_init(&queue->lock);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_queues;
+		if (isc_condition_init(&queue->work_available) !=
+		    ISC_R_SUCCESS)
+		{
+			DESTROYLOCK(&queue->lock);
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_condition_init() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			result = ISC_R_UNEXPECTED;
+			goto cleanup_queues;
+		}
+		INIT_LIST(queue->ready_tasks);
+		INIT_LIST(queue->ready_priority_tasks);
+		queue->idle = false;
+		manager->nqueues++;
 	}
+
 	if (default_quantum == 0)
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
 	manager->default_quantum = default_quantum;
 	INIT_LIST(manager->tasks);
-	INIT_LIST(manager->ready_tasks);
-	INIT_LIST(manager->ready_priority_tasks);
-	manager->tasks_running = 0;
-	manager->tasks_ready = 0;
+	manager->curq = 0;
+	manager->halted = 0;
+	manager->sends = 0;
+	manager->sends_locked = 0;
+	manager->sends_contended = 0;
+	atomic_init(&manager->tasks_count, 0);
+	atomic_init(&manager->tasks_running, 0);
+	atomic_init(&manager->tasks_ready, 0);
+	atomic_init(&manager->tasks_stolen, 0);
+	atomic_init(&manager->idle_workers, 0);
 	manager->exclusive_requested = false;
 	manager->pause_requested = false;
 	manager->exiting = false;
@@ -1355,14 +1800,19 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 
 	LOCK(&manager->lock);
 	/*
-	 * Start workers.
+	 * Start workers.  Each worker that starts takes the next queue,
+	 * so the first manager->workers queues are served and tasks are
+	 * only placed on those; the queues left over at the end because
+	 * a worker failed to start are never used.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run,
+				      &manager->queues[manager->workers],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			char name[16];	/* thread name limit on Linux */
-			snprintf(name, sizeof(name), "isc-worker%04u", i);
+			snprintf(name, sizeof(name), "isc-worker%04u",
+				 manager->workers);
 			isc_thread_setname(manager->threads[manager->workers],
 					   name);
 			manager->workers++;
@@ -1381,10 +1831,14 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 
 	return (ISC_R_SUCCESS);
 
- cleanup_exclusivegranted:
-	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
+ cleanup_queues:
+	for (i = 0; i < manager->nqueues; i++) {
+		(void)isc_condition_destroy(&manager->queues[i].work_available);
+		DESTROYLOCK(&manager->queues[i].lock);
+	}
+	isc_mem_put(mctx, manager->queues, workers * sizeof(isc__taskqueue_t));
+ cleanup_haltcond:
+	(void)isc_condition_destroy(&manager->halt_cond);
  cleanup_threads:
 	isc_mem_free(mctx, manager->threads);
  cleanup_lock:
@@ -1440,12 +1894,14 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * Make sure we only get called once.
 	 */
 	INSIST(!manager->exiting);
+	lock_all_queues(manager);
 	manager->exiting = true;
 
 	/*
 	 * If privileged mode was on, turn it off.
 	 */
 	manager->mode = isc_taskmgrmode_normal;
+	unlock_all_queues(manager);
 
 	/*
 	 * Post shutdown event(s) to every task (if they haven't already been
@@ -1455,8 +1911,14 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	     task != NULL;
 	     task = NEXT(task, link)) {
 		LOCK(&task->lock);
-		if (task_shutdown(task))
+		if (task_shutdown(task)) {
+			isc__taskqueue_t *queue;
+
+			queue = &manager->queues[task->threadid];
+			LOCK(&queue->lock);
 			push_readyq(manager, task);
+			UNLOCK(&queue->lock);
+		}
 		UNLOCK(&task->lock);
 	}
 	/*
@@ -1464,7 +1926,7 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * there's work left to do, and if there are already no tasks left
 	 * it will cause the workers to see manager->exiting.
 	 */
-	BROADCAST(&manager->work_available);
+	wake_all_queues(manager);
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1483,8 +1945,17 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 
 	LOCK(&manager->lock);
+	lock_all_queues(manager);
 	manager->mode = mode;
+	unlock_all_queues(manager);
 	UNLOCK(&manager->lock);
+
+	/*
+	 * Tasks may have been queued without waking anybody while we
+	 * were in privileged mode.
+	 */
+	if (mode == isc_taskmgrmode_normal)
+		wake_all_queues(manager);
 }
 
 isc_taskmgrmode_t
@@ -1500,10 +1971,16 @@ isc__taskmgr_mode(isc_taskmgr_t *manager0) {
 void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
-	manager->pause_requested = true;
+	unsigned int i;
+
 	LOCK(&manager->lock);
-	while (manager->tasks_running > 0) {
-		WAIT(&manager->paused, &manager->lock);
+	lock_all_queues(manager);
+	manager->pause_requested = true;
+	for (i = 0; i < manager->workers; i++)
+		BROADCAST(&manager->queues[i].work_available);
+	unlock_all_queues(manager);
+	while (manager->halted < manager->workers) {
+		WAIT(&manager->halt_cond, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
 }
@@ -1514,12 +1991,50 @@ isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 
 	LOCK(&manager->lock);
 	if (manager->pause_requested) {
+		lock_all_queues(manager);
 		manager->pause_requested = false;
-		BROADCAST(&manager->work_available);
+		unlock_all_queues(manager);
+		BROADCAST(&manager->halt_cond);
 	}
 	UNLOCK(&manager->lock);
 }
 
+void
+isc__taskmgr_sendstats(isc_taskmgr_t *manager0, uint64_t *sends,
+		       uint64_t *locked, uint64_t *contended)
+{
+	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
+	isc__task_t *task;
+	uint64_t s, l, c;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	LOCK(&manager->lock);
+	s = manager->sends;
+	l = manager->sends_locked;
+	c = manager->sends_contended;
+	for (task = HEAD(manager->tasks);
+	     task != NULL;
+	     task = NEXT(task, link))
+	{
+		LOCK(&task->lock);
+		s += task->nsent;
+		UNLOCK(&task->lock);
+		l += atomic_load_explicit(&task->sends_locked,
+					  memory_order_relaxed);
+		c += atomic_load_explicit(&task->sends_contended,
+					  memory_order_relaxed);
+	}
+	UNLOCK(&manager->lock);
+
+	if (sends != NULL)
+		*sends = s;
+	if (locked != NULL)
+		*locked = l;
+	if (contended != NULL)
+		*contended = c;
+}
+
 void
 isc_taskmgr_setexcltask(isc_taskmgr_t *mgr0, isc_task_t *task0) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *) mgr0;
@@ -1556,6 +2071,7 @@ isc_result_t
 isc__task_beginexclusive(isc_task_t *task0) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc__taskmgr_t *manager = task->manager;
+	unsigned int i;
 
 	REQUIRE(task->state == task_state_running);
 /*
@@ -1568,9 +2084,18 @@ isc__task_beginexclusive(isc_task_t *task0) {
 		UNLOCK(&manager->lock);
 		return (ISC_R_LOCKBUSY);
 	}
+	lock_all_queues(manager);
 	manager->exclusive_requested = true;
-	while (manager->tasks_running > 1) {
-		WAIT(&manager->exclusive_granted, &manager->lock);
+	for (i = 0; i < manager->workers; i++)
+		BROADCAST(&manager->queues[i].work_available);
+	unlock_all_queues(manager);
+
+	/*
+	 * Wait for every other worker to halt; we are running on the
+	 * remaining one.
+	 */
+	while (manager->halted + 1 < manager->workers) {
+		WAIT(&manager->halt_cond, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
 	return (ISC_R_SUCCESS);
@@ -1584,8 +2109,10 @@ isc__task_endexclusive(isc_task_t *task0) {
 	REQUIRE(task->state == task_state_running);
 	LOCK(&manager->lock);
 	REQUIRE(manager->exclusive_requested);
+	lock_all_queues(manager);
 	manager->exclusive_requested = false;
-	BROADCAST(&manager->work_available);
+	unlock_all_queues(manager);
+	BROADCAST(&manager->halt_cond);
 	UNLOCK(&manager->lock);
 }
 
@@ -1593,6 +2120,7 @@ void
 isc__task_setprivilege(isc_task_t *task0, bool priv) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 	bool oldpriv;
 
 	LOCK(&task->lock);
@@ -1606,14 +2134,15 @@ isc__task_setprivilege(isc_task_t *task0, bool priv) {
 	if (priv == oldpriv)
 		return;
 
-	LOCK(&manager->lock);
+	queue = &manager->queues[task->threadid];
+	LOCK(&queue->lock);
 	if (priv && ISC_LINK_LINKED(task, ready_link))
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 	else if (!priv && ISC_LINK_LINKED(task, ready_priority_link))
-		DEQUEUE(manager->ready_priority_tasks, task,
+		DEQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 bool
@@ -1670,13 +2199,23 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-running"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_running));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+		(int)atomic_load_explicit(&mgr->tasks_running,
+					  memory_order_relaxed)));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-ready"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_ready));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+		(int)atomic_load_explicit(&mgr->tasks_ready,
+					  memory_order_relaxed)));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-ready */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-stolen"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+		(unsigned int)atomic_load_explicit(&mgr->tasks_stolen,
+						   memory_order_relaxed)));
+	TRY0(xmlTextWriterEndElement(writer)); /* tasks-stolen */
+
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks"));
@@ -1767,14 +2306,21 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "default-quantum", obj);
 
-	obj = json_object_new_int(mgr->tasks_running);
+	obj = json_object_new_int(atomic_load_explicit(&mgr->tasks_running,
+						       memory_order_relaxed));
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-running", obj);
 
-	obj = json_object_new_int(mgr->tasks_ready);
+	obj = json_object_new_int(atomic_load_explicit(&mgr->tasks_ready,
+						       memory_order_relaxed));
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-ready", obj);
 
+	obj = json_object_new_int64(atomic_load_explicit(&mgr->tasks_stolen,
+							 memory_order_relaxed));
+	CHECKMEM(obj);
+	json_object_object_add(tasks, "tasks-stolen", obj);
+
 	array = json_object_new_array();
 	CHECKMEM(array);
 
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <atf-c.h>
+
+#include <isc/drwlock.h>
+#include <isc/result.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+ATF_TC(isc_drwlock_try);
+ATF_TC_HEAD(isc_drwlock_try, tc) {
+	atf_tc_set_md_var(tc, "descr", "trylock, tryupgrade and downgrade");
+}
+ATF_TC_BODY(isc_drwlock_try, tc) {
+	isc_result_t result;
+	isc_drwlock_t rwl;
+
+	result = isc_test_begin(NULL, false, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_drwlock_init(&rwl, mctx, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Readers share the lock and keep writers out. */
+	RUNTIME_CHECK(isc_drwlock_lock(&rwl, isc_rwlocktype_read) ==
+		      ISC_R_SUCCESS);
+	result = isc_drwlock_trylock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = isc_drwlock_trylock(&rwl, isc_rwlocktype_write);
+	ATF_CHECK_EQ(result, ISC_R_LOCKBUSY);
+
+	/* Two readers cannot upgrade; a sole reader can. */
+	result = isc_drwlock_tryupgrade(&rwl);
+	ATF_CHECK_EQ(result, ISC_R_LOCKBUSY);
+	isc_drwlock_unlock(&rwl, isc_rwlocktype_read);
+	result = isc_drwlock_tryupgrade(&rwl);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	/* A writer keeps everyone else out. */
+	result = isc_drwlock_trylock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_LOCKBUSY);
+
+	isc_drwlock_downgrade(&rwl);
+	result = isc_drwlock_trylock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	isc_drwlock_unlock(&rwl, isc_rwlocktype_read);
+	isc_drwlock_unlock(&rwl, isc_rwlocktype_read);
+
+	result = isc_drwlock_trylock(&rwl, isc_rwlocktype_write);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	isc_drwlock_unlock(&rwl, isc_rwlocktype_write);
+
+	isc_drwlock_destroy(&rwl);
+	isc_test_end();
+}
+
+#define NTHREADS	8
+#define NLOOPS		20000
+
+static isc_drwlock_t shared;
+static unsigned int pair[2];
+static int torn;
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+worker(isc_threadarg_t arg) {
+	uintptr_t id = (uintptr_t)arg;
+	int i;
+
+	for (i = 0; i < NLOOPS; i++) {
+		if (id == 0 || i % 50 == 0) {
+			/*
+			 * Writers keep the two halves of 'pair' equal.
+			 */
+			isc_drwlock_lock(&shared, isc_rwlocktype_write);
+			pair[0]++;
+			pair[1]++;
+			isc_drwlock_unlock(&shared, isc_rwlocktype_write);
+		} else {
+			isc_drwlock_lock(&shared, isc_rwlocktype_read);
+			if (pair[0] != pair[1]) {
+				torn++;
+			}
+			if (i % 7 == 0 &&
+			    isc_drwlock_tryupgrade(&shared) == ISC_R_SUCCESS)
+			{
+				pair[0]++;
+				pair[1]++;
+				isc_drwlock_downgrade(&shared);
+			}
+			isc_drwlock_unlock(&shared, isc_rwlocktype_read);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(isc_drwlock_threads);
+ATF_TC_HEAD(isc_drwlock_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "readers never see a writer at work");
+}
+ATF_TC_BODY(isc_drwlock_threads, tc) {
+	isc_result_t result;
+	isc_thread_t threads[NTHREADS];
+	isc_threadresult_t tresult;
+	uintptr_t i;
+
+	result = isc_test_begin(NULL, false, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_drwlock_init(&shared, mctx, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(worker, (isc_threadarg_t)i,
+					   &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++) {
+		isc_thread_join(threads[i], &tresult);
+	}
+
+	ATF_CHECK_EQ(torn, 0);
+	ATF_CHECK_EQ(pair[0], pair[1]);
+	ATF_CHECK(pair[0] >= NLOOPS);
+
+	isc_drwlock_destroy(&shared);
+	isc_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, isc_drwlock_try);
+	ATF_TP_ADD_TC(tp, isc_drwlock_threads);
+	return (atf_no_error());
+}
@@ -25,6 +25,7 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 static void *
@@ -295,6 +296,159 @@ static void test_ht_iterator() {
 	ATF_REQUIRE_EQ(ht, NULL);
 }
 
+static void
+test_ht_resize(void) {
+	isc_ht_t *ht = NULL;
+	isc_ht_iter_t *iter = NULL;
+	isc_result_t result;
+	isc_mem_t *mctx = NULL;
+	uintptr_t i, j = 0, count = 100000;
+	unsigned int walked;
+	unsigned char key[16];
+	void *v;
+
+	result = isc_mem_createx2(0, 0, default_memalloc, default_memfree,
+				  NULL, &mctx, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_ht_init(&ht, mctx, 1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Grow from two buckets, looking up a key added earlier after
+	 * each add; walk the table now and then, which will often catch
+	 * it half way through a rehash.
+	 */
+	for (i = 1; i <= count; i++) {
+		snprintf((char *)key, sizeof(key), "%u", (unsigned int)i);
+		strlcat((char *)key, " key of a raw hashtable!!", sizeof(key));
+		result = isc_ht_add(ht, key, 16, (void *) i);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		j = (j * 7919 + 1) % i + 1;
+		snprintf((char *)key, sizeof(key), "%u", (unsigned int)j);
+		strlcat((char *)key, " key of a raw hashtable!!", sizeof(key));
+		result = isc_ht_find(ht, key, 16, &v);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(j, (uintptr_t) v);
+
+		if (i % 9973 != 0)
+			continue;
+
+		walked = 0;
+		result = isc_ht_iter_create(ht, &iter);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		for (result = isc_ht_iter_first(iter);
+		     result == ISC_R_SUCCESS;
+		     result = isc_ht_iter_next(iter))
+		{
+			walked++;
+		}
+		ATF_REQUIRE_EQ(result, ISC_R_NOMORE);
+		ATF_REQUIRE_EQ(walked, i);
+		isc_ht_iter_destroy(&iter);
+	}
+	ATF_REQUIRE_EQ(isc_ht_count(ht), count);
+
+	/*
+	 * Shrink again, checking that the survivors stay reachable.
+	 */
+	for (i = 1; i <= count; i++) {
+		if (i % 1000 == 0)
+			continue;
+		snprintf((char *)key, sizeof(key), "%u", (unsigned int)i);
+		strlcat((char *)key, " key of a raw hashtable!!", sizeof(key));
+		result = isc_ht_delete(ht, key, 16);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	ATF_REQUIRE_EQ(isc_ht_count(ht), count / 1000);
+
+	for (i = 1000; i <= count; i += 1000) {
+		snprintf((char *)key, sizeof(key), "%u", (unsigned int)i);
+		strlcat((char *)key, " key of a raw hashtable!!", sizeof(key));
+		result = isc_ht_find(ht, key, 16, &v);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(i, (uintptr_t) v);
+	}
+
+	isc_ht_destroy(&ht);
+	ATF_REQUIRE_EQ(ht, NULL);
+
+	isc_mem_destroy(&mctx);
+}
+
+#ifdef ISC_BENCHMARK_TESTS
+static void
+test_ht_benchmark(uint8_t bits, uintptr_t count) {
+	isc_ht_t *ht = NULL;
+	isc_result_t result;
+	isc_mem_t *mctx = NULL;
+	isc_time_t start, finish, t0, t1;
+	uint64_t usecs, worst = 0, lat;
+	uintptr_t i;
+	unsigned char key[16];
+	void *v;
+
+	result = isc_mem_createx2(0, 0, default_memalloc, default_memfree,
+				  NULL, &mctx, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_ht_init(&ht, mctx, bits);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	memset(key, 0, sizeof(key));
+
+	isc_time_now(&start);
+	for (i = 0; i < count; i++) {
+		memmove(key, &i, sizeof(i));
+		isc_time_now(&t0);
+		result = isc_ht_add(ht, key, sizeof(key), (void *) i);
+		isc_time_now(&t1);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		lat = isc_time_microdiff(&t1, &t0);
+		if (lat > worst)
+			worst = lat;
+	}
+	isc_time_now(&finish);
+	usecs = isc_time_microdiff(&finish, &start);
+	printf("%2u bits: %lu adds in %" PRIu64 " us, "
+	       "slowest add %" PRIu64 " us\n", bits,
+	       (unsigned long)count, usecs, worst);
+
+	isc_time_now(&start);
+	for (i = 0; i < count; i++) {
+		memmove(key, &i, sizeof(i));
+		result = isc_ht_find(ht, key, sizeof(key), &v);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	isc_time_now(&finish);
+	usecs = isc_time_microdiff(&finish, &start);
+	printf("%2u bits: %lu finds in %" PRIu64 " us\n", bits,
+	       (unsigned long)count, usecs);
+
+	worst = 0;
+	isc_time_now(&start);
+	for (i = 0; i < count; i++) {
+		memmove(key, &i, sizeof(i));
+		isc_time_now(&t0);
+		result = isc_ht_delete(ht, key, sizeof(key));
+		isc_time_now(&t1);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		lat = isc_time_microdiff(&t1, &t0);
+		if (lat > worst)
+			worst = lat;
+	}
+	isc_time_now(&finish);
+	usecs = isc_time_microdiff(&finish, &start);
+	printf("%2u bits: %lu deletes in %" PRIu64 " us, "
+	       "slowest delete %" PRIu64 " us\n", bits,
+	       (unsigned long)count, usecs, worst);
+
+	isc_ht_destroy(&ht);
+	isc_mem_destroy(&mctx);
+}
+#endif /* ISC_BENCHMARK_TESTS */
+
 ATF_TC(isc_ht_20);
 ATF_TC_HEAD(isc_ht_20, tc) {
 	atf_tc_set_md_var(tc, "descr", "20 bit, 200K elements test");
@@ -339,6 +493,29 @@ ATF_TC_BODY(isc_ht_32, tc) {
 }
 #endif
 
+ATF_TC(isc_ht_resize);
+ATF_TC_HEAD(isc_ht_resize, tc) {
+	atf_tc_set_md_var(tc, "descr", "grow and shrink with rehashing");
+}
+
+ATF_TC_BODY(isc_ht_resize, tc) {
+	UNUSED(tc);
+	test_ht_resize();
+}
+
+#ifdef ISC_BENCHMARK_TESTS
+ATF_TC(benchmark);
+ATF_TC_HEAD(benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr", "10M keys, growing vs. presized");
+}
+
+ATF_TC_BODY(benchmark, tc) {
+	UNUSED(tc);
+	test_ht_benchmark(1, 10000000);
+	test_ht_benchmark(24, 10000000);
+}
+#endif /* ISC_BENCHMARK_TESTS */
+
 ATF_TC(isc_ht_iterator);
 ATF_TC_HEAD(isc_ht_iterator, tc) {
 	atf_tc_set_md_var(tc, "descr", "hashtable iterator");
@@ -358,5 +535,9 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_ht_1);
 /*	ATF_TP_ADD_TC(tp, isc_ht_32); */
 	ATF_TP_ADD_TC(tp, isc_ht_iterator);
+	ATF_TP_ADD_TC(tp, isc_ht_resize);
+#ifdef ISC_BENCHMARK_TESTS
+	ATF_TP_ADD_TC(tp, benchmark);
+#endif /* ISC_BENCHMARK_TESTS */
 	return (atf_no_error());
 }
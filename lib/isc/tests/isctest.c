@@ -85,7 +85,7 @@ create_managers(unsigned int workers) {
 	isc_taskmgr_setexcltask(taskmgr, maintask);
 
 	CHECK(isc_timermgr_create(mctx, &timermgr));
-	CHECK(isc_socketmgr_create(mctx, &socketmgr));
+	CHECK(isc_socketmgr_create2(mctx, &socketmgr, 0, workers));
 	return (ISC_R_SUCCESS);
 
  cleanup:
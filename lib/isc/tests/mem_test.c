@@ -20,9 +20,12 @@
 
 #include <isc/file.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
+#include <isc/thread.h>
+#include <isc/util.h>
 
 static void *
 default_memalloc(void *arg, size_t size) {
@@ -263,6 +266,140 @@ ATF_TC_BODY(isc_mem_inuse, tc) {
 	isc_test_end();
 }
 
+#define MAG_THREADS	4
+#define MAG_ITEMS	64
+#define MAG_LOOPS	20000
+
+static isc_mem_t *mag_mctx = NULL;
+static isc_mempool_t *mag_pool = NULL;
+static int mag_water = -1;
+
+static void
+mag_watercb(void *arg, int mark) {
+	UNUSED(arg);
+
+	mag_water = mark;
+	isc_mem_waterack(mag_mctx, mark);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+mag_thread(isc_threadarg_t arg) {
+	void *items[MAG_ITEMS];
+	void *blocks[MAG_ITEMS];
+	size_t size = 16 + 8 * (uintptr_t)arg;
+	unsigned int i, j;
+
+	for (i = 0; i < MAG_LOOPS; i++) {
+		for (j = 0; j < MAG_ITEMS; j++) {
+			items[j] = isc_mempool_get(mag_pool);
+			blocks[j] = isc_mem_get(mag_mctx, size + j);
+			if (items[j] == NULL || blocks[j] == NULL)
+				return ((isc_threadresult_t)1);
+			memset(blocks[j], 0, size + j);
+		}
+		for (j = 0; j < MAG_ITEMS; j++) {
+			isc_mempool_put(mag_pool, items[j]);
+			isc_mem_put(mag_mctx, blocks[j], size + j);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(isc_mem_magazines);
+ATF_TC_HEAD(isc_mem_magazines, tc) {
+	atf_tc_set_md_var(tc, "descr", "per-thread magazine caches");
+}
+
+ATF_TC_BODY(isc_mem_magazines, tc) {
+	static const unsigned int flags[] = {
+		0, ISC_MEMFLAG_INTERNAL | ISC_MEMFLAG_FILL
+	};
+	isc_thread_t threads[MAG_THREADS];
+	isc_threadresult_t tresult;
+	isc_result_t result;
+	isc_mutex_t lock;
+	unsigned int debugging;
+	void *ptrs[1024];
+	unsigned int f, i;
+
+	result = isc_test_begin(NULL, false, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* The caches are bypassed while allocations are being recorded. */
+	debugging = isc_mem_debugging;
+	isc_mem_debugging = 0;
+
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+		result = isc_mem_createx2(0, 0, default_memalloc,
+					  default_memfree, NULL, &mag_mctx,
+					  flags[f]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		/*
+		 * Water marks must still fire although most gets and
+		 * puts are served from this thread's cache.
+		 */
+		isc_mem_setwater(mag_mctx, mag_watercb, NULL,
+				 128 * 1024, 64 * 1024);
+		mag_water = -1;
+		for (i = 0; i < 1024; i++) {
+			ptrs[i] = isc_mem_get(mag_mctx, 200);
+			ATF_REQUIRE(ptrs[i] != NULL);
+		}
+		ATF_CHECK_EQ(mag_water, ISC_MEM_HIWATER);
+		ATF_CHECK(isc_mem_isovermem(mag_mctx));
+		ATF_CHECK(isc_mem_inuse(mag_mctx) >= 1024 * 200);
+		for (i = 0; i < 1024; i++) {
+			isc_mem_put(mag_mctx, ptrs[i], 200);
+		}
+		ATF_CHECK_EQ(mag_water, ISC_MEM_LOWATER);
+		ATF_CHECK(!isc_mem_isovermem(mag_mctx));
+		ATF_CHECK(isc_mem_inuse(mag_mctx) < 64 * 1024);
+		isc_mem_setwater(mag_mctx, NULL, NULL, 0, 0);
+
+		/*
+		 * Hammer a context and a locked pool from several threads.
+		 */
+		result = isc_mempool_create(mag_mctx, 48, &mag_pool);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		isc_mempool_associatelock(mag_pool, &lock);
+		isc_mempool_setfreemax(mag_pool, 32);
+		isc_mempool_setfillcount(mag_pool, 16);
+
+		for (i = 0; i < MAG_THREADS; i++) {
+			result = isc_thread_create(mag_thread,
+						   (isc_threadarg_t)(uintptr_t)i,
+						   &threads[i]);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		for (i = 0; i < MAG_THREADS; i++) {
+			isc_thread_join(threads[i], &tresult);
+			ATF_CHECK_EQ(tresult, (isc_threadresult_t)0);
+		}
+
+		ATF_CHECK_EQ(isc_mempool_getallocated(mag_pool), 0);
+
+		/*
+		 * Destroying the pool and the context returns what the
+		 * caches still hold; a leak would trip an assertion.
+		 */
+		isc_mempool_destroy(&mag_pool);
+		isc_mem_destroy(&mag_mctx);
+	}
+
+	DESTROYLOCK(&lock);
+	isc_mem_debugging = debugging;
+
+	isc_test_end();
+}
+
 #if ISC_MEM_TRACKLINES
 ATF_TC(isc_mem_noflags);
 ATF_TC_HEAD(isc_mem_noflags, tc) {
@@ -431,6 +568,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_mem);
 	ATF_TP_ADD_TC(tp, isc_mem_total);
 	ATF_TP_ADD_TC(tp, isc_mem_inuse);
+	ATF_TP_ADD_TC(tp, isc_mem_magazines);
 #if ISC_MEM_TRACKLINES
 	ATF_TP_ADD_TC(tp, isc_mem_noflags);
 	ATF_TP_ADD_TC(tp, isc_mem_recordflag);
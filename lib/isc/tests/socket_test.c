@@ -202,6 +202,213 @@ ATF_TC_BODY(udp_sendto, tc) {
 	isc_test_end();
 }
 
+/* Test batched UDP sendto/recv */
+ATF_TC(udp_batch);
+ATF_TC_HEAD(udp_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "batched UDP sendto/recv");
+}
+ATF_TC_BODY(udp_batch, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[5][BUFSIZ], recvbuf[BUFSIZ], expect[BUFSIZ];
+	completion_t completion, sent[5];
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_setbatch(s2, 4, 512);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_socket_detach(&s1);
+		isc_socket_detach(&s2);
+		isc_test_end();
+		atf_tc_skip("batched I/O not supported");
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_setbatch(s2, 4, 512);
+	ATF_CHECK_EQ(result, ISC_R_EXISTS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * More datagrams than fit in one batch, all queued before the
+	 * flush runs.
+	 */
+	for (i = 0; i < 5; i++) {
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "Hello %d", i);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		completion_init(&sent[i]);
+		result = isc_socket_sendto(s2, &r, task, event_done, &sent[i],
+					   &addr1, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < 5; i++) {
+		waitfor(&sent[i]);
+		ATF_CHECK(sent[i].done);
+		ATF_CHECK_EQ(sent[i].result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Bounce them back so the batched socket drains them with
+	 * recvmmsg(); the last one is truncated to its receive buffer.
+	 */
+	for (i = 0; i < 5; i++) {
+		r.base = (void *) recvbuf;
+		r.length = BUFSIZ;
+		completion_init(&completion);
+		result = isc_socket_recv(s1, &r, 1, task, event_done,
+					 &completion);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf, sendbuf[i]);
+
+		r.length = strlen(recvbuf) + 1;
+		completion_init(&completion);
+		result = isc_socket_sendto(s1, &r, task, event_done,
+					   &completion, &addr2, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 5; i++) {
+		memset(recvbuf, 0, sizeof(recvbuf));
+		r.base = (void *) recvbuf;
+		r.length = (i == 4) ? 5 : BUFSIZ;
+		completion_init(&completion);
+		recv_trunc = false;
+		result = isc_socket_recv(s2, &r, 1, task, event_done,
+					 &completion);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+		snprintf(expect, sizeof(expect), "%.*s",
+			 (i == 4) ? 5 : BUFSIZ, sendbuf[i]);
+		ATF_CHECK_STREQ(recvbuf, expect);
+		ATF_CHECK_EQ(recv_trunc, (i == 4));
+	}
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
+/* Test UDP sendto/recv on sockets spread over several watcher threads */
+ATF_TC(udp_threads);
+ATF_TC_HEAD(udp_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto/recv with multiple "
+			  "socket watcher threads");
+}
+ATF_TC_BODY(udp_threads, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr[8];
+	struct in_addr in;
+	isc_socket_t *s[8];
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[8][BUFSIZ];
+	completion_t completion[8];
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, true, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK(isc_socketmgr_getnthreads(socketmgr) >= 1);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Consecutive descriptors are assigned to different watcher
+	 * threads, so receive on all of them at once.
+	 */
+	in.s_addr = inet_addr("127.0.0.1");
+	for (i = 0; i < 8; i++) {
+		s[i] = NULL;
+		isc_sockaddr_fromin(&addr[i], &in, 0);
+		result = isc_socket_create(socketmgr, PF_INET,
+					   isc_sockettype_udp, &s[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_bind(s[i], &addr[i], 0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_getsockname(s[i], &addr[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s[i], &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 8; i++) {
+		completion_t sendcompletion;
+
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %d", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+
+		completion_init(&sendcompletion);
+		result = isc_socket_sendto(s[(i + 1) % 8], &r, task,
+					   event_done, &sendcompletion,
+					   &addr[i], NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&sendcompletion);
+		ATF_CHECK(sendcompletion.done);
+		ATF_CHECK_EQ(sendcompletion.result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 8; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %d", i);
+		waitfor(&completion[i]);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf[i], sendbuf);
+	}
+
+	isc_task_detach(&task);
+
+	for (i = 0; i < 8; i++)
+		isc_socket_detach(&s[i]);
+
+	isc_test_end();
+}
+
 /* Test UDP sendto/recv with duplicated socket */
 ATF_TC(udp_dup);
 ATF_TC_HEAD(udp_dup, tc) {
@@ -303,6 +510,118 @@ ATF_TC_BODY(udp_dup, tc) {
 	isc_test_end();
 }
 
+/* Test UDP sockets sharing a port with SO_REUSEPORT */
+ATF_TC(udp_reuseport);
+ATF_TC_HEAD(udp_reuseport, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sockets bound with REUSEPORT");
+}
+ATF_TC_BODY(udp_reuseport, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr, addr1, addr2, addr3;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL, *s3 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf1[BUFSIZ], recvbuf2[BUFSIZ];
+	completion_t completion, completion1, completion2;
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr,
+				 ISC_SOCKET_REUSEADDRESS|ISC_SOCKET_REUSEPORT);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_socket_detach(&s1);
+		isc_test_end();
+		atf_tc_skip("SO_REUSEPORT not supported");
+	}
+	ATF_REQUIRE_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			   isc_result_totext(result));
+	result = isc_socket_getsockname(s1, &addr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(isc_sockaddr_getport(&addr) != 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr,
+				 ISC_SOCKET_REUSEADDRESS|ISC_SOCKET_REUSEPORT);
+	ATF_REQUIRE_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			   isc_result_totext(result));
+
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(isc_sockaddr_equal(&addr1, &addr));
+	ATF_CHECK(isc_sockaddr_equal(&addr2, &addr));
+
+	isc_sockaddr_fromin(&addr3, &in, 0);
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s3);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s3, &addr3, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The datagram must arrive on exactly one of the sharing sockets.
+	 */
+	completion_init(&completion1);
+	r.base = (void *) recvbuf1;
+	r.length = BUFSIZ;
+	result = isc_socket_recv(s1, &r, 1, task, event_done, &completion1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	completion_init(&completion2);
+	r.base = (void *) recvbuf2;
+	r.length = BUFSIZ;
+	result = isc_socket_recv(s2, &r, 1, task, event_done, &completion2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	snprintf(sendbuf, sizeof(sendbuf), "Hello");
+	r.base = (void *) sendbuf;
+	r.length = strlen(sendbuf) + 1;
+	completion_init(&completion);
+	result = isc_socket_sendto(s3, &r, task, event_done, &completion,
+				   &addr, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion);
+	ATF_CHECK(completion.done);
+	ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+
+	for (i = 0; !completion1.done && !completion2.done && i < 5000; i++) {
+		isc_test_nap(1000);
+	}
+	ATF_CHECK(completion1.done || completion2.done);
+	ATF_CHECK(!(completion1.done && completion2.done));
+	if (completion1.done) {
+		ATF_CHECK_STREQ(recvbuf1, "Hello");
+	} else if (completion2.done) {
+		ATF_CHECK_STREQ(recvbuf2, "Hello");
+	}
+
+	isc_socket_cancel(s1, task, ISC_SOCKCANCEL_RECV);
+	isc_socket_cancel(s2, task, ISC_SOCKCANCEL_RECV);
+	waitfor2(&completion1, &completion2);
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+	isc_socket_detach(&s3);
+
+	isc_test_end();
+}
+
 /* Test TCP sendto/recv (IPv4) */
 ATF_TC(udp_dscp_v4);
 ATF_TC_HEAD(udp_dscp_v4, tc) {
@@ -884,7 +1203,10 @@ ATF_TC_BODY(udp_trunc, tc) {
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, udp_sendto);
+	ATF_TP_ADD_TC(tp, udp_batch);
+	ATF_TP_ADD_TC(tp, udp_threads);
 	ATF_TP_ADD_TC(tp, udp_dup);
+	ATF_TP_ADD_TC(tp, udp_reuseport);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v4);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v6);
 	ATF_TP_ADD_TC(tp, udp_dscp_v4);
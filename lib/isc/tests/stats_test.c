@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <config.h>
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+#include <isc/result.h>
+#include <isc/stats.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+#define NCOUNTERS	20
+#define NTHREADS	6
+#define NINCREMENTS	100000
+
+static uint64_t values[NCOUNTERS];
+static int dumped;
+
+static void
+dump(isc_statscounter_t counter, uint64_t value, void *arg) {
+	UNUSED(arg);
+
+	ATF_REQUIRE(counter < NCOUNTERS);
+	values[counter] = value;
+	dumped++;
+}
+
+static void
+dumpall(isc_stats_t *stats, unsigned int options) {
+	memset(values, 0, sizeof(values));
+	dumped = 0;
+	isc_stats_dump(stats, dump, NULL, options);
+}
+
+ATF_TC(isc_stats_basic);
+ATF_TC_HEAD(isc_stats_basic, tc) {
+	atf_tc_set_md_var(tc, "descr", "increment, decrement, set and dump");
+}
+ATF_TC_BODY(isc_stats_basic, tc) {
+	isc_result_t result;
+	isc_stats_t *stats = NULL;
+	int i;
+
+	result = isc_test_begin(NULL, false, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mctx, &stats, NCOUNTERS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_stats_ncounters(stats), NCOUNTERS);
+
+	dumpall(stats, 0);
+	ATF_CHECK_EQ(dumped, 0);
+	dumpall(stats, ISC_STATSDUMP_VERBOSE);
+	ATF_CHECK_EQ(dumped, NCOUNTERS);
+
+	for (i = 0; i < NCOUNTERS; i++) {
+		int j;
+		for (j = 0; j < i; j++) {
+			isc_stats_increment(stats, i);
+		}
+	}
+	isc_stats_decrement(stats, 5);
+	isc_stats_set(stats, 1000, 7);
+
+	dumpall(stats, 0);
+	ATF_CHECK_EQ(dumped, NCOUNTERS - 1);
+	for (i = 0; i < NCOUNTERS; i++) {
+		uint64_t expect = i;
+		if (i == 5)
+			expect = 4;
+		if (i == 7)
+			expect = 1000;
+		ATF_CHECK_EQ(values[i], expect);
+	}
+
+	isc_stats_detach(&stats);
+	isc_test_end();
+}
+
+static isc_stats_t *shared;
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+incrementer(isc_threadarg_t arg) {
+	uintptr_t id = (uintptr_t)arg;
+	int i;
+
+	for (i = 0; i < NINCREMENTS; i++) {
+		isc_stats_increment(shared, i % NCOUNTERS);
+		/*
+		 * Gauges go up in one thread and down in another.
+		 */
+		if (id % 2 == 0) {
+			isc_stats_increment(shared, 0);
+		} else {
+			isc_stats_decrement(shared, 0);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(isc_stats_threads);
+ATF_TC_HEAD(isc_stats_threads, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "counters updated from several threads add up");
+}
+ATF_TC_BODY(isc_stats_threads, tc) {
+	isc_result_t result;
+	isc_thread_t threads[NTHREADS];
+	isc_threadresult_t tresult;
+	uintptr_t i;
+
+	result = isc_test_begin(NULL, false, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mctx, &shared, NCOUNTERS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(incrementer, (isc_threadarg_t)i,
+					   &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++) {
+		isc_thread_join(threads[i], &tresult);
+	}
+
+	dumpall(shared, ISC_STATSDUMP_VERBOSE);
+	for (i = 0; i < NCOUNTERS; i++) {
+		ATF_CHECK_EQ(values[i],
+			     (uint64_t)NTHREADS * NINCREMENTS / NCOUNTERS);
+	}
+
+	isc_stats_detach(&shared);
+	isc_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, isc_stats_basic);
+	ATF_TP_ADD_TC(tp, isc_stats_threads);
+	return (atf_no_error());
+}
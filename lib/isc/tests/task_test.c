@@ -25,6 +25,7 @@
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
@@ -1421,6 +1422,234 @@ ATF_TC_BODY(purgeevent_notpurge, tc) {
 	try_purgeevent(false);
 }
 
+/*
+ * Concurrent senders test:
+ * Events sent to one task by several threads at once are all
+ * delivered, and those from each thread in the order they were sent.
+ */
+
+#define CS_SENDERS	4
+#define CS_EVENTS	20000
+
+static isc_task_t *cs_task = NULL;
+static unsigned int cs_next[CS_SENDERS];
+static unsigned int cs_received = 0;
+static bool cs_ordered = true;
+
+static void
+cs_cb(isc_task_t *task, isc_event_t *event) {
+	uintptr_t sender = (uintptr_t) event->ev_sender;
+	uintptr_t seq = (uintptr_t) event->ev_arg;
+
+	UNUSED(task);
+
+	/* Only ever run by one worker at a time. */
+	if (cs_next[sender] != seq)
+		cs_ordered = false;
+	cs_next[sender] = seq + 1;
+	isc_event_free(&event);
+
+	LOCK(&lock);
+	if (++cs_received == CS_SENDERS * CS_EVENTS)
+		SIGNAL(&cv);
+	UNLOCK(&lock);
+}
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+cs_sender(isc_threadarg_t arg) {
+	uintptr_t sender = (uintptr_t) arg;
+	uintptr_t seq;
+
+	for (seq = 0; seq < CS_EVENTS; seq++) {
+		isc_event_t *event;
+
+		event = isc_event_allocate(mctx, (void *)sender, 1, cs_cb,
+					   (void *)seq, sizeof(*event));
+		RUNTIME_CHECK(event != NULL);
+		isc_task_send(cs_task, &event);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(concurrent_send);
+ATF_TC_HEAD(concurrent_send, tc) {
+	atf_tc_set_md_var(tc, "descr", "concurrent senders to one task");
+}
+ATF_TC_BODY(concurrent_send, tc) {
+	isc_result_t result;
+	isc_thread_t threads[CS_SENDERS];
+	uint64_t sends, locked, contended;
+	uintptr_t i;
+
+	UNUSED(tc);
+
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_condition_init(&cv);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, true, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &cs_task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < CS_SENDERS; i++) {
+		result = isc_thread_create(cs_sender, (isc_threadarg_t) i,
+					   &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < CS_SENDERS; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	LOCK(&lock);
+	while (cs_received < CS_SENDERS * CS_EVENTS) {
+		WAIT(&cv, &lock);
+	}
+	UNLOCK(&lock);
+
+	ATF_CHECK(cs_ordered);
+	for (i = 0; i < CS_SENDERS; i++) {
+		ATF_CHECK_EQ(cs_next[i], CS_EVENTS);
+	}
+
+	/*
+	 * Every send is counted.  A send that finds the inbox empty has
+	 * to take the task lock to schedule the task, so at least the
+	 * first one did.
+	 */
+	isc__taskmgr_sendstats(taskmgr, &sends, &locked, &contended);
+	ATF_CHECK(sends >= CS_SENDERS * CS_EVENTS);
+	ATF_CHECK(locked >= 1);
+	ATF_CHECK(locked <= sends);
+	ATF_CHECK(contended <= locked);
+
+	isc_task_detach(&cs_task);
+	isc_test_end();
+	DESTROYLOCK(&lock);
+	(void) isc_condition_destroy(&cv);
+}
+
+#ifdef ISC_BENCHMARK_TESTS
+/*
+ * Throughput benchmark:
+ * Pass events around a ring of tasks and report how many
+ * task_send/dispatch round trips per second the task manager
+ * sustains with 1 to 64 worker threads.
+ */
+
+#define BENCH_EVENTS	200000
+#define BENCH_TASKS	8	/* per worker */
+
+static isc_task_t *bench_tasks[64 * BENCH_TASKS];
+static unsigned int bench_ntasks;
+static unsigned int bench_outstanding;
+
+static void
+bench_cb(isc_task_t *task, isc_event_t *event) {
+	uintptr_t hops = (uintptr_t) event->ev_arg;
+	uintptr_t next = (uintptr_t) event->ev_sender;
+
+	UNUSED(task);
+
+	if (hops > 0) {
+		event->ev_arg = (void *)(hops - 1);
+		event->ev_sender = (void *)((next + 1) % bench_ntasks);
+		isc_task_send(bench_tasks[next], &event);
+		return;
+	}
+
+	isc_event_free(&event);
+	LOCK(&lock);
+	if (--bench_outstanding == 0)
+		SIGNAL(&cv);
+	UNLOCK(&lock);
+}
+
+ATF_TC(benchmark);
+ATF_TC_HEAD(benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr", "task send/dispatch throughput");
+}
+ATF_TC_BODY(benchmark, tc) {
+	isc_result_t result;
+	isc_taskmgr_t *manager;
+	isc_time_t start, finish;
+	unsigned int workers, i;
+	uint64_t usecs, sends, locked, contended;
+
+	UNUSED(tc);
+
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_condition_init(&cv);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, false, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (workers = 1; workers <= 64; workers *= 2) {
+		manager = NULL;
+		result = isc_taskmgr_create(mctx, workers, 0, &manager);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		bench_ntasks = workers * BENCH_TASKS;
+		for (i = 0; i < bench_ntasks; i++) {
+			bench_tasks[i] = NULL;
+			result = isc_task_create(manager, 0, &bench_tasks[i]);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+
+		LOCK(&lock);
+		bench_outstanding = bench_ntasks;
+		isc_time_now(&start);
+		for (i = 0; i < bench_ntasks; i++) {
+			isc_event_t *event;
+
+			event = isc_event_allocate(mctx,
+				    (void *)(uintptr_t)((i + 1) % bench_ntasks),
+				    1, bench_cb,
+				    (void *)(uintptr_t)(BENCH_EVENTS /
+							bench_ntasks),
+				    sizeof(*event));
+			ATF_REQUIRE(event != NULL);
+			isc_task_send(bench_tasks[i], &event);
+		}
+		while (bench_outstanding > 0) {
+			WAIT(&cv, &lock);
+		}
+		isc_time_now(&finish);
+		UNLOCK(&lock);
+
+		usecs = isc_time_microdiff(&finish, &start);
+		if (usecs == 0)
+			usecs = 1;
+		printf("%2u workers: %u events in %" PRIu64 " us, "
+		       "%" PRIu64 " events/s\n", workers,
+		       (BENCH_EVENTS / bench_ntasks) * bench_ntasks, usecs,
+		       ((uint64_t)(BENCH_EVENTS / bench_ntasks) *
+			bench_ntasks * 1000000) / usecs);
+
+		for (i = 0; i < bench_ntasks; i++)
+			isc_task_detach(&bench_tasks[i]);
+		isc__taskmgr_sendstats(manager, &sends, &locked, &contended);
+		printf("            %" PRIu64 " sends, %" PRIu64 " locked, "
+		       "%" PRIu64 " contended\n", sends, locked, contended);
+		isc_taskmgr_destroy(&manager);
+	}
+
+	isc_test_end();
+	DESTROYLOCK(&lock);
+	(void) isc_condition_destroy(&cv);
+}
+#endif /* ISC_BENCHMARK_TESTS */
+
 /*
  * Main
  */
@@ -1438,6 +1667,10 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, purgerange);
 	ATF_TP_ADD_TC(tp, purgeevent);
 	ATF_TP_ADD_TC(tp, purgeevent_notpurge);
+	ATF_TP_ADD_TC(tp, concurrent_send);
+#ifdef ISC_BENCHMARK_TESTS
+	ATF_TP_ADD_TC(tp, benchmark);
+#endif /* ISC_BENCHMARK_TESTS */
 	return (atf_no_error());
 }
 
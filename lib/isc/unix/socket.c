@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/bufferlist.h>
 #include <isc/condition.h>
@@ -189,6 +190,15 @@ typedef enum { poll_idle, poll_active, poll_checking } pollstate_t;
 #define FDLOCK_COUNT		1024
 #define FDLOCK_ID(fd)		((fd) % FDLOCK_COUNT)
 
+/*%
+ * Each descriptor is watched by exactly one watcher thread, selected by
+ * the descriptor number.  A descriptor is only closed by its own watcher
+ * thread, so the mapping cannot change while the kernel may still hand
+ * out the same number to a new socket.
+ */
+#define FDTHREAD_ID(manager, fd)	((fd) % (manager)->nthreads)
+#define FDTHREAD(manager, fd)	(&(manager)->threads[FDTHREAD_ID(manager, fd)])
+
 /*%
  * Maximum number of events communicated with the kernel.  There should normally
  * be no need for having a large number.
@@ -324,6 +334,31 @@ typedef isc_event_t intev_t;
 
 typedef struct isc__socket isc__socket_t;
 typedef struct isc__socketmgr isc__socketmgr_t;
+typedef struct isc__socketthread isc__socketthread_t;
+
+#ifdef HAVE_RECVMMSG
+#define RECVBATCH(sock)	((sock)->recvbatch != NULL)
+#else
+#define RECVBATCH(sock)	false
+#endif
+
+#ifdef HAVE_RECVMMSG
+/*%
+ * Datagrams drained from a UDP socket by a single recvmmsg() call that
+ * have not yet been handed out to receive requests.
+ */
+typedef struct isc__recvbatch {
+	unsigned int		count;		/*%< number of slots */
+	unsigned int		size;		/*%< bytes per slot */
+	unsigned int		next;		/*%< next datagram to hand out */
+	unsigned int		ready;		/*%< datagrams received */
+	unsigned char		*data;
+	char			*cmsgs;
+	isc_sockaddr_t		*addrs;
+	struct iovec		*iovs;
+	struct mmsghdr		*msgs;
+} isc__recvbatch_t;
+#endif
 
 #define NEWCONNSOCK(ev) ((isc__socket_t *)(ev)->newsocket)
 
@@ -378,18 +413,22 @@ struct isc__socket {
 	int			fdwatchflags;
 	isc_task_t		*fdwatchtask;
 	unsigned int		dscp;
+
+	unsigned int		sendbatch;	/* max datagrams per sendmmsg */
+#ifdef HAVE_RECVMMSG
+	isc__recvbatch_t	*recvbatch;
+#endif
 };
 
 #define SOCKET_MANAGER_MAGIC	ISC_MAGIC('I', 'O', 'm', 'g')
 #define VALID_MANAGER(m)	ISC_MAGIC_VALID(m, SOCKET_MANAGER_MAGIC)
 
-struct isc__socketmgr {
+struct isc__socketthread {
 	/* Not locked. */
-	isc_socketmgr_t		common;
-	isc_mem_t	       *mctx;
-	isc_mutex_t		lock;
-	isc_mutex_t		*fdlock;
-	isc_stats_t		*stats;
+	isc__socketmgr_t	*manager;
+	int			threadid;
+	isc_thread_t		thread;
+	int			pipe_fds[2];
 #ifdef USE_KQUEUE
 	int			kqueue_fd;
 	int			nevents;
@@ -407,11 +446,27 @@ struct isc__socketmgr {
 	int			nevents;
 	struct pollfd		*events;
 #endif	/* USE_DEVPOLL */
+
+	/* Updated by the watcher thread only. */
+	atomic_uint_fast64_t	polls;		/* returns from the wait */
+	atomic_uint_fast64_t	ioevents;	/* descriptor events */
+	atomic_uint_fast64_t	ctlmsgs;	/* control pipe messages */
+	atomic_uint_fast64_t	maxevents;	/* full event buffers */
+};
+
+struct isc__socketmgr {
+	/* Not locked. */
+	isc_socketmgr_t		common;
+	isc_mem_t	       *mctx;
+	isc_mutex_t		lock;
+	isc_mutex_t		*fdlock;
+	isc_stats_t		*stats;
+	int			nthreads;
+	isc__socketthread_t	*threads;
 #ifdef USE_SELECT
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
 	unsigned int		maxsocks;
-	int			pipe_fds[2];
 
 	/* Locked by fdlock. */
 	isc__socket_t	       **fds;
@@ -433,7 +488,6 @@ struct isc__socketmgr {
 	int			maxfd;
 #endif	/* USE_SELECT */
 	int			reserved;	/* unlocked */
-	isc_thread_t		watcher;
 	isc_condition_t		shutdown_ok;
 	int			maxudp;
 };
@@ -474,7 +528,7 @@ static void build_msghdr_send(isc__socket_t *, char *, isc_socketevent_t *,
 			      struct msghdr *, struct iovec *, size_t *);
 static void build_msghdr_recv(isc__socket_t *, char *, isc_socketevent_t *,
 			      struct msghdr *, struct iovec *, size_t *);
-static bool process_ctlfd(isc__socketmgr_t *manager);
+static bool process_ctlfd(isc__socketthread_t *thread);
 static void setdscp(isc__socket_t *sock, isc_dscp_t dscp);
 
 /*%
@@ -583,7 +637,7 @@ isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks);
+		       unsigned int maxsocks, int nthreads);
 isc_result_t
 isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager0, unsigned int *nsockp);
 void
@@ -845,12 +899,15 @@ dec_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
 }
 
 static inline isc_result_t
-watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+watch_fd(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
 	struct kevent evchange;
 
+	UNUSED(manager);
+
 	memset(&evchange, 0, sizeof(evchange));
 	if (msg == SELECT_POKE_READ)
 		evchange.filter = EVFILT_READ;
@@ -858,7 +915,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_ADD;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -879,7 +936,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (oldevents == 0U) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1) {
 		if (errno == EEXIST)
 			UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -901,7 +958,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	pfd.fd = fd;
 	pfd.revents = 0;
 	LOCK(&manager->fdlock[lockid]);
-	if (write(manager->devpoll_fd, &pfd, sizeof(pfd)) == -1)
+	if (write(thread->devpoll_fd, &pfd, sizeof(pfd)) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -925,12 +982,15 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static inline isc_result_t
-unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+unwatch_fd(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
 	struct kevent evchange;
 
+	UNUSED(manager);
+
 	memset(&evchange, 0, sizeof(evchange));
 	if (msg == SELECT_POKE_READ)
 		evchange.filter = EVFILT_READ;
@@ -938,7 +998,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_DELETE;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -957,7 +1017,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (event.events == 0U) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1 && errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		strerror_r(errno, strbuf, sizeof(strbuf));
@@ -994,7 +1054,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		writelen += sizeof(pfds[1]);
 	}
 
-	if (write(manager->devpoll_fd, pfds, writelen) == -1)
+	if (write(thread->devpoll_fd, pfds, writelen) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -1018,7 +1078,8 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static void
-wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
+wakeup_socket(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result;
 	int lockid = FDLOCK_ID(fd);
 
@@ -1029,13 +1090,14 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	 */
 
 	INSIST(fd >= 0 && fd < (int)manager->maxsocks);
+	INSIST(FDTHREAD(manager, fd) == thread);
 
 	if (msg == SELECT_POKE_CLOSE) {
 		/* No one should be updating fdstate, so no need to lock it */
 		INSIST(manager->fdstate[fd] == CLOSE_PENDING);
 		manager->fdstate[fd] = CLOSED;
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		(void)close(fd);
 		return;
 	}
@@ -1052,8 +1114,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		 * fdlock; otherwise it could cause deadlock due to a lock order
 		 * reversal.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 	if (manager->fdstate[fd] != MANAGED) {
@@ -1065,7 +1127,7 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	/*
 	 * Set requested bit.
 	 */
-	result = watch_fd(manager, fd, msg);
+	result = watch_fd(thread, fd, msg);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * XXXJT: what should we do?  Ignoring the failure of watching
@@ -1080,12 +1142,12 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 /*
- * Poke the select loop when there is something for us to do.
+ * Poke a watcher thread when there is something for it to do.
  * The write is required (by POSIX) to complete.  That is, we
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+thread_poke(isc__socketthread_t *thread, int fd, int msg) {
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
@@ -1094,7 +1156,7 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(thread->pipe_fds[1], buf, sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1120,16 +1182,24 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	INSIST(cc == sizeof(buf));
 }
 
+/*
+ * Poke the watcher thread that owns 'fd'.
+ */
+static inline void
+select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+	thread_poke(FDTHREAD(mgr, fd), fd, msg);
+}
+
 /*
  * Read a message on the internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketthread_t *thread, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(thread->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1748,43 +1818,26 @@ dump_msg(struct msghdr *msg) {
 #define DOIO_HARD		2	/* i/o error, event sent */
 #define DOIO_EOF		3	/* EOF, no event sent */
 
+/*
+ * Classify a failed receive on 'sock' into a soft or hard error.
+ */
 static int
-doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_RECV];
-	size_t read_count;
-	size_t actual_count;
-	struct msghdr msghdr;
-	isc_buffer_t *buffer;
-	int recv_errno;
+recv_error(isc__socket_t *sock, isc_socketevent_t *dev, int cc,
+	   int recv_errno)
+{
 	char strbuf[ISC_STRERRORSIZE];
-	char cmsgbuf[RECVCMSGBUFLEN] = {0};
-
-	build_msghdr_recv(sock, cmsgbuf, dev, &msghdr, iov, &read_count);
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	cc = recvmsg(sock->fd, &msghdr, 0);
-	recv_errno = errno;
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
 
-	if (cc < 0) {
-		if (SOFT_ERROR(recv_errno))
-			return (DOIO_SOFT);
+	if (SOFT_ERROR(recv_errno))
+		return (DOIO_SOFT);
 
-		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
-			strerror_r(recv_errno, strbuf, sizeof(strbuf));
-			socket_log(sock, NULL, IOEVENT,
-				   isc_msgcat, ISC_MSGSET_SOCKET,
-				   ISC_MSG_DOIORECV,
-				  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
-				   sock->fd, cc, recv_errno, strbuf);
-		}
+	if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+		strerror_r(recv_errno, strbuf, sizeof(strbuf));
+		socket_log(sock, NULL, IOEVENT,
+			   isc_msgcat, ISC_MSGSET_SOCKET,
+			   ISC_MSG_DOIORECV,
+			  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
+			   sock->fd, cc, recv_errno, strbuf);
+	}
 
 #define SOFT_OR_HARD(_system, _isc) \
 	if (recv_errno == _system) { \
@@ -1804,25 +1857,208 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 		return (DOIO_HARD); \
 	}
 
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
-		SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
-		SOFT_OR_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		/* Should never get this one but it was seen. */
+	SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+	SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+	SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
+	SOFT_OR_HARD(ENOBUFS, ISC_R_NORESOURCES);
+	/* Should never get this one but it was seen. */
 #ifdef ENOPROTOOPT
-		SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
 #endif
-		SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
 
 #undef SOFT_OR_HARD
 #undef ALWAYS_HARD
 
-		dev->result = isc__errno2result(recv_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_RECVFAIL]);
-		return (DOIO_HARD);
+	dev->result = isc__errno2result(recv_errno);
+	inc_stats(sock->manager->stats,
+		  sock->statsindex[STATID_RECVFAIL]);
+	return (DOIO_HARD);
+}
+
+#ifdef HAVE_RECVMMSG
+static void
+free_recvbatch(isc_mem_t *mctx, isc__recvbatch_t **rbp) {
+	isc__recvbatch_t *rb = *rbp;
+
+	if (rb->data != NULL)
+		isc_mem_put(mctx, rb->data, rb->count * rb->size);
+	if (rb->cmsgs != NULL)
+		isc_mem_put(mctx, rb->cmsgs, rb->count * RECVCMSGBUFLEN);
+	if (rb->addrs != NULL)
+		isc_mem_put(mctx, rb->addrs, rb->count * sizeof(rb->addrs[0]));
+	if (rb->iovs != NULL)
+		isc_mem_put(mctx, rb->iovs, rb->count * sizeof(rb->iovs[0]));
+	if (rb->msgs != NULL)
+		isc_mem_put(mctx, rb->msgs, rb->count * sizeof(rb->msgs[0]));
+	isc_mem_put(mctx, rb, sizeof(*rb));
+	*rbp = NULL;
+}
+
+static isc_result_t
+alloc_recvbatch(isc_mem_t *mctx, unsigned int count, unsigned int size,
+		isc__recvbatch_t **rbp)
+{
+	isc__recvbatch_t *rb;
+
+	rb = isc_mem_get(mctx, sizeof(*rb));
+	if (rb == NULL)
+		return (ISC_R_NOMEMORY);
+	rb->count = count;
+	rb->size = size;
+	rb->next = rb->ready = 0;
+	rb->data = isc_mem_get(mctx, count * size);
+	rb->cmsgs = isc_mem_get(mctx, count * RECVCMSGBUFLEN);
+	rb->addrs = isc_mem_get(mctx, count * sizeof(rb->addrs[0]));
+	rb->iovs = isc_mem_get(mctx, count * sizeof(rb->iovs[0]));
+	rb->msgs = isc_mem_get(mctx, count * sizeof(rb->msgs[0]));
+	if (rb->data == NULL || rb->cmsgs == NULL || rb->addrs == NULL ||
+	    rb->iovs == NULL || rb->msgs == NULL)
+	{
+		free_recvbatch(mctx, &rb);
+		return (ISC_R_NOMEMORY);
+	}
+
+	*rbp = rb;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Hand the next datagram held in the socket's receive batch to 'dev',
+ * refilling the batch with recvmmsg() if it has been used up.  The
+ * socket must be locked.
+ */
+static int
+doio_recvbatch(isc__socket_t *sock, isc_socketevent_t *dev) {
+	isc__recvbatch_t *rb = sock->recvbatch;
+	struct msghdr *msghdr;
+	unsigned int i, cc, copied;
+	unsigned char *base;
+	isc_buffer_t *buffer;
+	isc_region_t available;
+	int n;
+
+	INSIST(sock->type == isc_sockettype_udp);
+
+ again:
+	if (rb->next == rb->ready) {
+		rb->next = rb->ready = 0;
+		for (i = 0; i < rb->count; i++) {
+			msghdr = &rb->msgs[i].msg_hdr;
+			memset(msghdr, 0, sizeof(*msghdr));
+			rb->iovs[i].iov_base = rb->data + i * rb->size;
+			rb->iovs[i].iov_len = rb->size;
+			msghdr->msg_name = (void *)&rb->addrs[i].type.sa;
+			msghdr->msg_namelen = sizeof(rb->addrs[i].type);
+			msghdr->msg_iov = &rb->iovs[i];
+			msghdr->msg_iovlen = 1;
+#if defined(USE_CMSG)
+			msghdr->msg_control = rb->cmsgs + i * RECVCMSGBUFLEN;
+			msghdr->msg_controllen = RECVCMSGBUFLEN;
+#endif
+			rb->msgs[i].msg_len = 0;
+		}
+
+		n = recvmmsg(sock->fd, rb->msgs, rb->count, 0, NULL);
+		if (n < 0)
+			return (recv_error(sock, dev, n, errno));
+		rb->ready = n;
+		if (n == 0)
+			return (DOIO_SOFT);
+	}
+
+	i = rb->next++;
+	msghdr = &rb->msgs[i].msg_hdr;
+	cc = rb->msgs[i].msg_len;
+
+	memset(&dev->address, 0, sizeof(dev->address));
+	dev->address.type = rb->addrs[i].type;
+	dev->address.length = msghdr->msg_namelen;
+	if (isc_sockaddr_getport(&dev->address) == 0) {
+		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+			socket_log(sock, &dev->address, IOEVENT,
+				   isc_msgcat, ISC_MSGSET_SOCKET,
+				   ISC_MSG_ZEROPORT,
+				   "dropping source port zero packet");
+		}
+		goto again;
 	}
+	if (sock->manager->maxudp != 0 &&
+	    cc > (unsigned int)sock->manager->maxudp)
+	{
+		goto again;
+	}
+
+	socket_log(sock, &dev->address, IOEVENT,
+		   isc_msgcat, ISC_MSGSET_SOCKET, ISC_MSG_PKTRECV,
+		   "packet received correctly");
+
+	process_cmsg(sock, msghdr, dev);
+
+	/*
+	 * Copy the datagram out, truncating it if the request is
+	 * smaller than what we received.
+	 */
+	base = rb->data + i * rb->size;
+	buffer = ISC_LIST_HEAD(dev->bufferlist);
+	if (buffer == NULL) {
+		copied = ISC_MIN(cc, dev->region.length - dev->n);
+		memmove(dev->region.base + dev->n, base, copied);
+	} else {
+		copied = 0;
+		while (buffer != NULL && copied < cc) {
+			REQUIRE(ISC_BUFFER_VALID(buffer));
+			isc_buffer_availableregion(buffer, &available);
+			available.length = ISC_MIN(available.length,
+						   cc - copied);
+			memmove(available.base, base + copied,
+				available.length);
+			isc_buffer_add(buffer, available.length);
+			copied += available.length;
+			buffer = ISC_LIST_NEXT(buffer, link);
+		}
+	}
+	if (copied < cc)
+		dev->attributes |= ISC_SOCKEVENTATTR_TRUNC;
+	dev->n += copied;
+
+	dev->result = ISC_R_SUCCESS;
+	return (DOIO_SUCCESS);
+}
+#endif /* HAVE_RECVMMSG */
+
+static int
+doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	size_t read_count;
+	size_t actual_count;
+	struct msghdr msghdr;
+	isc_buffer_t *buffer;
+	int recv_errno;
+	char cmsgbuf[RECVCMSGBUFLEN] = {0};
+
+#ifdef HAVE_RECVMMSG
+	if (sock->recvbatch != NULL)
+		return (doio_recvbatch(sock, dev));
+#endif
+
+	build_msghdr_recv(sock, cmsgbuf, dev, &msghdr, iov, &read_count);
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	cc = recvmsg(sock->fd, &msghdr, 0);
+	recv_errno = errno;
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	if (cc < 0)
+		return (recv_error(sock, dev, cc, recv_errno));
 
 	/*
 	 * On TCP and UNIX sockets, zero length reads indicate EOF,
@@ -2049,6 +2285,73 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+#ifdef HAVE_SENDMMSG
+/*
+ * Send up to 'sock->sendbatch' datagrams from the head of the send
+ * queue with a single sendmmsg() call and post their completion events.
+ * Returns the number of datagrams sent; if nothing could be sent the
+ * caller falls back to doio_send() on the queue head, which classifies
+ * the error.  The socket must be locked.
+ */
+static unsigned int
+doio_sendbatch(isc__socket_t *sock) {
+	struct mmsghdr msgs[ISC_SOCKET_MAXBATCH];
+	struct iovec iovs[ISC_SOCKET_MAXBATCH][MAXSCATTERGATHER_SEND];
+	char cmsgbufs[ISC_SOCKET_MAXBATCH][SENDCMSGBUFLEN];
+	isc_socketevent_t *devs[ISC_SOCKET_MAXBATCH];
+	size_t write_count[ISC_SOCKET_MAXBATCH];
+	isc_socketevent_t *dev;
+	unsigned int i, n = 0;
+	int attempts = 0;
+	int cc;
+
+	INSIST(sock->type == isc_sockettype_udp);
+
+	/*
+	 * The 'maxudp' test hook and per-socket (rather than per-packet)
+	 * DSCP changes are handled by doio_send() one datagram at a time.
+	 */
+	if (sock->manager->maxudp != 0)
+		return (0);
+
+	for (dev = ISC_LIST_HEAD(sock->send_list);
+	     dev != NULL && n < sock->sendbatch;
+	     dev = ISC_LIST_NEXT(dev, ev_link))
+	{
+		if ((dev->attributes & ISC_SOCKEVENTATTR_DSCP) != 0 &&
+		    !sock->pktdscp)
+		{
+			break;
+		}
+		memset(cmsgbufs[n], 0, SENDCMSGBUFLEN);
+		build_msghdr_send(sock, cmsgbufs[n], dev, &msgs[n].msg_hdr,
+				  iovs[n], &write_count[n]);
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+	}
+	if (n < 2)
+		return (0);
+
+ resend:
+	cc = sendmmsg(sock->fd, msgs, n, 0);
+	if (cc < 0 && errno == EINTR && ++attempts < NRETRIES)
+		goto resend;
+	if (cc <= 0)
+		return (0);
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		dev = devs[i];
+		dev->n += msgs[i].msg_len;
+		if (msgs[i].msg_len != write_count[i])
+			return (i);
+		dev->result = ISC_R_SUCCESS;
+		send_senddone_event(sock, &dev);
+	}
+
+	return (cc);
+}
+#endif /* HAVE_SENDMMSG */
+
 /*
  * Kill.
  *
@@ -2081,8 +2384,8 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 		 * solve this would be to dup() the watched descriptor, but we
 		 * take a simpler approach at this moment.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd, SELECT_POKE_READ);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd, SELECT_POKE_WRITE);
 	} else
 		select_poke(manager, fd, SELECT_POKE_CLOSE);
 
@@ -2113,8 +2416,8 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 			}
 			UNLOCK(&manager->fdlock[lockid]);
 		}
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
+		if (manager->maxfd < manager->threads[0].pipe_fds[0])
+			manager->maxfd = manager->threads[0].pipe_fds[0];
 	}
 
 	UNLOCK(&manager->lock);
@@ -2200,6 +2503,10 @@ allocate_socket(isc__socketmgr_t *manager, isc_sockettype_t type,
 	sock->connecting = 0;
 	sock->bound = 0;
 	sock->pktdscp = 0;
+	sock->sendbatch = 0;
+#ifdef HAVE_RECVMMSG
+	sock->recvbatch = NULL;
+#endif
 
 	/*
 	 * Initialize the lock.
@@ -2256,6 +2563,11 @@ free_socket(isc__socket_t **socketp) {
 	INSIST(ISC_LIST_EMPTY(sock->connect_list));
 	INSIST(!ISC_LINK_LINKED(sock, link));
 
+#ifdef HAVE_RECVMMSG
+	if (sock->recvbatch != NULL)
+		free_recvbatch(sock->manager->mctx, &sock->recvbatch);
+#endif
+
 	sock->common.magic = 0;
 	sock->common.impmagic = 0;
 
@@ -3766,6 +4078,12 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 	 * Try to do as much I/O as possible on this socket.  There are no
 	 * limits here, currently.
 	 */
+#ifdef HAVE_SENDMMSG
+	if (sock->sendbatch != 0) {
+		while (doio_sendbatch(sock) != 0)
+			;
+	}
+#endif
 	dev = ISC_LIST_HEAD(sock->send_list);
 	while (dev != NULL) {
 		switch (doio_send(sock, dev)) {
@@ -3875,14 +4193,19 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
  * and unlocking twice if both reads and writes are possible.
  */
 static void
-process_fd(isc__socketmgr_t *manager, int fd, bool readable,
+process_fd(isc__socketthread_t *thread, int fd, bool readable,
 	   bool writeable)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	isc__socket_t *sock;
 	bool unlock_sock;
 	bool unwatch_read = false, unwatch_write = false;
 	int lockid = FDLOCK_ID(fd);
 
+	if (readable || writeable)
+		atomic_fetch_add_explicit(&thread->ioevents, 1,
+					  memory_order_relaxed);
+
 	/*
 	 * If the socket is going to be closed, don't do more I/O.
 	 */
@@ -3890,8 +4213,8 @@ process_fd(isc__socketmgr_t *manager, int fd, bool readable,
 	if (manager->fdstate[fd] == CLOSE_PENDING) {
 		UNLOCK(&manager->fdlock[lockid]);
 
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 
@@ -3936,21 +4259,24 @@ check_write:
  unlock_fd:
 	UNLOCK(&manager->fdlock[lockid]);
 	if (unwatch_read)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
 	if (unwatch_write)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 
 }
 
 #ifdef USE_KQUEUE
 static bool
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct kevent *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	bool readable, writable;
 	bool done = false;
 	bool have_ctlevent = false;
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
+		atomic_fetch_add_explicit(&thread->maxevents, 1,
+					  memory_order_relaxed);
 		/*
 		 * This is not an error, but something unexpected.  If this
 		 * happens, it may indicate the need for increasing
@@ -3964,29 +4290,33 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].ident < manager->maxsocks);
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
 		readable = (events[i].filter == EVFILT_READ);
 		writable = (events[i].filter == EVFILT_WRITE);
-		process_fd(manager, events[i].ident, readable, writable);
+		process_fd(thread, events[i].ident, readable, writable);
 	}
 
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static bool
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketthread_t *thread, struct epoll_event *events,
+	    int nevents)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	bool done = false;
 	bool have_ctlevent = false;
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
+		atomic_fetch_add_explicit(&thread->maxevents, 1,
+					  memory_order_relaxed);
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -3995,7 +4325,7 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
@@ -4011,24 +4341,27 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 			int fd = events[i].data.fd;
 			events[i].events |= manager->epoll_events[fd];
 		}
-		process_fd(manager, events[i].data.fd,
+		process_fd(thread, events[i].data.fd,
 			   (events[i].events & EPOLLIN) != 0,
 			   (events[i].events & EPOLLOUT) != 0);
 	}
 
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 
 	return (done);
 }
 #elif defined(USE_DEVPOLL)
 static bool
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct pollfd *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	bool done = false;
 	bool have_ctlevent = false;
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
+		atomic_fetch_add_explicit(&thread->maxevents, 1,
+					  memory_order_relaxed);
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4037,46 +4370,47 @@ process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
 
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].fd < (int)manager->maxsocks);
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
-		process_fd(manager, events[i].fd,
+		process_fd(thread, events[i].fd,
 			   (events[i].events & POLLIN) != 0,
 			   (events[i].events & POLLOUT) != 0);
 	}
 
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketthread_t *thread, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 
 	REQUIRE(maxfd <= (int)manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == thread->pipe_fds[0] || i == thread->pipe_fds[1])
 			continue;
-		process_fd(manager, i, FD_ISSET(i, readfds),
+		process_fd(thread, i, FD_ISSET(i, readfds),
 			   FD_ISSET(i, writefds));
 	}
 }
 #endif
 
 static bool
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketthread_t *thread) {
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(thread, &fd, &msg);
 
-		manager_log(manager, IOEVENT,
+		manager_log(thread->manager, IOEVENT,
 			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
 					   ISC_MSG_WATCHERMSG,
 					   "watcher got message %d "
@@ -4088,6 +4422,9 @@ process_ctlfd(isc__socketmgr_t *manager) {
 		if (msg == SELECT_POKE_NOTHING)
 			break;
 
+		atomic_fetch_add_explicit(&thread->ctlmsgs, 1,
+					  memory_order_relaxed);
+
 		/*
 		 * Handle shutdown message.  We really should
 		 * jump out of this loop right away, but
@@ -4103,7 +4440,7 @@ process_ctlfd(isc__socketmgr_t *manager) {
 		 * and decide if we need to watch on it now
 		 * or not.
 		 */
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(thread, fd, msg);
 	}
 
 	return (false);
@@ -4111,14 +4448,16 @@ process_ctlfd(isc__socketmgr_t *manager) {
 
 /*
  * This is the thread that will loop forever, always in a select or poll
- * call.
+ * call.  There is one per watcher thread of the manager, each polling
+ * only the descriptors that FDTHREAD() assigns to it.
  *
  * When select returns something to do, track down what thread gets to do
  * this I/O and post the event to it.
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketthread_t *thread = uap;
+	isc__socketmgr_t *manager = thread->manager;
 	bool done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -4144,34 +4483,34 @@ watcher(void *uap) {
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = thread->pipe_fds[0];
 #endif
 	done = false;
 	while (!done) {
 		do {
 #ifdef USE_KQUEUE
-			cc = kevent(manager->kqueue_fd, NULL, 0,
-				    manager->events, manager->nevents, NULL);
+			cc = kevent(thread->kqueue_fd, NULL, 0,
+				    thread->events, thread->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+			cc = epoll_wait(thread->epoll_fd, thread->events,
+					thread->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			/*
 			 * Re-probe every thousand calls.
 			 */
-			if (manager->calls++ > 1000U) {
+			if (thread->calls++ > 1000U) {
 				result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 				if (result != ISC_R_SUCCESS)
-					manager->open_max = 64;
-				manager->calls = 0;
+					thread->open_max = 64;
+				thread->calls = 0;
 			}
 			for (pass = 0; pass < 2; pass++) {
-				dvp.dp_fds = manager->events;
-				dvp.dp_nfds = manager->nevents;
-				if (dvp.dp_nfds >= manager->open_max)
-					dvp.dp_nfds = manager->open_max - 1;
+				dvp.dp_fds = thread->events;
+				dvp.dp_nfds = thread->nevents;
+				if (dvp.dp_nfds >= thread->open_max)
+					dvp.dp_nfds = thread->open_max - 1;
 #ifndef ISC_SOCKET_USE_POLLWATCH
 				dvp.dp_timeout = -1;
 #else
@@ -4181,7 +4520,7 @@ watcher(void *uap) {
 					dvp.dp_timeout =
 						 ISC_SOCKET_POLLWATCH_TIMEOUT;
 #endif	/* ISC_SOCKET_USE_POLLWATCH */
-				cc = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+				cc = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 				if (cc == -1 && errno == EINVAL) {
 					/*
 					 * {OPEN_MAX} may have dropped.  Look
@@ -4189,9 +4528,9 @@ watcher(void *uap) {
 					 */
 					result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 					if (result != ISC_R_SUCCESS)
-						manager->open_max = 64;
+						thread->open_max = 64;
 				} else
 					break;
 			}
@@ -4245,17 +4584,20 @@ watcher(void *uap) {
 #endif
 		} while (cc < 0);
 
+		atomic_fetch_add_explicit(&thread->polls, 1,
+					  memory_order_relaxed);
+
 #if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+		done = process_fds(thread, thread->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
+		process_fds(thread, maxfd, manager->read_fds_copy,
 			    manager->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
 		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+			done = process_ctlfd(thread);
 #endif
 	}
 
@@ -4289,20 +4631,43 @@ isc__socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
  */
 
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_thread(isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
+	isc_mem_t *mctx = manager->mctx;
 	isc_result_t result;
-#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
 	char strbuf[ISC_STRERRORSIZE];
-#endif
+
+	atomic_init(&thread->polls, 0);
+	atomic_init(&thread->ioevents, 0);
+	atomic_init(&thread->ctlmsgs, 0);
+	atomic_init(&thread->maxevents, 0);
+
+	/*
+	 * Create the special fds that will be used to wake up the
+	 * select/poll loop when something internal needs to be done.
+	 */
+	if (pipe(thread->pipe_fds) != 0) {
+		strerror_r(errno, strbuf, sizeof(strbuf));
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "pipe() %s: %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"),
+				 strbuf);
+		return (ISC_R_UNEXPECTED);
+	}
+
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[0]) == ISC_R_SUCCESS);
 
 #ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct kevent) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
+	}
+	thread->kqueue_fd = kqueue();
+	if (thread->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		strerror_r(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4310,26 +4675,28 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
+		goto close_pipe;
 	}
 
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		close(thread->kqueue_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
+		goto close_pipe;
 	}
 #elif defined(USE_EPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
+	}
+	thread->epoll_fd = epoll_create(thread->nevents);
+	if (thread->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		strerror_r(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4337,42 +4704,32 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
+		goto close_pipe;
 	}
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		close(thread->epoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
+		goto close_pipe;
 	}
 #elif defined(USE_DEVPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
 	result = isc_resource_getcurlimit(isc_resource_openfiles,
-					  &manager->open_max);
+					  &thread->open_max);
 	if (result != ISC_R_SUCCESS)
-		manager->open_max = 64;
-	manager->calls = 0;
-	manager->events = isc_mem_get(mctx, sizeof(struct pollfd) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	/*
-	 * Note: fdpollinfo should be able to support all possible FDs, so
-	 * it must have maxsocks entries (not nevents).
-	 */
-	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
-					  manager->maxsocks);
-	if (manager->fdpollinfo == NULL) {
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		return (ISC_R_NOMEMORY);
+		thread->open_max = 64;
+	thread->calls = 0;
+	thread->events = isc_mem_get(mctx, sizeof(struct pollfd) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
 	}
-	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
-	manager->devpoll_fd = open("/dev/poll", O_RDWR);
-	if (manager->devpoll_fd == -1) {
+	thread->devpoll_fd = open("/dev/poll", O_RDWR);
+	if (thread->devpoll_fd == -1) {
 		result = isc__errno2result(errno);
 		strerror_r(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4380,24 +4737,86 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		goto close_pipe;
 	}
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->devpoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		close(thread->devpoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		goto close_pipe;
 	}
 #elif defined(USE_SELECT)
-	UNUSED(result);
+	UNUSED(mctx);
 
+	(void)watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	if (manager->maxfd < thread->pipe_fds[0])
+		manager->maxfd = thread->pipe_fds[0];
+	result = ISC_R_SUCCESS;
+#endif	/* USE_KQUEUE */
+
+	if (result == ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+ close_pipe:
+#endif
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+	return (result);
+}
+
+static void
+cleanup_thread(isc__socketthread_t *thread) {
+	isc_mem_t *mctx = thread->manager->mctx;
+	isc_result_t result;
+
+	result = unwatch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "epoll_ctl(DEL) %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+	}
+
+#ifdef USE_KQUEUE
+	close(thread->kqueue_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
+#elif defined(USE_EPOLL)
+	close(thread->epoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
+#elif defined(USE_DEVPOLL)
+	close(thread->devpoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
+#elif defined(USE_SELECT)
+	UNUSED(mctx);
+#endif	/* USE_KQUEUE */
+
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+}
+
+/*
+ * Set up the state shared by all watcher threads.
+ */
+static isc_result_t
+setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+#ifdef USE_DEVPOLL
+	/*
+	 * Note: fdpollinfo should be able to support all possible FDs, so
+	 * it must have maxsocks entries (not nevents).
+	 */
+	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
+					  manager->maxsocks);
+	if (manager->fdpollinfo == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
+#elif defined(USE_SELECT)
 #if ISC_SOCKET_MAXSOCKETS > FD_SETSIZE
 	/*
 	 * Note: this code should also cover the case of MAXSOCKETS <=
@@ -4441,38 +4860,18 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 	}
 	memset(manager->read_fds, 0, manager->fd_bufsize);
 	memset(manager->write_fds, 0, manager->fd_bufsize);
-
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
-#endif	/* USE_KQUEUE */
+	manager->maxfd = 0;
+#else
+	UNUSED(mctx);
+	UNUSED(manager);
+#endif	/* USE_DEVPOLL */
 
 	return (ISC_R_SUCCESS);
 }
 
 static void
 cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
-	isc_result_t result;
-
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	if (result != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "epoll_ctl(DEL) %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-	}
-
-#ifdef USE_KQUEUE
-	close(manager->kqueue_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct kevent) * manager->nevents);
-#elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
-#elif defined(USE_DEVPOLL)
-	close(manager->devpoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct pollfd) * manager->nevents);
+#ifdef USE_DEVPOLL
 	isc_mem_put(mctx, manager->fdpollinfo,
 		    sizeof(pollinfo_t) * manager->maxsocks);
 #elif defined(USE_SELECT)
@@ -4484,27 +4883,38 @@ cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 		isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
 	if (manager->write_fds_copy != NULL)
 		isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
-#endif	/* USE_KQUEUE */
+#else
+	UNUSED(mctx);
+	UNUSED(manager);
+#endif	/* USE_DEVPOLL */
 }
 
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc__socketmgr_create2(mctx, managerp, 0));
+	return (isc__socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	int i;
 	isc__socketmgr_t *manager;
-	char strbuf[ISC_STRERRORSIZE];
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
+	if (nthreads < 1)
+		nthreads = 1;
+#ifdef USE_SELECT
+	/*
+	 * The select() descriptor sets are shared by the manager, so only
+	 * a single watcher thread can be supported.
+	 */
+	nthreads = 1;
+#endif
 
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
@@ -4515,6 +4925,7 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	manager->maxsocks = maxsocks;
 	manager->reserved = 0;
 	manager->maxudp = 0;
+	manager->nthreads = nthreads;
 	manager->fds = isc_mem_get(mctx,
 				   manager->maxsocks * sizeof(isc__socket_t *));
 	if (manager->fds == NULL) {
@@ -4535,6 +4946,14 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	}
 	memset(manager->epoll_events, 0, manager->maxsocks * sizeof(uint32_t));
 #endif
+	manager->threads = isc_mem_get(mctx, manager->nthreads *
+				       sizeof(isc__socketthread_t));
+	if (manager->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_manager;
+	}
+	memset(manager->threads, 0,
+	       manager->nthreads * sizeof(isc__socketthread_t));
 	manager->stats = NULL;
 
 	manager->common.methods = &socketmgrmethods;
@@ -4572,59 +4991,63 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		goto cleanup_lock;
 	}
 
-	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
-	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		strerror_r(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
-
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
+	isc_mem_attach(mctx, &manager->mctx);
 
 	/*
-	 * Set up initial state for the select loop
+	 * Set up initial state for the select loops
 	 */
 	result = setup_watcher(mctx, manager);
 	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+		goto cleanup_condition;
 
 	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
 
 	/*
-	 * Start up the select/poll thread.
+	 * Start up the select/poll threads.
 	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
+	for (i = 0; i < manager->nthreads; i++) {
+		isc__socketthread_t *thread = &manager->threads[i];
+		char name[32];
+
+		thread->manager = manager;
+		thread->threadid = i;
+		result = setup_thread(thread);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_threads;
+		if (isc_thread_create(watcher, thread, &thread->thread) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			cleanup_thread(thread);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup_threads;
+		}
+		snprintf(name, sizeof(name), "isc-socket-%d", i);
+		isc_thread_setname(thread->thread, name);
 	}
-	isc_thread_setname(manager->watcher, "isc-socket");
-	isc_mem_attach(mctx, &manager->mctx);
 
 	*managerp = (isc_socketmgr_t *)manager;
 
 	return (ISC_R_SUCCESS);
 
-cleanup:
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
+cleanup_threads:
+	while (--i >= 0) {
+		isc__socketthread_t *thread = &manager->threads[i];
+
+		thread_poke(thread, 0, SELECT_POKE_SHUTDOWN);
+		(void)isc_thread_join(thread->thread, NULL);
+		cleanup_thread(thread);
+	}
+	cleanup_watcher(mctx, manager);
 
 cleanup_condition:
 	(void)isc_condition_destroy(&manager->shutdown_ok);
-
+	isc_mem_detach(&manager->mctx);
 
 cleanup_lock:
 	if (manager->fdlock != NULL) {
@@ -4638,6 +5061,10 @@ free_manager:
 		isc_mem_put(mctx, manager->fdlock,
 			    FDLOCK_COUNT * sizeof(isc_mutex_t));
 	}
+	if (manager->threads != NULL) {
+		isc_mem_put(mctx, manager->threads,
+			    manager->nthreads * sizeof(isc__socketthread_t));
+	}
 #if defined(USE_EPOLL)
 	if (manager->epoll_events != NULL) {
 		isc_mem_put(mctx, manager->epoll_events,
@@ -4668,6 +5095,15 @@ isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager0, unsigned int *nsockp) {
 	return (ISC_R_SUCCESS);
 }
 
+int
+isc_socketmgr_getnthreads(isc_socketmgr_t *manager0) {
+	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	return (manager->nthreads);
+}
+
 void
 isc_socketmgr_setstats(isc_socketmgr_t *manager0, isc_stats_t *stats) {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
@@ -4710,34 +5146,41 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	UNLOCK(&manager->lock);
 
 	/*
-	 * Here, poke our select/poll thread.  Do this by closing the write
-	 * half of the pipe, which will send EOF to the read half.
-	 * This is currently a no-op in the non-threaded case.
+	 * Here, poke our select/poll threads.  Do this by writing a
+	 * shutdown message to each of their control pipes.
 	 */
-	select_poke(manager, 0, SELECT_POKE_SHUTDOWN);
+	for (i = 0; i < manager->nthreads; i++)
+		thread_poke(&manager->threads[i], 0, SELECT_POKE_SHUTDOWN);
 
 	/*
-	 * Wait for thread to exit.
+	 * Wait for threads to exit, and clean up after them.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	for (i = 0; i < manager->nthreads; i++) {
+		isc__socketthread_t *thread = &manager->threads[i];
+
+		if (isc_thread_join(thread->thread, NULL) != ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+		cleanup_thread(thread);
+	}
 
 	/*
 	 * Clean up.
 	 */
 	cleanup_watcher(manager->mctx, manager);
 
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 
 	for (i = 0; i < (int)manager->maxsocks; i++)
 		if (manager->fdstate[i] == CLOSE_PENDING) /* no need to lock */
 			(void)close(i);
 
+	isc_mem_put(manager->mctx, manager->threads,
+		    manager->nthreads * sizeof(isc__socketthread_t));
 #if defined(USE_EPOLL)
 	isc_mem_put(manager->mctx, manager->epoll_events,
 		    manager->maxsocks * sizeof(uint32_t));
@@ -4779,7 +5222,7 @@ socket_recv(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 
 	dev->ev_sender = task;
 
-	if (sock->type == isc_sockettype_udp) {
+	if (sock->type == isc_sockettype_udp && !RECVBATCH(sock)) {
 		io_state = doio_recv(sock, dev);
 	} else {
 		LOCK(&sock->lock);
@@ -4982,6 +5425,30 @@ socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 		}
 	}
 
+	if (sock->sendbatch != 0) {
+		/*
+		 * Batched UDP socket: queue the datagram and let
+		 * internal_send() flush everything that has accumulated
+		 * by the time it runs with sendmmsg().
+		 */
+		isc_task_attach(task, &ntask);
+		dev->attributes |= ISC_SOCKEVENTATTR_ATTACHED;
+
+		LOCK(&sock->lock);
+		ISC_LIST_ENQUEUE(sock->send_list, dev, ev_link);
+		if (!sock->pending_send)
+			dispatch_send(sock);
+
+		socket_log(sock, NULL, EVENT, NULL, 0, 0,
+			   "socket_send: event %p -> task %p (batched)",
+			   dev, ntask);
+		UNLOCK(&sock->lock);
+
+		if ((flags & ISC_SOCKFLAG_IMMEDIATE) != 0)
+			result = ISC_R_INPROGRESS;
+		return (result);
+	}
+
 	if (sock->type == isc_sockettype_udp)
 		io_state = doio_send(sock, dev);
 	else {
@@ -5389,6 +5856,29 @@ isc__socket_bind(isc_socket_t *sock0, const isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+#if defined(SO_REUSEPORT_LB)
+		int reuseopt = SO_REUSEPORT_LB;
+#elif defined(SO_REUSEPORT)
+		int reuseopt = SO_REUSEPORT;
+#endif
+#if defined(SO_REUSEPORT_LB) || defined(SO_REUSEPORT)
+		if (setsockopt(sock->fd, SOL_SOCKET, reuseopt, (void *)&on,
+			       sizeof(on)) < 0)
+		{
+			/*
+			 * Don't press on here: without the option the
+			 * bind() below could only fail with EADDRINUSE
+			 * and hide the real reason from the caller.
+			 */
+			UNLOCK(&sock->lock);
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+#else
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
 #ifdef AF_UNIX
  bind_socket:
 #endif
@@ -6229,6 +6719,51 @@ isc__socket_dscp(isc_socket_t *sock0, isc_dscp_t dscp) {
 	setdscp(sock, dscp);
 }
 
+isc_result_t
+isc_socket_setbatch(isc_socket_t *sock0, unsigned int count,
+		    unsigned int size)
+{
+	isc__socket_t *sock = (isc__socket_t *)sock0;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_SOCKET(sock));
+	REQUIRE(sock->type == isc_sockettype_udp);
+	REQUIRE(size > 0);
+
+	if (count > ISC_SOCKET_MAXBATCH)
+		count = ISC_SOCKET_MAXBATCH;
+	if (count < 2)
+		return (ISC_R_SUCCESS);
+
+#if !defined(HAVE_RECVMMSG) && !defined(HAVE_SENDMMSG)
+	UNUSED(size);
+	return (ISC_R_NOTIMPLEMENTED);
+#else
+	LOCK(&sock->lock);
+	if (RECVBATCH(sock) || sock->sendbatch != 0 ||
+	    !ISC_LIST_EMPTY(sock->recv_list) ||
+	    !ISC_LIST_EMPTY(sock->send_list))
+	{
+		UNLOCK(&sock->lock);
+		return (ISC_R_EXISTS);
+	}
+
+#ifdef HAVE_RECVMMSG
+	result = alloc_recvbatch(sock->manager->mctx, count, size,
+				 &sock->recvbatch);
+#else
+	UNUSED(size);
+#endif
+#ifdef HAVE_SENDMMSG
+	if (result == ISC_R_SUCCESS)
+		sock->sendbatch = count;
+#endif
+	UNLOCK(&sock->lock);
+#endif
+
+	return (result);
+}
+
 isc_socketevent_t *
 isc_socket_socketevent(isc_mem_t *mctx, void *sender,
 			isc_eventtype_t eventtype, isc_taskaction_t action,
@@ -6305,10 +6840,58 @@ isc_socketmgr_renderxml(isc_socketmgr_t *mgr0, xmlTextWriterPtr writer) {
 	char peerbuf[ISC_SOCKADDR_FORMATSIZE];
 	isc_sockaddr_t addr;
 	socklen_t len;
-	int xmlrc;
+	int i, xmlrc;
 
 	LOCK(&mgr->lock);
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "socketthreads"));
+	for (i = 0; i < mgr->nthreads; i++) {
+		isc__socketthread_t *thread = &mgr->threads[i];
+		uint64_t polls, ioevents, ctlmsgs, maxevents;
+
+		polls = atomic_load_explicit(&thread->polls,
+					     memory_order_relaxed);
+		ioevents = atomic_load_explicit(&thread->ioevents,
+						memory_order_relaxed);
+		ctlmsgs = atomic_load_explicit(&thread->ctlmsgs,
+					       memory_order_relaxed);
+		maxevents = atomic_load_explicit(&thread->maxevents,
+						 memory_order_relaxed);
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "socketthread"));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "id"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+						    thread->threadid));
+		TRY0(xmlTextWriterEndElement(writer)); /* id */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "polls"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    polls));
+		TRY0(xmlTextWriterEndElement(writer)); /* polls */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "events"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    ioevents));
+		TRY0(xmlTextWriterEndElement(writer)); /* events */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					ISC_XMLCHAR "control-messages"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    ctlmsgs));
+		TRY0(xmlTextWriterEndElement(writer)); /* control-messages */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					ISC_XMLCHAR "max-events-reached"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    maxevents));
+		TRY0(xmlTextWriterEndElement(writer)); /* max-events-reached */
+
+		TRY0(xmlTextWriterEndElement(writer)); /* socketthread */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* socketthreads */
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "sockets"));
 	sock = ISC_LIST_HEAD(mgr->socklist);
 	while (sock != NULL) {
@@ -6418,11 +7001,55 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 	isc_sockaddr_t addr;
 	socklen_t len;
 	json_object *obj, *array = json_object_new_array();
+	json_object *threads = NULL;
+	int i;
 
 	CHECKMEM(array);
 
 	LOCK(&mgr->lock);
 
+	threads = json_object_new_array();
+	CHECKMEM(threads);
+
+	for (i = 0; i < mgr->nthreads; i++) {
+		isc__socketthread_t *thread = &mgr->threads[i];
+		json_object *entry = json_object_new_object();
+
+		CHECKMEM(entry);
+		json_object_array_add(threads, entry);
+
+		obj = json_object_new_int(thread->threadid);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "id", obj);
+
+		obj = json_object_new_int64(
+			atomic_load_explicit(&thread->polls,
+					     memory_order_relaxed));
+		CHECKMEM(obj);
+		json_object_object_add(entry, "polls", obj);
+
+		obj = json_object_new_int64(
+			atomic_load_explicit(&thread->ioevents,
+					     memory_order_relaxed));
+		CHECKMEM(obj);
+		json_object_object_add(entry, "events", obj);
+
+		obj = json_object_new_int64(
+			atomic_load_explicit(&thread->ctlmsgs,
+					     memory_order_relaxed));
+		CHECKMEM(obj);
+		json_object_object_add(entry, "control-messages", obj);
+
+		obj = json_object_new_int64(
+			atomic_load_explicit(&thread->maxevents,
+					     memory_order_relaxed));
+		CHECKMEM(obj);
+		json_object_object_add(entry, "max-events-reached", obj);
+	}
+
+	json_object_object_add(stats, "socketthreads", threads);
+	threads = NULL;
+
 	sock = ISC_LIST_HEAD(mgr->socklist);
 	while (sock != NULL) {
 		json_object *states, *entry = json_object_new_object();
@@ -6523,6 +7150,9 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 	result = ISC_R_SUCCESS;
 
  error:
+	if (threads != NULL)
+		json_object_put(threads);
+
 	if (array != NULL)
 		json_object_put(array);
 
@@ -2640,18 +2640,24 @@ SocketIoThread(LPVOID ThreadContext) {
  */
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc_socketmgr_create2(mctx, managerp, 0));
+	return (isc_socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	isc_socketmgr_t *manager;
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
+	/*
+	 * The number of completion port threads is derived from the
+	 * number of CPUs; see iocompletionport_init().
+	 */
+	UNUSED(nthreads);
+
 	if (maxsocks != 0)
 		return (ISC_R_NOTIMPLEMENTED);
 
@@ -2701,6 +2707,13 @@ isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager, unsigned int *nsockp) {
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+int
+isc_socketmgr_getnthreads(isc_socketmgr_t *manager) {
+	REQUIRE(VALID_MANAGER(manager));
+
+	return (manager->maxIOCPThreads);
+}
+
 void
 isc_socketmgr_setstats(isc_socketmgr_t *manager, isc_stats_t *stats) {
 	REQUIRE(VALID_MANAGER(manager));
@@ -3247,6 +3260,14 @@ isc__socket_bind(isc_socket_t *sock, const isc_sockaddr_t *sockaddr,
 		UNLOCK(&sock->lock);
 		return (ISC_R_FAMILYMISMATCH);
 	}
+	/*
+	 * Windows has no SO_REUSEPORT equivalent that load balances
+	 * between sockets.
+	 */
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	/*
 	 * Only set SO_REUSEADDR when we want a specific port.
 	 */
@@ -3908,6 +3929,17 @@ isc__socket_dscp(isc_socket_t *sock, isc_dscp_t dscp) {
 #endif
 }
 
+isc_result_t
+isc__socket_setbatch(isc_socket_t *sock, unsigned int count,
+		     unsigned int size)
+{
+	REQUIRE(VALID_SOCKET(sock));
+	UNUSED(count);
+	UNUSED(size);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 void
 isc__socket_cleanunix(const isc_sockaddr_t *addr, bool active) {
 	UNUSED(addr);
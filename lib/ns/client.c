@@ -112,7 +112,6 @@
  * server.
  */
 
-#define COOKIE_SIZE 24U /* 8 + 4 + 4 + 8 */
 #define ECS_SIZE 20U /* 2 + 1 + 1 + [0..16] */
 
 #define WANTNSID(x) (((x)->attributes & NS_CLIENTATTR_WANTNSID) != 0)
@@ -1048,6 +1047,92 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	ns_client_next(client, result);
 }
 
+void
+ns_client_sendwire(ns_client_t *client, const isc_region_t *wire) {
+	isc_result_t result;
+	unsigned char *data;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	isc_stats_t *sizestats;
+	dns_rcode_t rcode;
+	unsigned char sendbuf[SEND_BUFFER_SIZE];
+#ifdef HAVE_DNSTAP
+	dns_dtmsgtype_t dtmsgtype;
+	isc_region_t zr;
+	isc_buffer_t mb;
+#endif /* HAVE_DNSTAP */
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(wire != NULL && wire->length >= DNS_MESSAGE_HEADERLEN);
+
+	CTRACE("sendwire");
+
+	result = client_allocsendbuf(client, &buffer, NULL, wire->length,
+				     sendbuf, &data);
+	if (result != ISC_R_SUCCESS)
+		goto done;
+
+	/*
+	 * Copy the response to the buffer and fix up the id.
+	 */
+	isc_buffer_availableregion(&buffer, &r);
+	result = isc_buffer_copyregion(&buffer, wire);
+	if (result != ISC_R_SUCCESS)
+		goto done;
+	r.base[0] = (client->message->id >> 8) & 0xff;
+	r.base[1] = client->message->id & 0xff;
+	rcode = r.base[3] & 0x0f;
+
+#ifdef HAVE_DNSTAP
+	memset(&zr, 0, sizeof(zr));
+	if (((r.base[2] << 8) & DNS_MESSAGEFLAG_AA) != 0 &&
+	    client->query.authzone != NULL)
+	{
+		dns_name_toregion(dns_zone_getorigin(client->query.authzone),
+				  &zr);
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0)
+		dtmsgtype = DNS_DTTYPE_CR;
+	else
+		dtmsgtype = DNS_DTTYPE_AR;
+	if (client->view != NULL) {
+		isc_buffer_init(&mb, r.base, wire->length);
+		isc_buffer_add(&mb, wire->length);
+		dns_dt_send(client->view, dtmsgtype, &client->peeraddr,
+			    &client->destsockaddr, TCP_CLIENT(client), &zr,
+			    &client->requesttime, NULL, &mb);
+	}
+#endif /* HAVE_DNSTAP */
+
+	if (TCP_CLIENT(client)) {
+		sizestats = (isc_sockaddr_pf(&client->peeraddr) == AF_INET)
+				? client->sctx->tcpoutstats4
+				: client->sctx->tcpoutstats6;
+	} else {
+		sizestats = (isc_sockaddr_pf(&client->peeraddr) == AF_INET)
+				? client->sctx->udpoutstats4
+				: client->sctx->udpoutstats6;
+	}
+	isc_stats_increment(sizestats, ISC_MIN((int)wire->length / 16, 256));
+	ns_stats_increment(client->sctx->nsstats, ns_statscounter_response);
+	dns_rcodestats_increment(client->sctx->rcodestats, rcode);
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		ns_stats_increment(client->sctx->nsstats,
+				   ns_statscounter_edns0out);
+	}
+
+	result = client_sendpkg(client, &buffer);
+	if (result == ISC_R_SUCCESS)
+		return;
+
+ done:
+	if (client->tcpbuf != NULL) {
+		isc_mem_put(client->mctx, client->tcpbuf, TCP_BUFFER_SIZE);
+		client->tcpbuf = NULL;
+	}
+	ns_client_next(client, result);
+}
+
 static void
 client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -1209,6 +1294,9 @@ client_send(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
+	if ((client->query.attributes & NS_QUERYATTR_ANSCACHE) != 0)
+		ns_query_cacheanswer(client, &buffer);
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -1270,6 +1358,12 @@ client_send(ns_client_t *client) {
 		}
 	} else {
 		respsize = isc_buffer_usedlength(&buffer);
+		/*
+		 * Answer any clients waiting for this response first;
+		 * the request may end as soon as it has been sent.
+		 */
+		if (client->query.waitlist != NULL)
+			ns_query_sendwaiters(client, &buffer);
 		result = client_sendpkg(client, &buffer);
 #ifdef HAVE_DNSTAP
 		if (client->view != NULL) {
@@ -1594,7 +1688,7 @@ ns_client_addopt(ns_client_t *client, dns_message_t *message,
 {
 	unsigned char ecs[ECS_SIZE];
 	char nsid[BUFSIZ], *nsidp;
-	unsigned char cookie[COOKIE_SIZE];
+	unsigned char cookie[NS_COOKIE_SIZE];
 	isc_result_t result;
 	dns_view_t *view;
 	dns_resolver_t *resolver;
@@ -1641,20 +1735,11 @@ ns_client_addopt(ns_client_t *client, dns_message_t *message,
 	}
  no_nsid:
 	if ((client->attributes & NS_CLIENTATTR_WANTCOOKIE) != 0) {
-		isc_buffer_t buf;
-		isc_stdtime_t now;
-		uint32_t nonce;
-
-		isc_buffer_init(&buf, cookie, sizeof(cookie));
-		isc_stdtime_get(&now);
-
-		isc_nonce_buf(&nonce, sizeof(nonce));
-
-		compute_cookie(client, now, nonce, client->sctx->secret, &buf);
+		ns_client_makecookie(client, cookie);
 
 		INSIST(count < DNS_EDNSOPTIONS);
 		ednsopts[count].code = DNS_OPT_COOKIE;
-		ednsopts[count].length = COOKIE_SIZE;
+		ednsopts[count].length = NS_COOKIE_SIZE;
 		ednsopts[count].value = cookie;
 		count++;
 	}
@@ -1889,10 +1974,27 @@ compute_cookie(ns_client_t *client, uint32_t when, uint32_t nonce,
 	}
 }
 
+void
+ns_client_makecookie(ns_client_t *client, unsigned char *cookie) {
+	isc_buffer_t buf;
+	isc_stdtime_t now;
+	uint32_t nonce;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(cookie != NULL);
+
+	isc_buffer_init(&buf, cookie, NS_COOKIE_SIZE);
+	isc_stdtime_get(&now);
+
+	isc_nonce_buf(&nonce, sizeof(nonce));
+
+	compute_cookie(client, now, nonce, client->sctx->secret, &buf);
+}
+
 static void
 process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 	ns_altsecret_t *altsecret;
-	unsigned char dbuf[COOKIE_SIZE];
+	unsigned char dbuf[NS_COOKIE_SIZE];
 	unsigned char *old;
 	isc_stdtime_t now;
 	uint32_t when;
@@ -1913,7 +2015,7 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 
 	ns_stats_increment(client->sctx->nsstats, ns_statscounter_cookiein);
 
-	if (optlen != COOKIE_SIZE) {
+	if (optlen != NS_COOKIE_SIZE) {
 		/*
 		 * Not our token.
 		 */
@@ -1955,7 +2057,7 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 	isc_buffer_init(&db, dbuf, sizeof(dbuf));
 	compute_cookie(client, when, nonce, client->sctx->secret, &db);
 
-	if (isc_safe_memequal(old, dbuf, COOKIE_SIZE)) {
+	if (isc_safe_memequal(old, dbuf, NS_COOKIE_SIZE)) {
 		ns_stats_increment(client->sctx->nsstats,
 				   ns_statscounter_cookiematch);
 		client->attributes |= NS_CLIENTATTR_HAVECOOKIE;
@@ -1968,7 +2070,7 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 	{
 		isc_buffer_init(&db, dbuf, sizeof(dbuf));
 		compute_cookie(client, when, nonce, altsecret->secret, &db);
-		if (isc_safe_memequal(old, dbuf, COOKIE_SIZE)) {
+		if (isc_safe_memequal(old, dbuf, NS_COOKIE_SIZE)) {
 			ns_stats_increment(client->sctx->nsstats,
 					   ns_statscounter_cookiematch);
 			client->attributes |= NS_CLIENTATTR_HAVECOOKIE;
@@ -2984,9 +3086,13 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 
 	client->delaytimer = NULL;
 
+	/*
+	 * The client's message is reset and reused for every request
+	 * the client handles, so let it allocate from an arena.
+	 */
 	client->message = NULL;
-	result = dns_message_create(client->mctx, DNS_MESSAGE_INTENTPARSE,
-				    &client->message);
+	result = dns_message_create2(client->mctx, DNS_MESSAGE_INTENTPARSE,
+				     DNS_MESSAGECREATE_ARENA, &client->message);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_timer;
 
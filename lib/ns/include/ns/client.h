@@ -176,6 +176,9 @@ struct ns_client {
 typedef ISC_QUEUE(ns_client_t) client_queue_t;
 typedef ISC_LIST(ns_client_t) client_list_t;
 
+/*% Size of a COOKIE option in a response: client and server cookies. */
+#define NS_COOKIE_SIZE			24U /* 8 + 4 + 4 + 8 */
+
 #define NS_CLIENT_MAGIC			ISC_MAGIC('N','S','C','c')
 #define NS_CLIENT_VALID(c)		ISC_MAGIC_VALID(c, NS_CLIENT_MAGIC)
 
@@ -233,6 +236,15 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+void
+ns_client_sendwire(ns_client_t *client, const isc_region_t *wire);
+/*%<
+ * Finish processing the current client request and send the
+ * previously rendered response 'wire', using client->message->id
+ * for the id.  Response statistics are updated as for
+ * ns_client_send().
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%<
@@ -413,6 +425,14 @@ isc_result_t
 ns_client_addopt(ns_client_t *client, dns_message_t *message,
 		 dns_rdataset_t **opt);
 
+void
+ns_client_makecookie(ns_client_t *client, unsigned char *cookie);
+/*%<
+ * Make the value of the COOKIE option to send to 'client', which has
+ * sent a client cookie, in 'cookie', which must be NS_COOKIE_SIZE
+ * bytes long.
+ */
+
 isc_result_t
 ns__clientmgr_getclient(ns_clientmgr_t *manager, ns_interface_t *ifp,
 			bool tcp, ns_client_t **clientp);
@@ -122,6 +122,22 @@ ns_interfacemgr_setbacklog(ns_interfacemgr_t *mgr, int backlog);
  * Set the size of the listen() backlog queue.
  */
 
+void
+ns_interfacemgr_setreuseport(ns_interfacemgr_t *mgr, bool reuseport);
+/*%<
+ * If 'reuseport' is true, UDP listeners created from now on bind one
+ * socket per dispatch with SO_REUSEPORT instead of sharing duplicates
+ * of a single socket, where the operating system supports it.
+ */
+
+void
+ns_interfacemgr_setudpbatch(ns_interfacemgr_t *mgr, unsigned int udpbatch);
+/*%<
+ * Set the number of datagrams UDP listeners created from now on
+ * receive or send per system call; 0 or 1 disables batching.  See
+ * isc_socket_setbatch().
+ */
+
 bool
 ns_interfacemgr_islistening(ns_interfacemgr_t *mgr);
 /*%<
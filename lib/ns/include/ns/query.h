@@ -96,6 +96,15 @@ struct ns_query {
 	dns_keytag_t root_key_sentinel_keyid;
 	bool root_key_sentinel_is_ta;
 	bool root_key_sentinel_not_ta;
+
+	struct {
+		dns_anscache_t *	cache;
+		dns_dbversion_t *	version;
+		uint32_t		generation;
+		uint32_t		variant;
+	} ans;
+
+	ns_waitlist_t *			waitlist;
 };
 
 #define NS_QUERYATTR_RECURSIONOK	0x0001
@@ -115,6 +124,8 @@ struct ns_query {
 #define NS_QUERYATTR_DNS64EXCLUDE	0x8000
 #define NS_QUERYATTR_RRL_CHECKED	0x10000
 #define NS_QUERYATTR_REDIRECT		0x20000
+#define NS_QUERYATTR_ANSCACHE		0x40000
+#define NS_QUERYATTR_WAITING		0x80000
 
 /* query context structure */
 
@@ -179,6 +190,22 @@ ns_query_start(ns_client_t *client);
 void
 ns_query_cancel(ns_client_t *client);
 
+void
+ns_query_cacheanswer(ns_client_t *client, isc_buffer_t *buffer);
+/*%<
+ * If the response to the current query of 'client', rendered in
+ * 'buffer', may be reused for identical queries, add it to the answer
+ * cache of the zone it was answered from.
+ */
+
+void
+ns_query_sendwaiters(ns_client_t *client, isc_buffer_t *buffer);
+/*%<
+ * Send the response to the current query of 'client', rendered in
+ * 'buffer', to every client that has been waiting for it because it
+ * sent an identical query, with the message ID of its own query.
+ */
+
 /*%
  * (Must not be used outside this module and its associated unit tests.)
  */
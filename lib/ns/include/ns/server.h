@@ -19,7 +19,9 @@
 
 #include <isc/log.h>
 #include <isc/fuzz.h>
+#include <isc/ht.h>
 #include <isc/magic.h>
+#include <isc/mutex.h>
 #include <isc/quota.h>
 #include <isc/random.h>
 #include <isc/sockaddr.h>
@@ -89,6 +91,10 @@ struct ns_server {
 	isc_quota_t		tcpquota;
 	isc_quota_t		xfroutquota;
 
+	/*% Clients waiting for identical queries being resolved */
+	isc_mutex_t		waitlock;
+	isc_ht_t *		waitlists;	/*%< locked by waitlock */
+
 	/*% Test options and other configurables */
 	uint32_t		options;
 	unsigned int		delay;
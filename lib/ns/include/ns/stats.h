@@ -102,7 +102,13 @@ enum {
 	ns_statscounter_prefetch = 63,
 	ns_statscounter_keytagopt = 64,
 
-	ns_statscounter_max = 65
+	ns_statscounter_synthrecavoided = 65,
+
+	ns_statscounter_recursjoin = 66,
+
+	ns_statscounter_anscachehit = 67,
+
+	ns_statscounter_max = 68
 };
 
 void
@@ -23,6 +23,7 @@ typedef struct ns_interfacemgr		ns_interfacemgr_t;
 typedef struct ns_query			ns_query_t;
 typedef struct ns_server		ns_server_t;
 typedef struct ns_stats			ns_stats_t;
+typedef struct ns_waitlist		ns_waitlist_t;
 
 typedef enum {
 	ns_cookiealg_aes,
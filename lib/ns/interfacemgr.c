@@ -83,6 +83,8 @@ struct ns_interfacemgr {
 	ISC_LIST(isc_sockaddr_t) listenon;
 	int			backlog;	/*%< Listen queue size */
 	unsigned int		udpdisp;	/*%< UDP dispatch count */
+	bool			reuseport;	/*%< Shard UDP listeners */
+	unsigned int		udpbatch;	/*%< Datagrams per UDP syscall */
 #ifdef USE_ROUTE_SOCKET
 	isc_task_t *		task;
 	isc_socket_t *		route;
@@ -219,6 +221,8 @@ ns_interfacemgr_create(isc_mem_t *mctx,
 	mgr->listenon4 = NULL;
 	mgr->listenon6 = NULL;
 	mgr->udpdisp = udpdisp;
+	mgr->reuseport = false;
+	mgr->udpbatch = 0;
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
@@ -326,6 +330,22 @@ ns_interfacemgr_setbacklog(ns_interfacemgr_t *mgr, int backlog) {
 
 }
 
+void
+ns_interfacemgr_setreuseport(ns_interfacemgr_t *mgr, bool reuseport) {
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+	LOCK(&mgr->lock);
+	mgr->reuseport = reuseport;
+	UNLOCK(&mgr->lock);
+}
+
+void
+ns_interfacemgr_setudpbatch(ns_interfacemgr_t *mgr, unsigned int udpbatch) {
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+	LOCK(&mgr->lock);
+	mgr->udpbatch = udpbatch;
+	UNLOCK(&mgr->lock);
+}
+
 dns_aclenv_t *
 ns_interfacemgr_getaclenv(ns_interfacemgr_t *mgr) {
 	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
@@ -461,6 +481,8 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	isc_result_t result;
 	unsigned int attrs;
 	unsigned int attrmask;
+	bool reuseport;
+	unsigned int udpbatch;
 	int disp, i;
 
 	attrs = 0;
@@ -474,25 +496,81 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
+	LOCK(&ifp->mgr->lock);
+	reuseport = ifp->mgr->reuseport;
+	udpbatch = ifp->mgr->udpbatch;
+	UNLOCK(&ifp->mgr->lock);
+
 	ifp->nudpdispatch = ISC_MIN(ifp->mgr->udpdisp, MAX_UDP_DISPATCH);
 	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
-		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
-						 ifp->mgr->socketmgr,
-						 ifp->mgr->taskmgr, &ifp->addr,
-						 4096, UDPBUFFERS,
-						 32768, 8219, 8237,
-						 attrs, attrmask,
-						 &ifp->udpdispatch[disp],
-						 disp == 0
-						    ? NULL
-						    : ifp->udpdispatch[0]);
-		if (result != ISC_R_SUCCESS) {
-			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
-				      "could not listen on UDP socket: %s",
-				      isc_result_totext(result));
-			goto udp_dispatch_failure;
+		/*
+		 * With SO_REUSEPORT each dispatch gets a socket of its
+		 * own, so the kernel spreads queries across the worker
+		 * tasks instead of all of them contending for reads on
+		 * duplicates of a single socket.  If the system can't do
+		 * that, fall back to duplicating the first socket.
+		 */
+		if (reuseport) {
+			result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
+						ifp->mgr->socketmgr,
+						ifp->mgr->taskmgr, &ifp->addr,
+						4096, UDPBUFFERS,
+						32768, 8219, 8237,
+						attrs | DNS_DISPATCHATTR_REUSEPORT,
+						attrmask,
+						&ifp->udpdispatch[disp], NULL);
+			if (result != ISC_R_SUCCESS) {
+				isc_log_write(IFMGR_COMMON_LOGARGS,
+					      ISC_LOG_INFO,
+					      "could not shard UDP listener "
+					      "with SO_REUSEPORT: %s",
+					      isc_result_totext(result));
+				reuseport = false;
+			}
+		}
+
+		if (!reuseport) {
+			result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
+							 ifp->mgr->socketmgr,
+							 ifp->mgr->taskmgr,
+							 &ifp->addr,
+							 4096, UDPBUFFERS,
+							 32768, 8219, 8237,
+							 attrs, attrmask,
+							 &ifp->udpdispatch[disp],
+							 disp == 0
+							    ? NULL
+							    : ifp->udpdispatch[0]);
+			if (result != ISC_R_SUCCESS) {
+				isc_log_write(IFMGR_COMMON_LOGARGS,
+					      ISC_LOG_ERROR,
+					      "could not listen on UDP "
+					      "socket: %s",
+					      isc_result_totext(result));
+				goto udp_dispatch_failure;
+			}
 		}
 
+		/*
+		 * Drain and flush datagrams in batches.  A dispatch that
+		 * was shared rather than created here may already be
+		 * batched, or busy; that is not an error.
+		 */
+		if (udpbatch > 1) {
+			isc_socket_t *sock;
+
+			sock = dns_dispatch_getsocket(ifp->udpdispatch[disp]);
+			result = isc_socket_setbatch(sock, udpbatch, 4096);
+			if (result != ISC_R_SUCCESS &&
+			    result != ISC_R_EXISTS)
+			{
+				isc_log_write(IFMGR_COMMON_LOGARGS,
+					      ISC_LOG_INFO,
+					      "could not enable batched "
+					      "UDP I/O: %s",
+					      isc_result_totext(result));
+			}
+		}
 	}
 
 	result = ns_clientmgr_createclients(ifp->clientmgr, ifp->nudpdispatch,
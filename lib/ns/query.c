@@ -29,6 +29,7 @@
 #include <isc/util.h>
 
 #include <dns/adb.h>
+#include <dns/anscache.h>
 #include <dns/badcache.h>
 #include <dns/byaddr.h>
 #include <dns/cache.h>
@@ -38,6 +39,7 @@
 #include <dns/dnsrps.h>
 #include <dns/dnssec.h>
 #include <dns/events.h>
+#include <dns/hotnames.h>
 #include <dns/keytable.h>
 #include <dns/message.h>
 #include <dns/ncache.h>
@@ -154,6 +156,55 @@ do { \
 #define REDIRECT(c)		(((c)->query.attributes & \
 				  NS_QUERYATTR_REDIRECT) != 0)
 
+/*% Waiting for the response to an identical query? */
+#define WAITING(c)		(((c)->query.attributes & \
+				  NS_QUERYATTR_WAITING) != 0)
+
+/*% May the response be added to the zone's answer cache? */
+#define ANSCACHE(c)		(((c)->query.attributes & \
+				  NS_QUERYATTR_ANSCACHE) != 0)
+
+/*%
+ * Client attributes which add per-client content to the response, so
+ * that it must not be taken from or added to an answer cache.
+ */
+#define ANSCACHE_CLIENTATTRS	(NS_CLIENTATTR_WANTNSID | \
+				 NS_CLIENTATTR_FILTER_AAAA | \
+				 NS_CLIENTATTR_WANTCOOKIE | \
+				 NS_CLIENTATTR_HAVECOOKIE | \
+				 NS_CLIENTATTR_WANTEXPIRE | \
+				 NS_CLIENTATTR_HAVEECS | \
+				 NS_CLIENTATTR_WANTPAD | \
+				 NS_CLIENTATTR_USEKEEPALIVE)
+
+/*%
+ * The COOKIE option is the one piece of per-client content which a
+ * copy of a response can be patched for; see ns_query_sendwaiters().
+ */
+#define COOKIE_CLIENTATTRS	(NS_CLIENTATTR_WANTCOOKIE | \
+				 NS_CLIENTATTR_HAVECOOKIE)
+
+/*%
+ * Answer cache variant bits; the low 16 bits hold the UDP response
+ * size limit.
+ */
+#define ANSVARIANT_TCP		0x00010000
+#define ANSVARIANT_EDNS		0x00020000
+#define ANSVARIANT_DO		0x00040000
+#define ANSVARIANT_AD		0x00080000
+#define ANSVARIANT_RD		0x00100000
+#define ANSVARIANT_CD		0x00200000
+#define ANSVARIANT_INET6	0x00400000
+#define ANSVARIANT_COOKIE	0x00800000
+#define ANSVARIANT_HAVECOOKIE	0x01000000
+
+/*%
+ * Set in the 'info' of an answer cache entry if the response has AA
+ * set; the rest is the ns_statscounter_t that query_send() counted it
+ * under.
+ */
+#define ANSINFO_AUTHANS		0x10000
+
 /*% Does the rdataset 'r' have an attached 'No QNAME Proof'? */
 #define NOQNAME(r)		(((r)->attributes & \
 				  DNS_RDATASETATTR_NOQNAME) != 0)
@@ -343,6 +394,9 @@ query_setup(ns_client_t *client, dns_rdatatype_t qtype);
 static isc_result_t
 query_lookup(query_ctx_t *qctx);
 
+static isc_result_t
+query_anscache(query_ctx_t *qctx);
+
 static void
 fetch_callback(isc_task_t *task, isc_event_t *event);
 
@@ -350,6 +404,9 @@ static void
 recparam_update(ns_query_recparam_t *param, dns_rdatatype_t qtype,
 		const dns_name_t *qname, const dns_name_t *qdomain);
 
+static void
+query_freewaitlist(ns_client_t *client);
+
 static isc_result_t
 query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	      dns_name_t *qdomain, dns_rdataset_t *nameservers,
@@ -489,15 +546,14 @@ inc_stats(ns_client_t *client, isc_statscounter_t counter) {
 	}
 }
 
-static void
-query_send(ns_client_t *client) {
+/*%
+ * Return the statistics counter for the kind of response in
+ * client->message.
+ */
+static isc_statscounter_t
+query_respcounter(ns_client_t *client) {
 	isc_statscounter_t counter;
 
-	if ((client->message->flags & DNS_MESSAGEFLAG_AA) == 0)
-		inc_stats(client, ns_statscounter_nonauthans);
-	else
-		inc_stats(client, ns_statscounter_authans);
-
 	if (client->message->rcode == dns_rcode_noerror) {
 		dns_section_t answer = DNS_SECTION_ANSWER;
 		if (ISC_LIST_EMPTY(client->message->sections[answer])) {
@@ -514,7 +570,17 @@ query_send(ns_client_t *client) {
 	else /* We end up here in case of YXDOMAIN, and maybe others */
 		counter = ns_statscounter_failure;
 
-	inc_stats(client, counter);
+	return (counter);
+}
+
+static void
+query_send(ns_client_t *client) {
+	if ((client->message->flags & DNS_MESSAGEFLAG_AA) == 0)
+		inc_stats(client, ns_statscounter_nonauthans);
+	else
+		inc_stats(client, ns_statscounter_authans);
+
+	inc_stats(client, query_respcounter(client));
 	ns_client_send(client);
 }
 
@@ -545,7 +611,9 @@ query_error(ns_client_t *client, isc_result_t result, int line) {
 
 static void
 query_next(ns_client_t *client, isc_result_t result) {
-	if (result == DNS_R_DUPLICATE)
+	if (result == DNS_R_DUPLICATE && WAITING(client))
+		inc_stats(client, ns_statscounter_recursjoin);
+	else if (result == DNS_R_DUPLICATE)
 		inc_stats(client, ns_statscounter_duplicate);
 	else if (result == DNS_R_DROP)
 		inc_stats(client, ns_statscounter_dropped);
@@ -638,6 +706,11 @@ query_reset(ns_client_t *client, bool everything) {
 		dns_db_detach(&client->query.authdb);
 	if (client->query.authzone != NULL)
 		dns_zone_detach(&client->query.authzone);
+	if (client->query.ans.cache != NULL)
+		dns_anscache_detach(&client->query.ans.cache);
+	client->query.ans.version = NULL;
+	if (client->query.waitlist != NULL)
+		query_freewaitlist(client);
 
 	if (client->query.dns64_aaaa != NULL)
 		query_putrdataset(client, &client->query.dns64_aaaa);
@@ -955,6 +1028,8 @@ ns_query_init(ns_client_t *client) {
 	client->query.redirect.is_zone = false;
 	client->query.redirect.fname =
 		dns_fixedname_initname(&client->query.redirect.fixed);
+	client->query.ans.cache = NULL;
+	client->query.waitlist = NULL;
 	query_reset(client, false);
 	result = query_newdbversion(client, 3);
 	if (result != ISC_R_SUCCESS) {
@@ -2464,6 +2539,13 @@ query_prefetch(ns_client_t *client, dns_name_t *qname,
 	ns_client_t *dummy = NULL;
 	unsigned int options;
 
+	if (client->view->hotnames != NULL &&
+	    (rdataset->attributes & DNS_RDATASETATTR_PREFETCH) != 0)
+	{
+		dns_hotnames_hit(client->view->hotnames, qname,
+				 rdataset->type, rdataset->ttl);
+	}
+
 	if (client->query.prefetch != NULL ||
 	    client->view->prefetch_trigger == 0U ||
 	    rdataset->ttl > client->view->prefetch_trigger ||
@@ -5417,6 +5499,14 @@ ns__query_start(query_ctx_t *qctx) {
 		} else {
 			inc_stats(qctx->client, ns_statscounter_udp);
 		}
+
+		/*
+		 * Check the zone's answer cache.
+		 */
+		result = query_anscache(qctx);
+		if (result != ISC_R_COMPLETE) {
+			return (result);
+		}
 	}
 
 	return (query_lookup(qctx));
@@ -5686,6 +5776,396 @@ recparam_update(ns_query_recparam_t *param, dns_rdatatype_t qtype,
 	}
 }
 
+/*%
+ * Compute the variant which describes everything other than the query
+ * name, type and class that the rendered response to the current
+ * query of 'client' depends on.  Return false if the response may
+ * also be rewritten by the view, or carry content specific to this
+ * client other than a COOKIE option, so that it cannot be shared
+ * with other clients.
+ */
+static bool
+query_variant(ns_client_t *client, uint32_t *variantp) {
+	dns_view_t *view = client->view;
+	uint32_t variant = 0;
+	unsigned int udpsize;
+
+	if (view->rpzs != NULL || view->rrl != NULL ||
+	    view->dns64cnt != 0 || view->sortlist != NULL ||
+	    view->nocasecompress != NULL ||
+	    view->v4_aaaa != dns_aaaa_ok || view->v6_aaaa != dns_aaaa_ok)
+	{
+		return (false);
+	}
+
+#ifdef NS_HOOKS_ENABLE
+	if (ns__hook_table != NULL) {
+		return (false);
+	}
+#endif /* NS_HOOKS_ENABLE */
+
+	if (client->message->rdclass != view->rdclass ||
+	    client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL ||
+	    client->signer != NULL ||
+	    (client->attributes &
+	     ANSCACHE_CLIENTATTRS & ~COOKIE_CLIENTATTRS) != 0 ||
+	    client->query.root_key_sentinel_is_ta ||
+	    client->query.root_key_sentinel_not_ta)
+	{
+		return (false);
+	}
+
+	if (TCP(client)) {
+		variant |= ANSVARIANT_TCP;
+	} else {
+		udpsize = client->udpsize;
+		if (!HAVECOOKIE(client)) {
+			udpsize = ISC_MIN(view->nocookieudp, udpsize);
+		}
+		variant |= ISC_MIN(udpsize, 0xffff);
+	}
+	if (WANTCOOKIE(client)) {
+		variant |= ANSVARIANT_COOKIE;
+	}
+	if (HAVECOOKIE(client)) {
+		variant |= ANSVARIANT_HAVECOOKIE;
+	}
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		variant |= ANSVARIANT_EDNS;
+	}
+	if (WANTDNSSEC(client)) {
+		variant |= ANSVARIANT_DO;
+	}
+	if (WANTAD(client)) {
+		variant |= ANSVARIANT_AD;
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+		variant |= ANSVARIANT_RD;
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_CD) != 0) {
+		variant |= ANSVARIANT_CD;
+	}
+	/* The preferred glue depends on the transport of the query. */
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6) {
+		variant |= ANSVARIANT_INET6;
+	}
+
+	*variantp = variant;
+	return (true);
+}
+
+/*%
+ * A client whose query is identical to one that another client is
+ * already resolving does not recurse itself.  Instead it leaves a
+ * waiter record on the other client's wait list and goes back to
+ * serving requests; when the response to the first query has been
+ * rendered, it is copied to each waiter with the message ID patched.
+ *
+ * Wait lists are found by a key made up of the view, the interface
+ * the queries arrived on, the variant computed by query_variant(),
+ * and the query class, type and name; the name is compared with its
+ * case preserved, since it is echoed in the response.  There is at
+ * most one wait list per recursing client, and each is limited to
+ * WAITLIST_MAXWAITERS waiters.
+ */
+#define WAITLIST_MAXWAITERS	1000
+#define WAITLIST_MAXKEY		(2 * sizeof(void *) + 8 + DNS_NAME_MAXWIRE)
+
+typedef struct query_waiter query_waiter_t;
+
+struct query_waiter {
+	isc_sockaddr_t			peeraddr;
+	struct in6_pktinfo		pktinfo;
+	bool				usepktinfo;
+	dns_messageid_t			id;
+	unsigned char			cookie[NS_COOKIE_SIZE];
+	ISC_LINK(query_waiter_t)	link;
+};
+
+struct ns_waitlist {
+	ns_client_t *			owner;
+	unsigned int			count;
+	ISC_LIST(query_waiter_t)	waiters;
+	unsigned int			keysize;
+	unsigned char			key[WAITLIST_MAXKEY];
+};
+
+/*%
+ * Build the wait list key for the current query of 'client' in 'key',
+ * which must be WAITLIST_MAXKEY bytes long.  Return false if the
+ * query's response cannot be shared with other clients.
+ */
+static bool
+query_waitkey(ns_client_t *client, unsigned char *key,
+	      unsigned int *keysizep)
+{
+	isc_buffer_t b;
+	isc_region_t r;
+	uint32_t variant;
+
+	if (TCP(client) ||
+	    (client->attributes & NS_CLIENTATTR_RA) == 0 ||
+	    (client->attributes & NS_CLIENTATTR_MULTICAST) != 0 ||
+	    !query_variant(client, &variant))
+	{
+		return (false);
+	}
+
+	isc_buffer_init(&b, key, WAITLIST_MAXKEY);
+	isc_buffer_putmem(&b, (unsigned char *)&client->view,
+			  sizeof(client->view));
+	isc_buffer_putmem(&b, (unsigned char *)&client->interface,
+			  sizeof(client->interface));
+	isc_buffer_putuint32(&b, variant);
+	isc_buffer_putuint16(&b, client->message->rdclass);
+	isc_buffer_putuint16(&b, client->query.qtype);
+	dns_name_toregion(client->query.qname, &r);
+	isc_buffer_putmem(&b, r.base, r.length);
+
+	*keysizep = isc_buffer_usedlength(&b);
+	return (true);
+}
+
+/*%
+ * If another client is resolving a query identical to the current
+ * query of 'client', add 'client' to its wait list and return
+ * ISC_R_SUCCESS.  Otherwise, if the query is eligible, start a wait
+ * list for other clients to wait on 'client', and return
+ * ISC_R_NOTFOUND so that 'client' recurses as usual.
+ */
+static isc_result_t
+query_wait(ns_client_t *client) {
+	ns_server_t *sctx = client->sctx;
+	ns_waitlist_t *waitlist = NULL;
+	query_waiter_t *waiter;
+	unsigned char key[WAITLIST_MAXKEY];
+	unsigned char cookie[NS_COOKIE_SIZE];
+	unsigned int keysize;
+	isc_result_t result;
+
+	if (!query_waitkey(client, key, &keysize)) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	if (WANTCOOKIE(client)) {
+		ns_client_makecookie(client, cookie);
+	}
+
+	LOCK(&sctx->waitlock);
+	result = isc_ht_find(sctx->waitlists, key, keysize,
+			     (void **)&waitlist);
+	if (result == ISC_R_SUCCESS) {
+		if (waitlist->count >= WAITLIST_MAXWAITERS) {
+			result = ISC_R_NOTFOUND;
+			goto unlock;
+		}
+		waiter = isc_mem_get(sctx->mctx, sizeof(*waiter));
+		if (waiter == NULL) {
+			result = ISC_R_NOTFOUND;
+			goto unlock;
+		}
+		waiter->peeraddr = client->peeraddr;
+		waiter->pktinfo = client->pktinfo;
+		waiter->usepktinfo =
+			((client->attributes & NS_CLIENTATTR_PKTINFO) != 0);
+		waiter->id = client->message->id;
+		memmove(waiter->cookie, cookie, sizeof(cookie));
+		ISC_LINK_INIT(waiter, link);
+		ISC_LIST_APPEND(waitlist->waiters, waiter, link);
+		waitlist->count++;
+		client->query.attributes |= NS_QUERYATTR_WAITING;
+		goto unlock;
+	}
+
+	waitlist = isc_mem_get(sctx->mctx, sizeof(*waitlist));
+	if (waitlist == NULL) {
+		goto unlock;
+	}
+	waitlist->owner = client;
+	waitlist->count = 0;
+	ISC_LIST_INIT(waitlist->waiters);
+	waitlist->keysize = keysize;
+	memmove(waitlist->key, key, keysize);
+	if (isc_ht_add(sctx->waitlists, key, keysize,
+		       waitlist) != ISC_R_SUCCESS)
+	{
+		isc_mem_put(sctx->mctx, waitlist, sizeof(*waitlist));
+		goto unlock;
+	}
+	client->query.waitlist = waitlist;
+	result = ISC_R_NOTFOUND;
+
+ unlock:
+	UNLOCK(&sctx->waitlock);
+	return (result);
+}
+
+/*%
+ * Take the wait list of 'client' out of the server's table, so that
+ * no more clients can join it, and return it.
+ */
+static ns_waitlist_t *
+query_unlinkwaitlist(ns_client_t *client) {
+	ns_server_t *sctx = client->sctx;
+	ns_waitlist_t *waitlist = client->query.waitlist;
+	isc_result_t result;
+
+	INSIST(waitlist->owner == client);
+
+	LOCK(&sctx->waitlock);
+	result = isc_ht_delete(sctx->waitlists, waitlist->key,
+			       waitlist->keysize);
+	UNLOCK(&sctx->waitlock);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	client->query.waitlist = NULL;
+	return (waitlist);
+}
+
+/*%
+ * Free the wait list of 'client' without answering the waiters; the
+ * query is being abandoned without a response.
+ */
+static void
+query_freewaitlist(ns_client_t *client) {
+	ns_server_t *sctx = client->sctx;
+	ns_waitlist_t *waitlist;
+	query_waiter_t *waiter;
+
+	waitlist = query_unlinkwaitlist(client);
+	while ((waiter = ISC_LIST_HEAD(waitlist->waiters)) != NULL) {
+		ISC_LIST_UNLINK(waitlist->waiters, waiter, link);
+		isc_mem_put(sctx->mctx, waiter, sizeof(*waiter));
+	}
+	isc_mem_put(sctx->mctx, waitlist, sizeof(*waitlist));
+}
+
+static void
+query_waitersenddone(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *sevent = (isc_socketevent_t *) event;
+	ns_server_t *sctx = sevent->ev_arg;
+
+	UNUSED(task);
+
+	isc_mem_put(sctx->mctx, sevent->region.base, sevent->region.length);
+	isc_event_free(&event);
+	ns_server_detach(&sctx);
+}
+
+/*%
+ * Send a copy of the response 'wire' to 'waiter' from the socket of
+ * 'client', and count it as a response.  If 'cookie' is true, 'wire'
+ * ends with a COOKIE option, which is replaced with the waiter's.
+ */
+static void
+query_sendwaiter(ns_client_t *client, query_waiter_t *waiter,
+		 const isc_region_t *wire, bool cookie,
+		 unsigned int respcounter)
+{
+	ns_server_t *sctx = NULL;
+	struct in6_pktinfo *pktinfo = NULL;
+	isc_region_t r;
+	isc_result_t result;
+	isc_stats_t *sizestats;
+
+	r.base = isc_mem_get(client->sctx->mctx, wire->length);
+	if (r.base == NULL) {
+		return;
+	}
+	r.length = wire->length;
+	memmove(r.base, wire->base, wire->length);
+	r.base[0] = (waiter->id >> 8) & 0xff;
+	r.base[1] = waiter->id & 0xff;
+	if (cookie) {
+		memmove(r.base + r.length - NS_COOKIE_SIZE, waiter->cookie,
+			NS_COOKIE_SIZE);
+	}
+
+	if (waiter->usepktinfo) {
+		pktinfo = &waiter->pktinfo;
+	}
+
+	ns_server_attach(client->sctx, &sctx);
+	result = isc_socket_sendto(client->udpsocket, &r, client->task,
+				   query_waitersenddone, sctx,
+				   &waiter->peeraddr, pktinfo);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(sctx->mctx, r.base, r.length);
+		ns_server_detach(&sctx);
+		return;
+	}
+
+	sizestats = (isc_sockaddr_pf(&waiter->peeraddr) == AF_INET)
+			? client->sctx->udpoutstats4
+			: client->sctx->udpoutstats6;
+	isc_stats_increment(sizestats, ISC_MIN((int)r.length / 16, 256));
+	inc_stats(client, ns_statscounter_response);
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		inc_stats(client, ns_statscounter_edns0out);
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) {
+		inc_stats(client, ns_statscounter_authans);
+	} else {
+		inc_stats(client, ns_statscounter_nonauthans);
+	}
+	inc_stats(client, respcounter);
+	dns_rcodestats_increment(client->sctx->rcodestats,
+				 client->message->rcode);
+}
+
+void
+ns_query_sendwaiters(ns_client_t *client, isc_buffer_t *buffer) {
+	static const unsigned char cookieopt[4] = {
+		DNS_OPT_COOKIE >> 8, DNS_OPT_COOKIE & 0xff,
+		NS_COOKIE_SIZE >> 8, NS_COOKIE_SIZE & 0xff
+	};
+	ns_server_t *sctx;
+	ns_waitlist_t *waitlist;
+	query_waiter_t *waiter;
+	unsigned int respcounter;
+	isc_region_t r;
+	bool cookie;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(buffer != NULL);
+
+	if (client->query.waitlist == NULL) {
+		return;
+	}
+
+	isc_buffer_usedregion(buffer, &r);
+
+	/*
+	 * A response to a client which sent a cookie ends with the OPT
+	 * record, which carries only the COOKIE option; see
+	 * query_variant().  If it does not look like that, the waiters
+	 * are left to retry.
+	 */
+	cookie = WANTCOOKIE(client);
+	if (cookie &&
+	    (r.length < DNS_MESSAGE_HEADERLEN + 4 + NS_COOKIE_SIZE ||
+	     memcmp(r.base + r.length - NS_COOKIE_SIZE - 4, cookieopt,
+		    sizeof(cookieopt)) != 0 ||
+	     memcmp(r.base + r.length - NS_COOKIE_SIZE, client->cookie,
+		    sizeof(client->cookie)) != 0))
+	{
+		query_freewaitlist(client);
+		return;
+	}
+
+	sctx = client->sctx;
+	waitlist = query_unlinkwaitlist(client);
+	respcounter = query_respcounter(client);
+
+	while ((waiter = ISC_LIST_HEAD(waitlist->waiters)) != NULL) {
+		ISC_LIST_UNLINK(waitlist->waiters, waiter, link);
+		query_sendwaiter(client, waiter, &r, cookie, respcounter);
+		isc_mem_put(sctx->mctx, waiter, sizeof(*waiter));
+	}
+	isc_mem_put(sctx->mctx, waitlist, sizeof(*waitlist));
+}
+
 /*%
  * Prepare client for recursion, then create a resolver fetch, with
  * the event callback set to fetch_callback(). Afterward we terminate
@@ -5716,6 +6196,20 @@ query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 
 	recparam_update(&client->query.recparam, qtype, qname, qdomain);
 
+	/*
+	 * Wait for the response to an identical query if one is already
+	 * being resolved.  Only the original question qualifies.
+	 */
+	if (!resuming && client->query.restarts == 0 &&
+	    qtype == client->query.qtype && qname == client->query.qname &&
+	    client->query.waitlist == NULL)
+	{
+		result = query_wait(client);
+		if (result == ISC_R_SUCCESS) {
+			return (DNS_R_DUPLICATE);
+		}
+	}
+
 	if (!resuming)
 		inc_stats(client, ns_statscounter_recursion);
 
@@ -6115,6 +6609,165 @@ ns__query_sfcache(query_ctx_t *qctx) {
 	return (ISC_R_COMPLETE);
 }
 
+/*%
+ * Decide whether the response to the current query may be taken from,
+ * or added to, the answer cache of the zone it is answered from, and
+ * if so, compute the variant which describes everything other than
+ * the query name and type that the rendered response depends on.
+ *
+ * Only plain authoritative answers from a single zone qualify: any
+ * feature which can rewrite the response, add per-client content to
+ * it or pull in data from another zone or the cache disqualifies it.
+ */
+static bool
+query_ansvariant(query_ctx_t *qctx, uint32_t *variantp) {
+	ns_client_t *client = qctx->client;
+	dns_view_t *view = client->view;
+
+	if (!qctx->is_zone || !qctx->authoritative || qctx->zone == NULL ||
+	    qctx->is_staticstub_zone || qctx->qtype == dns_rdatatype_ds ||
+	    dns_zone_getview(qctx->zone) != view || view->recursion ||
+	    (client->attributes & COOKIE_CLIENTATTRS) != 0)
+	{
+		return (false);
+	}
+
+	return (query_variant(client, variantp));
+}
+
+/*%
+ * Look for the response to the current query in the answer cache of
+ * the zone it is answered from, and send it if it is there.
+ *
+ * Otherwise, if the zone has an answer cache, arrange for the rendered
+ * response to be added to it by ns_query_cacheanswer(), and return
+ * ISC_R_COMPLETE so that query processing continues.
+ */
+static isc_result_t
+query_anscache(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_anscache_t *cache = NULL;
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+	uint32_t variant, generation;
+	unsigned int info;
+	unsigned char wire[DNS_ANSCACHE_MAXLENGTH];
+
+	if (!query_ansvariant(qctx, &variant)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	dns_zone_getanswercache(qctx->zone, &cache);
+	if (cache == NULL) {
+		return (ISC_R_COMPLETE);
+	}
+
+	/*
+	 * Note the generation before looking anything up, so that a
+	 * response rendered from data which changes in the meantime is
+	 * not cached.
+	 */
+	generation = dns_anscache_generation(cache);
+
+	isc_buffer_init(&b, wire, sizeof(wire));
+	result = dns_anscache_find(cache, client->query.qname, qctx->qtype,
+				   variant, &b, &info);
+	if (result != ISC_R_SUCCESS) {
+		client->query.ans.cache = cache;
+		client->query.ans.version = qctx->version;
+		client->query.ans.generation = generation;
+		client->query.ans.variant = variant;
+		client->query.attributes |= NS_QUERYATTR_ANSCACHE;
+		return (ISC_R_COMPLETE);
+	}
+
+	dns_anscache_detach(&cache);
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_anscache: hit");
+
+	if ((info & ANSINFO_AUTHANS) != 0) {
+		inc_stats(client, ns_statscounter_authans);
+	} else {
+		inc_stats(client, ns_statscounter_nonauthans);
+	}
+	inc_stats(client, info & ~ANSINFO_AUTHANS);
+	inc_stats(client, ns_statscounter_anscachehit);
+
+	qctx_clean(qctx);
+	qctx_freedata(qctx);
+
+	isc_buffer_usedregion(&b, &r);
+	ns_client_sendwire(client, &r);
+
+	ns_client_detach(&qctx->client);
+	return (ISC_R_SUCCESS);
+}
+
+void
+ns_query_cacheanswer(ns_client_t *client, isc_buffer_t *buffer) {
+	dns_dbversion_t *version = NULL;
+	dns_db_t *db = NULL;
+	isc_region_t r;
+	unsigned int info;
+	bool current;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(buffer != NULL);
+
+	if (!ANSCACHE(client)) {
+		return;
+	}
+
+	/*
+	 * Only cache complete, final answers to the original question.
+	 */
+	if ((client->message->rcode != dns_rcode_noerror &&
+	     client->message->rcode != dns_rcode_nxdomain) ||
+	    (client->message->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    client->query.restarts != 0 ||
+	    client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL ||
+	    client->query.authdb == NULL || client->query.authzone == NULL)
+	{
+		return;
+	}
+
+	/*
+	 * The response must have been built from the current version of
+	 * the zone's current database; if not, it may already be stale.
+	 * Any later change flushes the cache and advances its generation,
+	 * which dns_anscache_add() checks.
+	 */
+	dns_db_currentversion(client->query.authdb, &version);
+	current = (version == client->query.ans.version);
+	dns_db_closeversion(client->query.authdb, &version, false);
+	if (!current) {
+		return;
+	}
+	if (dns_zone_getdb(client->query.authzone, &db) != ISC_R_SUCCESS) {
+		return;
+	}
+	current = (db == client->query.authdb);
+	dns_db_detach(&db);
+	if (!current) {
+		return;
+	}
+
+	info = query_respcounter(client);
+	if ((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) {
+		info |= ANSINFO_AUTHANS;
+	}
+
+	isc_buffer_usedregion(buffer, &r);
+	(void)dns_anscache_add(client->query.ans.cache,
+			       client->query.origqname,
+			       client->query.qtype,
+			       client->query.ans.variant,
+			       client->query.ans.generation,
+			       info, &r);
+}
+
 /*%
  * Handle response rate limiting (RRL).
  */
@@ -9277,6 +9930,14 @@ query_coveringnsec(query_ctx_t *qctx) {
 		return (result);
 	}
 
+	if (done && RECURSIONOK(qctx->client)) {
+		/*
+		 * Without the synthesized answer this query would have
+		 * been sent upstream.
+		 */
+		inc_stats(qctx->client, ns_statscounter_synthrecavoided);
+	}
+
 	if (!done) {
 		/*
 		 * No covering NSEC was found; proceed with recursion.
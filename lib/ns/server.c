@@ -56,6 +56,9 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 	CHECKFATAL(isc_quota_init(&sctx->tcpquota, 10));
 	CHECKFATAL(isc_quota_init(&sctx->recursionquota, 100));
 
+	CHECKFATAL(isc_mutex_init(&sctx->waitlock));
+	CHECKFATAL(isc_ht_init(&sctx->waitlists, mctx, 8));
+
 	CHECKFATAL(dns_tkeyctx_create(mctx, &sctx->tkeyctx));
 
 	CHECKFATAL(ns_stats_create(mctx, ns_statscounter_max, &sctx->nsstats));
@@ -145,6 +148,10 @@ ns_server_detach(ns_server_t **sctxp) {
 		isc_quota_destroy(&sctx->tcpquota);
 		isc_quota_destroy(&sctx->xfroutquota);
 
+		INSIST(isc_ht_count(sctx->waitlists) == 0);
+		isc_ht_destroy(&sctx->waitlists);
+		DESTROYLOCK(&sctx->waitlock);
+
 		if (sctx->server_id != NULL)
 			isc_mem_free(sctx->mctx, sctx->server_id);
 